@@ -0,0 +1,311 @@
+#ifndef HPP_AES256CTRCIPHER_H
+#define HPP_AES256CTRCIPHER_H
+
+#include "cipher.h"
+#include "noncopyable.h"
+#include "thread.h"
+#include "cores.h"
+#include "assert.h"
+#include "exception.h"
+
+#include <openssl/evp.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// AES-256 in counter mode. Every block of keystream depends only on the
+// key and its position, so big buffers are split to segments that are
+// encrypted on multiple threads. Result is the same as with one thread,
+// and does not depend on how data is split to calls. Encryption and
+// decryption are the same operation, and there is no padding.
+class AES256CTRCipher : public Cipher, public NonCopyable
+{
+
+public:
+
+	// Size of initialization vector. It is the initial value
+	// of the counter, and it is incremented as big endian.
+	static size_t const IV_SIZE = 16;
+	static size_t const KEY_SIZE = 32;
+
+	// If threads is zero, all cores are used
+	inline AES256CTRCipher(void);
+	inline AES256CTRCipher(ByteV const& key, ByteV const& iv, size_t threads = 1);
+	inline virtual ~AES256CTRCipher(void);
+
+	inline void init(ByteV const& key, ByteV const& iv, size_t threads = 1);
+
+	// Starts from beginning of keystream of given initialization vector
+	inline void reset(ByteV const& iv) { resetEncryption(iv); resetDecryption(iv); }
+	inline void resetEncryption(ByteV const& iv);
+	inline void resetDecryption(ByteV const& iv);
+
+private:
+
+	// Buffers smaller than this are not split to threads
+	static size_t const MIN_SEGMENT_SIZE = 64 * 1024;
+
+	// Encryption of one segment
+	struct Job
+	{
+		EVP_CIPHER_CTX* ctx;
+		uint8_t counter[IV_SIZE];
+		size_t skip;
+		uint8_t* result;
+		uint8_t const* data;
+		size_t data_size;
+		std::string error;
+	};
+	typedef std::vector< Job > Jobs;
+
+	typedef std::vector< EVP_CIPHER_CTX* > Contexts;
+
+	bool initialized;
+
+	// One context for every thread. All have the same key.
+	Contexts ctxs;
+
+	// Initialization vectors and positions in keystreams
+	uint8_t enc_iv[IV_SIZE];
+	uint8_t dec_iv[IV_SIZE];
+	uint64_t enc_pos;
+	uint64_t dec_pos;
+
+	inline virtual void doEncryption(ByteV& result, uint8_t const* data, size_t data_size);
+	inline virtual void finalizeEncryption(ByteV& result) { (void)result; }
+	inline virtual void doDecryption(ByteV& result, uint8_t const* data, size_t data_size);
+	inline virtual void finalizeDecryption(ByteV& result) { (void)result; }
+
+	inline virtual size_t doEncryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize);
+	inline virtual size_t doDecryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize);
+
+	// Applies keystream at given position to data
+	inline void process(uint8_t* result, uint8_t const* data, size_t data_size, uint8_t const* iv, uint64_t pos);
+
+	static void runJob(void* job_raw);
+
+	inline void setIv(uint8_t* dest, ByteV const& iv);
+
+	inline void freeContexts(void);
+
+};
+
+inline AES256CTRCipher::AES256CTRCipher(void) :
+initialized(false),
+enc_pos(0),
+dec_pos(0)
+{
+}
+
+inline AES256CTRCipher::AES256CTRCipher(ByteV const& key, ByteV const& iv, size_t threads) :
+initialized(false),
+enc_pos(0),
+dec_pos(0)
+{
+	try {
+		init(key, iv, threads);
+	}
+	catch ( ... ) {
+		freeContexts();
+		throw;
+	}
+}
+
+inline AES256CTRCipher::~AES256CTRCipher(void)
+{
+	// For security, clean ciphers. Freeing does it.
+	freeContexts();
+}
+
+inline void AES256CTRCipher::init(ByteV const& key, ByteV const& iv, size_t threads)
+{
+	freeContexts();
+
+	if (key.size() != KEY_SIZE) {
+		throw Exception("Key has invalid size!");
+	}
+	setIv(enc_iv, iv);
+	setIv(dec_iv, iv);
+	enc_pos = 0;
+	dec_pos = 0;
+
+	if (threads == 0) {
+		threads = getNumberOfCores();
+	}
+	ctxs.reserve(threads);
+	while (ctxs.size() < threads) {
+		EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+		if (!ctx) {
+			throw Exception("Unable to create OpenSSL cipher context!");
+		}
+		ctxs.push_back(ctx);
+		if (!EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), NULL, &key[0], NULL)) {
+			throw Exception("Unable to initialize OpenSSL cipher!");
+		}
+	}
+
+	initialized = true;
+}
+
+inline void AES256CTRCipher::resetEncryption(ByteV const& iv)
+{
+	setIv(enc_iv, iv);
+	enc_pos = 0;
+}
+
+inline void AES256CTRCipher::resetDecryption(ByteV const& iv)
+{
+	setIv(dec_iv, iv);
+	dec_pos = 0;
+}
+
+inline void AES256CTRCipher::doEncryption(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	size_t result_begin = result.size();
+	result.resize(result_begin + data_size);
+	if (data_size > 0) {
+		doEncryptionInto(&result[result_begin], data, data_size, false);
+	}
+}
+
+inline void AES256CTRCipher::doDecryption(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	size_t result_begin = result.size();
+	result.resize(result_begin + data_size);
+	if (data_size > 0) {
+		doDecryptionInto(&result[result_begin], data, data_size, false);
+	}
+}
+
+inline size_t AES256CTRCipher::doEncryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
+{
+	(void)finalize;
+	process(result, data, data_size, enc_iv, enc_pos);
+	enc_pos += data_size;
+	return data_size;
+}
+
+inline size_t AES256CTRCipher::doDecryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
+{
+	(void)finalize;
+	process(result, data, data_size, dec_iv, dec_pos);
+	dec_pos += data_size;
+	return data_size;
+}
+
+inline void AES256CTRCipher::process(uint8_t* result, uint8_t const* data, size_t data_size, uint8_t const* iv, uint64_t pos)
+{
+	if (!initialized) {
+		throw Exception("Cipher is not initialized!");
+	}
+	if (data_size == 0) {
+		return;
+	}
+
+	// Split data to segments. Segments end at
+	// block boundaries, except the last one.
+	size_t segments = std::min(ctxs.size(), (data_size + size_t(MIN_SEGMENT_SIZE) - 1) / MIN_SEGMENT_SIZE);
+	size_t segment_size = ((data_size + segments - 1) / segments + IV_SIZE - 1) / IV_SIZE * IV_SIZE;
+	Jobs jobs;
+	jobs.reserve(segments);
+	for (size_t segment_begin = 0; segment_begin < data_size; segment_begin += segment_size) {
+		jobs.push_back(Job());
+		Job& job = jobs.back();
+		job.ctx = ctxs[jobs.size() - 1];
+		job.result = result + segment_begin;
+		job.data = data + segment_begin;
+		job.data_size = std::min(segment_size, data_size - segment_begin);
+
+		// Counter is initialization vector plus number of block
+		uint64_t segment_pos = pos + segment_begin;
+		uint64_t add = segment_pos / IV_SIZE;
+		job.skip = segment_pos % IV_SIZE;
+		for (size_t byte = IV_SIZE; byte > 0; -- byte) {
+			uint64_t sum = uint64_t(iv[byte - 1]) + (add & 0xff);
+			job.counter[byte - 1] = sum;
+			add = (add >> 8) + (sum >> 8);
+		}
+	}
+	HppAssert(jobs.size() <= ctxs.size(), "Too many segments!");
+
+	// Run jobs. The first one is run by this thread.
+	std::vector< Thread > jobs_threads;
+	jobs_threads.reserve(jobs.size() - 1);
+	for (size_t job_id = 1; job_id < jobs.size(); ++ job_id) {
+		jobs_threads.push_back(Thread(runJob, reinterpret_cast< void* >(&jobs[job_id])));
+	}
+	runJob(reinterpret_cast< void* >(&jobs[0]));
+	for (size_t thread_id = 0; thread_id < jobs_threads.size(); ++ thread_id) {
+		jobs_threads[thread_id].wait();
+	}
+
+	for (Jobs::const_iterator jobs_it = jobs.begin();
+	     jobs_it != jobs.end();
+	     ++ jobs_it) {
+		if (!jobs_it->error.empty()) {
+			throw Exception(jobs_it->error);
+		}
+	}
+}
+
+inline void AES256CTRCipher::runJob(void* job_raw)
+{
+	Job& job = *reinterpret_cast< Job* >(job_raw);
+
+	// Only counter is set, key schedule is already in context
+	if (!EVP_EncryptInit_ex(job.ctx, NULL, NULL, NULL, job.counter)) {
+		job.error = "Unable to set counter of OpenSSL cipher!";
+		return;
+	}
+
+	// If segment begins in the middle of block,
+	// then beginning of keystream is thrown away.
+	int subresult_size;
+	if (job.skip > 0) {
+		uint8_t dummy[IV_SIZE] = { 0 };
+		if (!EVP_EncryptUpdate(job.ctx, dummy, &subresult_size, dummy, job.skip)) {
+			job.error = "Unable to encrypt with OpenSSL cipher!";
+			return;
+		}
+	}
+
+	// OpenSSL takes sizes as integers, so
+	// huge buffers are given in parts.
+	size_t const MAX_PART = 1 << 30;
+	size_t done = 0;
+	while (done < job.data_size) {
+		size_t part = std::min(job.data_size - done, MAX_PART);
+		if (!EVP_EncryptUpdate(job.ctx, job.result + done, &subresult_size, job.data + done, part)) {
+			job.error = "Unable to encrypt with OpenSSL cipher!";
+			return;
+		}
+		done += part;
+	}
+}
+
+inline void AES256CTRCipher::setIv(uint8_t* dest, ByteV const& iv)
+{
+	if (iv.size() != IV_SIZE) {
+		throw Exception("Initialization vector has invalid size!");
+	}
+	std::copy(iv.begin(), iv.end(), dest);
+}
+
+inline void AES256CTRCipher::freeContexts(void)
+{
+	for (Contexts::iterator ctxs_it = ctxs.begin();
+	     ctxs_it != ctxs.end();
+	     ++ ctxs_it) {
+		EVP_CIPHER_CTX_free(*ctxs_it);
+	}
+	ctxs.clear();
+	initialized = false;
+}
+
+}
+
+#endif
@@ -86,8 +86,8 @@ private:
 	float rad;
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -277,14 +277,14 @@ inline void Angle::constructFromJson(Json const& json)
 	rad = json.getNumber();
 }
 
-inline void Angle::doSerialize(ByteV& result, bool bigendian) const
+inline void Angle::doSerialize(BinaryWriter& writer) const
 {
-	result += floatToByteV(rad, bigendian);
+	writer.writeFloat(rad);
 }
 
-inline void Angle::doDeserialize(std::istream& strm, bool bigendian)
+inline void Angle::doDeserialize(BinaryReader& reader)
 {
-	rad = deserializeFloat(strm, bigendian);
+	rad = reader.readFloat();
 }
 
 inline Angle operator*(float f, Angle const& a)
@@ -0,0 +1,750 @@
+#ifndef HPP_ASYNCFILEIO_H
+#define HPP_ASYNCFILEIO_H
+
+#include "path.h"
+#include "bytev.h"
+#include "thread.h"
+#include "mutex.h"
+#include "lock.h"
+#include "condition.h"
+#include "cores.h"
+#include "exception.h"
+#include "noncopyable.h"
+#include "time.h"
+
+#include <queue>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <stdint.h>
+#ifdef HPP_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace Hpp
+{
+
+class AsyncFileIO;
+
+// Reading or writing of one whole file in the background. Request works
+// like a future: it can be polled with isDone() or waited with wait(),
+// and result is read from it after that. Callback can be set too. One
+// request can be used again after it is done.
+class AsyncFileRequest : public NonCopyable
+{
+
+	friend class AsyncFileIO;
+
+public:
+
+	enum Type { READ, WRITE };
+
+	// Called on I/O thread when request has finished, before waiters are
+	// woken up. Callback must be short, it must not throw, and it must not
+	// wait for other requests. It may submit new requests.
+	typedef void (*Callback)(AsyncFileRequest& request, void* data);
+
+	inline AsyncFileRequest(void);
+	// Waits if request is still pending
+	inline ~AsyncFileRequest(void);
+
+	// Prepares request without submitting it. Bigger
+	// priority is handled first. Bytes are copied.
+	inline void setRead(Path const& path, int priority = 0);
+	inline void setWrite(Path const& path, ByteV const& bytes, int priority = 0);
+	inline void setCallback(Callback callback, void* data);
+
+	inline bool isPending(void) const;
+	inline bool isDone(void) const;
+	inline void wait(void);
+
+	// Result, valid when request is done
+	inline Type getType(void) const { return type; }
+	inline Path const& getPath(void) const { return path; }
+	inline bool failed(void) const { return !error.empty(); }
+	inline std::string const& getError(void) const { return error; }
+	// Contents of read file. These can be swapped out.
+	inline ByteV& getData(void) { return data; }
+
+private:
+
+	enum State { IDLE, PENDING, DONE };
+
+	Type type;
+	Path path;
+	ByteV data;
+	int priority;
+
+	Callback callback;
+	void* callback_data;
+
+	// Set for requests that are created and destroyed by AsyncFileIO
+	bool owned_by_service;
+
+	mutable Mutex mutex;
+	Condition cond;
+	State state;
+	std::string error;
+
+	// Order of submission. Used when priorities are equal.
+	uint64_t order;
+
+	#ifdef HPP_USE_IO_URING
+	int fd;
+	size_t done_bytes;
+	struct iovec iov;
+	#endif
+
+	inline void ensureNotPending(void) const;
+
+};
+
+// Service that reads and writes files on background threads, so that
+// for example rendering thread does not need to wait for disk. Pending
+// requests are handled in order of priority. Destructor waits until
+// all submitted requests are done.
+//
+// There are two backends. Thread backend runs requests on a pool of
+// threads using functions of Path. If HPP_USE_IO_URING is defined, then
+// io_uring of Linux can be used instead. It has only one thread, that
+// submits all pending requests with one system call and lets kernel
+// do the rest. AUTO uses io_uring if it is available, and otherwise
+// falls back to threads.
+class AsyncFileIO : public NonCopyable
+{
+
+public:
+
+	enum Backend { AUTO, THREADS, IO_URING };
+
+	// If threads is zero, then one thread per core is used.
+	// Queue depth limits requests in flight in io_uring.
+	inline AsyncFileIO(Backend backend = AUTO, size_t threads = 0, size_t queue_depth = 64);
+	inline ~AsyncFileIO(void);
+
+	inline Backend getBackend(void) const { return backend; }
+
+	// Requests that are owned by caller. They must be alive until done.
+	inline void readAsync(AsyncFileRequest& request, Path const& path, int priority = 0);
+	inline void writeAsync(AsyncFileRequest& request, Path const& path, ByteV const& bytes, int priority = 0);
+
+	// Requests that are owned by service. They are destroyed after
+	// callback, so result must be swapped out of them in callback.
+	inline void readAsync(Path const& path, AsyncFileRequest::Callback callback, void* data, int priority = 0);
+	inline void writeAsync(Path const& path, ByteV const& bytes, AsyncFileRequest::Callback callback = NULL, void* data = NULL, int priority = 0);
+
+	// Submits requests that are prepared with setRead() or setWrite().
+	// Submitting many at once takes the lock and wakes threads once.
+	inline void submit(AsyncFileRequest& request);
+	inline void submit(std::vector< AsyncFileRequest* > const& requests);
+
+private:
+
+	// Bigger priority first, then older first
+	struct Compare
+	{
+		inline bool operator()(AsyncFileRequest const* r1, AsyncFileRequest const* r2) const
+		{
+			if (r1->priority != r2->priority) return r1->priority < r2->priority;
+			return r1->order > r2->order;
+		}
+	};
+	typedef std::priority_queue< AsyncFileRequest*, std::vector< AsyncFileRequest* >, Compare > Queue;
+
+	typedef std::vector< Thread > Threads;
+
+	Backend backend;
+
+	Mutex mutex;
+	Condition cond;
+	Queue queue;
+	uint64_t next_order;
+	bool stopping;
+
+	Threads threads;
+
+	#ifdef HPP_USE_IO_URING
+	// Rings that are shared with kernel
+	struct Ring
+	{
+		int fd;
+		unsigned entries;
+		void* sq_ptr;
+		size_t sq_size;
+		void* cq_ptr;
+		size_t cq_size;
+		struct io_uring_sqe* sqes;
+		size_t sqes_size;
+		unsigned* sq_tail;
+		unsigned* sq_mask;
+		unsigned* sq_array;
+		unsigned* cq_head;
+		unsigned* cq_tail;
+		unsigned* cq_mask;
+		struct io_uring_cqe* cqes;
+		// Entries that are queued but not yet given to kernel
+		unsigned unsubmitted;
+	};
+	Ring ring;
+
+	// Reads and writes are split to chunks of at most this size
+	static size_t const RING_CHUNK_SIZE = 64 * 1024 * 1024;
+
+	inline bool setupRing(size_t queue_depth);
+	inline void closeRing(void);
+	// Opens file and prepares request. Returns false if request is already done.
+	inline bool startRingRequest(AsyncFileRequest* request);
+	inline void queueRingChunk(AsyncFileRequest* request);
+	inline void enterRing(unsigned min_complete);
+	// Takes back entries that kernel has not taken and finishes their
+	// requests with error. Returns how many requests were finished.
+	inline unsigned failUnsubmitted(std::string const& error);
+	inline static void runRing(void* io_raw);
+	#endif
+
+	// Calls callback and marks request done
+	inline static void finish(AsyncFileRequest* request);
+
+	inline static void runWorker(void* io_raw);
+
+};
+
+inline AsyncFileRequest::AsyncFileRequest(void) :
+type(READ),
+priority(0),
+callback(NULL),
+callback_data(NULL),
+owned_by_service(false),
+state(IDLE),
+order(0)
+{
+}
+
+inline AsyncFileRequest::~AsyncFileRequest(void)
+{
+	Lock lock(mutex);
+	while (state == PENDING) {
+		cond.wait(mutex);
+	}
+}
+
+inline void AsyncFileRequest::setRead(Path const& path, int priority)
+{
+	ensureNotPending();
+	this->type = READ;
+	this->path = path;
+	this->priority = priority;
+	data.clear();
+}
+
+inline void AsyncFileRequest::setWrite(Path const& path, ByteV const& bytes, int priority)
+{
+	ensureNotPending();
+	this->type = WRITE;
+	this->path = path;
+	this->priority = priority;
+	data = bytes;
+}
+
+inline void AsyncFileRequest::setCallback(Callback callback, void* data)
+{
+	ensureNotPending();
+	this->callback = callback;
+	this->callback_data = data;
+}
+
+inline bool AsyncFileRequest::isPending(void) const
+{
+	Lock lock(mutex);
+	return state == PENDING;
+}
+
+inline bool AsyncFileRequest::isDone(void) const
+{
+	Lock lock(mutex);
+	return state == DONE;
+}
+
+inline void AsyncFileRequest::wait(void)
+{
+	Lock lock(mutex);
+	if (state == IDLE) {
+		throw Exception("Unable to wait for file request that is not submitted!");
+	}
+	while (state == PENDING) {
+		cond.wait(mutex);
+	}
+}
+
+inline void AsyncFileRequest::ensureNotPending(void) const
+{
+	if (isPending()) {
+		throw Exception("File request is still pending!");
+	}
+}
+
+inline AsyncFileIO::AsyncFileIO(Backend backend, size_t threads, size_t queue_depth) :
+backend(backend),
+next_order(0),
+stopping(false)
+{
+	#ifdef HPP_USE_IO_URING
+	ring.fd = -1;
+	if (backend == AUTO || backend == IO_URING) {
+		if (setupRing(queue_depth)) {
+			this->backend = IO_URING;
+			this->threads.push_back(Thread(runRing, reinterpret_cast< void* >(this)));
+			return;
+		}
+		if (backend == IO_URING) {
+			throw Exception("Unable to set up io_uring for file I/O!");
+		}
+	}
+	#else
+	(void)queue_depth;
+	if (backend == IO_URING) {
+		throw Exception("Support for io_uring is not compiled in! Define HPP_USE_IO_URING to enable it.");
+	}
+	#endif
+
+	this->backend = THREADS;
+	if (threads == 0) {
+		threads = getNumberOfCores();
+	}
+	this->threads.reserve(threads);
+	for (size_t thread_id = 0; thread_id < threads; ++ thread_id) {
+		this->threads.push_back(Thread(runWorker, reinterpret_cast< void* >(this)));
+	}
+}
+
+inline AsyncFileIO::~AsyncFileIO(void)
+{
+	Lock lock(mutex);
+	stopping = true;
+	lock.unlock();
+	cond.broadcast();
+	for (Threads::iterator threads_it = threads.begin();
+	     threads_it != threads.end();
+	     ++ threads_it) {
+		threads_it->wait();
+	}
+	#ifdef HPP_USE_IO_URING
+	closeRing();
+	#endif
+}
+
+inline void AsyncFileIO::readAsync(AsyncFileRequest& request, Path const& path, int priority)
+{
+	request.setRead(path, priority);
+	submit(request);
+}
+
+inline void AsyncFileIO::writeAsync(AsyncFileRequest& request, Path const& path, ByteV const& bytes, int priority)
+{
+	request.setWrite(path, bytes, priority);
+	submit(request);
+}
+
+inline void AsyncFileIO::readAsync(Path const& path, AsyncFileRequest::Callback callback, void* data, int priority)
+{
+	AsyncFileRequest* request = new AsyncFileRequest;
+	request->owned_by_service = true;
+	try {
+		request->setRead(path, priority);
+		request->setCallback(callback, data);
+		submit(*request);
+	}
+	catch ( ... ) {
+		delete request;
+		throw;
+	}
+}
+
+inline void AsyncFileIO::writeAsync(Path const& path, ByteV const& bytes, AsyncFileRequest::Callback callback, void* data, int priority)
+{
+	AsyncFileRequest* request = new AsyncFileRequest;
+	request->owned_by_service = true;
+	try {
+		request->setWrite(path, bytes, priority);
+		request->setCallback(callback, data);
+		submit(*request);
+	}
+	catch ( ... ) {
+		delete request;
+		throw;
+	}
+}
+
+inline void AsyncFileIO::submit(AsyncFileRequest& request)
+{
+	submit(std::vector< AsyncFileRequest* >(1, &request));
+}
+
+inline void AsyncFileIO::submit(std::vector< AsyncFileRequest* > const& requests)
+{
+	// Whole batch is checked before any of it is marked pending,
+	// because marked requests would otherwise never finish.
+	std::vector< AsyncFileRequest* > sorted(requests);
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+		throw Exception("Same file request is submitted more than once!");
+	}
+	for (std::vector< AsyncFileRequest* >::const_iterator requests_it = requests.begin();
+	     requests_it != requests.end();
+	     ++ requests_it) {
+		AsyncFileRequest* request = *requests_it;
+		Lock request_lock(request->mutex);
+		if (request->state == AsyncFileRequest::PENDING) {
+			throw Exception("File request is already pending!");
+		}
+	}
+
+	for (std::vector< AsyncFileRequest* >::const_iterator requests_it = requests.begin();
+	     requests_it != requests.end();
+	     ++ requests_it) {
+		AsyncFileRequest* request = *requests_it;
+		Lock request_lock(request->mutex);
+		request->state = AsyncFileRequest::PENDING;
+		request->error.clear();
+	}
+
+	Lock lock(mutex);
+	for (std::vector< AsyncFileRequest* >::const_iterator requests_it = requests.begin();
+	     requests_it != requests.end();
+	     ++ requests_it) {
+		(*requests_it)->order = next_order ++;
+		queue.push(*requests_it);
+	}
+	lock.unlock();
+	if (requests.size() == 1) {
+		cond.signal();
+	} else {
+		cond.broadcast();
+	}
+}
+
+inline void AsyncFileIO::finish(AsyncFileRequest* request)
+{
+	if (request->callback) {
+		request->callback(*request, request->callback_data);
+	}
+	if (request->owned_by_service) {
+		request->state = AsyncFileRequest::DONE;
+		delete request;
+		return;
+	}
+	Lock lock(request->mutex);
+	request->state = AsyncFileRequest::DONE;
+	request->cond.broadcast();
+}
+
+inline void AsyncFileIO::runWorker(void* io_raw)
+{
+	AsyncFileIO& io = *reinterpret_cast< AsyncFileIO* >(io_raw);
+
+	Lock lock(io.mutex);
+	while (true) {
+		while (io.queue.empty() && !io.stopping) {
+			io.cond.wait(io.mutex);
+		}
+		if (io.queue.empty()) {
+			break;
+		}
+		AsyncFileRequest* request = io.queue.top();
+		io.queue.pop();
+		lock.unlock();
+
+		try {
+			if (request->type == AsyncFileRequest::READ) {
+				request->path.readBytes(request->data);
+			} else {
+				request->path.writeBytes(request->data);
+			}
+		}
+		catch (Exception const& e) {
+			request->error = e.what();
+		}
+		catch (std::bad_alloc const&) {
+			request->error = "Out of memory in reading of file \"" + request->path.toString() + "\"!";
+		}
+		finish(request);
+
+		lock.relock();
+	}
+}
+
+#ifdef HPP_USE_IO_URING
+
+inline bool AsyncFileIO::setupRing(size_t queue_depth)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, unsigned(std::max< size_t >(queue_depth, 1)), &params);
+	if (fd < 0) {
+		return false;
+	}
+
+	ring.fd = fd;
+	ring.entries = params.sq_entries;
+	ring.unsubmitted = 0;
+	ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring.sq_ptr = MAP_FAILED;
+	ring.cq_ptr = MAP_FAILED;
+	ring.sqes = reinterpret_cast< struct io_uring_sqe* >(MAP_FAILED);
+
+	// Newer kernels map both rings at once
+	bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap) {
+		ring.sq_size = std::max(ring.sq_size, ring.cq_size);
+	}
+	ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring.sq_ptr == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+	if (single_mmap) {
+		ring.cq_ptr = ring.sq_ptr;
+	} else {
+		ring.cq_ptr = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (ring.cq_ptr == MAP_FAILED) {
+			closeRing();
+			return false;
+		}
+	}
+	void* sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+	ring.sqes = reinterpret_cast< struct io_uring_sqe* >(sqes);
+
+	uint8_t* sq = reinterpret_cast< uint8_t* >(ring.sq_ptr);
+	uint8_t* cq = reinterpret_cast< uint8_t* >(ring.cq_ptr);
+	ring.sq_tail = reinterpret_cast< unsigned* >(sq + params.sq_off.tail);
+	ring.sq_mask = reinterpret_cast< unsigned* >(sq + params.sq_off.ring_mask);
+	ring.sq_array = reinterpret_cast< unsigned* >(sq + params.sq_off.array);
+	ring.cq_head = reinterpret_cast< unsigned* >(cq + params.cq_off.head);
+	ring.cq_tail = reinterpret_cast< unsigned* >(cq + params.cq_off.tail);
+	ring.cq_mask = reinterpret_cast< unsigned* >(cq + params.cq_off.ring_mask);
+	ring.cqes = reinterpret_cast< struct io_uring_cqe* >(cq + params.cq_off.cqes);
+	return true;
+}
+
+inline void AsyncFileIO::closeRing(void)
+{
+	if (ring.fd < 0) {
+		return;
+	}
+	if (reinterpret_cast< void* >(ring.sqes) != MAP_FAILED) {
+		munmap(ring.sqes, ring.sqes_size);
+	}
+	if (ring.cq_ptr != MAP_FAILED && ring.cq_ptr != ring.sq_ptr) {
+		munmap(ring.cq_ptr, ring.cq_size);
+	}
+	if (ring.sq_ptr != MAP_FAILED) {
+		munmap(ring.sq_ptr, ring.sq_size);
+	}
+	::close(ring.fd);
+	ring.fd = -1;
+}
+
+inline bool AsyncFileIO::startRingRequest(AsyncFileRequest* request)
+{
+	request->fd = -1;
+	request->done_bytes = 0;
+	if (request->path.isUnknown()) {
+		request->error = "Unable to access unknown path!";
+		return false;
+	}
+	std::string filename = request->path.toString();
+	if (request->type == AsyncFileRequest::READ) {
+		request->fd = ::open(filename.c_str(), O_RDONLY);
+		if (request->fd < 0) {
+			request->error = "Unable to open file \"" + filename + "\" for reading! Reason: " + strerror(errno);
+			return false;
+		}
+		struct stat st;
+		if (fstat(request->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+			request->error = "Unable to read bytes from file! Reason: \"" + filename + "\" is not file!";
+		} else {
+			try {
+				request->data.resize(st.st_size);
+			}
+			catch (std::bad_alloc const&) {
+				request->error = "Out of memory in reading of file \"" + filename + "\"!";
+			}
+		}
+	} else {
+		request->fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (request->fd < 0) {
+			request->error = "Unable to open file \"" + filename + "\" for writing! Reason: " + strerror(errno);
+			return false;
+		}
+	}
+	if (!request->error.empty() || request->data.empty()) {
+		::close(request->fd);
+		request->fd = -1;
+		return false;
+	}
+	return true;
+}
+
+inline void AsyncFileIO::queueRingChunk(AsyncFileRequest* request)
+{
+	request->iov.iov_base = &request->data[0] + request->done_bytes;
+	request->iov.iov_len = std::min(request->data.size() - request->done_bytes, size_t(RING_CHUNK_SIZE));
+
+	unsigned tail = *ring.sq_tail;
+	unsigned index = tail & *ring.sq_mask;
+	struct io_uring_sqe* sqe = &ring.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = request->type == AsyncFileRequest::READ ? IORING_OP_READV : IORING_OP_WRITEV;
+	sqe->fd = request->fd;
+	sqe->addr = reinterpret_cast< uintptr_t >(&request->iov);
+	sqe->len = 1;
+	sqe->off = request->done_bytes;
+	sqe->user_data = reinterpret_cast< uintptr_t >(request);
+	ring.sq_array[index] = index;
+	// Kernel must see the entry before the new tail
+	__atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++ ring.unsubmitted;
+}
+
+inline void AsyncFileIO::enterRing(unsigned min_complete)
+{
+	unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+	while (ring.unsubmitted > 0 || min_complete > 0) {
+		int result = syscall(__NR_io_uring_enter, ring.fd, ring.unsubmitted, min_complete, flags, NULL, 0);
+		if (result < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+				continue;
+			}
+			throw Exception(std::string("Unable to submit file I/O to io_uring! Reason: ") + strerror(errno));
+		}
+		ring.unsubmitted -= result;
+		break;
+	}
+}
+
+inline unsigned AsyncFileIO::failUnsubmitted(std::string const& error)
+{
+	unsigned tail = *ring.sq_tail;
+	for (unsigned i = 0; i < ring.unsubmitted; ++ i) {
+		struct io_uring_sqe* sqe = &ring.sqes[(tail - 1 - i) & *ring.sq_mask];
+		AsyncFileRequest* request = reinterpret_cast< AsyncFileRequest* >(uintptr_t(sqe->user_data));
+		::close(request->fd);
+		request->fd = -1;
+		request->error = error;
+		finish(request);
+	}
+	unsigned failed = ring.unsubmitted;
+	__atomic_store_n(ring.sq_tail, tail - failed, __ATOMIC_RELEASE);
+	ring.unsubmitted = 0;
+	return failed;
+}
+
+inline void AsyncFileIO::runRing(void* io_raw)
+{
+	AsyncFileIO& io = *reinterpret_cast< AsyncFileIO* >(io_raw);
+
+	unsigned in_flight = 0;
+	std::vector< AsyncFileRequest* > started;
+	started.reserve(io.ring.entries);
+	while (true) {
+
+		// Take as many requests as there is room for
+		{
+			Lock lock(io.mutex);
+			while (io.queue.empty() && in_flight == 0 && !io.stopping) {
+				io.cond.wait(io.mutex);
+			}
+			if (io.queue.empty() && in_flight == 0) {
+				break;
+			}
+			while (!io.queue.empty() && in_flight + started.size() < io.ring.entries) {
+				started.push_back(io.queue.top());
+				io.queue.pop();
+			}
+		}
+
+		// Requests of this round are submitted together
+		for (std::vector< AsyncFileRequest* >::iterator started_it = started.begin();
+		     started_it != started.end();
+		     ++ started_it) {
+			AsyncFileRequest* request = *started_it;
+			if (io.startRingRequest(request)) {
+				io.queueRingChunk(request);
+				++ in_flight;
+			} else {
+				finish(request);
+			}
+		}
+		started.clear();
+		if (in_flight == 0) {
+			continue;
+		}
+
+		// Submit and wait until at least one is complete. If this
+		// fails, then requests that kernel already has are still
+		// reaped, because they will complete anyway.
+		try {
+			io.enterRing(1);
+		}
+		catch (Exception const& e) {
+			unsigned failed = io.failUnsubmitted(e.what());
+			in_flight -= failed;
+			if (failed == 0) {
+				Delay::msecs(1).sleep();
+			}
+		}
+
+		unsigned head = *io.ring.cq_head;
+		unsigned tail = __atomic_load_n(io.ring.cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			struct io_uring_cqe* cqe = &io.ring.cqes[head & *io.ring.cq_mask];
+			AsyncFileRequest* request = reinterpret_cast< AsyncFileRequest* >(uintptr_t(cqe->user_data));
+			int result = cqe->res;
+			++ head;
+
+			bool done = false;
+			if (result < 0) {
+				request->error = "Unable to " + std::string(request->type == AsyncFileRequest::READ ? "read" : "write") + " file \"" + request->path.toString() + "\"! Reason: " + strerror(-result);
+				done = true;
+			} else if (result == 0) {
+				// File got shorter while reading
+				request->data.resize(request->done_bytes);
+				done = true;
+			} else {
+				request->done_bytes += result;
+				done = request->done_bytes >= request->data.size();
+			}
+
+			if (done) {
+				::close(request->fd);
+				request->fd = -1;
+				-- in_flight;
+				finish(request);
+			} else {
+				io.queueRingChunk(request);
+			}
+		}
+		__atomic_store_n(io.ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef HPP_BATCHHASHER_H
+#define HPP_BATCHHASHER_H
+
+#include "bytev.h"
+#include "thread.h"
+#include "mutex.h"
+#include "condition.h"
+#include "lock.h"
+#include "cores.h"
+#include "assert.h"
+#include "noncopyable.h"
+#include "exception.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <new>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Hashes many separate messages at once. Hashers are created once and
+// every message is hashed with Hasher::hashMessage(), and hashes are
+// written to a buffer given by caller. With Sha256Hasher and
+// Sha512Hasher nothing is allocated per message. Big batches are split
+// to threads, so that every thread gets about the same amount of bytes.
+// Threads are started when they are first needed and kept until the
+// BatchHasher is destroyed.
+template< class HasherType > class BatchHasher : public NonCopyable
+{
+
+public:
+
+	// Part of memory to hash
+	struct Message
+	{
+		uint8_t const* data;
+		size_t size;
+		inline Message(void) : data(NULL), size(0) { }
+		inline Message(uint8_t const* data, size_t size) : data(data), size(size) { }
+	};
+	typedef std::vector< Message > Messages;
+
+	// If threads is zero, all cores are used
+	inline BatchHasher(size_t threads = 1);
+	inline virtual ~BatchHasher(void);
+
+	// Size of one hash
+	inline size_t getSize(void) { return size; }
+
+	// Hashes messages. Hash of every message is written to results,
+	// one after another, so results must have room for the amount of
+	// messages times getSize() bytes.
+	inline void hash(uint8_t* results, Message const* messages, size_t messages_size);
+	inline void hash(uint8_t* results, Messages const& messages);
+
+	// Hashes messages and appends their hashes to results
+	inline void hash(ByteV& results, std::vector< ByteV > const& messages);
+
+private:
+
+	// Batches smaller than this are not split to threads
+	static size_t const MIN_BYTES_PER_THREAD = 64 * 1024;
+
+	// Hashing of a range of messages
+	struct Job
+	{
+		HasherType* hasher;
+		uint8_t* results;
+		Message const* messages;
+		size_t messages_size;
+		size_t size;
+		std::string error;
+	};
+	typedef std::vector< Job > Jobs;
+
+	typedef std::vector< HasherType* > Hashers;
+
+	// Threads that run jobs. Jobs are taken in order, and the
+	// thread that calls hash() takes them too.
+	struct Workers
+	{
+		std::vector< Thread > threads;
+		Mutex mutex;
+		// Signaled when there are new jobs or workers should stop
+		Condition jobs_cond;
+		// Signaled when the last job has finished
+		Condition done_cond;
+		Jobs* jobs;
+		size_t next_job;
+		size_t jobs_left;
+		bool stop;
+	};
+
+	Hashers hashers;
+	size_t size;
+	Jobs jobs;
+	Workers* workers;
+
+	inline void startWorkers(void);
+	inline void stopWorkers(void);
+
+	inline static void runJobs(Workers* workers);
+
+	static void workerThread(void* workers_raw);
+	static void runJob(void* job_raw);
+
+};
+
+template< class HasherType >
+inline BatchHasher< HasherType >::BatchHasher(size_t threads) :
+workers(NULL)
+{
+	if (threads == 0) {
+		threads = getNumberOfCores();
+	}
+	hashers.reserve(threads);
+	try {
+		while (hashers.size() < threads) {
+			hashers.push_back(new HasherType());
+		}
+	}
+	catch ( ... ) {
+		for (typename Hashers::iterator hashers_it = hashers.begin();
+		     hashers_it != hashers.end();
+		     ++ hashers_it) {
+			delete *hashers_it;
+		}
+		throw;
+	}
+	size = hashers[0]->getSize();
+}
+
+template< class HasherType >
+inline BatchHasher< HasherType >::~BatchHasher(void)
+{
+	stopWorkers();
+	for (typename Hashers::iterator hashers_it = hashers.begin();
+	     hashers_it != hashers.end();
+	     ++ hashers_it) {
+		delete *hashers_it;
+	}
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::hash(uint8_t* results, Message const* messages, size_t messages_size)
+{
+	if (messages_size == 0) {
+		return;
+	}
+
+	uint64_t total_bytes = 0;
+	for (size_t message_id = 0; message_id < messages_size; ++ message_id) {
+		total_bytes += messages[message_id].size;
+	}
+
+	// Split messages to ranges of about same amount of bytes
+	size_t jobs_amount = std::min(uint64_t(hashers.size()), total_bytes / MIN_BYTES_PER_THREAD);
+	jobs_amount = std::max(std::min(jobs_amount, messages_size), size_t(1));
+	jobs.resize(jobs_amount);
+	size_t message_id = 0;
+	uint64_t bytes_done = 0;
+	for (size_t job_id = 0; job_id < jobs_amount; ++ job_id) {
+		Job& job = jobs[job_id];
+		job.hasher = hashers[job_id];
+		job.results = results + message_id * size;
+		job.messages = messages + message_id;
+		job.size = size;
+		job.error.clear();
+		size_t messages_begin = message_id;
+		if (job_id == jobs_amount - 1) {
+			message_id = messages_size;
+		} else {
+			uint64_t bytes_end = total_bytes * (job_id + 1) / jobs_amount;
+			// Leave at least one message for every remaining job
+			size_t messages_end = messages_size - (jobs_amount - job_id - 1);
+			do {
+				bytes_done += messages[message_id].size;
+				++ message_id;
+			} while (bytes_done < bytes_end && message_id < messages_end);
+		}
+		job.messages_size = message_id - messages_begin;
+	}
+
+	// Run jobs with workers and this thread
+	if (jobs_amount > 1 && !workers) {
+		startWorkers();
+	}
+	if (jobs_amount > 1) {
+		Lock lock(workers->mutex);
+		workers->jobs = &jobs;
+		workers->next_job = 0;
+		workers->jobs_left = jobs_amount;
+		lock.unlock();
+		workers->jobs_cond.broadcast();
+		runJobs(workers);
+		lock.relock();
+		while (workers->jobs_left > 0) {
+			workers->done_cond.wait(workers->mutex);
+		}
+		workers->jobs = NULL;
+	} else {
+		runJob(reinterpret_cast< void* >(&jobs[0]));
+	}
+
+	for (typename Jobs::const_iterator jobs_it = jobs.begin();
+	     jobs_it != jobs.end();
+	     ++ jobs_it) {
+		if (!jobs_it->error.empty()) {
+			throw Exception(jobs_it->error);
+		}
+	}
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::hash(uint8_t* results, Messages const& messages)
+{
+	if (!messages.empty()) {
+		hash(results, &messages[0], messages.size());
+	}
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::hash(ByteV& results, std::vector< ByteV > const& messages)
+{
+	if (messages.empty()) {
+		return;
+	}
+	Messages views;
+	views.reserve(messages.size());
+	for (std::vector< ByteV >::const_iterator messages_it = messages.begin();
+	     messages_it != messages.end();
+	     ++ messages_it) {
+		views.push_back(Message(messages_it->empty() ? NULL : &(*messages_it)[0], messages_it->size()));
+	}
+	size_t results_begin = results.size();
+	results.resize(results_begin + messages.size() * size);
+	hash(&results[results_begin], views);
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::startWorkers(void)
+{
+	HppAssert(!workers, "Workers are already started!");
+	workers = new Workers;
+	workers->jobs = NULL;
+	workers->next_job = 0;
+	workers->jobs_left = 0;
+	workers->stop = false;
+	// Calling thread works too
+	workers->threads.reserve(hashers.size() - 1);
+	try {
+		for (size_t thread_id = 0; thread_id < hashers.size() - 1; ++ thread_id) {
+			workers->threads.push_back(Thread(workerThread, reinterpret_cast< void* >(workers)));
+		}
+	}
+	catch ( ... ) {
+		stopWorkers();
+		throw;
+	}
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::stopWorkers(void)
+{
+	if (!workers) {
+		return;
+	}
+	Lock lock(workers->mutex);
+	workers->stop = true;
+	lock.unlock();
+	workers->jobs_cond.broadcast();
+	for (size_t thread_id = 0; thread_id < workers->threads.size(); ++ thread_id) {
+		workers->threads[thread_id].wait();
+	}
+	delete workers;
+	workers = NULL;
+}
+
+template< class HasherType >
+inline void BatchHasher< HasherType >::runJobs(Workers* workers)
+{
+	Lock lock(workers->mutex);
+	while (workers->jobs && workers->next_job < workers->jobs->size()) {
+		Job* job = &(*workers->jobs)[workers->next_job];
+		++ workers->next_job;
+		lock.unlock();
+		runJob(reinterpret_cast< void* >(job));
+		lock.relock();
+		-- workers->jobs_left;
+		if (workers->jobs_left == 0) {
+			workers->done_cond.broadcast();
+		}
+	}
+}
+
+template< class HasherType >
+void BatchHasher< HasherType >::workerThread(void* workers_raw)
+{
+	Workers* workers = reinterpret_cast< Workers* >(workers_raw);
+	Lock lock(workers->mutex);
+	while (true) {
+		while (!workers->stop && !(workers->jobs && workers->next_job < workers->jobs->size())) {
+			workers->jobs_cond.wait(workers->mutex);
+		}
+		if (workers->stop) {
+			return;
+		}
+		lock.unlock();
+		runJobs(workers);
+		lock.relock();
+	}
+}
+
+template< class HasherType >
+void BatchHasher< HasherType >::runJob(void* job_raw)
+{
+	Job& job = *reinterpret_cast< Job* >(job_raw);
+	try {
+		uint8_t* result = job.results;
+		for (size_t message_id = 0; message_id < job.messages_size; ++ message_id) {
+			Message const& message = job.messages[message_id];
+			job.hasher->hashMessage(result, message.data, message.size);
+			result += job.size;
+		}
+	}
+	catch (Exception const& e) {
+		job.hasher->reset();
+		job.error = e.what();
+	}
+	catch (std::bad_alloc const&) {
+		job.hasher->reset();
+		job.error = "Out of memory in batch hashing!";
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "benchmarktransport.h"
+#include "benchmarkthroughput.h"
+
+#include "exception.h"
+#include "path.h"
+#include "json.h"
+
+#include <openssl/crypto.h>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace Hpp
+{
+
+namespace Benchmarks
+{
+
+size_t allocations = 0;
+uint64_t allocated_bytes = 0;
+
+}
+
+}
+
+// Allocations are counted, so benchmarks can report them. Parallel
+// compression allocates from multiple threads, so counters are atomic.
+static void countAllocation(size_t size)
+{
+	#ifdef __GNUC__
+	__sync_fetch_and_add(&Hpp::Benchmarks::allocations, 1);
+	__sync_fetch_and_add(&Hpp::Benchmarks::allocated_bytes, size);
+	#else
+	++ Hpp::Benchmarks::allocations;
+	Hpp::Benchmarks::allocated_bytes += size;
+	#endif
+}
+
+// Dynamic exception specifications were removed in C++17
+#if __cplusplus >= 201103L
+#define HPP_THROWS_BAD_ALLOC
+#define HPP_THROWS_NOTHING noexcept
+#else
+#define HPP_THROWS_BAD_ALLOC throw (std::bad_alloc)
+#define HPP_THROWS_NOTHING throw ()
+#endif
+
+// Functions are not inlined, because then GCC would see memory from
+// operator new being released with free().
+#ifdef __GNUC__
+void* operator new(size_t size) HPP_THROWS_BAD_ALLOC __attribute__((noinline));
+void operator delete(void* ptr) HPP_THROWS_NOTHING __attribute__((noinline));
+#endif
+
+void* operator new(size_t size) HPP_THROWS_BAD_ALLOC
+{
+	countAllocation(size);
+	void* result = malloc(size ? size : 1);
+	if (!result) {
+		throw std::bad_alloc();
+	}
+	return result;
+}
+
+void operator delete(void* ptr) HPP_THROWS_NOTHING
+{
+	free(ptr);
+}
+
+// Hashers and ciphers of OpenSSL allocate with malloc(), so
+// they are counted through memory functions of OpenSSL.
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+static void* opensslMalloc(size_t size, char const* file, int line)
+{
+	(void)file;
+	(void)line;
+	countAllocation(size);
+	return malloc(size);
+}
+static void* opensslRealloc(void* ptr, size_t size, char const* file, int line)
+{
+	(void)file;
+	(void)line;
+	countAllocation(size);
+	return realloc(ptr, size);
+}
+static void opensslFree(void* ptr, char const* file, int line)
+{
+	(void)file;
+	(void)line;
+	free(ptr);
+}
+#else
+static void* opensslMalloc(size_t size)
+{
+	countAllocation(size);
+	return malloc(size);
+}
+static void* opensslRealloc(void* ptr, size_t size)
+{
+	countAllocation(size);
+	return realloc(ptr, size);
+}
+static void opensslFree(void* ptr)
+{
+	free(ptr);
+}
+#endif
+
+// Usage: benchmark [--json <file>] [--quick] [<corpus file> ...]
+int main(int argc, char** argv)
+{
+	// This must be done before OpenSSL allocates anything
+	if (!CRYPTO_set_mem_functions(opensslMalloc, opensslRealloc, opensslFree)) {
+		std::cerr << "WARNING: Allocations of OpenSSL are not counted!" << std::endl;
+	}
+
+	srand(time(NULL));
+
+	std::string json_file;
+	bool quick = false;
+	std::vector< Hpp::Path > files;
+	for (int arg_id = 1; arg_id < argc; ++ arg_id) {
+		std::string arg = argv[arg_id];
+		if (arg == "--json" && arg_id + 1 < argc) {
+			json_file = argv[++ arg_id];
+		} else if (arg == "--quick") {
+			quick = true;
+		} else {
+			files.push_back(Hpp::Path(arg));
+		}
+	}
+
+	try {
+		Hpp::Benchmarks::benchmarkTransport();
+
+		Hpp::Delay min_time = quick ? Hpp::Delay::msecs(20) : Hpp::Delay::msecs(250);
+		Hpp::Json throughput = Hpp::Benchmarks::benchmarkThroughput(files, min_time);
+
+		if (!json_file.empty()) {
+			Hpp::Json results = Hpp::Json::newObject();
+			results.setMember("throughput", throughput);
+			Hpp::Path(json_file).writeString(results.encode(true));
+		}
+	}
+	catch (Hpp::Exception const& e)	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
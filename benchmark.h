@@ -0,0 +1,159 @@
+#ifndef HPP_BENCHMARK_H
+#define HPP_BENCHMARK_H
+
+#include "json.h"
+#include "time.h"
+#include "bytev.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+namespace Benchmarks
+{
+
+// Counters of heap allocations. These are updated by the replaced
+// operator new of benchmark program, so they stay zero elsewhere.
+extern size_t allocations;
+extern uint64_t allocated_bytes;
+
+// Returns CPU cycle counter, or zero if it is not available
+inline uint64_t readCycleCounter(void)
+{
+	#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	uint32_t lo;
+	uint32_t hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return (uint64_t(hi) << 32) | lo;
+	#else
+	return 0;
+	#endif
+}
+
+// Something that is measured. Corpus is split to buffers, and the
+// operation is run for every buffer, as if they were separate messages.
+class Operation
+{
+
+public:
+
+	inline Operation(void) { }
+	inline virtual ~Operation(void) { }
+
+	virtual std::string getName(void) const = 0;
+
+	// Called once before measuring, for example to compress
+	// the buffers that decompression benchmark needs.
+	inline virtual void prepare(std::vector< ByteV > const& buffers) { (void)buffers; }
+
+	// Processes one buffer. Returns the amount of output bytes.
+	virtual size_t run(size_t buffer_id, ByteV const& buffer) = 0;
+
+	// If output size is interesting, for example with
+	// compression, then this should return true.
+	inline virtual bool reportsRatio(void) const { return false; }
+
+};
+
+// Collects results of measurements, prints them, and converts them to Json
+class Results
+{
+
+public:
+
+	inline Results(void) : results(Json::newArray()) { }
+
+	// Runs operation over corpus, split to buffers of given size.
+	// All buffers are processed at least once, and then again
+	// until the minimum time has passed.
+	inline void measure(Operation& op, std::string const& corpus_name, ByteV const& corpus, size_t buffer_size, Delay const& min_time);
+
+	inline Json const& toJson(void) const { return results; }
+
+private:
+
+	Json results;
+
+};
+
+inline void Results::measure(Operation& op, std::string const& corpus_name, ByteV const& corpus, size_t buffer_size, Delay const& min_time)
+{
+	std::vector< ByteV > buffers;
+	for (size_t ofs = 0; ofs < corpus.size(); ofs += buffer_size) {
+		size_t end = std::min(ofs + buffer_size, corpus.size());
+		buffers.push_back(ByteV(corpus.begin() + ofs, corpus.begin() + end));
+	}
+	op.prepare(buffers);
+
+	uint64_t bytes_in = 0;
+	uint64_t bytes_out = 0;
+	size_t runs = 0;
+	size_t allocations_begin = allocations;
+	uint64_t allocated_bytes_begin = allocated_bytes;
+	uint64_t cycles_begin = readCycleCounter();
+	Time begin = now();
+	Delay time;
+	do {
+		for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+			bytes_out += op.run(buffer_id, buffers[buffer_id]);
+			bytes_in += buffers[buffer_id].size();
+			++ runs;
+		}
+		// Allocations of timing are not counted
+		size_t allocations_before_timing = allocations;
+		uint64_t allocated_bytes_before_timing = allocated_bytes;
+		time = now() - begin;
+		allocations_begin += allocations - allocations_before_timing;
+		allocated_bytes_begin += allocated_bytes - allocated_bytes_before_timing;
+	} while (time < min_time);
+	uint64_t cycles = readCycleCounter() - cycles_begin;
+	size_t allocs = allocations - allocations_begin;
+	uint64_t allocs_bytes = allocated_bytes - allocated_bytes_begin;
+
+	double secs = time.getSecondsAsDouble();
+	double mb_per_sec = bytes_in / secs / (1024.0 * 1024.0);
+	double allocs_per_run = double(allocs) / runs;
+
+	Json result = Json::newObject();
+	result.setMember("operation", Json::newString(op.getName()));
+	result.setMember("corpus", Json::newString(corpus_name));
+	result.setMember("buffer_size", Json::newNumber(uint64_t(buffer_size)));
+	result.setMember("bytes", Json::newNumber(bytes_in));
+	result.setMember("seconds", Json::newNumber(secs));
+	result.setMember("mb_per_second", Json::newNumber(mb_per_sec));
+	if (cycles) {
+		result.setMember("cycles_per_byte", Json::newNumber(double(cycles) / bytes_in));
+	} else {
+		result.setMember("cycles_per_byte", Json::newNull());
+	}
+	result.setMember("allocations_per_buffer", Json::newNumber(allocs_per_run));
+	result.setMember("allocated_bytes_per_buffer", Json::newNumber(double(allocs_bytes) / runs));
+	if (op.reportsRatio()) {
+		result.setMember("ratio", Json::newNumber(double(bytes_out) / bytes_in));
+	}
+	results.addItem(result);
+
+	std::cout << std::left << std::setw(28) << op.getName() << " " << std::setw(8) << corpus_name << " " << std::right << std::setw(8) << buffer_size << " B: ";
+	std::cout << std::fixed << std::setprecision(1) << std::setw(8) << mb_per_sec << " MB/s";
+	if (cycles) {
+		std::cout << std::setw(8) << (double(cycles) / bytes_in) << " c/B";
+	}
+	std::cout << std::setw(8) << allocs_per_run << " allocs/buf";
+	if (op.reportsRatio()) {
+		std::cout << std::setprecision(3) << "  ratio " << (double(bytes_out) / bytes_in);
+	}
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << std::setprecision(6) << std::endl;
+}
+
+}
+
+}
+
+#endif
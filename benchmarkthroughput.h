@@ -0,0 +1,485 @@
+#ifndef HPP_BENCHMARKTHROUGHPUT_H
+#define HPP_BENCHMARKTHROUGHPUT_H
+
+#include "benchmark.h"
+#include "compressor.h"
+#include "decompressor.h"
+#include "lz77codec.h"
+#include "codecs.h"
+#include "aes256cbccipher.h"
+#include "aes256ofbcipher.h"
+#include "aes256ctrcipher.h"
+#include "sha256hasher.h"
+#include "sha512hasher.h"
+#include "batchhasher.h"
+#include "fasthash.h"
+#include "serialize.h"
+#include "path.h"
+#include "cast.h"
+#include "json.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace Hpp
+{
+
+namespace Benchmarks
+{
+
+class CompressOperation : public Operation
+{
+public:
+	inline CompressOperation(int level, size_t threads) : level(level), threads(threads), initialized(false) { }
+	inline virtual ~CompressOperation(void) { if (initialized) comp.deinit(); }
+	inline virtual std::string getName(void) const
+	{
+		std::string name = "Compressor level " + (level == Compressor::DEFAULT_COMPRESSION ? std::string("default") : ssizeToStr(level));
+		if (threads == 0) name += ", all cores";
+		else if (threads != 1) name += ", " + sizeToStr(threads) + " threads";
+		return name;
+	}
+	inline virtual void prepare(std::vector< ByteV > const& buffers) { (void)buffers; if (!initialized) { comp.init(level, threads); initialized = true; } }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		comp.reset();
+		comp.compress(buffer);
+		comp.finish();
+		size_t result = 0;
+		while (comp.readChunk(chunk)) {
+			result += chunk.size();
+		}
+		return result;
+	}
+	inline virtual bool reportsRatio(void) const { return true; }
+private:
+	int level;
+	size_t threads;
+	bool initialized;
+	Compressor comp;
+	ByteV chunk;
+};
+
+class DecompressOperation : public Operation
+{
+public:
+	inline DecompressOperation(void) { decomp.init(); }
+	inline virtual ~DecompressOperation(void) { if (decomp.isInitialized()) decomp.deinit(); }
+	inline virtual std::string getName(void) const { return "Decompressor"; }
+	inline virtual void prepare(std::vector< ByteV > const& buffers)
+	{
+		compressed.clear();
+		Compressor comp;
+		comp.init();
+		for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+			comp.reset();
+			comp.compress(buffers[buffer_id]);
+			comp.finish();
+			compressed.push_back(comp.read());
+		}
+		comp.deinit();
+	}
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer;
+		decomp.reset();
+		decomp.decompress(compressed[buffer_id]);
+		size_t result = 0;
+		while (decomp.readChunk(chunk)) {
+			result += chunk.size();
+		}
+		return result;
+	}
+private:
+	Decompressor decomp;
+	std::vector< ByteV > compressed;
+	ByteV chunk;
+};
+
+class Lz77PackOperation : public Operation
+{
+public:
+	inline virtual std::string getName(void) const { return "Lz77Codec pack"; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		packed.clear();
+		codec.pack(packed, buffer);
+		return packed.size();
+	}
+	inline virtual bool reportsRatio(void) const { return true; }
+private:
+	Lz77Codec codec;
+	ByteV packed;
+};
+
+class Lz77UnpackOperation : public Operation
+{
+public:
+	inline virtual std::string getName(void) const { return "Lz77Codec unpack"; }
+	inline virtual void prepare(std::vector< ByteV > const& buffers)
+	{
+		packed.clear();
+		for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+			packed.push_back(ByteV());
+			codec.pack(packed.back(), buffers[buffer_id]);
+		}
+	}
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer;
+		unpacked.clear();
+		unpack(unpacked, packed[buffer_id]);
+		return unpacked.size();
+	}
+private:
+	Lz77Codec codec;
+	std::vector< ByteV > packed;
+	ByteV unpacked;
+};
+
+// Block cipher is reset for every buffer, as every
+// message needs its own padding. Stream cipher is not.
+template< class CipherType, bool BLOCK_CIPHER > class CipherOperation : public Operation
+{
+public:
+	inline CipherOperation(std::string const& name, bool decrypt) :
+	name(name + (decrypt ? " decrypt" : " encrypt")),
+	decrypt(decrypt),
+	key(32, 0x42),
+	iv(16, 0x24),
+	cipher(key, iv, BLOCK_CIPHER)
+	{
+	}
+	inline virtual std::string getName(void) const { return name; }
+	inline virtual void prepare(std::vector< ByteV > const& buffers)
+	{
+		encrypted.clear();
+		if (!decrypt) {
+			return;
+		}
+		CipherType enc_cipher(key, iv, BLOCK_CIPHER);
+		for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+			if (BLOCK_CIPHER) {
+				enc_cipher.init(key, iv, true);
+			}
+			encrypted.push_back(ByteV());
+			enc_cipher.encrypt(buffers[buffer_id]);
+			enc_cipher.readEncrypted(encrypted.back(), BLOCK_CIPHER);
+		}
+	}
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		if (BLOCK_CIPHER) {
+			cipher.reset(iv);
+		}
+		output.clear();
+		if (decrypt) {
+			cipher.decrypt(encrypted[buffer_id]);
+			cipher.readDecrypted(output, BLOCK_CIPHER);
+		} else {
+			cipher.encrypt(buffer);
+			cipher.readEncrypted(output, BLOCK_CIPHER);
+		}
+		return output.size();
+	}
+private:
+	std::string name;
+	bool decrypt;
+	ByteV key;
+	ByteV iv;
+	CipherType cipher;
+	std::vector< ByteV > encrypted;
+	ByteV output;
+};
+
+// Encrypts buffers in place, as separate messages
+template< class CipherType > class InPlaceCipherOperation : public Operation
+{
+public:
+	inline InPlaceCipherOperation(std::string const& name, bool padding) :
+	name(name + " encrypt in place"),
+	padding(padding),
+	key(32, 0x42),
+	iv(16, 0x24),
+	cipher(key, iv, padding)
+	{
+	}
+	inline virtual std::string getName(void) const { return name; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		// Copying the buffer is part of measurement, but
+		// the same copy is needed by the normal API too.
+		output.assign(buffer.begin(), buffer.end());
+		cipher.resetEncryption(iv);
+		cipher.encryptInPlace(output, padding);
+		return output.size();
+	}
+private:
+	std::string name;
+	bool padding;
+	ByteV key;
+	ByteV iv;
+	CipherType cipher;
+	ByteV output;
+};
+
+// Counter mode, on one thread or on all cores
+class CtrCipherOperation : public Operation
+{
+public:
+	inline CtrCipherOperation(size_t threads) :
+	name(threads == 0 ? "AES256CTRCipher, all cores" : "AES256CTRCipher"),
+	iv(16, 0x24),
+	cipher(ByteV(32, 0x42), iv, threads)
+	{
+	}
+	inline virtual std::string getName(void) const { return name; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		output.assign(buffer.begin(), buffer.end());
+		cipher.resetEncryption(iv);
+		cipher.encryptInPlace(output);
+		return output.size();
+	}
+private:
+	std::string name;
+	ByteV iv;
+	AES256CTRCipher cipher;
+	ByteV output;
+};
+
+template< class HasherType > class HashOperation : public Operation
+{
+public:
+	inline HashOperation(std::string const& name) : name(name) { }
+	inline virtual std::string getName(void) const { return name; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		hasher.addData(buffer);
+		hasher.getHash(hash);
+		return hash.size();
+	}
+private:
+	std::string name;
+	HasherType hasher;
+	ByteV hash;
+};
+
+class FastHashOperation : public Operation
+{
+public:
+	inline virtual std::string getName(void) const { return "FastHasher"; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		hash = fastHash(buffer);
+		return sizeof(hash);
+	}
+private:
+	uint64_t hash;
+};
+
+// Buffer is split to small messages, which are hashed separately,
+// either one by one with a new hasher, or with BatchHasher.
+template< class HasherType > class SmallMessagesHashOperation : public Operation
+{
+public:
+	static size_t const MESSAGE_SIZE = 64;
+	inline SmallMessagesHashOperation(std::string const& name, bool batch) :
+	name(name + (batch ? ", batch of 64 B messages" : ", 64 B messages")),
+	batch(batch)
+	{
+	}
+	inline virtual std::string getName(void) const { return name; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		size_t messages_amount = (buffer.size() + MESSAGE_SIZE - 1) / MESSAGE_SIZE;
+		if (batch) {
+			messages.clear();
+			for (size_t ofs = 0; ofs < buffer.size(); ofs += MESSAGE_SIZE) {
+				messages.push_back(typename BatchHasher< HasherType >::Message(&buffer[ofs], std::min(size_t(MESSAGE_SIZE), buffer.size() - ofs)));
+			}
+			hashes.resize(messages_amount * batch_hasher.getSize());
+			batch_hasher.hash(&hashes[0], messages);
+		} else {
+			hashes.clear();
+			for (size_t ofs = 0; ofs < buffer.size(); ofs += MESSAGE_SIZE) {
+				HasherType hasher;
+				hasher.addData(&buffer[ofs], std::min(size_t(MESSAGE_SIZE), buffer.size() - ofs));
+				hashes += hasher.getHash();
+			}
+		}
+		return hashes.size();
+	}
+private:
+	std::string name;
+	bool batch;
+	BatchHasher< HasherType > batch_hasher;
+	typename BatchHasher< HasherType >::Messages messages;
+	ByteV hashes;
+};
+
+// Buffer is read as big endian floats, either one
+// by one or as an array with deserializeArray().
+class FloatDeserializeOperation : public Operation
+{
+public:
+	inline FloatDeserializeOperation(bool array) : array(array) { }
+	inline virtual std::string getName(void) const { return array ? "deserializeArray, floats" : "deserializeFloat"; }
+	inline virtual size_t run(size_t buffer_id, ByteV const& buffer)
+	{
+		(void)buffer_id;
+		size_t floats_size = buffer.size() / 4;
+		floats.resize(floats_size);
+		ConstByteView view(buffer);
+		if (array) {
+			if (floats_size > 0) {
+				deserializeArray(&floats[0], floats_size, view);
+			}
+		} else {
+			for (size_t i = 0; i < floats_size; ++ i) {
+				floats[i] = deserializeFloat(view);
+			}
+		}
+		return floats_size * 4;
+	}
+private:
+	bool array;
+	std::vector< float > floats;
+};
+
+// Synthetic corpora
+inline ByteV createRandomCorpus(size_t size)
+{
+	ByteV result(size);
+	for (size_t i = 0; i < size; ++ i) {
+		result[i] = rand();
+	}
+	return result;
+}
+
+inline ByteV createTextCorpus(size_t size)
+{
+	static char const* const WORDS[] = { "{\"entity\":", "12", "345", ",\"position\":[", "1.5,", "-3.25,", "0.0]", ",\"name\":", "\"player\"", ",\"alive\":true", "}\n" };
+	ByteV result;
+	result.reserve(size);
+	while (result.size() < size) {
+		char const* word = WORDS[rand() % (sizeof(WORDS) / sizeof(*WORDS))];
+		size_t word_size = std::min(strlen(word), size - result.size());
+		result.insert(result.end(), word, word + word_size);
+	}
+	return result;
+}
+
+// Vertices of smooth surface as floats
+inline ByteV createFloatCorpus(size_t size)
+{
+	ByteV result(size);
+	size_t floats = size / sizeof(float);
+	for (size_t i = 0; i < floats; ++ i) {
+		float f = (i % 3) * 10.0f + (i / 3 % 256) * 0.125f + (rand() % 16) * 0.001f;
+		memcpy(&result[i * sizeof(float)], &f, sizeof(float));
+	}
+	return result;
+}
+
+// Runs compression and crypto benchmarks over synthetic corpora and
+// given files. Returns results as Json, so they can be stored and
+// compared between versions.
+inline Json benchmarkThroughput(std::vector< Path > const& files, Delay const& min_time = Delay::msecs(250))
+{
+	size_t const CORPUS_SIZE = 2 * 1024 * 1024;
+	size_t const MAX_FILE_CORPUS_SIZE = 16 * 1024 * 1024;
+
+	std::vector< std::string > corpus_names;
+	std::vector< ByteV > corpora;
+	corpus_names.push_back("random");
+	corpora.push_back(createRandomCorpus(CORPUS_SIZE));
+	corpus_names.push_back("text");
+	corpora.push_back(createTextCorpus(CORPUS_SIZE));
+	corpus_names.push_back("floats");
+	corpora.push_back(createFloatCorpus(CORPUS_SIZE));
+	for (std::vector< Path >::const_iterator files_it = files.begin();
+	     files_it != files.end();
+	     ++ files_it) {
+		corpus_names.push_back(files_it->getFilename());
+		corpora.push_back(files_it->readBytes());
+		if (corpora.back().size() > MAX_FILE_CORPUS_SIZE) {
+			corpora.back().resize(MAX_FILE_CORPUS_SIZE);
+		}
+		if (corpora.back().empty()) {
+			throw Exception("Corpus file " + files_it->toString() + " is empty!");
+		}
+	}
+
+	std::vector< size_t > buffer_sizes;
+	buffer_sizes.push_back(1024);
+	buffer_sizes.push_back(64 * 1024);
+	buffer_sizes.push_back(1024 * 1024);
+
+	std::vector< Operation* > ops;
+	ops.push_back(new CompressOperation(Compressor::FAST, 1));
+	ops.push_back(new CompressOperation(Compressor::DEFAULT_COMPRESSION, 1));
+	ops.push_back(new CompressOperation(Compressor::BEST, 1));
+	ops.push_back(new CompressOperation(Compressor::DEFAULT_COMPRESSION, 0));
+	ops.push_back(new DecompressOperation());
+	ops.push_back(new Lz77PackOperation());
+	ops.push_back(new Lz77UnpackOperation());
+	ops.push_back(new CipherOperation< AES256CBCCipher, true >("AES256CBCCipher", false));
+	ops.push_back(new CipherOperation< AES256CBCCipher, true >("AES256CBCCipher", true));
+	ops.push_back(new CipherOperation< AES256OFBCipher, false >("AES256OFBCipher", false));
+	ops.push_back(new CipherOperation< AES256OFBCipher, false >("AES256OFBCipher", true));
+	ops.push_back(new InPlaceCipherOperation< AES256CBCCipher >("AES256CBCCipher", true));
+	ops.push_back(new InPlaceCipherOperation< AES256OFBCipher >("AES256OFBCipher", false));
+	ops.push_back(new CtrCipherOperation(1));
+	ops.push_back(new CtrCipherOperation(0));
+	ops.push_back(new HashOperation< Sha256Hasher >("Sha256Hasher"));
+	ops.push_back(new HashOperation< Sha512Hasher >("Sha512Hasher"));
+	ops.push_back(new FastHashOperation());
+	ops.push_back(new SmallMessagesHashOperation< Sha256Hasher >("Sha256Hasher", false));
+	ops.push_back(new SmallMessagesHashOperation< Sha256Hasher >("Sha256Hasher", true));
+	ops.push_back(new FloatDeserializeOperation(false));
+	ops.push_back(new FloatDeserializeOperation(true));
+
+	Results results;
+	try {
+		for (std::vector< Operation* >::iterator ops_it = ops.begin();
+		     ops_it != ops.end();
+		     ++ ops_it) {
+			for (size_t corpus_id = 0; corpus_id < corpora.size(); ++ corpus_id) {
+				for (size_t buffer_size_id = 0; buffer_size_id < buffer_sizes.size(); ++ buffer_size_id) {
+					results.measure(**ops_it, corpus_names[corpus_id], corpora[corpus_id], buffer_sizes[buffer_size_id], min_time);
+				}
+			}
+		}
+	}
+	catch ( ... ) {
+		for (std::vector< Operation* >::iterator ops_it = ops.begin();
+		     ops_it != ops.end();
+		     ++ ops_it) {
+			delete *ops_it;
+		}
+		throw;
+	}
+	for (std::vector< Operation* >::iterator ops_it = ops.begin();
+	     ops_it != ops.end();
+	     ++ ops_it) {
+		delete *ops_it;
+	}
+
+	return results.toJson();
+}
+
+}
+
+}
+
+#endif
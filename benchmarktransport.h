@@ -0,0 +1,136 @@
+#ifndef HPP_BENCHMARKTRANSPORT_H
+#define HPP_BENCHMARKTRANSPORT_H
+
+#include "transportpipeline.h"
+#include "deflatestage.h"
+#include "cipherstage.h"
+#include "aes256ofbcipher.h"
+#include "time.h"
+#include "exception.h"
+#include "assert.h"
+
+#include <zlib.h>
+#include <iostream>
+#include <cstdlib>
+
+namespace Hpp
+{
+
+namespace Benchmarks
+{
+
+// Creates somewhat compressible message
+inline ByteV createTransportMessage(size_t size)
+{
+	static char const* const WORDS[] = { "{\"pos\":", "[1.5,", "-3.25,", "0.0]", ",\"id\":", "123", "\"name\":", "\"player\"", "}" };
+	ByteV result;
+	result.reserve(size);
+	while (result.size() < size) {
+		char const* word = WORDS[rand() % (sizeof(WORDS) / sizeof(*WORDS))];
+		while (*word && result.size() < size) {
+			result.push_back(*word);
+			++ word;
+		}
+	}
+	return result;
+}
+
+inline void benchmarkTransportMessages(size_t message_size, size_t messages)
+{
+	ByteV key(32, 0x42);
+	ByteV iv(16, 0x24);
+	ByteV message = createTransportMessage(message_size);
+
+	// Manual path: one zlib stream that is flushed after every
+	// message, like in DeflateStage, and Cipher. Results are
+	// collected to new buffers and copied between every step.
+	Delay manual_time;
+	size_t manual_bytes = 0;
+	{
+		AES256OFBCipher cipher(key, iv, false);
+		z_stream strm;
+		strm.zalloc = Z_NULL;
+		strm.zfree = Z_NULL;
+		strm.opaque = Z_NULL;
+		if (deflateInit(&strm, Z_DEFAULT_COMPRESSION) != Z_OK) {
+			throw Exception("Unable to initialize compression!");
+		}
+		uint8_t chunk[16 * 1024];
+		ByteV output;
+		Time begin = now();
+		for (size_t message_id = 0; message_id < messages; ++ message_id) {
+			ByteV compressed;
+			strm.next_in = &message[0];
+			strm.avail_in = message.size();
+			do {
+				strm.next_out = chunk;
+				strm.avail_out = sizeof(chunk);
+				deflate(&strm, Z_SYNC_FLUSH);
+				compressed.insert(compressed.end(), chunk, chunk + sizeof(chunk) - strm.avail_out);
+			} while (strm.avail_out == 0);
+			cipher.encrypt(compressed);
+			ByteV encrypted;
+			cipher.readEncrypted(encrypted, false);
+			output.clear();
+			output.insert(output.end(), encrypted.begin(), encrypted.end());
+			manual_bytes += output.size();
+		}
+		manual_time = now() - begin;
+		deflateEnd(&strm);
+	}
+
+	// Pipeline path
+	Delay pipeline_time;
+	size_t pipeline_bytes = 0;
+	{
+		AES256OFBCipher cipher(key, iv, false);
+		DeflateStage deflate_stage;
+		CipherStage cipher_stage(&cipher);
+		TransportPipeline pipeline;
+		pipeline.addStage(&deflate_stage);
+		pipeline.addStage(&cipher_stage);
+		ByteV output;
+		Time begin = now();
+		for (size_t message_id = 0; message_id < messages; ++ message_id) {
+			output.clear();
+			pipeline.encode(output, &message[0], message.size());
+			pipeline_bytes += output.size();
+		}
+		pipeline_time = now() - begin;
+
+		// Ensure pipeline produces correct data
+		AES256OFBCipher cipher2(key, iv, false);
+		DeflateStage deflate_stage2;
+		CipherStage cipher_stage2(&cipher2);
+		TransportPipeline pipeline2;
+		pipeline2.addStage(&deflate_stage2);
+		pipeline2.addStage(&cipher_stage2);
+		ByteV encoded;
+		ByteV decoded;
+		for (size_t round = 0; round < 3; ++ round) {
+			encoded.clear();
+			pipeline2.encode(encoded, &message[0], message.size());
+			decoded.clear();
+			pipeline2.decode(decoded, &encoded[0], encoded.size());
+			HppAssert(decoded == message, "Transport pipeline has failed!");
+		}
+	}
+
+	double total_mb = double(message_size) * messages / (1024.0 * 1024.0);
+	std::cout << "Transport, " << messages << " messages of " << message_size << " bytes:" << std::endl;
+	std::cout << "  manual:   " << (total_mb / manual_time.getSecondsAsDouble()) << " MB/s, " << manual_bytes << " bytes out" << std::endl;
+	std::cout << "  pipeline: " << (total_mb / pipeline_time.getSecondsAsDouble()) << " MB/s, " << pipeline_bytes << " bytes out" << std::endl;
+}
+
+inline void benchmarkTransport(void)
+{
+	benchmarkTransportMessages(200, 20000);
+	benchmarkTransportMessages(4 * 1024, 5000);
+	benchmarkTransportMessages(256 * 1024, 100);
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef HPP_BINARYREADER_H
+#define HPP_BINARYREADER_H
+
+#include "bytev.h"
+#include "byteview.h"
+#include "cast.h"
+#include "serialize.h"
+#include "exception.h"
+#include "noncopyable.h"
+
+#include <istream>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Reads binary data that is written by BinaryWriter. Reading past the
+// end throws an exception. Reader reads either from memory, where
+// nothing is copied, or from a stream, where only as many bytes are
+// read as are needed. Views returned by readBytes() are valid until
+// the next read from a stream, or as long as the memory exists.
+class BinaryReader : public NonCopyable
+{
+
+public:
+
+	inline BinaryReader(uint8_t const* data, size_t size, bool bigendian = true);
+	inline BinaryReader(ConstByteView data, bool bigendian = true);
+	inline BinaryReader(ByteV const& data, bool bigendian = true);
+	inline BinaryReader(std::istream& strm, bool bigendian = true);
+
+	inline bool isBigEndian(void) const { return bigendian; }
+
+	// Amount of bytes read so far
+	inline size_t getPosition(void) const { return pos; }
+
+	// Amount of bytes left. Not known with streams.
+	inline size_t getRemaining(void) const;
+	inline bool atEnd(void) const;
+
+	inline uint8_t readUInt8(void) { return *take(1); }
+	inline uint16_t readUInt16(void) { return cStrToUInt16(take(2), bigendian); }
+	inline uint32_t readUInt32(void) { return cStrToUInt32(take(4), bigendian); }
+	inline uint64_t readUInt64(void) { return cStrToUInt64(take(8), bigendian); }
+	inline int8_t readInt8(void) { return int8_t(*take(1)); }
+	inline int16_t readInt16(void) { return cStrToInt16(take(2), bigendian); }
+	inline int32_t readInt32(void) { return cStrToInt32(take(4), bigendian); }
+	inline int64_t readInt64(void) { return cStrToInt64(take(8), bigendian); }
+	inline float readFloat(void) { return cStrToFloat(take(4), bigendian); }
+	inline double readDouble(void);
+	inline bool readBool(void) { return *take(1) != 0; }
+
+	inline uint64_t readVarUInt(void);
+	inline int64_t readVarInt(void);
+
+	inline std::string readString(void);
+	inline ConstByteView readBytes(size_t size);
+	inline void readBytes(uint8_t* result, size_t size);
+	inline void skip(size_t size);
+
+	// See deserializeArray()
+	template< typename Type > inline void readArray(Type* result, size_t size);
+
+private:
+
+	uint8_t const* data;
+	size_t size;
+	std::istream* strm;
+	bool bigendian;
+
+	size_t pos;
+
+	// Bytes read from stream
+	ByteV scratch;
+
+	// Returns pointer to next bytes and moves over them
+	inline uint8_t const* take(size_t amount);
+
+};
+
+inline BinaryReader::BinaryReader(uint8_t const* data, size_t size, bool bigendian) :
+data(data),
+size(size),
+strm(NULL),
+bigendian(bigendian),
+pos(0)
+{
+}
+
+inline BinaryReader::BinaryReader(ConstByteView data, bool bigendian) :
+data(data.data()),
+size(data.size()),
+strm(NULL),
+bigendian(bigendian),
+pos(0)
+{
+}
+
+inline BinaryReader::BinaryReader(ByteV const& data, bool bigendian) :
+data(data.empty() ? NULL : &data[0]),
+size(data.size()),
+strm(NULL),
+bigendian(bigendian),
+pos(0)
+{
+}
+
+inline BinaryReader::BinaryReader(std::istream& strm, bool bigendian) :
+data(NULL),
+size(0),
+strm(&strm),
+bigendian(bigendian),
+pos(0)
+{
+}
+
+inline size_t BinaryReader::getRemaining(void) const
+{
+	if (strm) {
+		throw Exception("Amount of remaining bytes is not known when reading from stream!");
+	}
+	return size - pos;
+}
+
+inline bool BinaryReader::atEnd(void) const
+{
+	if (strm) {
+		return strm->peek() == std::istream::traits_type::eof();
+	}
+	return pos == size;
+}
+
+inline double BinaryReader::readDouble(void)
+{
+	uint64_t i = readUInt64();
+	double result;
+	memcpy(&result, &i, 8);
+	return result;
+}
+
+inline uint64_t BinaryReader::readVarUInt(void)
+{
+	uint64_t result = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = *take(1);
+		result |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			if (shift == 63 && byte > 1) {
+				throw Exception("Varint is too big!");
+			}
+			return result;
+		}
+	}
+	throw Exception("Varint is too long!");
+}
+
+inline int64_t BinaryReader::readVarInt(void)
+{
+	uint64_t zigzag = readVarUInt();
+	return int64_t((zigzag >> 1) ^ uint64_t(-int64_t(zigzag & 1)));
+}
+
+inline std::string BinaryReader::readString(void)
+{
+	uint64_t string_size = readVarUInt();
+	if (string_size > size_t(-1)) {
+		throw Exception("String is too long!");
+	}
+	ConstByteView bytes = readBytes(string_size);
+	return std::string(reinterpret_cast< char const* >(bytes.data()), bytes.size());
+}
+
+inline ConstByteView BinaryReader::readBytes(size_t size)
+{
+	return ConstByteView(take(size), size);
+}
+
+inline void BinaryReader::readBytes(uint8_t* result, size_t size)
+{
+	if (strm) {
+		// Read straight to result
+		strm->read(reinterpret_cast< char* >(result), size);
+		if (size_t(strm->gcount()) != size) {
+			throw Exception("Unexpected end of data!");
+		}
+		pos += size;
+	} else if (size > 0) {
+		memcpy(result, take(size), size);
+	}
+}
+
+inline void BinaryReader::skip(size_t size)
+{
+	take(size);
+}
+
+template< typename Type >
+inline void BinaryReader::readArray(Type* result, size_t size)
+{
+	if (strm) {
+		deserializeArray(result, size, *strm, bigendian);
+		pos += size * sizeof(Type);
+	} else {
+		if ((this->size - pos) / sizeof(Type) < size) {
+			throw Exception("Unexpected end of data!");
+		}
+		deserializeArray(result, size, take(size * sizeof(Type)), bigendian);
+	}
+}
+
+inline uint8_t const* BinaryReader::take(size_t amount)
+{
+	if (strm) {
+		scratch.resize(amount);
+		if (amount == 0) {
+			return NULL;
+		}
+		strm->read(reinterpret_cast< char* >(&scratch[0]), amount);
+		if (size_t(strm->gcount()) != amount) {
+			throw Exception("Unexpected end of data!");
+		}
+		pos += amount;
+		return &scratch[0];
+	}
+	if (size - pos < amount) {
+		throw Exception("Unexpected end of data!");
+	}
+	uint8_t const* result = data + pos;
+	pos += amount;
+	return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef HPP_BINARYWRITER_H
+#define HPP_BINARYWRITER_H
+
+#include "bytev.h"
+#include "byteview.h"
+#include "cast.h"
+#include "serialize.h"
+#include "noncopyable.h"
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Writes binary data to the end of a ByteV. Values are written straight
+// to the buffer, so there are no temporary vectors, and the buffer grows
+// like std::vector does. If the final size is known, reserve() it first.
+//
+// Varints are unsigned LEB128: seven bits per byte, least significant
+// first, and the highest bit tells if more bytes follow. Signed varints
+// are zigzag encoded first, so that small negative numbers are short
+// too. Strings are prefixed with their length as varint.
+class BinaryWriter : public NonCopyable
+{
+
+public:
+
+	inline BinaryWriter(ByteV& buf, bool bigendian = true);
+
+	inline bool isBigEndian(void) const { return bigendian; }
+
+	// Buffer that is written to
+	inline ByteV& getBuffer(void) { return buf; }
+	inline size_t getSize(void) const { return buf.size(); }
+
+	// Makes room for given amount of more bytes
+	inline void reserve(size_t size) { buf.reserve(buf.size() + size); }
+
+	inline void writeUInt8(uint8_t i) { buf.push_back(i); }
+	inline void writeUInt16(uint16_t i) { uInt16ToCStr(i, grow(2), bigendian); }
+	inline void writeUInt32(uint32_t i) { uInt32ToCStr(i, grow(4), bigendian); }
+	inline void writeUInt64(uint64_t i) { uInt64ToCStr(i, grow(8), bigendian); }
+	inline void writeInt8(int8_t i) { buf.push_back(uint8_t(i)); }
+	inline void writeInt16(int16_t i) { int16ToCStr(i, grow(2), bigendian); }
+	inline void writeInt32(int32_t i) { int32ToCStr(i, grow(4), bigendian); }
+	inline void writeInt64(int64_t i) { int64ToCStr(i, grow(8), bigendian); }
+	inline void writeFloat(float f) { floatToCStr(f, grow(4), bigendian); }
+	inline void writeDouble(double d);
+	inline void writeBool(bool b) { buf.push_back(b ? 1 : 0); }
+
+	inline void writeVarUInt(uint64_t i);
+	inline void writeVarInt(int64_t i) { writeVarUInt((uint64_t(i) << 1) ^ uint64_t(-int64_t(uint64_t(i) >> 63))); }
+
+	inline void writeString(std::string const& s);
+	inline void writeBytes(uint8_t const* data, size_t size);
+	inline void writeBytes(ConstByteView data) { writeBytes(data.data(), data.size()); }
+
+	// See serializeArray()
+	template< typename Type > inline void writeArray(Type const* values, size_t size) { serializeArray(grow(size * sizeof(Type)), values, size, bigendian); }
+
+private:
+
+	ByteV& buf;
+	bool bigendian;
+
+	// Adds bytes to the end of buffer and returns pointer to them
+	inline uint8_t* grow(size_t size);
+
+};
+
+inline BinaryWriter::BinaryWriter(ByteV& buf, bool bigendian) :
+buf(buf),
+bigendian(bigendian)
+{
+}
+
+inline void BinaryWriter::writeDouble(double d)
+{
+	uint64_t i;
+	memcpy(&i, &d, 8);
+	uInt64ToCStr(i, grow(8), bigendian);
+}
+
+inline void BinaryWriter::writeVarUInt(uint64_t i)
+{
+	uint8_t bytes[10];
+	size_t bytes_size = 0;
+	while (i >= 0x80) {
+		bytes[bytes_size ++] = uint8_t(i) | 0x80;
+		i >>= 7;
+	}
+	bytes[bytes_size ++] = uint8_t(i);
+	writeBytes(bytes, bytes_size);
+}
+
+inline void BinaryWriter::writeString(std::string const& s)
+{
+	writeVarUInt(s.size());
+	writeBytes(reinterpret_cast< uint8_t const* >(s.data()), s.size());
+}
+
+inline void BinaryWriter::writeBytes(uint8_t const* data, size_t size)
+{
+	if (size > 0) {
+		memcpy(grow(size), data, size);
+	}
+}
+
+inline uint8_t* BinaryWriter::grow(size_t size)
+{
+	if (size == 0) {
+		return NULL;
+	}
+	size_t old_size = buf.size();
+	buf.resize(old_size + size);
+	return &buf[0] + old_size;
+}
+
+}
+
+#endif
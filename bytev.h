@@ -17,8 +17,8 @@ typedef std::vector< uint8_t > ByteV;
 inline Hpp::ByteV operator+(Hpp::ByteV const& v0, Hpp::ByteV const& v1);
 inline Hpp::ByteV operator+(Hpp::ByteV const& v, std::string const& s);
 inline Hpp::ByteV operator+(std::string const& s, Hpp::ByteV const& v);
-inline Hpp::ByteV operator+=(Hpp::ByteV& v0, Hpp::ByteV const& v1);
-inline Hpp::ByteV operator+=(Hpp::ByteV& v, std::string const& s);
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v0, Hpp::ByteV const& v1);
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v, std::string const& s);
 
 inline Hpp::ByteV operator+(Hpp::ByteV const& v0, Hpp::ByteV const& v1)
 {
@@ -47,13 +47,13 @@ inline Hpp::ByteV operator+(std::string const& s, Hpp::ByteV const& v)
 	return new_v;
 }
 
-inline Hpp::ByteV operator+=(Hpp::ByteV& v0, Hpp::ByteV const& v1)
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v0, Hpp::ByteV const& v1)
 {
 	v0.insert(v0.end(), v1.begin(), v1.end());
 	return v0;
 }
 
-inline Hpp::ByteV operator+=(Hpp::ByteV& v, std::string const& s)
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v, std::string const& s)
 {
 	v.insert(v.end(), s.begin(), s.end());
 	return v;
@@ -0,0 +1,124 @@
+#ifndef HPP_BYTEVIEW_H
+#define HPP_BYTEVIEW_H
+
+#include "bytev.h"
+#include "exception.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// View to bytes that are owned by someone else, for example ByteV or a
+// buffer of Image. View is only a pointer and size, so it is cheap to
+// pass by value, and nothing is copied. View becomes invalid if its
+// owner is destroyed or resized. ByteView allows modifying bytes and
+// ConstByteView does not. ByteView converts to ConstByteView.
+class ByteView
+{
+
+public:
+
+	inline ByteView(void) : ptr(NULL), len(0) { }
+	inline ByteView(uint8_t* data, size_t size) : ptr(data), len(size) { }
+	inline ByteView(ByteV& v) : ptr(v.empty() ? NULL : &v[0]), len(v.size()) { }
+
+	inline uint8_t* data(void) const { return ptr; }
+	inline size_t size(void) const { return len; }
+	inline bool empty(void) const { return len == 0; }
+
+	inline uint8_t* begin(void) const { return ptr; }
+	inline uint8_t* end(void) const { return ptr + len; }
+
+	inline uint8_t& operator[](size_t offset) const { return ptr[offset]; }
+
+	// Returns part of view. If size is not given, rest of view is returned.
+	inline ByteView sub(size_t offset, size_t size) const;
+	inline ByteView sub(size_t offset) const;
+
+	inline ByteV toByteV(void) const { return ByteV(ptr, ptr + len); }
+
+private:
+
+	uint8_t* ptr;
+	size_t len;
+
+};
+
+class ConstByteView
+{
+
+public:
+
+	inline ConstByteView(void) : ptr(NULL), len(0) { }
+	inline ConstByteView(uint8_t const* data, size_t size) : ptr(data), len(size) { }
+	inline ConstByteView(ByteV const& v) : ptr(v.empty() ? NULL : &v[0]), len(v.size()) { }
+	inline ConstByteView(ByteView const& view) : ptr(view.data()), len(view.size()) { }
+
+	inline uint8_t const* data(void) const { return ptr; }
+	inline size_t size(void) const { return len; }
+	inline bool empty(void) const { return len == 0; }
+
+	inline uint8_t const* begin(void) const { return ptr; }
+	inline uint8_t const* end(void) const { return ptr + len; }
+
+	inline uint8_t const& operator[](size_t offset) const { return ptr[offset]; }
+
+	// Returns part of view. If size is not given, rest of view is returned.
+	inline ConstByteView sub(size_t offset, size_t size) const;
+	inline ConstByteView sub(size_t offset) const;
+
+	inline ByteV toByteV(void) const { return ByteV(ptr, ptr + len); }
+
+private:
+
+	uint8_t const* ptr;
+	size_t len;
+
+};
+
+inline ByteView ByteView::sub(size_t offset, size_t size) const
+{
+	if (offset > len || size > len - offset) {
+		throw Exception("Part of view is out of range!");
+	}
+	return ByteView(ptr + offset, size);
+}
+
+inline ByteView ByteView::sub(size_t offset) const
+{
+	if (offset > len) {
+		throw Exception("Part of view is out of range!");
+	}
+	return ByteView(ptr + offset, len - offset);
+}
+
+inline ConstByteView ConstByteView::sub(size_t offset, size_t size) const
+{
+	if (offset > len || size > len - offset) {
+		throw Exception("Part of view is out of range!");
+	}
+	return ConstByteView(ptr + offset, size);
+}
+
+inline ConstByteView ConstByteView::sub(size_t offset) const
+{
+	if (offset > len) {
+		throw Exception("Part of view is out of range!");
+	}
+	return ConstByteView(ptr + offset, len - offset);
+}
+
+}
+
+// Appends viewed bytes
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v, Hpp::ConstByteView const& view);
+
+inline Hpp::ByteV& operator+=(Hpp::ByteV& v, Hpp::ConstByteView const& view)
+{
+	v.insert(v.end(), view.begin(), view.end());
+	return v;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef HPP_BYTEVIEWREADERBUF_H
+#define HPP_BYTEVIEWREADERBUF_H
+
+#include "byteview.h"
+
+#include <istream>
+
+namespace Hpp
+{
+
+// Stream buffer that reads viewed bytes in place. Whole view is
+// the buffer of stream, so reading does not call virtual functions
+// for every byte and nothing is copied before it is read.
+class ByteViewReaderBufStreambuf : public std::basic_streambuf< char, std::char_traits< char > >
+{
+
+public:
+
+	inline ByteViewReaderBufStreambuf(ConstByteView view);
+
+protected:
+
+	inline virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+	inline virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+};
+
+inline ByteViewReaderBufStreambuf::ByteViewReaderBufStreambuf(ConstByteView view)
+{
+	// Stream buffer never writes to its get area
+	char* begin = const_cast< char* >(reinterpret_cast< char const* >(view.data()));
+	setg(begin, begin, begin + view.size());
+}
+
+inline ByteViewReaderBufStreambuf::pos_type ByteViewReaderBufStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if (!(which & std::ios_base::in)) {
+		return pos_type(off_type(-1));
+	}
+	off_type base;
+	if (dir == std::ios_base::beg) {
+		base = 0;
+	} else if (dir == std::ios_base::cur) {
+		base = gptr() - eback();
+	} else {
+		base = egptr() - eback();
+	}
+	off_type result = base + off;
+	if (result < 0 || result > egptr() - eback()) {
+		return pos_type(off_type(-1));
+	}
+	setg(eback(), eback() + result, egptr());
+	return pos_type(result);
+}
+
+inline ByteViewReaderBufStreambuf::pos_type ByteViewReaderBufStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+class ByteViewReaderBuf : public std::basic_istream< char, std::char_traits< char > >
+{
+
+public:
+
+	inline ByteViewReaderBuf(ConstByteView view);
+
+private:
+
+	ByteViewReaderBufStreambuf buf;
+
+};
+
+inline ByteViewReaderBuf::ByteViewReaderBuf(ConstByteView view) :
+std::basic_istream< char, std::char_traits< char > >(&buf),
+buf(view)
+{
+}
+
+}
+
+#endif
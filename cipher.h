@@ -2,8 +2,12 @@
 #define HPP_CIPHER_H
 
 #include "bytev.h"
+#include "byteview.h"
+#include "exception.h"
 
 #include <string>
+#include <vector>
+#include <cstring>
 
 namespace Hpp
 {
@@ -23,6 +27,7 @@ public:
 	inline void encrypt(ByteV const& data);
 	inline void encrypt(std::string const& data);
 	inline void encrypt(uint8_t const* data, size_t data_size);
+	inline void encrypt(ConstByteView data);
 	inline void readEncrypted(ByteV& result, bool finalize, size_t max_size = 0);
 
 	// Decrypts chunk of data. Result of decryption can be done
@@ -32,8 +37,38 @@ public:
 	inline void decrypt(ByteV const& data);
 	inline void decrypt(std::string const& data);
 	inline void decrypt(uint8_t const* data, size_t data_size);
+	inline void decrypt(ConstByteView data);
 	inline void readDecrypted(ByteV& result, bool finalize, size_t max_size = 0);
 
+	// Encrypts/decrypts directly to a buffer, without copying result
+	// through internal cache. Result must have room for at least
+	// getMaxResultSize() bytes. Result may be the same buffer as data,
+	// to process it in place, but buffers must not overlap otherwise.
+	// Returns the amount of bytes written. Data that is waiting to be
+	// read with readEncrypted()/readDecrypted() must be read first.
+	inline size_t encryptInto(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, bool finalize = false);
+	inline size_t decryptInto(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, bool finalize = false);
+	inline size_t encryptInto(ByteView result, ConstByteView data, bool finalize = false);
+	inline size_t decryptInto(ByteView result, ConstByteView data, bool finalize = false);
+
+	// Encrypts/decrypts buffer in place. Buffer is resized if
+	// result differs in size, for example because of padding.
+	inline void encryptInPlace(ByteV& data, bool finalize = false);
+	inline void decryptInPlace(ByteV& data, bool finalize = false);
+
+	// Encrypts/decrypts many buffers in place, as if they were
+	// one continuous stream. If finalize is set, then cipher is
+	// finalized after the last buffer.
+	inline void encryptInPlace(std::vector< ByteV >& buffers, bool finalize = false);
+	inline void decryptInPlace(std::vector< ByteV >& buffers, bool finalize = false);
+
+	// Returns how big the result of encryption or decryption of
+	// given amount of data can be, including finalization.
+	inline size_t getMaxResultSize(size_t data_size) const { return data_size + getBlockSize(); }
+
+	// Size of block of cipher. Stream ciphers return one.
+	inline virtual size_t getBlockSize(void) const { return 1; }
+
 private:
 
 	// Storage for the data that user does not want to read yet
@@ -47,6 +82,12 @@ private:
 	virtual void doDecryption(ByteV& result, uint8_t const* data, size_t data_size) = 0;
 	virtual void finalizeDecryption(ByteV& result) = 0;
 
+	// Encryption/decryption to raw buffer. Result is known to have room
+	// for getMaxResultSize() bytes. Default implementations go through
+	// ByteV, so subclasses should override these if they can do better.
+	inline virtual size_t doEncryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize);
+	inline virtual size_t doDecryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize);
+
 };
 
 inline void Cipher::encrypt(ByteV const& data)
@@ -64,6 +105,11 @@ inline void Cipher::encrypt(uint8_t const* data, size_t data_size)
 	doEncryption(encrypt_cache, data, data_size);
 }
 
+inline void Cipher::encrypt(ConstByteView data)
+{
+	doEncryption(encrypt_cache, data.data(), data.size());
+}
+
 inline void Cipher::readEncrypted(ByteV& result, bool finalize, size_t max_size)
 {
 	if (finalize) {
@@ -98,6 +144,11 @@ inline void Cipher::decrypt(uint8_t const* data, size_t data_size)
 	doDecryption(decrypt_cache, data, data_size);
 }
 
+inline void Cipher::decrypt(ConstByteView data)
+{
+	doDecryption(decrypt_cache, data.data(), data.size());
+}
+
 inline void Cipher::readDecrypted(ByteV& result, bool finalize, size_t max_size)
 {
 	if (finalize) {
@@ -117,6 +168,98 @@ inline void Cipher::readDecrypted(ByteV& result, bool finalize, size_t max_size)
 	}
 }
 
+inline size_t Cipher::encryptInto(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, bool finalize)
+{
+	if (!encrypt_cache.empty()) {
+		throw Exception("Encrypted data must be read before encrypting to buffer!");
+	}
+	if (result_size < getMaxResultSize(data_size)) {
+		throw Exception("Not enough room for encrypted data!");
+	}
+	return doEncryptionInto(result, data, data_size, finalize);
+}
+
+inline size_t Cipher::decryptInto(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, bool finalize)
+{
+	if (!decrypt_cache.empty()) {
+		throw Exception("Decrypted data must be read before decrypting to buffer!");
+	}
+	if (result_size < getMaxResultSize(data_size)) {
+		throw Exception("Not enough room for decrypted data!");
+	}
+	return doDecryptionInto(result, data, data_size, finalize);
+}
+
+inline size_t Cipher::encryptInto(ByteView result, ConstByteView data, bool finalize)
+{
+	return encryptInto(result.data(), result.size(), data.data(), data.size(), finalize);
+}
+
+inline size_t Cipher::decryptInto(ByteView result, ConstByteView data, bool finalize)
+{
+	return decryptInto(result.data(), result.size(), data.data(), data.size(), finalize);
+}
+
+inline void Cipher::encryptInPlace(ByteV& data, bool finalize)
+{
+	size_t data_size = data.size();
+	data.resize(getMaxResultSize(data_size));
+	data.resize(encryptInto(&data[0], data.size(), &data[0], data_size, finalize));
+}
+
+inline void Cipher::decryptInPlace(ByteV& data, bool finalize)
+{
+	size_t data_size = data.size();
+	data.resize(getMaxResultSize(data_size));
+	data.resize(decryptInto(&data[0], data.size(), &data[0], data_size, finalize));
+}
+
+inline void Cipher::encryptInPlace(std::vector< ByteV >& buffers, bool finalize)
+{
+	for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+		encryptInPlace(buffers[buffer_id], finalize && buffer_id + 1 == buffers.size());
+	}
+}
+
+inline void Cipher::decryptInPlace(std::vector< ByteV >& buffers, bool finalize)
+{
+	for (size_t buffer_id = 0; buffer_id < buffers.size(); ++ buffer_id) {
+		decryptInPlace(buffers[buffer_id], finalize && buffer_id + 1 == buffers.size());
+	}
+}
+
+inline size_t Cipher::doEncryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
+{
+	ByteV subresult;
+	doEncryption(subresult, data, data_size);
+	if (finalize) {
+		finalizeEncryption(subresult);
+	}
+	if (subresult.size() > getMaxResultSize(data_size)) {
+		throw Exception("Cipher produced more data than expected!");
+	}
+	if (!subresult.empty()) {
+		memcpy(result, &subresult[0], subresult.size());
+	}
+	return subresult.size();
+}
+
+inline size_t Cipher::doDecryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
+{
+	ByteV subresult;
+	doDecryption(subresult, data, data_size);
+	if (finalize) {
+		finalizeDecryption(subresult);
+	}
+	if (subresult.size() > getMaxResultSize(data_size)) {
+		throw Exception("Cipher produced more data than expected!");
+	}
+	if (!subresult.empty()) {
+		memcpy(result, &subresult[0], subresult.size());
+	}
+	return subresult.size();
+}
+
 }
 
 #endif
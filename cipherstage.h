@@ -0,0 +1,48 @@
+#ifndef HPP_CIPHERSTAGE_H
+#define HPP_CIPHERSTAGE_H
+
+#include "transportstage.h"
+#include "cipher.h"
+
+namespace Hpp
+{
+
+// Encryption stage. The Cipher is not owned by this stage. Data is
+// encrypted straight to result buffer, without going through the cache
+// of Cipher. Cipher is never finalized, so it must be a stream cipher
+// without padding, for example AES256OFBCipher. With block ciphers, the
+// last partial block of every message would be held back until the
+// next message.
+class CipherStage : public TransportStage
+{
+
+public:
+
+	inline CipherStage(Cipher* cipher) : cipher(cipher) { }
+	inline virtual ~CipherStage(void) { }
+
+private:
+
+	Cipher* cipher;
+
+	inline virtual void encode(ByteV& result, uint8_t const* data, size_t data_size)
+	{
+		size_t result_begin = result.size();
+		result.resize(result_begin + cipher->getMaxResultSize(data_size));
+		size_t result_size = cipher->encryptInto(&result[result_begin], result.size() - result_begin, data, data_size);
+		result.resize(result_begin + result_size);
+	}
+
+	inline virtual void decode(ByteV& result, uint8_t const* data, size_t data_size)
+	{
+		size_t result_begin = result.size();
+		result.resize(result_begin + cipher->getMaxResultSize(data_size));
+		size_t result_size = cipher->decryptInto(&result[result_begin], result.size() - result_begin, data, data_size);
+		result.resize(result_begin + result_size);
+	}
+
+};
+
+}
+
+#endif
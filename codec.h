@@ -0,0 +1,132 @@
+#ifndef HPP_CODEC_H
+#define HPP_CODEC_H
+
+#include "bytev.h"
+#include "exception.h"
+#include "noncopyable.h"
+
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Base class for block compression algorithms. Codecs compress one
+// buffer at a time, so they suit well for network frames and caches.
+// Codec objects may hold working memory, so one object should not be
+// used from multiple threads at the same time.
+//
+// Packed data has a small header that tells the codec and the size of
+// original data, so it can be unpacked without knowing which codec was
+// used. See unpack() in codecs.h.
+class Codec : public NonCopyable
+{
+
+public:
+
+	// Identifiers of codecs. These are stored to packed
+	// data, so existing values must never be changed.
+	enum Id {
+		ZLIB = 1,
+		LZ77 = 2
+	};
+
+	inline Codec(void) { }
+	inline virtual ~Codec(void) { }
+
+	virtual Id getId(void) const = 0;
+
+	// Returns size of result buffer that is always enough for compress()
+	virtual size_t getMaxCompressedSize(size_t data_size) const = 0;
+
+	// Returns size that data of given compressed size can never exceed.
+	// This is used to reject corrupted headers before allocating.
+	virtual size_t getMaxDecompressedSize(size_t compressed_size) const = 0;
+
+	// Compresses data to result buffer, that must be at least
+	// getMaxCompressedSize() bytes. Returns size of compressed data.
+	virtual size_t compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size) = 0;
+
+	// Decompresses data. Size of result must be exactly the size of
+	// original data. Throws exception if data is corrupted.
+	virtual void decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size) = 0;
+
+	// Compresses data and appends it with header to result
+	inline void pack(ByteV& result, uint8_t const* data, size_t data_size);
+	inline void pack(ByteV& result, ByteV const& data);
+
+	// Reads header of packed data. Returns size of header.
+	inline static size_t readHeader(uint8_t& codec_id, size_t& data_size, uint8_t const* packed, size_t packed_size);
+
+	// Maximum size of header
+	static size_t const MAX_HEADER_SIZE = 12;
+
+private:
+
+	static uint8_t const HEADER_MAGIC = 0xC5;
+
+};
+
+inline void Codec::pack(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	size_t result_begin = result.size();
+	result.resize(result_begin + MAX_HEADER_SIZE + getMaxCompressedSize(data_size));
+
+	// Header is magic byte, codec and size of
+	// original data as variable length integer.
+	uint8_t* header = &result[result_begin];
+	size_t header_size = 0;
+	header[header_size ++] = HEADER_MAGIC;
+	header[header_size ++] = getId();
+	uint64_t size_left = data_size;
+	while (size_left >= 0x80) {
+		header[header_size ++] = (size_left & 0x7f) | 0x80;
+		size_left >>= 7;
+	}
+	header[header_size ++] = size_left;
+
+	size_t compressed_size;
+	try {
+		compressed_size = compress(header + header_size, result.size() - result_begin - header_size, data, data_size);
+	}
+	catch ( ... ) {
+		result.resize(result_begin);
+		throw;
+	}
+	result.resize(result_begin + header_size + compressed_size);
+}
+
+inline void Codec::pack(ByteV& result, ByteV const& data)
+{
+	pack(result, data.empty() ? NULL : &data[0], data.size());
+}
+
+inline size_t Codec::readHeader(uint8_t& codec_id, size_t& data_size, uint8_t const* packed, size_t packed_size)
+{
+	if (packed_size < 3 || packed[0] != HEADER_MAGIC) {
+		throw Exception("Invalid header of packed data!");
+	}
+	codec_id = packed[1];
+	uint64_t size = 0;
+	size_t header_size = 2;
+	uint8_t shift = 0;
+	while (true) {
+		if (header_size >= packed_size || shift > 63) {
+			throw Exception("Invalid header of packed data!");
+		}
+		uint8_t byte = packed[header_size ++];
+		size |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			break;
+		}
+		shift += 7;
+	}
+	data_size = size;
+	if (data_size != size) {
+		throw Exception("Packed data is too big!");
+	}
+	return header_size;
+}
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef HPP_CODECS_H
+#define HPP_CODECS_H
+
+#include "codec.h"
+#include "zlibcodec.h"
+#include "lz77codec.h"
+#include "exception.h"
+
+namespace Hpp
+{
+
+// Creates codec by its ID. Caller is responsible of deleting it.
+inline Codec* createCodec(uint8_t codec_id)
+{
+	switch (codec_id) {
+	case Codec::ZLIB:
+		return new ZlibCodec();
+	case Codec::LZ77:
+		return new Lz77Codec();
+	}
+	throw Exception("Unknown codec!");
+}
+
+// Unpacks data that has been packed by any codec and appends it to
+// result. Decompression of built in codecs needs no working memory,
+// so codec objects are cheap to create here.
+inline void unpack(ByteV& result, uint8_t const* packed, size_t packed_size)
+{
+	uint8_t codec_id;
+	size_t data_size;
+	size_t header_size = Codec::readHeader(codec_id, data_size, packed, packed_size);
+
+	ZlibCodec zlib_codec;
+	Lz77Codec lz77_codec;
+	Codec* codec;
+	if (codec_id == Codec::ZLIB) {
+		codec = &zlib_codec;
+	} else if (codec_id == Codec::LZ77) {
+		codec = &lz77_codec;
+	} else {
+		throw Exception("Unknown codec!");
+	}
+	if (data_size > codec->getMaxDecompressedSize(packed_size - header_size)) {
+		throw Exception("Corrupted data!");
+	}
+	if (!data_size) {
+		return;
+	}
+
+	size_t result_begin = result.size();
+	result.resize(result_begin + data_size);
+	try {
+		codec->decompress(&result[result_begin], data_size, packed + header_size, packed_size - header_size);
+	}
+	catch ( ... ) {
+		result.resize(result_begin);
+		throw;
+	}
+}
+
+inline void unpack(ByteV& result, ByteV const& packed)
+{
+	unpack(result, packed.empty() ? NULL : &packed[0], packed.size());
+}
+
+}
+
+#endif
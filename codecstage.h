@@ -0,0 +1,41 @@
+#ifndef HPP_CODECSTAGE_H
+#define HPP_CODECSTAGE_H
+
+#include "transportstage.h"
+#include "codecs.h"
+
+namespace Hpp
+{
+
+// Compression stage that packs every message independently with given
+// codec. Unlike DeflateStage, messages do not refer to each other, but
+// with Lz77Codec this is much faster. Receiver does not need to know
+// the codec, because it is stored to every message. The Codec is not
+// owned by this stage.
+class CodecStage : public TransportStage
+{
+
+public:
+
+	inline CodecStage(Codec* codec) : codec(codec) { }
+	inline virtual ~CodecStage(void) { }
+
+private:
+
+	Codec* codec;
+
+	inline virtual void encode(ByteV& result, uint8_t const* data, size_t data_size)
+	{
+		codec->pack(result, data, data_size);
+	}
+
+	inline virtual void decode(ByteV& result, uint8_t const* data, size_t data_size)
+	{
+		unpack(result, data, data_size);
+	}
+
+};
+
+}
+
+#endif
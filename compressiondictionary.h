@@ -0,0 +1,206 @@
+#ifndef HPP_COMPRESSIONDICTIONARY_H
+#define HPP_COMPRESSIONDICTIONARY_H
+
+#include "bytev.h"
+#include "path.h"
+#include "exception.h"
+
+#include <zlib.h>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Preset dictionary for zlib. Small messages compress poorly, because
+// there is no earlier data to refer to. With a dictionary that contains
+// typical content of messages, even short ones can be compressed well.
+// Same dictionary must be given to Compressor and Decompressor.
+//
+// The ID of dictionary is its Adler-32 checksum. Zlib stores it to the
+// header of stream, so Decompressor can pick the right dictionary.
+class CompressionDictionary
+{
+
+public:
+
+	// Zlib uses at most this much of the end of dictionary
+	static size_t const MAX_SIZE = 32 * 1024;
+
+	inline CompressionDictionary(void) : id(adler32(0, Z_NULL, 0)) { }
+	inline CompressionDictionary(ByteV const& data) { setData(data); }
+
+	inline void setData(ByteV const& data);
+	inline ByteV const& getData(void) const { return data; }
+	inline uint32_t getId(void) const { return id; }
+
+	// Dictionary file is just the raw data
+	inline void load(Path const& path);
+	inline void save(Path const& path) const;
+
+	// Builds dictionary from sample messages. Samples should be
+	// typical messages, and there should be plenty of them. Parts that
+	// occur in many samples are selected, so that the most common ones
+	// are at the end, where they are cheapest to refer to.
+	inline static CompressionDictionary train(std::vector< ByteV > const& samples, size_t max_size = MAX_SIZE);
+
+private:
+
+	// Parameters of training. Segments of samples are scored by how
+	// common their short substrings are among all samples.
+	static size_t const TRAIN_KMER_SIZE = 8;
+	static size_t const TRAIN_SEGMENT_SIZE = 64;
+	static size_t const TRAIN_HASH_BITS = 20;
+
+	struct Segment
+	{
+		uint64_t score;
+		size_t sample;
+		size_t offset;
+		inline bool operator<(Segment const& s) const { return score < s.score; }
+	};
+
+	ByteV data;
+	uint32_t id;
+
+	inline static uint32_t hashKmer(uint8_t const* kmer);
+
+};
+
+inline void CompressionDictionary::setData(ByteV const& data)
+{
+	this->data = data;
+	id = adler32(adler32(0, Z_NULL, 0), data.empty() ? Z_NULL : &data[0], data.size());
+}
+
+inline void CompressionDictionary::load(Path const& path)
+{
+	setData(path.readBytes());
+}
+
+inline void CompressionDictionary::save(Path const& path) const
+{
+	path.writeBytes(data);
+}
+
+inline CompressionDictionary CompressionDictionary::train(std::vector< ByteV > const& samples, size_t max_size)
+{
+	max_size = std::min(max_size, size_t(MAX_SIZE));
+
+	// Count in how many samples every substring occurs. Substrings are
+	// hashed, so counts are approximate. For every hash, the last
+	// sample it was seen in is stored to count every sample once.
+	size_t const hashes_size = size_t(1) << TRAIN_HASH_BITS;
+	std::vector< uint32_t > counts(hashes_size, 0);
+	std::vector< uint32_t > last_sample(hashes_size, 0);
+	size_t total_size = 0;
+	for (size_t sample_id = 0; sample_id < samples.size(); ++ sample_id) {
+		ByteV const& sample = samples[sample_id];
+		total_size += sample.size();
+		for (size_t ofs = 0; ofs + TRAIN_KMER_SIZE <= sample.size(); ++ ofs) {
+			uint32_t hash = hashKmer(&sample[ofs]);
+			if (last_sample[hash] != sample_id + 1) {
+				last_sample[hash] = sample_id + 1;
+				++ counts[hash];
+			}
+		}
+	}
+	// Substrings that occur in only one sample are useless
+	for (size_t hash = 0; hash < hashes_size; ++ hash) {
+		if (counts[hash] < 2) {
+			counts[hash] = 0;
+		}
+	}
+
+	// Samples are split to epochs, and the best segment of every epoch
+	// is selected. When segment is selected, its substrings are not
+	// counted anymore, so later segments bring something new.
+	size_t segments_amount = max_size / TRAIN_SEGMENT_SIZE;
+	size_t epoch_size = std::max(total_size / std::max(segments_amount, size_t(1)), size_t(TRAIN_SEGMENT_SIZE));
+	size_t const kmers_in_segment = TRAIN_SEGMENT_SIZE - TRAIN_KMER_SIZE + 1;
+	std::vector< Segment > selected;
+	size_t sample_id = 0;
+	size_t sample_begin = 0;
+	for (size_t epoch_begin = 0; epoch_begin < total_size; epoch_begin += epoch_size) {
+		size_t epoch_end = std::min(epoch_begin + epoch_size, total_size);
+
+		// Skip samples that end before this epoch
+		while (sample_id < samples.size() && sample_begin + samples[sample_id].size() <= epoch_begin) {
+			sample_begin += samples[sample_id].size();
+			++ sample_id;
+		}
+
+		Segment best;
+		best.score = 0;
+		size_t epoch_sample_begin = sample_begin;
+		for (size_t epoch_sample_id = sample_id;
+		     epoch_sample_id < samples.size() && epoch_sample_begin < epoch_end;
+		     epoch_sample_begin += samples[epoch_sample_id].size(), ++ epoch_sample_id) {
+			ByteV const& sample = samples[epoch_sample_id];
+			if (sample.size() < TRAIN_SEGMENT_SIZE) {
+				continue;
+			}
+			// Segments that begin inside this epoch
+			size_t first = std::max(epoch_begin, epoch_sample_begin) - epoch_sample_begin;
+			size_t last = std::min(epoch_end - epoch_sample_begin, sample.size() - TRAIN_SEGMENT_SIZE + 1);
+			if (first >= last) {
+				continue;
+			}
+			// Score of segment is updated when it slides forward
+			uint64_t score = 0;
+			for (size_t kmer = 0; kmer < kmers_in_segment; ++ kmer) {
+				score += counts[hashKmer(&sample[first + kmer])];
+			}
+			for (size_t ofs = first; ofs < last; ++ ofs) {
+				if (ofs > first) {
+					score -= counts[hashKmer(&sample[ofs - 1])];
+					score += counts[hashKmer(&sample[ofs + kmers_in_segment - 1])];
+				}
+				if (score > best.score) {
+					best.score = score;
+					best.sample = epoch_sample_id;
+					best.offset = ofs;
+				}
+			}
+		}
+
+		if (best.score > 0) {
+			selected.push_back(best);
+			ByteV const& sample = samples[best.sample];
+			for (size_t kmer = 0; kmer < kmers_in_segment; ++ kmer) {
+				counts[hashKmer(&sample[best.offset + kmer])] = 0;
+			}
+		}
+	}
+
+	// Best segments go to the end
+	std::stable_sort(selected.begin(), selected.end());
+	ByteV dict_data;
+	dict_data.reserve(selected.size() * TRAIN_SEGMENT_SIZE);
+	for (std::vector< Segment >::const_iterator selected_it = selected.begin();
+	     selected_it != selected.end();
+	     ++ selected_it) {
+		ByteV const& sample = samples[selected_it->sample];
+		dict_data.insert(dict_data.end(), sample.begin() + selected_it->offset, sample.begin() + selected_it->offset + TRAIN_SEGMENT_SIZE);
+	}
+	if (dict_data.size() > max_size) {
+		dict_data.erase(dict_data.begin(), dict_data.end() - max_size);
+	}
+
+	return CompressionDictionary(dict_data);
+}
+
+inline uint32_t CompressionDictionary::hashKmer(uint8_t const* kmer)
+{
+	uint32_t a;
+	uint32_t b;
+	memcpy(&a, kmer, 4);
+	memcpy(&b, kmer + 4, 4);
+	return ((a * 2654435761U) ^ (b * 2246822519U)) >> (32 - TRAIN_HASH_BITS);
+}
+
+}
+
+#endif
@@ -4,9 +4,21 @@
 #include "assert.h"
 #include "exception.h"
 #include "bytev.h"
-#include "byteq.h"
+#include "byteview.h"
+#include "compressiondictionary.h"
+#include "thread.h"
+#include "mutex.h"
+#include "condition.h"
+#include "lock.h"
+#include "cores.h"
 
 #include <zlib.h>
+#include <list>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <new>
 
 namespace Hpp
 {
@@ -26,246 +38,748 @@ public:
 	inline Compressor(void);
 	inline ~Compressor(void);
 
-	// Initializes compression
-	inline void init(int level = DEFAULT_COMPRESSION);
-
-	// Compress a chunk of data
+	// Initializes compression. If more than one thread is used, then
+	// input is split to blocks that are compressed in parallel. Every
+	// block uses the end of previous block as its dictionary, so the
+	// result is a normal zlib stream, and it is the same with any
+	// amount of threads above one. It differs from the result of one
+	// thread, because blocks are flushed separately. Zero threads means
+	// one per core. Worker threads are started on first parallel block
+	// and kept until deinit(), so reset() does not start them again. If
+	// dictionary is given, it must be kept alive until compressor is
+	// deinitialized.
+	inline void init(int level = DEFAULT_COMPRESSION, size_t threads = 1, CompressionDictionary const* dict = NULL);
+
+	// Starts a new stream with same settings. Old output is discarded.
+	// This is much cheaper than deinit() and init(), so it should be
+	// used when many small messages are compressed separately.
+	inline void reset(void);
+
+	// Compress a chunk of data. Data is given directly to zlib,
+	// so it is not copied to any intermediate buffer.
 	inline void compress(ByteV const& data);
+	inline void compress(uint8_t const* data, size_t data_size);
+	inline void compress(ConstByteView data);
 
 	// Reads a piece of compressed data. If max_size is set to 0, then
 	// maximum amount of compressed data is returned.
 	inline ByteV read(size_t max_size = 0);
 
+	// Reads compressed data to given buffer. Returns amount of bytes read.
+	inline size_t read(uint8_t* buf, size_t buf_size);
+	inline size_t read(ByteView buf) { return read(buf.data(), buf.size()); }
+
+	// Returns view to the oldest unread compressed output, without
+	// copying it. View is valid until compressor is used again. Mark
+	// bytes read with skip(). Returns empty view if there is no output.
+	inline ConstByteView peekChunk(void);
+	inline void skip(size_t size);
+
+	// Gives the oldest block of compressed output to caller without
+	// copying it. Old contents of "chunk" are lost. Returns false if
+	// there is no output available.
+	inline bool readChunk(ByteV& chunk);
+
+	// Returns amount of compressed data that can be read right now
+	inline size_t getAmountOfOutput(void);
+
+	// Ends compressed stream. After this, no more data can be compressed,
+	// but the rest of output can be read, for example with readChunk().
+	inline void finish(void);
+
 	// Deinitializes compression and returns the remaining bytes.
 	inline ByteV deinit(void);
 
-private:
+	// One-shot compression from span to span. Returns size of compressed
+	// data. Output buffer must be at least getMaxCompressedSize() bytes.
+	inline static size_t compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, int level = DEFAULT_COMPRESSION);
+	inline static size_t compress(ByteView result, ConstByteView data, int level = DEFAULT_COMPRESSION) { return compress(result.data(), result.size(), data.data(), data.size(), level); }
+	inline static size_t getMaxCompressedSize(size_t data_size) { return compressBound(data_size); }
 
-	// Sizes of dataholders
-	static size_t const INPUT_SIZE = 2048;
-	static size_t const OUTPUT_SIZE = 2048;
+private:
 
-	// Is compressor initialized
+	typedef std::list< ByteV > Blocks;
+
+	// Size of output blocks
+	static size_t const OUTPUT_SIZE = 64 * 1024;
+
+	// Size of input blocks in parallel mode and
+	// maximum size of dictionary of every block
+	static size_t const PARALLEL_BLOCK_SIZE = 128 * 1024;
+	static size_t const PARALLEL_DICTIONARY_SIZE = 32 * 1024;
+
+	// Compression of one block in parallel mode
+	struct ParallelJob
+	{
+		uint8_t const* data;
+		size_t data_size;
+		uint8_t const* dict;
+		size_t dict_size;
+		int level;
+		bool last;
+		ByteV result;
+		uLong adler;
+		std::string error;
+	};
+	typedef std::vector< ParallelJob > ParallelJobs;
+
+	// Threads that run parallel jobs. Jobs are taken in order, and
+	// the thread that calls compressParallel() takes them too.
+	struct Workers
+	{
+		std::vector< Thread > threads;
+		Mutex mutex;
+		// Signaled when there are new jobs or workers should stop
+		Condition jobs_cond;
+		// Signaled when the last job has finished
+		Condition done_cond;
+		ParallelJobs* jobs;
+		size_t next_job;
+		size_t jobs_left;
+		bool stop;
+	};
+
+	// Is compressor initialized and has the stream been finished
 	bool initialized;
+	bool finished;
+
+	// Settings of stream
+	int level;
+	size_t threads;
+	CompressionDictionary const* dict;
+
+	// Parallel mode. Input is collected until there is one block
+	// for every thread. End of previous block is kept as dictionary.
+	ByteV parallel_input;
+	ByteV parallel_dict;
+	uLong parallel_adler;
+	Workers* workers;
 
 	// The ZLib Stream object.
-	z_streamp zstrm;
+	z_stream zstrm;
+
+	// Block that zlib is currently writing to
+	ByteV output;
+
+	// Full blocks of output that wait for reading. Reading
+	// of the first block may have been started already.
+	Blocks blocks;
+	size_t blocks_size;
+	size_t first_block_read;
 
-	// C-arrays of input and output data.
-	Bytef* input;
-	Bytef* output;
+	// Moves compressed data from current output to blocks
+	inline void flushOutput(void);
 
-	// Pending output buffer
-	ByteQ output_queue;
+	// Makes output ready to receive more compressed data
+	inline void resetOutput(void);
+
+	// Starts new stream after zlib stream has been initialized or reset
+	inline void beginStream(void);
+
+	// Compresses full blocks of parallel input. If
+	// "last" is set, then all input is compressed.
+	inline void compressParallel(bool last);
+
+	inline void startWorkers(void);
+	inline void stopWorkers(void);
+
+	// Runs jobs until there are no more left to take
+	inline static void runJobs(Workers* workers);
+
+	static void workerThread(void* workers_raw);
+	static void parallelJob(void* job_raw);
 
 };
 
 inline Compressor::Compressor(void) :
-initialized(false)
+initialized(false),
+finished(false),
+level(DEFAULT_COMPRESSION),
+threads(1),
+dict(NULL),
+parallel_adler(0),
+workers(NULL),
+blocks_size(0),
+first_block_read(0)
 {
-	// Allocate space for data holders
-	input = new(std::nothrow) Bytef[INPUT_SIZE];
-	output = new(std::nothrow) Bytef[OUTPUT_SIZE];
-	if (!input || !output) {
-		delete input;
-		delete output;
-		throw std::bad_alloc();
-	}
-
-	zstrm = new z_stream;
 	// Tune allocation of zstream
-	zstrm->zalloc = Z_NULL;
-	zstrm->zfree = Z_NULL;
-	zstrm->next_in = input;
-	zstrm->avail_in = 0;
-	zstrm->next_out = output;
-	zstrm->avail_out = OUTPUT_SIZE;
+	zstrm.zalloc = Z_NULL;
+	zstrm.zfree = Z_NULL;
+	zstrm.opaque = Z_NULL;
 }
 
 inline Compressor::~Compressor(void)
 {
 	HppAssert(!initialized, "");
-	delete[] input;
-	delete[] output;
-	delete zstrm;
+	if (initialized && threads <= 1) {
+		deflateEnd(&zstrm);
+	}
+	stopWorkers();
 }
 
-inline void Compressor::init(int level)
+inline void Compressor::init(int level, size_t threads, CompressionDictionary const* dict)
 {
 	HppAssert(!initialized, "Compressor is already initialized!");
-	// Tune data containers of zstream
-	zstrm->next_in = input;
-	zstrm->avail_in = 0;
-	zstrm->next_out = output;
-	zstrm->avail_out = OUTPUT_SIZE;
-	// Initialize ZStream.
-	int err = deflateInit(zstrm, level);
-	if (err == Z_MEM_ERROR) {
-		throw std::bad_alloc();
-	}
-	if (err == Z_STREAM_ERROR) {
+	if (level != DEFAULT_COMPRESSION && (level < NO_COMPRESSION || level > BEST)) {
 		throw Exception("Invalid compression level!");
 	}
-	if (err == Z_VERSION_ERROR) {
-		throw Exception("Invalid zlib version!");
+	if (threads == 0) {
+		threads = getNumberOfCores();
+	}
+	this->level = level;
+	this->threads = threads;
+	this->dict = dict;
+
+	if (threads <= 1) {
+		// Initialize ZStream.
+		zstrm.next_in = Z_NULL;
+		zstrm.avail_in = 0;
+		int err = deflateInit(&zstrm, level);
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if (err == Z_STREAM_ERROR) {
+			throw Exception("Invalid compression level!");
+		}
+		if (err == Z_VERSION_ERROR) {
+			throw Exception("Invalid zlib version!");
+		}
+	}
+
+	try {
+		beginStream();
+	}
+	catch ( ... ) {
+		if (threads <= 1) {
+			deflateEnd(&zstrm);
+		}
+		throw;
 	}
 
 	initialized = true;
 }
 
+inline void Compressor::reset(void)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	if (threads <= 1) {
+		#ifndef NDEBUG
+		int err = deflateReset(&zstrm);
+		#else
+		deflateReset(&zstrm);
+		#endif
+		HppAssert(err == Z_OK, "");
+	}
+	beginStream();
+}
+
 inline void Compressor::compress(ByteV const& data)
+{
+	if (!data.empty()) {
+		compress(&data[0], data.size());
+	}
+}
+
+inline void Compressor::compress(uint8_t const* data, size_t data_size)
 {
 	HppAssert(initialized, "Compressor is not initialized!");
-	size_t data_compressed = 0;
-	while (data_compressed < data.size()) {
-
-		// Put as much data as possible to input buffer
-		size_t input_used = zstrm->next_in - input + zstrm->avail_in;
-		size_t copy_size;
-		if (INPUT_SIZE - input_used <= (data.size() - data_compressed)) {
-			copy_size = INPUT_SIZE - input_used;
-		} else {
-			copy_size = data.size() - data_compressed;
-		}
-		memcpy(zstrm->next_in + zstrm->avail_in,
-		       &data[data_compressed],
-		       copy_size);
-		zstrm->avail_in += copy_size;
-		data_compressed += copy_size;
-		HppAssert(data_compressed <= data.size(), "");
-
-		// Compress only if the whole input buffer is full.
-		HppAssert(input_used + copy_size <= INPUT_SIZE, "");
-		if (input_used + copy_size == INPUT_SIZE) {
-			#ifndef NDEBUG
-			int err = deflate(zstrm, false);
-			#else
-			deflate(zstrm, false);
-			#endif
-			HppAssert(err != Z_STREAM_ERROR, "");
-			HppAssert(err != Z_BUF_ERROR || zstrm->avail_out == 0, "");
-			if (zstrm->next_in == input + INPUT_SIZE) {
-				zstrm->next_in = input;
-				zstrm->avail_in = 0;
-			}
+	HppAssert(!finished, "Compressed stream is already finished!");
+	if (threads > 1) {
+		parallel_input.insert(parallel_input.end(), data, data + data_size);
+		if (parallel_input.size() >= PARALLEL_BLOCK_SIZE * threads) {
+			compressParallel(false);
 		}
+		return;
+	}
+	zstrm.next_in = const_cast< Bytef* >(data);
+	zstrm.avail_in = data_size;
+	while (zstrm.avail_in > 0) {
+		#ifndef NDEBUG
+		int err = deflate(&zstrm, Z_NO_FLUSH);
+		#else
+		deflate(&zstrm, Z_NO_FLUSH);
+		#endif
+		HppAssert(err != Z_STREAM_ERROR, "");
+		HppAssert(err != Z_BUF_ERROR || zstrm.avail_out == 0, "");
 
-		// If output is full, then empty it to queue
-		if (zstrm->avail_out == 0) {
-			Bytef* output_end = output + OUTPUT_SIZE;
-			HppAssert(zstrm->next_out == output_end, "");
-			for (Bytef* output_it = output;
-			     output_it != output_end;
-			     output_it ++) {
-				output_queue.push(*output_it);
-			}
-			zstrm->next_out = output;
-			zstrm->avail_out = OUTPUT_SIZE;
+		// If output is full, then move it to blocks
+		if (zstrm.avail_out == 0) {
+			flushOutput();
 		}
-
 	}
+}
 
+inline void Compressor::compress(ConstByteView data)
+{
+	if (!data.empty()) {
+		compress(data.data(), data.size());
+	}
 }
 
 inline ByteV Compressor::read(size_t max_size)
 {
 	HppAssert(initialized, "Compressor is not initialized!");
+	flushOutput();
+
+	// If everything is wanted and it is in one
+	// block, then it can be given without copying.
 	ByteV result;
-	if (max_size) {
-		result.reserve(max_size);
-	} else {
-		result.reserve(output_queue.size() + OUTPUT_SIZE);
+	if (!max_size && blocks.size() == 1 && first_block_read == 0) {
+		result.swap(blocks.front());
+		blocks.clear();
+		blocks_size = 0;
+		return result;
 	}
 
-	do {
+	size_t result_size = blocks_size;
+	if (max_size && max_size < result_size) {
+		result_size = max_size;
+	}
+	result.resize(result_size);
+	if (result_size) {
+		read(&result[0], result_size);
+	}
+	return result;
+}
 
-		// First move everything from queue
-		size_t from_queue;
-		if (!max_size ||
-		    output_queue.size() < max_size) {
-			from_queue = output_queue.size();
-		} else {
-			HppAssert(max_size, "");
-			from_queue = max_size;
-		}
-		for (size_t getter = 0; getter < from_queue; getter ++) {
-			HppAssert(!output_queue.empty(), "");
-			result.push_back(output_queue.front());
-			output_queue.pop();
+inline size_t Compressor::read(uint8_t* buf, size_t buf_size)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	flushOutput();
+
+	size_t result = 0;
+	while (result < buf_size && !blocks.empty()) {
+		ByteV const& block = blocks.front();
+		size_t copy_size = std::min(buf_size - result, block.size() - first_block_read);
+		memcpy(buf + result, &block[first_block_read], copy_size);
+		result += copy_size;
+		first_block_read += copy_size;
+		blocks_size -= copy_size;
+		if (first_block_read == block.size()) {
+			blocks.pop_front();
+			first_block_read = 0;
 		}
+	}
+	return result;
+}
 
-		// Stop now if we have read enough
-		HppAssert(!max_size || result.size() <= max_size, "");
-		if (max_size && result.size() == max_size) {
-			break;
-		}
+inline bool Compressor::readChunk(ByteV& chunk)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	flushOutput();
 
-		// Read output from zstream.
-		size_t zstrm_size = zstrm->next_out - output;
-		if (!max_size ||
-		    zstrm_size <= max_size - result.size()) {
-			result.insert(result.end(), output, zstrm->next_out);
-			zstrm->next_out = output;
-			zstrm->avail_out = OUTPUT_SIZE;
-			// All data is now used, so we can stop
-			break;
-		} else {
-			HppAssert(max_size, "");
-			size_t copy_size = max_size - result.size();
-			HppAssert(copy_size <= zstrm_size, "");
-			result.insert(result.end(), output, output + copy_size);
-			memmove(output, output + copy_size, zstrm_size - copy_size);
-			zstrm->next_out -= copy_size;
-			zstrm->avail_out += copy_size;
-		}
+	if (blocks.empty()) {
+		return false;
+	}
+	chunk.swap(blocks.front());
+	blocks.pop_front();
+	blocks_size -= chunk.size() - first_block_read;
+	if (first_block_read) {
+		chunk.erase(chunk.begin(), chunk.begin() + first_block_read);
+		first_block_read = 0;
+	}
+	return true;
+}
+
+inline ConstByteView Compressor::peekChunk(void)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	flushOutput();
 
-	} while (!max_size ||
-	         result.size() < max_size);
+	if (blocks.empty()) {
+		return ConstByteView();
+	}
+	ByteV const& block = blocks.front();
+	return ConstByteView(&block[first_block_read], block.size() - first_block_read);
+}
 
-	return result;
+inline void Compressor::skip(size_t size)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	flushOutput();
 
+	while (size > 0) {
+		if (blocks.empty()) {
+			throw Exception("Unable to skip more compressed output than there is!");
+		}
+		ByteV const& block = blocks.front();
+		size_t skip_size = std::min(size, block.size() - first_block_read);
+		size -= skip_size;
+		first_block_read += skip_size;
+		blocks_size -= skip_size;
+		if (first_block_read == block.size()) {
+			blocks.pop_front();
+			first_block_read = 0;
+		}
+	}
 }
 
-inline ByteV Compressor::deinit(void)
+inline size_t Compressor::getAmountOfOutput(void)
 {
 	HppAssert(initialized, "Compressor is not initialized!");
-	ByteV result;
-	result.reserve(output_queue.size() + OUTPUT_SIZE);
-	// First move everything from queue
-	while (!output_queue.empty()) {
-		result.push_back(output_queue.front());
-		output_queue.pop();
+	return blocks_size + OUTPUT_SIZE - zstrm.avail_out;
+}
+
+inline void Compressor::finish(void)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	HppAssert(!finished, "Compressed stream is already finished!");
+	if (threads > 1) {
+		compressParallel(true);
+		// Checksum of whole data
+		uint8_t trailer[4];
+		trailer[0] = parallel_adler >> 24;
+		trailer[1] = parallel_adler >> 16;
+		trailer[2] = parallel_adler >> 8;
+		trailer[3] = parallel_adler;
+		blocks.push_back(ByteV(trailer, trailer + 4));
+		blocks_size += 4;
+		finished = true;
+		return;
 	}
+	zstrm.next_in = Z_NULL;
+	zstrm.avail_in = 0;
 	while (true) {
 
-		int err = deflate(zstrm, Z_FINISH);
+		int err = deflate(&zstrm, Z_FINISH);
 		HppAssert(err != Z_STREAM_ERROR, "");
 		HppAssert(err != Z_BUF_ERROR, "");
 
-		// Move all data from output to result
-		result.insert(result.end(), output, zstrm->next_out);
-		zstrm->next_out = output;
-		zstrm->avail_out = OUTPUT_SIZE;
-
 		// Check if all data was succesfully compressed
 		if (err == Z_STREAM_END) {
-			HppAssert(zstrm->avail_in == 0, "");
 			break;
 		}
+
+		flushOutput();
 	}
-	#ifndef NDEBUG
-	int err = deflateEnd(zstrm);
-	#else
-	deflateEnd(zstrm);
-	#endif
-	HppAssert(err != Z_STREAM_ERROR, "");
-	HppAssert(err != Z_DATA_ERROR, "");
+	flushOutput();
+	finished = true;
+}
+
+inline ByteV Compressor::deinit(void)
+{
+	HppAssert(initialized, "Compressor is not initialized!");
+	if (!finished) {
+		finish();
+	}
+	ByteV result = read();
+	if (threads <= 1) {
+		#ifndef NDEBUG
+		int err = deflateEnd(&zstrm);
+		#else
+		deflateEnd(&zstrm);
+		#endif
+		HppAssert(err != Z_STREAM_ERROR, "");
+		HppAssert(err != Z_DATA_ERROR, "");
+	}
+	stopWorkers();
 
 	initialized = false;
 
 	return result;
 }
 
+inline size_t Compressor::compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size, int level)
+{
+	uLongf compressed_size = result_size;
+	int err = compress2(result, &compressed_size, data, data_size, level);
+	if (err == Z_MEM_ERROR) {
+		throw std::bad_alloc();
+	}
+	if (err == Z_BUF_ERROR) {
+		throw Exception("Not enough room for compressed data!");
+	}
+	if (err == Z_STREAM_ERROR) {
+		throw Exception("Invalid compression level!");
+	}
+	return compressed_size;
+}
+
+inline void Compressor::flushOutput(void)
+{
+	size_t output_size = OUTPUT_SIZE - zstrm.avail_out;
+	if (!output_size) {
+		return;
+	}
+	// Full blocks are given to list without copying. Partial
+	// ones are copied, so output buffer can be kept.
+	if (output_size == OUTPUT_SIZE) {
+		blocks.push_back(ByteV());
+		blocks.back().swap(output);
+	} else {
+		blocks.push_back(ByteV(output.begin(), output.begin() + output_size));
+	}
+	blocks_size += output_size;
+	resetOutput();
+}
+
+inline void Compressor::resetOutput(void)
+{
+	if (output.size() != OUTPUT_SIZE) {
+		output.resize(OUTPUT_SIZE);
+	}
+	zstrm.next_out = &output[0];
+	zstrm.avail_out = OUTPUT_SIZE;
+}
+
+inline void Compressor::beginStream(void)
+{
+	// Remove possible output of earlier stream
+	blocks.clear();
+	blocks_size = 0;
+	first_block_read = 0;
+	finished = false;
+
+	// Empty dictionary is same as no dictionary
+	bool use_dict = dict && !dict->getData().empty();
+
+	if (threads > 1) {
+		parallel_input.clear();
+		parallel_dict.clear();
+		parallel_adler = adler32(0, Z_NULL, 0);
+		// Write zlib header manually. Compression level is stored
+		// only as a hint, and checksum bits are added to it. If
+		// there is a dictionary, its ID follows the header.
+		ByteV header(2);
+		header[0] = 0x78;
+		if (level == DEFAULT_COMPRESSION || level == 6) {
+			header[1] = 2 << 6;
+		} else if (level <= 1) {
+			header[1] = 0;
+		} else if (level <= 5) {
+			header[1] = 1 << 6;
+		} else {
+			header[1] = 3 << 6;
+		}
+		if (use_dict) {
+			header[1] |= 0x20;
+		}
+		header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+		if (use_dict) {
+			uint32_t dict_id = dict->getId();
+			header.push_back(dict_id >> 24);
+			header.push_back(dict_id >> 16);
+			header.push_back(dict_id >> 8);
+			header.push_back(dict_id);
+			// First block refers to dictionary
+			ByteV const& dict_data = dict->getData();
+			size_t dict_size = std::min(size_t(PARALLEL_DICTIONARY_SIZE), dict_data.size());
+			parallel_dict.assign(dict_data.end() - dict_size, dict_data.end());
+		}
+		blocks_size = header.size();
+		blocks.push_back(ByteV());
+		blocks.back().swap(header);
+	} else if (use_dict) {
+		ByteV const& dict_data = dict->getData();
+		if (deflateSetDictionary(&zstrm, &dict_data[0], dict_data.size()) != Z_OK) {
+			throw Exception("Unable to set compression dictionary!");
+		}
+	}
+	resetOutput();
+}
+
+inline void Compressor::compressParallel(bool last)
+{
+	// Split input to jobs. Full blocks are always ended with sync
+	// flush, and the stream is ended by the remainder, even if it
+	// is empty. This way the result does not depend on how input
+	// was grouped to batches.
+	size_t blocks_amount = parallel_input.size() / PARALLEL_BLOCK_SIZE;
+	if (last) {
+		++ blocks_amount;
+	}
+	if (blocks_amount == 0) {
+		return;
+	}
+	ParallelJobs jobs(blocks_amount);
+	size_t input_used = 0;
+	for (size_t job_id = 0; job_id < blocks_amount; ++ job_id) {
+		ParallelJob& job = jobs[job_id];
+		job.data = parallel_input.empty() ? NULL : &parallel_input[0] + input_used;
+		job.data_size = std::min(size_t(PARALLEL_BLOCK_SIZE), parallel_input.size() - input_used);
+		if (job_id == 0) {
+			job.dict = parallel_dict.empty() ? NULL : &parallel_dict[0];
+			job.dict_size = parallel_dict.size();
+		} else {
+			job.dict_size = std::min(size_t(PARALLEL_DICTIONARY_SIZE), jobs[job_id - 1].data_size);
+			job.dict = job.data - job.dict_size;
+		}
+		job.level = level;
+		job.last = last && job_id == blocks_amount - 1;
+		input_used += job.data_size;
+	}
+
+	// Run jobs with workers and this thread
+	if (blocks_amount > 1 && !workers) {
+		startWorkers();
+	}
+	if (workers) {
+		Lock lock(workers->mutex);
+		workers->jobs = &jobs;
+		workers->next_job = 0;
+		workers->jobs_left = blocks_amount;
+		lock.unlock();
+		workers->jobs_cond.broadcast();
+		runJobs(workers);
+		lock.relock();
+		while (workers->jobs_left > 0) {
+			workers->done_cond.wait(workers->mutex);
+		}
+		workers->jobs = NULL;
+	} else {
+		parallelJob(reinterpret_cast< void* >(&jobs[0]));
+	}
+
+	// Collect results in order
+	for (size_t job_id = 0; job_id < blocks_amount; ++ job_id) {
+		ParallelJob& job = jobs[job_id];
+		if (!job.error.empty()) {
+			throw Exception(job.error);
+		}
+		parallel_adler = adler32_combine(parallel_adler, job.adler, job.data_size);
+		blocks_size += job.result.size();
+		blocks.push_back(ByteV());
+		blocks.back().swap(job.result);
+	}
+
+	// Keep end of input as dictionary and remove used input
+	size_t dict_size = std::min(size_t(PARALLEL_DICTIONARY_SIZE), jobs.back().data_size);
+	parallel_dict.assign(parallel_input.begin() + input_used - dict_size, parallel_input.begin() + input_used);
+	parallel_input.erase(parallel_input.begin(), parallel_input.begin() + input_used);
+}
+
+inline void Compressor::startWorkers(void)
+{
+	HppAssert(!workers, "Workers are already started!");
+	workers = new Workers;
+	workers->jobs = NULL;
+	workers->next_job = 0;
+	workers->jobs_left = 0;
+	workers->stop = false;
+	// Calling thread works too
+	workers->threads.reserve(threads - 1);
+	try {
+		for (size_t thread_id = 0; thread_id < threads - 1; ++ thread_id) {
+			workers->threads.push_back(Thread(workerThread, reinterpret_cast< void* >(workers)));
+		}
+	}
+	catch ( ... ) {
+		stopWorkers();
+		throw;
+	}
+}
+
+inline void Compressor::stopWorkers(void)
+{
+	if (!workers) {
+		return;
+	}
+	Lock lock(workers->mutex);
+	workers->stop = true;
+	lock.unlock();
+	workers->jobs_cond.broadcast();
+	for (size_t thread_id = 0; thread_id < workers->threads.size(); ++ thread_id) {
+		workers->threads[thread_id].wait();
+	}
+	delete workers;
+	workers = NULL;
+}
+
+inline void Compressor::runJobs(Workers* workers)
+{
+	Lock lock(workers->mutex);
+	while (workers->jobs && workers->next_job < workers->jobs->size()) {
+		ParallelJob* job = &(*workers->jobs)[workers->next_job];
+		++ workers->next_job;
+		lock.unlock();
+		parallelJob(reinterpret_cast< void* >(job));
+		lock.relock();
+		-- workers->jobs_left;
+		if (workers->jobs_left == 0) {
+			workers->done_cond.broadcast();
+		}
+	}
+}
+
+inline void Compressor::workerThread(void* workers_raw)
+{
+	Workers* workers = reinterpret_cast< Workers* >(workers_raw);
+	Lock lock(workers->mutex);
+	while (true) {
+		while (!workers->stop && !(workers->jobs && workers->next_job < workers->jobs->size())) {
+			workers->jobs_cond.wait(workers->mutex);
+		}
+		if (workers->stop) {
+			return;
+		}
+		lock.unlock();
+		runJobs(workers);
+		lock.relock();
+	}
+}
+
+inline void Compressor::parallelJob(void* job_raw)
+{
+	ParallelJob& job = *reinterpret_cast< ParallelJob* >(job_raw);
+
+	job.adler = adler32(adler32(0, Z_NULL, 0), job.data, job.data_size);
+
+	// Raw deflate, because header and checksum are written separately
+	z_stream strm;
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	if (deflateInit2(&strm, job.level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		job.error = "Unable to initialize parallel compression!";
+		return;
+	}
+	if (job.dict_size && deflateSetDictionary(&strm, job.dict, job.dict_size) != Z_OK) {
+		deflateEnd(&strm);
+		job.error = "Unable to set dictionary of parallel compression!";
+		return;
+	}
+
+	// Every block but the last one is ended with sync flush, so
+	// next block starts at byte boundary and can be appended.
+	int flush = job.last ? Z_FINISH : Z_SYNC_FLUSH;
+	try {
+		job.result.resize(deflateBound(&strm, job.data_size) + 16);
+	}
+	catch (std::bad_alloc const&) {
+		deflateEnd(&strm);
+		job.error = "Out of memory in parallel compression!";
+		return;
+	}
+	strm.next_in = const_cast< Bytef* >(job.data);
+	strm.avail_in = job.data_size;
+	size_t result_size = 0;
+	while (true) {
+		strm.next_out = &job.result[result_size];
+		strm.avail_out = job.result.size() - result_size;
+		int err = deflate(&strm, flush);
+		result_size = job.result.size() - strm.avail_out;
+		if (err == Z_STREAM_ERROR) {
+			deflateEnd(&strm);
+			job.error = "Parallel compression has failed!";
+			return;
+		}
+		if (strm.avail_out != 0 && (!job.last || err == Z_STREAM_END)) {
+			break;
+		}
+		// Should not happen, because of deflateBound()
+		try {
+			job.result.resize(job.result.size() * 2);
+		}
+		catch (std::bad_alloc const&) {
+			deflateEnd(&strm);
+			job.error = "Out of memory in parallel compression!";
+			return;
+		}
+	}
+	job.result.resize(result_size);
+	deflateEnd(&strm);
+}
+
 }
 
 #endif
@@ -52,15 +52,13 @@ void Connectionmanager::removerThread(void*)
 
 		Lock conns_lock(instance.conns_mutex);
 
-		if (instance.stop_requested) {
-			break;
-		}
-
+		// Connections that were destroyed just before
+		// stopping are cleaned too, so they do not leak.
 		if (instance.tcpconns_to_destroy.empty()) {
-			instance.conns_cond.wait(instance.conns_mutex);
 			if (instance.stop_requested) {
 				break;
 			}
+			instance.conns_cond.wait(instance.conns_mutex);
 		}
 
 		for (TCPConnections::iterator tcpconns_to_destroy_it = instance.tcpconns_to_destroy.begin();
@@ -6,9 +6,23 @@
 #include "../serializable.h"
 #include "../deserializable.h"
 #include "../cast.h"
+#include "../random.h"
+#include "../aes256ctrcipher.h"
+#include "../thread.h"
+#include "../cores.h"
 
+#include <openssl/evp.h>
 #include <openssl/rsa.h>
 #include <openssl/rand.h>
+#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#endif
+#include <vector>
+#include <string>
+#include <new>
 
 namespace Hpp
 {
@@ -37,13 +51,30 @@ public:
 	inline RSAKey(RSAKey const& key);
 	inline RSAKey const& operator=(RSAKey const& key);
 
-	inline bool valid(void) const { return rsa; }
-	inline bool hasPrivatePart(void) const { return rsa->d; }
+	inline bool valid(void) const { return pkey; }
+	inline bool hasPrivatePart(void) const;
 
 	// "result" is not cleared.
 	inline void encrypt(ByteV& result, ByteV const& data, Method method = DEFAULT);
 	inline void decrypt(ByteV& result, ByteV const& data, Method method = DEFAULT);
 
+	// Envelope encryption, for data of any size. Data is encrypted with
+	// AES-256-CTR using a random session key, and only the session key
+	// is encrypted with RSA, so the cost of RSA does not depend on size
+	// of data. Envelope is authenticated with HMAC-SHA256. Sealing uses
+	// public part of key and opening uses private part. If threads is
+	// zero, all cores are used for AES. "result" is not cleared.
+	inline void seal(ByteV& result, ByteV const& data, size_t threads = 1) const;
+	inline void open(ByteV& result, ByteV const& envelope, size_t threads = 1) const;
+
+	// Opens many envelopes, for example all handshakes that are waiting.
+	// Envelopes are split to threads, that all use the same key. Results
+	// replace contents of "results".
+	inline void openMany(std::vector< ByteV >& results, std::vector< ByteV > const& envelopes, size_t threads = 1) const;
+
+	// Returns size of envelope of given amount of data
+	inline size_t getEnvelopeSize(size_t data_size) const;
+
 	inline static RSAKey generatePrivateKey(size_t bits = 4096);
 	inline RSAKey generatePublicKey(void) const;
 
@@ -53,46 +84,102 @@ public:
 
 private:
 
-	RSA* rsa;
+	// Envelope consists of encrypted session secret, initialization
+	// vector, encrypted data and authentication code. Session secret
+	// has the key of AES and the key of HMAC.
+	static size_t const ENVELOPE_SECRET_SIZE = AES256CTRCipher::KEY_SIZE + 32;
+	static size_t const ENVELOPE_MAC_SIZE = 32;
+
+	// Opening of a range of envelopes
+	struct EnvelopeJob
+	{
+		RSAKey const* key;
+		ByteV* results;
+		ByteV const* envelopes;
+		size_t envelopes_size;
+		std::string error;
+	};
+	typedef std::vector< EnvelopeJob > EnvelopeJobs;
+
+	enum Operation
+	{
+		PUBLIC_ENCRYPT,
+		PRIVATE_ENCRYPT,
+		PUBLIC_DECRYPT,
+		PRIVATE_DECRYPT
+	};
+
+	enum KeyPart
+	{
+		PART_E,
+		PART_N,
+		PART_D
+	};
+
+	// Key is never modified after it has been created,
+	// so copies of RSAKey share it and threads can use it.
+	EVP_PKEY* pkey;
+
+	// Every operation has a context of its own, so that key is
+	// only read. "result_size" must be the size of buffer at first.
+	inline bool runOperation(uint8_t* result, size_t& result_size, uint8_t const* data, size_t data_size, Operation operation) const;
+
+	inline static void calculateEnvelopeMac(uint8_t* result, ByteV const& secret, uint8_t const* data, size_t data_size);
+
+	static void runEnvelopeJob(void* job_raw);
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
+
+	// "pkey" can be NULL in both functions.
+	inline static void cleanKey(EVP_PKEY* pkey);
+	inline static EVP_PKEY* shareKey(EVP_PKEY* pkey);
 
-	// "key" can be NULL in both functions.
-	inline static void cleanKey(RSA* rsa);
-	inline static RSA* cloneKey(RSA* rsa);
+	// Returns copy of part of key, or NULL if key does not have it
+	inline static BIGNUM* getKeyPart(EVP_PKEY* pkey, KeyPart part);
+	// Takes ownership of parts. "d" is NULL in public keys.
+	inline static EVP_PKEY* createKey(BIGNUM* e, BIGNUM* n, BIGNUM* d);
 
-	inline static ByteV bignumToByteV(BIGNUM* bn, bool bigendian);
-	inline static BIGNUM* istreamToBignum(std::istream& strm, bool bigendian);
+	inline static void writeBignum(BinaryWriter& writer, BIGNUM* bn);
+	inline static BIGNUM* readBignum(BinaryReader& reader);
 
 };
 
 inline RSAKey::RSAKey(void) :
-rsa(NULL)
+pkey(NULL)
 {
 }
 
 inline RSAKey::~RSAKey(void)
 {
-	cleanKey(rsa);
+	cleanKey(pkey);
 }
 
 inline RSAKey::RSAKey(RSAKey const& key)
 {
-	rsa = cloneKey(key.rsa);
+	pkey = shareKey(key.pkey);
 }
 
 inline RSAKey const& RSAKey::operator=(RSAKey const& key)
 {
-	cleanKey(rsa);
-	rsa = cloneKey(key.rsa);
+	EVP_PKEY* old_pkey = pkey;
+	pkey = shareKey(key.pkey);
+	cleanKey(old_pkey);
 	return *this;
 }
 
+inline bool RSAKey::hasPrivatePart(void) const
+{
+	BIGNUM* d = getKeyPart(pkey, PART_D);
+	bool result = d;
+	BN_clear_free(d);
+	return result;
+}
+
 inline void RSAKey::encrypt(ByteV& result, ByteV const& data, Method method)
 {
-	if (!rsa) {
+	if (!pkey) {
 		throw Exception("Unable to encrypt because RSA key is not initialized!");
 	}
 
@@ -114,7 +201,8 @@ inline void RSAKey::encrypt(ByteV& result, ByteV const& data, Method method)
 
 	size_t encrypted = 0;
 
-	ByteV chunk(RSA_size(rsa), 0);
+	size_t const KEY_SIZE = EVP_PKEY_size(pkey);
+	ByteV chunk(KEY_SIZE, 0);
 
 	while (encrypted < data.size()) {
 
@@ -124,26 +212,20 @@ inline void RSAKey::encrypt(ByteV& result, ByteV const& data, Method method)
 		// Calculate how big chunk we can encrypt with this RSA key.
 		// If it's more than there's data left to encrypt, we will
 		// snip the value shorter.
-		size_t encrypt_size = std::min< size_t >(RSA_size(rsa), data_left);
+		size_t encrypt_size = std::min(KEY_SIZE, data_left);
 
 		// Encrypt
-		int now_encrypted;
+		size_t now_encrypted = chunk.size();
 		if (final_method == PUBLIC) {
-			now_encrypted = RSA_public_encrypt(encrypt_size,
-			                                   &data[encrypted], &chunk[0],
-			                                   rsa, RSA_PKCS1_OAEP_PADDING);
-			if (now_encrypted < 0) {
+			if (!runOperation(&chunk[0], now_encrypted, &data[encrypted], encrypt_size, PUBLIC_ENCRYPT)) {
 				throw Exception("RSA public encryption has failed!");
 			}
 		} else {
-			now_encrypted = RSA_private_encrypt(encrypt_size,
-			                                    &data[encrypted], &chunk[0],
-			                                    rsa, RSA_PKCS1_PADDING);
-			if (now_encrypted < 0) {
+			if (!runOperation(&chunk[0], now_encrypted, &data[encrypted], encrypt_size, PRIVATE_ENCRYPT)) {
 				throw Exception("RSA private encryption has failed!");
 			}
 		}
-		HppAssert(now_encrypted <= RSA_size(rsa), "Unexpectedly big result!");
+		HppAssert(now_encrypted <= KEY_SIZE, "Unexpectedly big result!");
 
 		// Add part to result
 		result.insert(result.end(), chunk.begin(), chunk.begin() + now_encrypted);
@@ -152,9 +234,9 @@ inline void RSAKey::encrypt(ByteV& result, ByteV const& data, Method method)
 	}
 }
 
-void RSAKey::decrypt(ByteV& result, ByteV const& data, Method method)
+inline void RSAKey::decrypt(ByteV& result, ByteV const& data, Method method)
 {
-	if (!rsa) {
+	if (!pkey) {
 		throw Exception("Unable to decrypt because RSA key is not initialized!");
 	}
 
@@ -176,7 +258,8 @@ void RSAKey::decrypt(ByteV& result, ByteV const& data, Method method)
 
 	size_t decrypted = 0;
 
-	ByteV chunk(RSA_size(rsa), 0);
+	size_t const KEY_SIZE = EVP_PKEY_size(pkey);
+	ByteV chunk(KEY_SIZE, 0);
 
 	while (decrypted < data.size()) {
 
@@ -186,26 +269,20 @@ void RSAKey::decrypt(ByteV& result, ByteV const& data, Method method)
 		// Calculate how big chunk we can decrypt with this RSA key.
 		// If it's more than there's data left to decrypt, we will
 		// snip the value shorter.
-		size_t decrypt_size = std::min< size_t >(RSA_size(rsa), data_left);
+		size_t decrypt_size = std::min(KEY_SIZE, data_left);
 
 		// Encrypt
-		int now_decrypted;
+		size_t now_decrypted = chunk.size();
 		if (final_method == PRIVATE) {
-			now_decrypted = RSA_private_decrypt(decrypt_size,
-			                                    &data[decrypted], &chunk[0],
-			                                    rsa, RSA_PKCS1_OAEP_PADDING);
-			if (now_decrypted < 0) {
+			if (!runOperation(&chunk[0], now_decrypted, &data[decrypted], decrypt_size, PRIVATE_DECRYPT)) {
 				throw Exception("RSA private decryption has failed!");
 			}
 		} else {
-			now_decrypted = RSA_public_decrypt(decrypt_size,
-			                                   &data[decrypted], &chunk[0],
-			                                   rsa, RSA_PKCS1_PADDING);
-			if (now_decrypted < 0) {
+			if (!runOperation(&chunk[0], now_decrypted, &data[decrypted], decrypt_size, PUBLIC_DECRYPT)) {
 				throw Exception("RSA public decryption has failed!");
 			}
 		}
-		HppAssert(now_decrypted <= RSA_size(rsa), "Unexpectedly big result!");
+		HppAssert(now_decrypted <= KEY_SIZE, "Unexpectedly big result!");
 
 		// Add part to result
 		result.insert(result.end(), chunk.begin(), chunk.begin() + now_decrypted);
@@ -214,42 +291,187 @@ void RSAKey::decrypt(ByteV& result, ByteV const& data, Method method)
 	}
 }
 
+inline void RSAKey::seal(ByteV& result, ByteV const& data, size_t threads) const
+{
+	if (!pkey) {
+		throw Exception("Unable to seal envelope because RSA key is not initialized!");
+	}
+
+	ByteV secret = randomSecureData(ENVELOPE_SECRET_SIZE + AES256CTRCipher::IV_SIZE);
+	ByteV iv(secret.begin() + ENVELOPE_SECRET_SIZE, secret.end());
+	secret.resize(ENVELOPE_SECRET_SIZE);
+
+	size_t const WRAPPED_SIZE = EVP_PKEY_size(pkey);
+	size_t result_begin = result.size();
+	result.resize(result_begin + getEnvelopeSize(data.size()));
+	uint8_t* wrapped = &result[result_begin];
+	uint8_t* payload = wrapped + WRAPPED_SIZE;
+	uint8_t* mac = payload + AES256CTRCipher::IV_SIZE + data.size();
+
+	try {
+		// Only session secret is encrypted with RSA
+		size_t wrapped_size = WRAPPED_SIZE;
+		if (!runOperation(wrapped, wrapped_size, &secret[0], secret.size(), PUBLIC_ENCRYPT) || wrapped_size != WRAPPED_SIZE) {
+			throw Exception("Unable to encrypt session key of envelope! Maybe RSA key is too small?");
+		}
+
+		std::copy(iv.begin(), iv.end(), payload);
+		if (!data.empty()) {
+			AES256CTRCipher cipher(ByteV(secret.begin(), secret.begin() + AES256CTRCipher::KEY_SIZE), iv, threads);
+			// There is room for authentication code after encrypted data
+			cipher.encryptInto(payload + AES256CTRCipher::IV_SIZE, data.size() + ENVELOPE_MAC_SIZE, &data[0], data.size());
+		}
+
+		calculateEnvelopeMac(mac, secret, payload, AES256CTRCipher::IV_SIZE + data.size());
+	}
+	catch ( ... ) {
+		result.resize(result_begin);
+		throw;
+	}
+}
+
+inline void RSAKey::open(ByteV& result, ByteV const& envelope, size_t threads) const
+{
+	if (!pkey) {
+		throw Exception("Unable to open envelope because RSA key is not initialized!");
+	}
+	if (!hasPrivatePart()) {
+		throw Exception("Unable to open envelope because RSA key does not have private part!");
+	}
+
+	size_t const WRAPPED_SIZE = EVP_PKEY_size(pkey);
+	if (envelope.size() < getEnvelopeSize(0)) {
+		throw Exception("Envelope is too small!");
+	}
+	size_t data_size = envelope.size() - getEnvelopeSize(0);
+	uint8_t const* wrapped = &envelope[0];
+	uint8_t const* payload = wrapped + WRAPPED_SIZE;
+	uint8_t const* mac = payload + AES256CTRCipher::IV_SIZE + data_size;
+
+	// Decrypt session secret
+	ByteV secret(WRAPPED_SIZE, 0);
+	size_t secret_size = secret.size();
+	if (!runOperation(&secret[0], secret_size, wrapped, WRAPPED_SIZE, PRIVATE_DECRYPT) || secret_size != ENVELOPE_SECRET_SIZE) {
+		throw Exception("Unable to decrypt session key of envelope!");
+	}
+	secret.resize(ENVELOPE_SECRET_SIZE);
+
+	// Data is not decrypted before it is known to be unmodified
+	uint8_t mac_check[ENVELOPE_MAC_SIZE];
+	calculateEnvelopeMac(mac_check, secret, payload, AES256CTRCipher::IV_SIZE + data_size);
+	if (CRYPTO_memcmp(mac, mac_check, ENVELOPE_MAC_SIZE) != 0) {
+		throw Exception("Envelope has been modified!");
+	}
+
+	if (data_size == 0) {
+		return;
+	}
+	ByteV iv(payload, payload + AES256CTRCipher::IV_SIZE);
+	AES256CTRCipher cipher(ByteV(secret.begin(), secret.begin() + AES256CTRCipher::KEY_SIZE), iv, threads);
+	size_t result_begin = result.size();
+	result.resize(result_begin + cipher.getMaxResultSize(data_size));
+	try {
+		cipher.decryptInto(&result[result_begin], result.size() - result_begin, payload + AES256CTRCipher::IV_SIZE, data_size);
+	}
+	catch ( ... ) {
+		result.resize(result_begin);
+		throw;
+	}
+	result.resize(result_begin + data_size);
+}
+
+inline void RSAKey::openMany(std::vector< ByteV >& results, std::vector< ByteV > const& envelopes, size_t threads) const
+{
+	if (!pkey) {
+		throw Exception("Unable to open envelopes because RSA key is not initialized!");
+	}
+	if (!hasPrivatePart()) {
+		throw Exception("Unable to open envelopes because RSA key does not have private part!");
+	}
+
+	results.clear();
+	results.resize(envelopes.size());
+	if (envelopes.empty()) {
+		return;
+	}
+
+	if (threads == 0) {
+		threads = getNumberOfCores();
+	}
+	size_t jobs_amount = std::min(threads, envelopes.size());
+	EnvelopeJobs jobs(jobs_amount);
+	for (size_t job_id = 0; job_id < jobs_amount; ++ job_id) {
+		size_t begin = envelopes.size() * job_id / jobs_amount;
+		size_t end = envelopes.size() * (job_id + 1) / jobs_amount;
+		EnvelopeJob& job = jobs[job_id];
+		job.key = this;
+		job.results = &results[begin];
+		job.envelopes = &envelopes[begin];
+		job.envelopes_size = end - begin;
+	}
+
+	// Run jobs. The first one is run by this thread.
+	std::vector< Thread > jobs_threads;
+	jobs_threads.reserve(jobs_amount - 1);
+	for (size_t job_id = 1; job_id < jobs_amount; ++ job_id) {
+		jobs_threads.push_back(Thread(runEnvelopeJob, reinterpret_cast< void* >(&jobs[job_id])));
+	}
+	runEnvelopeJob(reinterpret_cast< void* >(&jobs[0]));
+	for (size_t thread_id = 0; thread_id < jobs_threads.size(); ++ thread_id) {
+		jobs_threads[thread_id].wait();
+	}
+
+	for (EnvelopeJobs::const_iterator jobs_it = jobs.begin();
+	     jobs_it != jobs.end();
+	     ++ jobs_it) {
+		if (!jobs_it->error.empty()) {
+			results.clear();
+			throw Exception(jobs_it->error);
+		}
+	}
+}
+
+inline size_t RSAKey::getEnvelopeSize(size_t data_size) const
+{
+	if (!pkey) {
+		throw Exception("Unable to calculate size of envelope because RSA key is not initialized!");
+	}
+	return EVP_PKEY_size(pkey) + AES256CTRCipher::IV_SIZE + data_size + ENVELOPE_MAC_SIZE;
+}
+
 inline RSAKey RSAKey::generatePrivateKey(size_t bits)
 {
 	RSAKey result;
 
 	RAND_load_file("/dev/urandom", bits / 4);
 
-	// Generate private key
-	result.rsa = RSA_new();
-	if (!result.rsa) {
+	// Generate private key. Public exponent is 65537.
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+	if (!ctx ||
+	    EVP_PKEY_keygen_init(ctx) <= 0 ||
+	    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits) <= 0 ||
+	    EVP_PKEY_keygen(ctx, &result.pkey) <= 0) {
+		EVP_PKEY_CTX_free(ctx);
 		throw Exception("Unable to create private RSA key!");
 	}
-	BIGNUM* e = BN_new();
-	if (!e) {
-		throw Exception("Unable to create exponent!");
-	}
-	BN_set_word(e, 65537);
-	RSA_generate_key_ex(result.rsa, bits, e, NULL);
-	BN_free(e);
+	EVP_PKEY_CTX_free(ctx);
 
 	return result;
 }
 
 inline RSAKey RSAKey::generatePublicKey(void) const
 {
-	if (!rsa || !rsa->e || !rsa->n) {
+	BIGNUM* e = pkey ? getKeyPart(pkey, PART_E) : NULL;
+	BIGNUM* n = pkey ? getKeyPart(pkey, PART_N) : NULL;
+	if (!e || !n) {
+		BN_free(e);
+		BN_free(n);
 		throw Exception("Unable to generate public key, because given key is not a proper private key!");
 	}
 
 	// Copy information from private key to public one.
 	RSAKey result;
-	result.rsa = RSA_new();
-	if (!result.rsa) {
-		throw Exception("Unable to create public RSA key!");
-	}
-	result.rsa->e = BN_dup(rsa->e);
-	result.rsa->n = BN_dup(rsa->n);
+	result.pkey = createKey(e, n, NULL);
 
 	return result;
 }
@@ -269,37 +491,47 @@ inline void RSAKey::constructFromJson(Json const& json)
 	deserialize(bytes);
 }
 
-inline void RSAKey::doSerialize(ByteV& result, bool bigendian) const
+inline void RSAKey::doSerialize(BinaryWriter& writer) const
 {
 	// If key is not initialized, then mark all
 	// numbers to have their length as zero.
-	if (!rsa) {
-		result += uInt32ToByteV(0);
-		result += uInt32ToByteV(0);
-		result += uInt32ToByteV(0);
+	if (!pkey) {
+		writer.writeUInt32(0);
+		writer.writeUInt32(0);
+		writer.writeUInt32(0);
 		return;
 	}
 
+	BIGNUM* e = getKeyPart(pkey, PART_E);
+	BIGNUM* n = getKeyPart(pkey, PART_N);
+	BIGNUM* d = getKeyPart(pkey, PART_D);
 	try {
-		result += bignumToByteV(rsa->e, bigendian);
-		result += bignumToByteV(rsa->n, bigendian);
-		result += bignumToByteV(rsa->d, bigendian);
+		writeBignum(writer, e);
+		writeBignum(writer, n);
+		writeBignum(writer, d);
 	}
-	catch (Exception const& e) {
-		throw Exception(std::string("Unable to serialize RSAKey! Reason: ") + e.what());
+	catch (Exception const& e2) {
+		BN_free(e);
+		BN_free(n);
+		BN_clear_free(d);
+		throw Exception(std::string("Unable to serialize RSAKey! Reason: ") + e2.what());
 	}
+	BN_free(e);
+	BN_free(n);
+	BN_clear_free(d);
 }
 
-inline void RSAKey::doDeserialize(std::istream& strm, bool bigendian)
+inline void RSAKey::doDeserialize(BinaryReader& reader)
 {
-	cleanKey(rsa);
+	cleanKey(pkey);
+	pkey = NULL;
 	BIGNUM* e = NULL;
 	BIGNUM* n = NULL;
 	BIGNUM* d = NULL;
 	try {
-		e = istreamToBignum(strm, bigendian);
-		n = istreamToBignum(strm, bigendian);
-		d = istreamToBignum(strm, bigendian);
+		e = readBignum(reader);
+		n = readBignum(reader);
+		d = readBignum(reader);
 	}
 	catch (Exception const& e2) {
 		BN_free(e);
@@ -313,54 +545,188 @@ inline void RSAKey::doDeserialize(std::istream& strm, bool bigendian)
 		return;
 	}
 
+	if (!e || !n) {
+		BN_free(e);
+		BN_free(n);
+		BN_clear_free(d);
+		throw Exception("Unable to deserialize an RSA key, because it is not complete!");
+	}
+
 	// Create new RSA key
-	rsa = RSA_new();
+	pkey = createKey(e, n, d);
+}
+
+inline void RSAKey::cleanKey(EVP_PKEY* pkey)
+{
+	EVP_PKEY_free(pkey);
+}
+
+inline EVP_PKEY* RSAKey::shareKey(EVP_PKEY* pkey)
+{
+	if (!pkey) return NULL;
+
+	// Values of Chinese remainder theorem are shared too, so
+	// private key operations of copies are as fast as originals.
+	#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	EVP_PKEY_up_ref(pkey);
+	#else
+	CRYPTO_add(&pkey->references, 1, CRYPTO_LOCK_EVP_PKEY);
+	#endif
+	return pkey;
+}
+
+inline BIGNUM* RSAKey::getKeyPart(EVP_PKEY* pkey, KeyPart part)
+{
+	#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	char const* name;
+	if (part == PART_E) {
+		name = OSSL_PKEY_PARAM_RSA_E;
+	} else if (part == PART_N) {
+		name = OSSL_PKEY_PARAM_RSA_N;
+	} else {
+		name = OSSL_PKEY_PARAM_RSA_D;
+	}
+	BIGNUM* result = NULL;
+	if (!EVP_PKEY_get_bn_param(pkey, name, &result)) {
+		return NULL;
+	}
+	return result;
+	#else
+	RSA* rsa = EVP_PKEY_get1_RSA(pkey);
 	if (!rsa) {
-		throw Exception("Unable to deserialize an RSA key!");
+		return NULL;
+	}
+	BIGNUM const* e;
+	BIGNUM const* n;
+	BIGNUM const* d;
+	#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	RSA_get0_key(rsa, &n, &e, &d);
+	#else
+	e = rsa->e;
+	n = rsa->n;
+	d = rsa->d;
+	#endif
+	BIGNUM const* source;
+	if (part == PART_E) {
+		source = e;
+	} else if (part == PART_N) {
+		source = n;
+	} else {
+		source = d;
 	}
+	BIGNUM* result = source ? BN_dup(source) : NULL;
+	RSA_free(rsa);
+	return result;
+	#endif
+}
 
-	// Set bignums
+inline EVP_PKEY* RSAKey::createKey(BIGNUM* e, BIGNUM* n, BIGNUM* d)
+{
+	EVP_PKEY* result = NULL;
+	#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	OSSL_PARAM_BLD* params_bld = OSSL_PARAM_BLD_new();
+	OSSL_PARAM* params = NULL;
+	if (params_bld &&
+	    OSSL_PARAM_BLD_push_BN(params_bld, OSSL_PKEY_PARAM_RSA_E, e) &&
+	    OSSL_PARAM_BLD_push_BN(params_bld, OSSL_PKEY_PARAM_RSA_N, n) &&
+	    (!d || OSSL_PARAM_BLD_push_BN(params_bld, OSSL_PKEY_PARAM_RSA_D, d))) {
+		params = OSSL_PARAM_BLD_to_param(params_bld);
+	}
+	EVP_PKEY_CTX* ctx = params ? EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL) : NULL;
+	if (ctx && EVP_PKEY_fromdata_init(ctx) > 0) {
+		EVP_PKEY_fromdata(ctx, &result, d ? EVP_PKEY_KEYPAIR : EVP_PKEY_PUBLIC_KEY, params);
+	}
+	EVP_PKEY_CTX_free(ctx);
+	OSSL_PARAM_free(params);
+	OSSL_PARAM_BLD_free(params_bld);
+	BN_free(e);
+	BN_free(n);
+	BN_clear_free(d);
+	#else
+	RSA* rsa = RSA_new();
+	result = EVP_PKEY_new();
+	if (!rsa || !result) {
+		RSA_free(rsa);
+		EVP_PKEY_free(result);
+		BN_free(e);
+		BN_free(n);
+		BN_clear_free(d);
+		throw Exception("Unable to create RSA key!");
+	}
+	#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	RSA_set0_key(rsa, n, e, d);
+	#else
 	rsa->e = e;
 	rsa->n = n;
 	rsa->d = d;
+	#endif
+	EVP_PKEY_assign_RSA(result, rsa);
+	#endif
+	if (!result) {
+		throw Exception("Unable to create RSA key!");
+	}
+	return result;
 }
 
-inline void RSAKey::cleanKey(RSA* rsa)
+inline bool RSAKey::runOperation(uint8_t* result, size_t& result_size, uint8_t const* data, size_t data_size, Operation operation) const
 {
-	RSA_free(rsa);
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(pkey, NULL);
+	if (!ctx) {
+		return false;
+	}
+	// Private encryption and public decryption are
+	// raw PKCS #1 signing and recovering of data.
+	bool success;
+	if (operation == PUBLIC_ENCRYPT) {
+		success = EVP_PKEY_encrypt_init(ctx) > 0 &&
+		          EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) > 0 &&
+		          EVP_PKEY_encrypt(ctx, result, &result_size, data, data_size) > 0;
+	} else if (operation == PRIVATE_ENCRYPT) {
+		success = EVP_PKEY_sign_init(ctx) > 0 &&
+		          EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) > 0 &&
+		          EVP_PKEY_sign(ctx, result, &result_size, data, data_size) > 0;
+	} else if (operation == PUBLIC_DECRYPT) {
+		success = EVP_PKEY_verify_recover_init(ctx) > 0 &&
+		          EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) > 0 &&
+		          EVP_PKEY_verify_recover(ctx, result, &result_size, data, data_size) > 0;
+	} else {
+		success = EVP_PKEY_decrypt_init(ctx) > 0 &&
+		          EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_OAEP_PADDING) > 0 &&
+		          EVP_PKEY_decrypt(ctx, result, &result_size, data, data_size) > 0;
+	}
+	EVP_PKEY_CTX_free(ctx);
+	return success;
 }
 
-inline RSA* RSAKey::cloneKey(RSA* rsa)
+inline void RSAKey::calculateEnvelopeMac(uint8_t* result, ByteV const& secret, uint8_t const* data, size_t data_size)
 {
-	// If there is no key, then cloning is not done
-	if (!rsa) return NULL;
-
-	// Create new RSA key
-	RSA* result = RSA_new();
-	if (!result) {
-		throw Exception("Unable to create new RSA key for cloning!");
+	unsigned int result_size;
+	if (!HMAC(EVP_sha256(), &secret[AES256CTRCipher::KEY_SIZE], ENVELOPE_SECRET_SIZE - AES256CTRCipher::KEY_SIZE, data, data_size, result, &result_size) || result_size != ENVELOPE_MAC_SIZE) {
+		throw Exception("Unable to calculate authentication code of envelope!");
 	}
+}
 
-	// Copy data from another key
-	if (!rsa->e || !rsa->n) {
-		RSA_free(result);
-		throw Exception("Unable to clone RSA key, because source key is not complete!");
+inline void RSAKey::runEnvelopeJob(void* job_raw)
+{
+	EnvelopeJob& job = *reinterpret_cast< EnvelopeJob* >(job_raw);
+	try {
+		for (size_t envelope_id = 0; envelope_id < job.envelopes_size; ++ envelope_id) {
+			job.key->open(job.results[envelope_id], job.envelopes[envelope_id]);
+		}
 	}
-	result->e = BN_dup(rsa->e);
-	result->n = BN_dup(rsa->n);
-	result->d = BN_dup(rsa->d);
-	if (!result->e || !result->n) {
-		RSA_free(result);
-		throw Exception("Unable to copy data from source RSA key to a new one!");
+	catch (Exception const& e) {
+		job.error = e.what();
+	}
+	catch (std::bad_alloc const&) {
+		job.error = "Out of memory in opening of envelopes!";
 	}
-
-	return result;
 }
 
-inline ByteV RSAKey::bignumToByteV(BIGNUM* bn, bool bigendian)
+inline void RSAKey::writeBignum(BinaryWriter& writer, BIGNUM* bn)
 {
 	if (!bn) {
-		return Hpp::uInt32ToByteV(0, bigendian);
+		writer.writeUInt32(0);
+		return;
 	}
 
 	int32_t size = BN_bn2mpi(bn, NULL);
@@ -373,24 +739,22 @@ inline ByteV RSAKey::bignumToByteV(BIGNUM* bn, bool bigendian)
 
 	// First four bytes represent length. But
 	// just to be sure, do this our way.
-	ByteV result = Hpp::uInt32ToByteV(size - 4, bigendian);
-	result.insert(result.end(), result_raw.begin() + 4, result_raw.end());
-
-	return result;
+	writer.writeUInt32(size - 4);
+	writer.writeBytes(&result_raw[0] + 4, size - 4);
 }
 
-inline BIGNUM* RSAKey::istreamToBignum(std::istream& strm, bool bigendian)
+inline BIGNUM* RSAKey::readBignum(BinaryReader& reader)
 {
 	// Read size of serialized bignum. If its
 	// zero, then it means there is no bignum.
-	uint32_t size = deserializeUInt32(strm, bigendian);
+	uint32_t size = reader.readUInt32();
 	if (size == 0) {
 		return NULL;
 	}
 
 	// Put size part back
 	Hpp::ByteV bignum_serialized = uInt32ToByteV(size);
-	bignum_serialized += deserializeByteV(strm, size);
+	bignum_serialized += reader.readBytes(size);
 
 	BIGNUM* result = BN_mpi2bn(&bignum_serialized[0], bignum_serialized.size(), NULL);
 	if (!result) {
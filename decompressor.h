@@ -4,9 +4,14 @@
 #include "assert.h"
 #include "exception.h"
 #include "bytev.h"
-#include "byteq.h"
+#include "compressiondictionary.h"
 
 #include <zlib.h>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <new>
 
 namespace Hpp
 {
@@ -22,78 +27,114 @@ public:
 
 	// Initializes decompression
 	inline void init(void);
+	inline bool isInitialized(void) const { return initialized; }
 
-	// Decompress a chunk of data
+	// Starts a new stream. Old output is discarded. This is much cheaper
+	// than deinit() and init(), and it also works after errors.
+	inline void reset(void);
+
+	// Adds dictionary that compressed streams may refer to. Stream tells
+	// the ID of its dictionary, so multiple ones can be added. Dictionary
+	// must be kept alive as long as this decompressor is used.
+	inline void addDictionary(CompressionDictionary const* dict) { dicts[dict->getId()] = dict; }
+
+	// Decompress a chunk of data. Data is given directly to zlib,
+	// so it is not copied to any intermediate buffer.
 	inline void decompress(ByteV const& data);
+	inline void decompress(uint8_t const* data, size_t data_size);
 
 	// Reads a piece of decompressed data. If max_size is set to 0, then
 	// maximum amount of decompressed data is returned.
 	inline ByteV read(size_t max_size = 0);
 
+	// Reads decompressed data to given buffer. Returns amount of bytes read.
+	inline size_t read(uint8_t* buf, size_t buf_size);
+
+	// Gives the oldest block of decompressed output to caller without
+	// copying it. Old contents of "chunk" are lost. Returns false if
+	// there is no output available.
+	inline bool readChunk(ByteV& chunk);
+
+	// Returns amount of decompressed data that can be read right now
+	inline size_t getAmountOfOutput(void);
+
+	// Tells if the end of compressed stream has been reached
+	inline bool isFinished(void) const { return finished; }
+
 	// Deinitializes decompression and returns the remaining bytes.
 	inline ByteV deinit(void);
 
+	// One-shot decompression from span to span. Returns size of
+	// decompressed data. Throws if result does not fit to buffer.
+	inline static size_t decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size);
+
 private:
 
-	// Sizes of dataholders
-	static size_t const INPUT_SIZE = 2048;
-	static size_t const OUTPUT_SIZE = 2048;
+	typedef std::list< ByteV > Blocks;
+	typedef std::map< uint32_t, CompressionDictionary const* > Dictionaries;
+
+	// Size of output blocks
+	static size_t const OUTPUT_SIZE = 64 * 1024;
 
-	// Is decompressor initialized
+	// Is decompressor initialized and has the end of stream been reached
 	bool initialized;
+	bool finished;
+
+	Dictionaries dicts;
 
 	// The ZLib Stream object.
-	z_streamp zstrm;
+	z_stream zstrm;
+
+	// Block that zlib is currently writing to
+	ByteV output;
+
+	// Full blocks of output that wait for reading. Reading
+	// of the first block may have been started already.
+	Blocks blocks;
+	size_t blocks_size;
+	size_t first_block_read;
+
+	// Moves decompressed data from current output to blocks
+	inline void flushOutput(void);
 
-	// C-arrays of input and output data.
-	Bytef* input;
-	Bytef* output;
+	// Makes output ready to receive more decompressed data
+	inline void resetOutput(void);
 
-	// Pending output buffer
-	ByteQ output_queue;
+	// Ends decompression because of error
+	inline void abort(void);
+
+	// Gives the dictionary that stream asks for to zlib
+	inline void setDictionary(void);
 
 };
 
 inline Decompressor::Decompressor(void) :
-initialized(false)
+initialized(false),
+finished(false),
+blocks_size(0),
+first_block_read(0)
 {
-	// Allocate space for data holders
-	input = new(std::nothrow) Bytef[INPUT_SIZE];
-	output = new(std::nothrow) Bytef[OUTPUT_SIZE];
-	if (!input || !output) {
-		delete input;
-		delete output;
-		throw std::bad_alloc();
-	}
-
-	zstrm = new z_stream;
 	// Tune allocation of zstream
-	zstrm->zalloc = Z_NULL;
-	zstrm->zfree = Z_NULL;
-	zstrm->next_in = input;
-	zstrm->avail_in = 0;
-	zstrm->next_out = output;
-	zstrm->avail_out = OUTPUT_SIZE;
+	zstrm.zalloc = Z_NULL;
+	zstrm.zfree = Z_NULL;
+	zstrm.opaque = Z_NULL;
 }
 
 inline Decompressor::~Decompressor(void)
 {
 	HppAssert(!initialized, "");
-	delete[] input;
-	delete[] output;
-	delete zstrm;
+	if (initialized) {
+		inflateEnd(&zstrm);
+	}
 }
 
 inline void Decompressor::init(void)
 {
 	HppAssert(!initialized, "Decompressor is already initialized!");
-	// Tune data containers of zstream
-	zstrm->next_in = input;
-	zstrm->avail_in = 0;
-	zstrm->next_out = output;
-	zstrm->avail_out = OUTPUT_SIZE;
 	// Initialize ZStream.
-	int err = inflateInit(zstrm);
+	zstrm.next_in = Z_NULL;
+	zstrm.avail_in = 0;
+	int err = inflateInit(&zstrm);
 	if (err == Z_MEM_ERROR) {
 		throw std::bad_alloc();
 	}
@@ -101,170 +142,203 @@ inline void Decompressor::init(void)
 		throw Exception("Invalid zlib version!");
 	}
 
+	// Remove possible output of earlier stream
+	blocks.clear();
+	blocks_size = 0;
+	first_block_read = 0;
+	resetOutput();
+
 	initialized = true;
+	finished = false;
+}
+
+inline void Decompressor::reset(void)
+{
+	if (!initialized) {
+		init();
+		return;
+	}
+	#ifndef NDEBUG
+	int err = inflateReset(&zstrm);
+	#else
+	inflateReset(&zstrm);
+	#endif
+	HppAssert(err == Z_OK, "");
+
+	blocks.clear();
+	blocks_size = 0;
+	first_block_read = 0;
+	resetOutput();
 
+	finished = false;
 }
 
 inline void Decompressor::decompress(ByteV const& data)
+{
+	if (!data.empty()) {
+		decompress(&data[0], data.size());
+	}
+}
+
+inline void Decompressor::decompress(uint8_t const* data, size_t data_size)
 {
 	HppAssert(initialized, "Decompressor is not initialized!");
-	size_t data_decompressed = 0;
-	while (data_decompressed < data.size()) {
-
-		// Put as much data as possible to input buffer
-		size_t input_used = zstrm->next_in - input + zstrm->avail_in;
-		size_t copy_size;
-		if (INPUT_SIZE - input_used <= (data.size() - data_decompressed)) {
-			copy_size = INPUT_SIZE - input_used;
-		} else {
-			copy_size = data.size() - data_decompressed;
+	if (finished) {
+		if (data_size) {
+			abort();
+			throw Exception("Data after the end of compressed stream!");
 		}
-		memcpy(zstrm->next_in + zstrm->avail_in,
-		       &data[data_decompressed],
-		       copy_size);
-		zstrm->avail_in += copy_size;
-		data_decompressed += copy_size;
-		HppAssert(data_decompressed <= data.size(), "");
-
-		// Compress only if the whole input buffer is full.
-		HppAssert(input_used + copy_size <= INPUT_SIZE, "");
-		if (input_used + copy_size == INPUT_SIZE) {
-			int err = inflate(zstrm, false);
-			HppAssert(err != Z_NEED_DICT, "");
-			if (err == Z_DATA_ERROR) {
-				initialized = false;
-				throw Exception("Corrupted data!");
-			}
-			HppAssert(err != Z_STREAM_ERROR, "");
-			if (err == Z_MEM_ERROR) {
-				throw std::bad_alloc();
-			}
-			HppAssert(err != Z_BUF_ERROR || zstrm->avail_out == 0, "");
-			if (zstrm->next_in == input + INPUT_SIZE) {
-				zstrm->next_in = input;
-				zstrm->avail_in = 0;
-			}
+		return;
+	}
+	zstrm.next_in = const_cast< Bytef* >(data);
+	zstrm.avail_in = data_size;
+	bool output_full;
+	do {
+		int err = inflate(&zstrm, Z_NO_FLUSH);
+		if (err == Z_NEED_DICT) {
+			setDictionary();
+			output_full = false;
+			continue;
 		}
-
-		// If output is full, then empty it to queue
-		if (zstrm->avail_out == 0) {
-			Bytef* output_end = output + OUTPUT_SIZE;
-			HppAssert(zstrm->next_out == output_end, "");
-			for (Bytef* output_it = output;
-			     output_it != output_end;
-			     output_it ++) {
-				output_queue.push(*output_it);
-			}
-			zstrm->next_out = output;
-			zstrm->avail_out = OUTPUT_SIZE;
+		if (err == Z_DATA_ERROR) {
+			abort();
+			throw Exception("Corrupted data!");
+		}
+		HppAssert(err != Z_STREAM_ERROR, "");
+		if (err == Z_MEM_ERROR) {
+			abort();
+			throw std::bad_alloc();
+		}
+		// Buffer error means that no progress was possible
+		if (err == Z_BUF_ERROR) {
+			HppAssert(zstrm.avail_in == 0, "");
+			break;
 		}
 
-	}
+		// If output is full, then move it to blocks. In this
+		// case zlib might still have more output pending.
+		output_full = (zstrm.avail_out == 0);
+		if (output_full) {
+			flushOutput();
+		}
 
+		if (err == Z_STREAM_END) {
+			finished = true;
+			if (zstrm.avail_in > 0) {
+				abort();
+				throw Exception("Data after the end of compressed stream!");
+			}
+			break;
+		}
+	} while (zstrm.avail_in > 0 || output_full);
 }
 
 inline ByteV Decompressor::read(size_t max_size)
 {
 	HppAssert(initialized, "Decompressor is not initialized!");
+	flushOutput();
+
+	// If everything is wanted and it is in one
+	// block, then it can be given without copying.
 	ByteV result;
-	if (max_size) {
-		result.reserve(max_size);
-	} else {
-		result.reserve(output_queue.size() + OUTPUT_SIZE);
+	if (!max_size && blocks.size() == 1 && first_block_read == 0) {
+		result.swap(blocks.front());
+		blocks.clear();
+		blocks_size = 0;
+		return result;
 	}
 
-	do {
-
-		// First move everything from queue
-		size_t from_queue;
-		if (!max_size ||
-		    output_queue.size() < max_size) {
-			from_queue = output_queue.size();
-		} else {
-			HppAssert(max_size, "");
-			from_queue = max_size;
-		}
-		for (size_t getter = 0; getter < from_queue; getter ++) {
-			HppAssert(!output_queue.empty(), "");
-			result.push_back(output_queue.front());
-			output_queue.pop();
-		}
-
-		// Stop now if we have read enough
-		HppAssert(!max_size || result.size() <= max_size, "");
-		if (max_size && result.size() == max_size) {
-			break;
-		}
+	size_t result_size = blocks_size;
+	if (max_size && max_size < result_size) {
+		result_size = max_size;
+	}
+	result.resize(result_size);
+	if (result_size) {
+		read(&result[0], result_size);
+	}
+	return result;
+}
 
-		// Read output from zstream.
-		size_t zstrm_size = zstrm->next_out - output;
-		if (!max_size ||
-		    zstrm_size <= max_size - result.size()) {
-			result.insert(result.end(), output, zstrm->next_out);
-			zstrm->next_out = output;
-			zstrm->avail_out = OUTPUT_SIZE;
-			// All data is now used, so we can stop
-			break;
-		} else {
-			HppAssert(max_size, "");
-			size_t copy_size = max_size - result.size();
-			HppAssert(copy_size <= zstrm_size, "");
-			result.insert(result.end(), output, output + copy_size);
-			memmove(output, output + copy_size, zstrm_size - copy_size);
-			zstrm->next_out -= copy_size;
-			zstrm->avail_out += copy_size;
+inline size_t Decompressor::read(uint8_t* buf, size_t buf_size)
+{
+	HppAssert(initialized, "Decompressor is not initialized!");
+	flushOutput();
+
+	size_t result = 0;
+	while (result < buf_size && !blocks.empty()) {
+		ByteV const& block = blocks.front();
+		size_t copy_size = std::min(buf_size - result, block.size() - first_block_read);
+		memcpy(buf + result, &block[first_block_read], copy_size);
+		result += copy_size;
+		first_block_read += copy_size;
+		blocks_size -= copy_size;
+		if (first_block_read == block.size()) {
+			blocks.pop_front();
+			first_block_read = 0;
 		}
+	}
+	return result;
+}
 
-	} while (!max_size ||
-	         result.size() < max_size);
+inline bool Decompressor::readChunk(ByteV& chunk)
+{
+	HppAssert(initialized, "Decompressor is not initialized!");
+	flushOutput();
 
-	return result;
+	if (blocks.empty()) {
+		return false;
+	}
+	chunk.swap(blocks.front());
+	blocks.pop_front();
+	blocks_size -= chunk.size() - first_block_read;
+	if (first_block_read) {
+		chunk.erase(chunk.begin(), chunk.begin() + first_block_read);
+		first_block_read = 0;
+	}
+	return true;
+}
 
+inline size_t Decompressor::getAmountOfOutput(void)
+{
+	HppAssert(initialized, "Decompressor is not initialized!");
+	return blocks_size + OUTPUT_SIZE - zstrm.avail_out;
 }
 
 inline ByteV Decompressor::deinit(void)
 {
 	HppAssert(initialized, "Decompressor is not initialized!");
-	ByteV result;
-	result.reserve(output_queue.size() + OUTPUT_SIZE);
-	// First move everything from queue
-	while (!output_queue.empty()) {
-		result.push_back(output_queue.front());
-		output_queue.pop();
-	}
-	while (true) {
 
-		int err = inflate(zstrm, false);
-		HppAssert(err != Z_NEED_DICT, "");
+	// Get rest of output that zlib may still hold
+	while (!finished) {
+		zstrm.next_in = Z_NULL;
+		zstrm.avail_in = 0;
+		int err = inflate(&zstrm, Z_SYNC_FLUSH);
+		if (err == Z_NEED_DICT) {
+			setDictionary();
+			continue;
+		}
 		if (err == Z_DATA_ERROR) {
-			initialized = false;
+			abort();
 			throw Exception("Corrupted data!");
 		}
-		HppAssert(err != Z_STREAM_ERROR, "");
 		if (err == Z_MEM_ERROR) {
-			initialized = false;
+			abort();
 			throw std::bad_alloc();
 		}
-		if (err == Z_BUF_ERROR && zstrm->avail_out != 0) {
-			initialized = false;
-			throw Exception("Empty source data!");
-		}
-
-		// Move all data from output to result
-		result.insert(result.end(), output, zstrm->next_out);
-		zstrm->next_out = output;
-		zstrm->avail_out = OUTPUT_SIZE;
-
-		// Check if all data was succesfully compressed
 		if (err == Z_STREAM_END) {
-			HppAssert(zstrm->avail_in == 0, "");
-			break;
+			finished = true;
+		} else if (zstrm.avail_out != 0) {
+			abort();
+			throw Exception("Empty source data!");
 		}
+		flushOutput();
 	}
+
+	ByteV result = read();
 	#ifndef NDEBUG
-	int err = inflateEnd(zstrm);
+	int err = inflateEnd(&zstrm);
 	#else
-	inflateEnd(zstrm);
+	inflateEnd(&zstrm);
 	#endif
 	HppAssert(err != Z_STREAM_ERROR, "");
 	HppAssert(err != Z_DATA_ERROR, "");
@@ -274,6 +348,70 @@ inline ByteV Decompressor::deinit(void)
 	return result;
 }
 
+inline size_t Decompressor::decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size)
+{
+	uLongf decompressed_size = result_size;
+	int err = uncompress(result, &decompressed_size, data, data_size);
+	if (err == Z_MEM_ERROR) {
+		throw std::bad_alloc();
+	}
+	if (err == Z_BUF_ERROR && decompressed_size == result_size) {
+		throw Exception("Not enough room for decompressed data!");
+	}
+	if (err != Z_OK) {
+		throw Exception("Corrupted data!");
+	}
+	return decompressed_size;
+}
+
+inline void Decompressor::flushOutput(void)
+{
+	size_t output_size = OUTPUT_SIZE - zstrm.avail_out;
+	if (!output_size) {
+		return;
+	}
+	// Full blocks are given to list without copying. Partial
+	// ones are copied, so output buffer can be kept.
+	if (output_size == OUTPUT_SIZE) {
+		blocks.push_back(ByteV());
+		blocks.back().swap(output);
+	} else {
+		blocks.push_back(ByteV(output.begin(), output.begin() + output_size));
+	}
+	blocks_size += output_size;
+	resetOutput();
+}
+
+inline void Decompressor::resetOutput(void)
+{
+	if (output.size() != OUTPUT_SIZE) {
+		output.resize(OUTPUT_SIZE);
+	}
+	zstrm.next_out = &output[0];
+	zstrm.avail_out = OUTPUT_SIZE;
+}
+
+inline void Decompressor::abort(void)
+{
+	inflateEnd(&zstrm);
+	initialized = false;
+}
+
+inline void Decompressor::setDictionary(void)
+{
+	// When dictionary is needed, zlib gives its ID in adler field
+	Dictionaries::const_iterator dicts_find = dicts.find(zstrm.adler);
+	if (dicts_find == dicts.end() || dicts_find->second->getData().empty()) {
+		abort();
+		throw Exception("Compressed data needs an unknown dictionary!");
+	}
+	ByteV const& dict_data = dicts_find->second->getData();
+	if (inflateSetDictionary(&zstrm, &dict_data[0], dict_data.size()) != Z_OK) {
+		abort();
+		throw Exception("Unable to set compression dictionary!");
+	}
+}
+
 }
 
 #endif
@@ -0,0 +1,144 @@
+#ifndef HPP_DEFLATESTAGE_H
+#define HPP_DEFLATESTAGE_H
+
+#include "transportstage.h"
+#include "compressiondictionary.h"
+#include "exception.h"
+#include "assert.h"
+
+#include <zlib.h>
+#include <new>
+
+namespace Hpp
+{
+
+// Zlib compression stage. Compression state is kept over message
+// boundaries and every message is flushed, so small messages can refer
+// to data of earlier ones. Output is written directly to result buffer.
+// A preset dictionary helps the first messages. Both ends must use the
+// same one, and it must be kept alive as long as the stage is used.
+class DeflateStage : public TransportStage
+{
+
+public:
+
+	inline DeflateStage(int level = Z_DEFAULT_COMPRESSION, CompressionDictionary const* dict = NULL);
+	inline virtual ~DeflateStage(void);
+
+private:
+
+	CompressionDictionary const* dict;
+
+	z_stream defstrm;
+	z_stream infstrm;
+
+	inline virtual void encode(ByteV& result, uint8_t const* data, size_t data_size);
+	inline virtual void decode(ByteV& result, uint8_t const* data, size_t data_size);
+
+};
+
+inline DeflateStage::DeflateStage(int level, CompressionDictionary const* dict) :
+dict(dict)
+{
+	defstrm.zalloc = Z_NULL;
+	defstrm.zfree = Z_NULL;
+	defstrm.opaque = Z_NULL;
+	int err = deflateInit(&defstrm, level);
+	if (err == Z_MEM_ERROR) {
+		throw std::bad_alloc();
+	}
+	if (err != Z_OK) {
+		throw Exception("Unable to initialize compression!");
+	}
+	if (dict && !dict->getData().empty()) {
+		ByteV const& dict_data = dict->getData();
+		if (deflateSetDictionary(&defstrm, &dict_data[0], dict_data.size()) != Z_OK) {
+			deflateEnd(&defstrm);
+			throw Exception("Unable to set compression dictionary!");
+		}
+	}
+
+	infstrm.zalloc = Z_NULL;
+	infstrm.zfree = Z_NULL;
+	infstrm.opaque = Z_NULL;
+	infstrm.next_in = Z_NULL;
+	infstrm.avail_in = 0;
+	err = inflateInit(&infstrm);
+	if (err != Z_OK) {
+		deflateEnd(&defstrm);
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		throw Exception("Unable to initialize decompression!");
+	}
+}
+
+inline DeflateStage::~DeflateStage(void)
+{
+	deflateEnd(&defstrm);
+	inflateEnd(&infstrm);
+}
+
+inline void DeflateStage::encode(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	defstrm.next_in = const_cast< Bytef* >(data);
+	defstrm.avail_in = data_size;
+
+	// Reserve enough space so that usually one round is enough
+	size_t result_begin = result.size();
+	size_t result_size = result_begin;
+	size_t reserve = deflateBound(&defstrm, data_size) + 16;
+	do {
+		result.resize(result_size + reserve);
+		defstrm.next_out = &result[result_size];
+		defstrm.avail_out = reserve;
+		int err = deflate(&defstrm, Z_SYNC_FLUSH);
+		HppAssert(err != Z_STREAM_ERROR, "Compression stream is broken!");
+		(void)err;
+		result_size = result.size() - defstrm.avail_out;
+		reserve = 1024;
+	} while (defstrm.avail_out == 0);
+	HppAssert(defstrm.avail_in == 0, "All input should be used!");
+	result.resize(result_size);
+}
+
+inline void DeflateStage::decode(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	infstrm.next_in = const_cast< Bytef* >(data);
+	infstrm.avail_in = data_size;
+
+	size_t result_size = result.size();
+	size_t reserve = data_size * 4 + 64;
+	do {
+		result.resize(result_size + reserve);
+		infstrm.next_out = &result[result_size];
+		infstrm.avail_out = reserve;
+		int err = inflate(&infstrm, Z_SYNC_FLUSH);
+		result_size = result.size() - infstrm.avail_out;
+		if (err == Z_NEED_DICT && dict && !dict->getData().empty() && infstrm.adler == dict->getId()) {
+			ByteV const& dict_data = dict->getData();
+			err = inflateSetDictionary(&infstrm, &dict_data[0], dict_data.size());
+			HppAssert(err == Z_OK, "Unable to set decompression dictionary!");
+			continue;
+		}
+		if (err == Z_NEED_DICT || err == Z_DATA_ERROR) {
+			result.resize(result_size);
+			throw Exception("Corrupted data!");
+		}
+		if (err == Z_MEM_ERROR) {
+			result.resize(result_size);
+			throw std::bad_alloc();
+		}
+		// Buffer error only means that no progress was
+		// possible, because there is no more input.
+		if (err == Z_BUF_ERROR || err == Z_STREAM_END) {
+			break;
+		}
+		reserve *= 2;
+	} while (infstrm.avail_out == 0 || infstrm.avail_in > 0);
+	result.resize(result_size);
+}
+
+}
+
+#endif
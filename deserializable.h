@@ -2,10 +2,12 @@
 #define HPP_DESERIALIZABLE_H
 
 #include "json.h"
-#include "bytevreaderbuf.h"
+#include "binaryreader.h"
 #include "bytev.h"
 #include "exception.h"
 
+#include <istream>
+
 namespace Hpp
 {
 
@@ -19,34 +21,49 @@ public:
 	inline void deserialize(ByteV::const_iterator& bytes_it, ByteV::const_iterator const& bytes_end, bool bigendian = true);
 	inline void deserialize(std::istream& strm, bool bigendian = true);
 
+	// Deserialize from the position of reader. This
+	// is useful when many objects are deserialized.
+	inline void deserialize(BinaryReader& reader);
+
 	// Deserialize from JSON
 	virtual void constructFromJson(Json const& json) = 0;
 
 private:
 
-	virtual void doDeserialize(std::istream& strm, bool bigendian) = 0;
+	virtual void doDeserialize(BinaryReader& reader) = 0;
 
 };
 
 inline void Deserializable::deserialize(ByteV const& bytes, bool bigendian)
 {
-	ByteV::const_iterator bytes_it = bytes.begin();
-	ByteVReaderBuf rbuf(bytes_it, bytes.end());
-	doDeserialize(rbuf, bigendian);
-	if (bytes_it != bytes.end()) {
+	BinaryReader reader(bytes, bigendian);
+	doDeserialize(reader);
+	if (!reader.atEnd()) {
 		throw Exception("Deserializable did not use all bytes!");
 	}
 }
 
 inline void Deserializable::deserialize(ByteV::const_iterator& bytes_it, ByteV::const_iterator const& bytes_end, bool bigendian)
 {
-	ByteVReaderBuf rbuf(bytes_it, bytes_end);
-	doDeserialize(rbuf, bigendian);
+	if (bytes_it == bytes_end) {
+		BinaryReader reader(NULL, 0, bigendian);
+		doDeserialize(reader);
+		return;
+	}
+	BinaryReader reader(&*bytes_it, bytes_end - bytes_it, bigendian);
+	doDeserialize(reader);
+	bytes_it += reader.getPosition();
 }
 
 inline void Deserializable::deserialize(std::istream& strm, bool bigendian)
 {
-	doDeserialize(strm, bigendian);
+	BinaryReader reader(strm, bigendian);
+	doDeserialize(reader);
+}
+
+inline void Deserializable::deserialize(BinaryReader& reader)
+{
+	doDeserialize(reader);
 }
 
 }
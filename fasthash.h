@@ -0,0 +1,359 @@
+#ifndef HPP_FASTHASH_H
+#define HPP_FASTHASH_H
+
+#include "bytev.h"
+#include "unicodestring.h"
+#include "path.h"
+#include "vector3.h"
+#include "ivector2.h"
+
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Fast non-cryptographic hash. This is XXH64, so results are compatible
+// with other implementations of it. It is meant for hash tables, cache
+// keys and detecting duplicates, but not for anything that has to
+// resist an attacker. Use Sha256Hasher for that.
+//
+// Data is processed in four independent lanes, so the processor can
+// work on them in parallel. Hash can be calculated at once with hash(),
+// or data can be given in parts with addData().
+class FastHasher
+{
+
+public:
+
+	inline FastHasher(uint64_t seed = 0) { reset(seed); }
+
+	inline void reset(uint64_t seed = 0);
+
+	inline void addData(uint8_t const* data, size_t data_size);
+	inline void addData(ByteV const& data) { addData(data.empty() ? NULL : &data[0], data.size()); }
+	inline void addData(std::string const& data) { addData(reinterpret_cast< uint8_t const* >(data.data()), data.size()); }
+
+	// Returns hash of data given so far. Unlike with Hasher, hashing
+	// is not reset, so more data can be added after this.
+	inline uint64_t getHash(void) const;
+
+	// Calculates hash of data at once. This is faster than addData()
+	// and getHash(), because nothing needs to be buffered.
+	inline static uint64_t hash(uint8_t const* data, size_t data_size, uint64_t seed = 0);
+
+private:
+
+	static uint64_t const PRIME1 = (uint64_t(0x9E3779B1U) << 32) | 0x85EBCA87U;
+	static uint64_t const PRIME2 = (uint64_t(0xC2B2AE3DU) << 32) | 0x27D4EB4FU;
+	static uint64_t const PRIME3 = (uint64_t(0x165667B1U) << 32) | 0x9E3779F9U;
+	static uint64_t const PRIME4 = (uint64_t(0x85EBCA77U) << 32) | 0xC2B2AE63U;
+	static uint64_t const PRIME5 = (uint64_t(0x27D4EB2FU) << 32) | 0x165667C5U;
+
+	// Size of data that all four lanes consume at once
+	static size_t const STRIPE_SIZE = 32;
+
+	uint64_t seed;
+	uint64_t lanes[4];
+	uint64_t total_size;
+	uint8_t buf[STRIPE_SIZE];
+	size_t buf_size;
+
+	inline static uint64_t rotl(uint64_t value, unsigned int bits) { return (value << bits) | (value >> (64 - bits)); }
+	inline static uint64_t read64(uint8_t const* ptr);
+	inline static uint32_t read32(uint8_t const* ptr);
+
+	inline static uint64_t round(uint64_t lane, uint64_t input);
+	inline static uint64_t mergeRound(uint64_t result, uint64_t lane);
+
+	inline static void initLanes(uint64_t* lanes, uint64_t seed);
+
+	// Consumes full stripes and returns pointer to the rest
+	inline static uint8_t const* consumeStripes(uint64_t* lanes, uint8_t const* data, size_t data_size);
+
+	// Calculates final hash from lanes and the last partial stripe
+	inline static uint64_t finalize(uint64_t const* lanes, uint64_t seed, uint64_t total_size, uint8_t const* rest, size_t rest_size);
+
+};
+
+// 128 bit hash, for example for content addressed caches, where
+// collisions of 64 bit hash would be too probable. This is made of
+// two 64 bit hashes with different seeds, so it is half as fast.
+struct FastHash128
+{
+	uint64_t low;
+	uint64_t high;
+
+	inline bool operator==(FastHash128 const& h) const { return low == h.low && high == h.high; }
+	inline bool operator!=(FastHash128 const& h) const { return low != h.low || high != h.high; }
+	inline bool operator<(FastHash128 const& h) const { return high < h.high || (high == h.high && low < h.low); }
+};
+
+inline FastHash128 fastHash128(uint8_t const* data, size_t data_size, uint64_t seed = 0);
+inline FastHash128 fastHash128(ByteV const& data, uint64_t seed = 0);
+
+// Hashes of common types. Hashes of Vector3 and IVector2
+// depend on their values only, so they are portable.
+inline uint64_t fastHash(uint8_t const* data, size_t data_size, uint64_t seed = 0) { return FastHasher::hash(data, data_size, seed); }
+inline uint64_t fastHash(ByteV const& data, uint64_t seed = 0);
+inline uint64_t fastHash(std::string const& str, uint64_t seed = 0);
+inline uint64_t fastHash(UnicodeString const& ustr, uint64_t seed = 0);
+inline uint64_t fastHash(Path const& path, uint64_t seed = 0);
+inline uint64_t fastHash(Vector3 const& v, uint64_t seed = 0);
+inline uint64_t fastHash(IVector2 const& v, uint64_t seed = 0);
+
+// Function object for hash tables
+template< class Type > struct FastHash
+{
+	inline size_t operator()(Type const& value) const { return fastHash(value); }
+};
+
+inline void FastHasher::reset(uint64_t seed)
+{
+	this->seed = seed;
+	initLanes(lanes, seed);
+	total_size = 0;
+	buf_size = 0;
+}
+
+inline void FastHasher::addData(uint8_t const* data, size_t data_size)
+{
+	if (data_size == 0) {
+		return;
+	}
+	total_size += data_size;
+
+	// Fill the partial stripe first
+	if (buf_size > 0) {
+		size_t fill = std::min(STRIPE_SIZE - buf_size, data_size);
+		memcpy(buf + buf_size, data, fill);
+		buf_size += fill;
+		data += fill;
+		data_size -= fill;
+		if (buf_size < STRIPE_SIZE) {
+			return;
+		}
+		consumeStripes(lanes, buf, STRIPE_SIZE);
+		buf_size = 0;
+	}
+
+	uint8_t const* rest = consumeStripes(lanes, data, data_size);
+	buf_size = data + data_size - rest;
+	if (buf_size > 0) {
+		memcpy(buf, rest, buf_size);
+	}
+}
+
+inline uint64_t FastHasher::getHash(void) const
+{
+	return finalize(lanes, seed, total_size, buf, buf_size);
+}
+
+inline uint64_t FastHasher::hash(uint8_t const* data, size_t data_size, uint64_t seed)
+{
+	uint64_t lanes[4];
+	initLanes(lanes, seed);
+	uint8_t const* rest = consumeStripes(lanes, data, data_size);
+	return finalize(lanes, seed, data_size, rest, data + data_size - rest);
+}
+
+inline uint64_t FastHasher::read64(uint8_t const* ptr)
+{
+	uint64_t result;
+	memcpy(&result, ptr, 8);
+	#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	result = __builtin_bswap64(result);
+	#endif
+	return result;
+}
+
+inline uint32_t FastHasher::read32(uint8_t const* ptr)
+{
+	uint32_t result;
+	memcpy(&result, ptr, 4);
+	#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	result = __builtin_bswap32(result);
+	#endif
+	return result;
+}
+
+inline uint64_t FastHasher::round(uint64_t lane, uint64_t input)
+{
+	lane += input * PRIME2;
+	lane = rotl(lane, 31);
+	return lane * PRIME1;
+}
+
+inline uint64_t FastHasher::mergeRound(uint64_t result, uint64_t lane)
+{
+	result ^= round(0, lane);
+	return result * PRIME1 + PRIME4;
+}
+
+inline void FastHasher::initLanes(uint64_t* lanes, uint64_t seed)
+{
+	lanes[0] = seed + PRIME1 + PRIME2;
+	lanes[1] = seed + PRIME2;
+	lanes[2] = seed;
+	lanes[3] = seed - PRIME1;
+}
+
+inline uint8_t const* FastHasher::consumeStripes(uint64_t* lanes, uint8_t const* data, size_t data_size)
+{
+	uint8_t const* data_end = data + data_size;
+	if (data_size >= STRIPE_SIZE) {
+		// Local variables let compiler keep lanes in registers
+		uint64_t lane0 = lanes[0];
+		uint64_t lane1 = lanes[1];
+		uint64_t lane2 = lanes[2];
+		uint64_t lane3 = lanes[3];
+		uint8_t const* stripes_end = data_end - STRIPE_SIZE;
+		do {
+			lane0 = round(lane0, read64(data));
+			lane1 = round(lane1, read64(data + 8));
+			lane2 = round(lane2, read64(data + 16));
+			lane3 = round(lane3, read64(data + 24));
+			data += STRIPE_SIZE;
+		} while (data <= stripes_end);
+		lanes[0] = lane0;
+		lanes[1] = lane1;
+		lanes[2] = lane2;
+		lanes[3] = lane3;
+	}
+	return data;
+}
+
+inline uint64_t FastHasher::finalize(uint64_t const* lanes, uint64_t seed, uint64_t total_size, uint8_t const* rest, size_t rest_size)
+{
+	uint64_t result;
+	if (total_size >= STRIPE_SIZE) {
+		result = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+		result = mergeRound(result, lanes[0]);
+		result = mergeRound(result, lanes[1]);
+		result = mergeRound(result, lanes[2]);
+		result = mergeRound(result, lanes[3]);
+	} else {
+		result = seed + PRIME5;
+	}
+	result += total_size;
+
+	while (rest_size >= 8) {
+		result ^= round(0, read64(rest));
+		result = rotl(result, 27) * PRIME1 + PRIME4;
+		rest += 8;
+		rest_size -= 8;
+	}
+	if (rest_size >= 4) {
+		result ^= uint64_t(read32(rest)) * PRIME1;
+		result = rotl(result, 23) * PRIME2 + PRIME3;
+		rest += 4;
+		rest_size -= 4;
+	}
+	while (rest_size > 0) {
+		result ^= *rest * PRIME5;
+		result = rotl(result, 11) * PRIME1;
+		++ rest;
+		-- rest_size;
+	}
+
+	// Mix all bits
+	result ^= result >> 33;
+	result *= PRIME2;
+	result ^= result >> 29;
+	result *= PRIME3;
+	result ^= result >> 32;
+	return result;
+}
+
+inline FastHash128 fastHash128(uint8_t const* data, size_t data_size, uint64_t seed)
+{
+	FastHash128 result;
+	result.low = FastHasher::hash(data, data_size, seed);
+	result.high = FastHasher::hash(data, data_size, ~seed);
+	return result;
+}
+
+inline FastHash128 fastHash128(ByteV const& data, uint64_t seed)
+{
+	return fastHash128(data.empty() ? NULL : &data[0], data.size(), seed);
+}
+
+inline uint64_t fastHash(ByteV const& data, uint64_t seed)
+{
+	return FastHasher::hash(data.empty() ? NULL : &data[0], data.size(), seed);
+}
+
+inline uint64_t fastHash(std::string const& str, uint64_t seed)
+{
+	return FastHasher::hash(reinterpret_cast< uint8_t const* >(str.data()), str.size(), seed);
+}
+
+inline uint64_t fastHash(UnicodeString const& ustr, uint64_t seed)
+{
+	// Characters are hashed as little endian 32 bit integers.
+	// They are collected to a small buffer to avoid calling
+	// addData() for every character.
+	FastHasher hasher(seed);
+	uint8_t buf[256];
+	size_t buf_size = 0;
+	for (UnicodeString::const_iterator ustr_it = ustr.begin();
+	     ustr_it != ustr.end();
+	     ++ ustr_it) {
+		UChr c = *ustr_it;
+		buf[buf_size ++] = c;
+		buf[buf_size ++] = c >> 8;
+		buf[buf_size ++] = c >> 16;
+		buf[buf_size ++] = c >> 24;
+		if (buf_size == sizeof(buf)) {
+			hasher.addData(buf, buf_size);
+			buf_size = 0;
+		}
+	}
+	hasher.addData(buf, buf_size);
+	return hasher.getHash();
+}
+
+inline uint64_t fastHash(Path const& path, uint64_t seed)
+{
+	return fastHash(path.toString(), seed);
+}
+
+inline uint64_t fastHash(Vector3 const& v, uint64_t seed)
+{
+	// Components are hashed as doubles, so that the result does not
+	// depend on the type of Real. Negative zero equals to zero, so
+	// it must have the same hash too.
+	double components[3] = { v.x, v.y, v.z };
+	uint8_t buf[24];
+	for (size_t component = 0; component < 3; ++ component) {
+		if (components[component] == 0) {
+			components[component] = 0;
+		}
+		uint64_t bits;
+		memcpy(&bits, &components[component], 8);
+		for (size_t byte = 0; byte < 8; ++ byte) {
+			buf[component * 8 + byte] = bits >> (byte * 8);
+		}
+	}
+	return FastHasher::hash(buf, sizeof(buf), seed);
+}
+
+inline uint64_t fastHash(IVector2 const& v, uint64_t seed)
+{
+	// Components are hashed as 64 bit little endian
+	// integers, whatever the size of ssize_t is.
+	uint8_t buf[16];
+	uint64_t x = int64_t(v.x);
+	uint64_t y = int64_t(v.y);
+	for (size_t byte = 0; byte < 8; ++ byte) {
+		buf[byte] = x >> (byte * 8);
+		buf[8 + byte] = y >> (byte * 8);
+	}
+	return FastHasher::hash(buf, sizeof(buf), seed);
+}
+
+}
+
+#endif
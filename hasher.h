@@ -2,6 +2,7 @@
 #define HPP_HASHER_H
 
 #include "bytev.h"
+#include "byteview.h"
 
 #include <string>
 
@@ -28,15 +29,25 @@ public:
 	inline void addData(int8_t const* data, size_t data_size);
 	inline void addData(uint8_t const* data, size_t data_size);
 	inline void addData(std::string const& data);
+	inline void addData(ConstByteView data);
 
 	// Gets hash. This also resets hashing. "result" is cleared.
 	inline void getHash(ByteV& result);
 	inline ByteV getHash(void);
 
+	// Writes hash to buffer of getSize() bytes. This also resets hashing.
+	inline void getHash(uint8_t* result);
+
+	// Hashes one whole message and writes its hash to buffer of
+	// getSize() bytes. Data given before is discarded.
+	inline void hashMessage(uint8_t* result, uint8_t const* data, size_t data_size);
+
 private:
 
 	virtual void doAddData(uint8_t const* data, size_t data_size) = 0;
 	virtual void doGetHash(uint8_t* result) = 0;
+	// Subclasses may hash whole messages faster than by streaming them
+	inline virtual void doHashMessage(uint8_t* result, uint8_t const* data, size_t data_size);
 
 };
 
@@ -46,7 +57,9 @@ inline Hasher::~Hasher(void)
 
 inline void Hasher::addData(ByteV const& data)
 {
-	doAddData(&data[0], data.size());
+	if (!data.empty()) {
+		doAddData(&data[0], data.size());
+	}
 }
 
 inline void Hasher::addData(int8_t const* data, size_t data_size)
@@ -64,6 +77,11 @@ inline void Hasher::addData(std::string const& data)
 	 doAddData((uint8_t const*)&data[0], data.size());
 }
 
+inline void Hasher::addData(ConstByteView data)
+{
+	doAddData(data.data(), data.size());
+}
+
 inline void Hasher::getHash(ByteV& result)
 {
 	result.resize(getSize());
@@ -78,6 +96,25 @@ inline ByteV Hasher::getHash(void)
 	return result;
 }
 
+inline void Hasher::getHash(uint8_t* result)
+{
+	doGetHash(result);
+	reset();
+}
+
+inline void Hasher::hashMessage(uint8_t* result, uint8_t const* data, size_t data_size)
+{
+	reset();
+	doHashMessage(result, data, data_size);
+}
+
+inline void Hasher::doHashMessage(uint8_t* result, uint8_t const* data, size_t data_size)
+{
+	doAddData(data, data_size);
+	doGetHash(result);
+	reset();
+}
+
 }
 
 #endif
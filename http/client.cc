@@ -0,0 +1,299 @@
+#include "client.h"
+
+#include "../exception.h"
+#include "../assert.h"
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+Client::Transfer::~Transfer(void)
+{
+	if (!finished && client) {
+		client->cancelTransfer(this);
+	}
+}
+
+Client::Transfer::Transfer(Client* client, std::string const& url) :
+client(client),
+curl(NULL),
+url(url),
+callback(NULL),
+callback_data(NULL),
+finished(false),
+response_http_code(0),
+sink(NULL)
+{
+	curl_error[0] = 0;
+}
+
+void Client::Transfer::ensureSucceeded(void) const
+{
+	if (!finished) {
+		throw Exception("Transfer from " + url + " has not finished yet!");
+	}
+	if (!error.empty()) {
+		throw Exception("Unable to connect to " + url + "! Reason: " + error);
+	}
+}
+
+size_t Client::Transfer::responseReader(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+	size_t totalsize = size * nmemb;
+	Transfer* t = reinterpret_cast< Transfer* >(userdata);
+
+	if (t->sink) {
+		// Exceptions must not pass through curl, so store
+		// error and make curl abort the transfer.
+		try {
+			t->sink->receive((uint8_t const*)ptr, totalsize, Request::getContentLength(t->curl));
+		}
+		catch (std::exception const& e) {
+			t->sink_error = e.what();
+			return 0;
+		}
+		return totalsize;
+	}
+
+	t->response_data.insert(t->response_data.end(), ptr, ptr + totalsize);
+
+	return totalsize;
+}
+
+Client::Client(void) :
+multi(curl_multi_init()),
+share(curl_share_init())
+{
+	if (!multi || !share) {
+		curl_multi_cleanup(multi);
+		curl_share_cleanup(share);
+		throw Exception("Unable to initialize HTTP client!");
+	}
+
+	// Share DNS cache, TLS sessions and connections
+	// between all transfers of this client.
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	#if LIBCURL_VERSION_NUM >= 0x073900
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	#endif
+}
+
+Client::~Client(void)
+{
+	// Abort running transfers. Those that are owned by
+	// the caller are only marked as failed, because
+	// caller is responsible of destroying them.
+	while (!transfers.empty()) {
+		Transfer* transfer = transfers.begin()->second;
+		releaseCurl(transfer);
+		transfer->finished = true;
+		transfer->error = "HTTP client was destroyed!";
+		transfer->client = NULL;
+		if (transfer->callback) {
+			delete transfer;
+		}
+	}
+
+	for (Curls::iterator idle_curls_it = idle_curls.begin();
+	     idle_curls_it != idle_curls.end();
+	     ++ idle_curls_it) {
+		curl_easy_cleanup(*idle_curls_it);
+	}
+
+	curl_multi_cleanup(multi);
+	curl_share_cleanup(share);
+}
+
+void Client::setMaxConnectionsPerHost(size_t max_conns)
+{
+	curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, long(max_conns));
+}
+
+Client::Transfer* Client::get(std::string const& url, Flags flags, Sink* sink)
+{
+	return startTransfer(url, flags, sink, NULL, NULL);
+}
+
+void Client::get(std::string const& url, Callback callback, void* data, Flags flags, Sink* sink)
+{
+	HppAssert(callback, "No callback given!");
+	startTransfer(url, flags, sink, callback, data);
+}
+
+size_t Client::perform(Delay const& max_wait)
+{
+	int running;
+	CURLMcode perform_result = curl_multi_perform(multi, &running);
+	if (perform_result != CURLM_OK) {
+		throw Exception(std::string("Unable to perform HTTP transfers! Reason: ") + curl_multi_strerror(perform_result));
+	}
+	handleFinishedTransfers();
+
+	if (transfers.empty() || (!max_wait.isInfinite() && max_wait <= Delay::secs(0))) {
+		return transfers.size();
+	}
+
+	// Wait for activity in sockets and then do some more work
+	int max_wait_ms;
+	if (max_wait.isInfinite() || max_wait.getSeconds() > 60) {
+		max_wait_ms = 60 * 1000;
+	} else {
+		max_wait_ms = max_wait.getSeconds() * 1000 + max_wait.getNanoseconds() / (1000 * 1000);
+	}
+	CURLMcode wait_result = curl_multi_wait(multi, NULL, 0, max_wait_ms, NULL);
+	if (wait_result != CURLM_OK) {
+		throw Exception(std::string("Unable to wait for HTTP transfers! Reason: ") + curl_multi_strerror(wait_result));
+	}
+
+	perform_result = curl_multi_perform(multi, &running);
+	if (perform_result != CURLM_OK) {
+		throw Exception(std::string("Unable to perform HTTP transfers! Reason: ") + curl_multi_strerror(perform_result));
+	}
+	handleFinishedTransfers();
+
+	return transfers.size();
+}
+
+void Client::run(void)
+{
+	while (perform(Delay::secs(1)) > 0) {
+	}
+}
+
+void Client::wait(Transfer const* transfer)
+{
+	HppAssert(transfer->client == this || transfer->finished, "Transfer belongs to another client!");
+	while (!transfer->finished) {
+		perform(Delay::secs(1));
+	}
+}
+
+Client::Transfer* Client::startTransfer(std::string const& url, Flags flags, Sink* sink, Callback callback, void* data)
+{
+	Transfer* transfer = new Transfer(this, url);
+	transfer->callback = callback;
+	transfer->callback_data = data;
+	transfer->sink = sink;
+	if (sink) {
+		sink->reset();
+	}
+
+	// Get easy handle. Recycle old one if possible.
+	CURL* curl;
+	if (!idle_curls.empty()) {
+		curl = idle_curls.back();
+		idle_curls.pop_back();
+	} else {
+		curl = curl_easy_init();
+		if (!curl) {
+			delete transfer;
+			throw Exception("Unable to create new HTTP transfer!");
+		}
+		curl_easy_setopt(curl, CURLOPT_SHARE, share);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Transfer::responseReader);
+	}
+	transfer->curl = curl;
+
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, transfer->curl_error);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+	curl_easy_setopt(curl, CURLOPT_URL, transfer->url.c_str());
+
+	// Redirects
+	if (flags & Request::DISABLE_REDIRECTS) curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+	else curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+	CURLMcode add_result = curl_multi_add_handle(multi, curl);
+	if (add_result != CURLM_OK) {
+		transfer->curl = NULL;
+		idle_curls.push_back(curl);
+		transfer->client = NULL;
+		delete transfer;
+		throw Exception(std::string("Unable to start HTTP transfer! Reason: ") + curl_multi_strerror(add_result));
+	}
+	transfers[curl] = transfer;
+
+	return transfer;
+}
+
+void Client::cancelTransfer(Transfer* transfer)
+{
+	HppAssert(!transfer->finished, "Transfer has already finished!");
+	releaseCurl(transfer);
+	transfer->finished = true;
+	transfer->error = "Transfer was cancelled!";
+}
+
+void Client::releaseCurl(Transfer* transfer)
+{
+	HppAssert(transfer->curl, "Transfer has no easy handle!");
+	CURL* curl = transfer->curl;
+	curl_multi_remove_handle(multi, curl);
+	transfers.erase(curl);
+	transfer->curl = NULL;
+
+	// Detach handle from transfer, so it can be reused.
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, NULL);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, NULL);
+	idle_curls.push_back(curl);
+}
+
+void Client::handleFinishedTransfers(void)
+{
+	int msgs_left;
+	CURLMsg* msg;
+	while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+		if (msg->msg != CURLMSG_DONE) {
+			continue;
+		}
+
+		Transfers::iterator transfers_find = transfers.find(msg->easy_handle);
+		HppAssert(transfers_find != transfers.end(), "Unknown transfer!");
+		Transfer* transfer = transfers_find->second;
+
+		// Store results
+		if (!transfer->sink_error.empty()) {
+			transfer->error = transfer->sink_error;
+		} else if (msg->data.result != CURLE_OK) {
+			if (transfer->curl_error[0]) {
+				transfer->error = transfer->curl_error;
+			} else {
+				transfer->error = curl_easy_strerror(msg->data.result);
+			}
+		} else {
+			curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &transfer->response_http_code);
+			if (transfer->sink) {
+				try {
+					transfer->sink->finish();
+				}
+				catch (std::exception const& e) {
+					transfer->error = e.what();
+				}
+			}
+		}
+
+		releaseCurl(transfer);
+		transfer->finished = true;
+
+		// If transfer has callback, then it is owned by us
+		if (transfer->callback) {
+			transfer->client = NULL;
+			try {
+				transfer->callback(*transfer, transfer->callback_data);
+			}
+			catch ( ... ) {
+				delete transfer;
+				throw;
+			}
+			delete transfer;
+		}
+	}
+}
+
+}
+
+}
@@ -0,0 +1,169 @@
+#ifndef HPP_HTTP_CLIENT_H
+#define HPP_HTTP_CLIENT_H
+
+#include "request.h"
+
+#include "../bytev.h"
+#include "../noncopyable.h"
+#include "../time.h"
+
+#include <curl/curl.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Asynchronous HTTP client. All transfers of one Client are driven by a
+// single curl multi handle from the thread that calls perform(), run() or
+// wait(). Easy handles are recycled and DNS cache, TLS sessions and open
+// connections are shared between transfers, so repeated requests to the
+// same host skip the connection setup.
+//
+// Client is not thread safe. Use it from one thread only.
+class Client : public NonCopyable
+{
+
+public:
+
+	// Flags are the same as in Request
+	typedef Request::Flags Flags;
+
+	class Transfer;
+
+	// Called when a transfer has finished, succesfully or not. After
+	// callback returns, the Transfer is destroyed by the Client.
+	typedef void (*Callback)(Transfer const& transfer, void* data);
+
+	// Result of one request. This works like a future: when it is
+	// returned to the caller, it can be polled with isFinished() or
+	// waited with Client::wait(). Destroying unfinished Transfer
+	// cancels it.
+	class Transfer : public NonCopyable
+	{
+
+		friend class Client;
+
+	public:
+
+		~Transfer(void);
+
+		inline std::string getUrl(void) const { return url; }
+
+		inline bool isFinished(void) const { return finished; }
+
+		// These may be called only after transfer has finished. If
+		// transfer has failed, then Exception is thrown.
+		// If Transfer has Sink, then response data is always empty.
+		inline ByteV const& getResponseData(void) const { ensureSucceeded(); return response_data; }
+		inline std::string getResponseText(void) const { ensureSucceeded(); return std::string(response_data.begin(), response_data.end()); }
+		inline uint16_t getHttpCode(void) const { ensureSucceeded(); return response_http_code; }
+
+		// Tells if there was transport level error,
+		// for example if connection could not be opened.
+		inline bool hasFailed(void) const { return finished && !error.empty(); }
+		inline std::string getError(void) const { return error; }
+
+	private:
+
+		Client* client;
+		CURL* curl;
+		char curl_error[CURL_ERROR_SIZE];
+
+		std::string url;
+
+		// Callback and its data. If callback is set,
+		// then Client owns this Transfer.
+		Callback callback;
+		void* callback_data;
+
+		bool finished;
+		std::string error;
+
+		// Response
+		ByteV response_data;
+		long response_http_code;
+
+		// Optional streaming target and possible error that
+		// it has thrown while curl has been performing.
+		Sink* sink;
+		std::string sink_error;
+
+		Transfer(Client* client, std::string const& url);
+
+		void ensureSucceeded(void) const;
+
+		static size_t responseReader(char* ptr, size_t size, size_t nmemb, void* userdata);
+
+	};
+
+	Client(void);
+	~Client(void);
+
+	// Limits amount of simultaneous connections to one host. Zero
+	// means no limit. Transfers that do not fit are queued.
+	void setMaxConnectionsPerHost(size_t max_conns);
+
+	// Starts a new GET request and returns a Transfer that is owned
+	// by the caller. If Sink is given, then response body is streamed
+	// to it. Note, that Sink is called from the thread that runs the
+	// Client, so it must not wait for that thread.
+	Transfer* get(std::string const& url, Flags flags = 0, Sink* sink = NULL);
+
+	// Starts a new GET request. When it is finished, callback is
+	// called from perform(), run() or wait() and the Transfer is then
+	// destroyed.
+	void get(std::string const& url, Callback callback, void* data, Flags flags = 0, Sink* sink = NULL);
+
+	// Does all the work that can be done without blocking, then waits
+	// at most "max_wait" for more network activity and works again.
+	// Finished transfers are marked and their callbacks are called.
+	// Returns amount of transfers that are still running.
+	size_t perform(Delay const& max_wait = Delay::secs(0));
+
+	// Runs until all transfers have finished
+	void run(void);
+
+	// Runs until specific transfer has finished
+	void wait(Transfer const* transfer);
+
+	inline size_t getAmountOfRunningTransfers(void) const { return transfers.size(); }
+
+private:
+
+	typedef std::map< CURL*, Transfer* > Transfers;
+	typedef std::vector< CURL* > Curls;
+
+	CURLM* multi;
+	CURLSH* share;
+
+	// Running transfers, indexed by their easy handles
+	Transfers transfers;
+
+	// Easy handles that are not used by any transfer right now.
+	// These are recycled, so their caches can be reused.
+	Curls idle_curls;
+
+	Transfer* startTransfer(std::string const& url, Flags flags, Sink* sink, Callback callback, void* data);
+
+	// Called when Transfer is destroyed while it is still running
+	void cancelTransfer(Transfer* transfer);
+
+	// Takes easy handle from transfer and puts it to idle handles
+	void releaseCurl(Transfer* transfer);
+
+	// Reads messages of finished transfers from multi handle
+	void handleFinishedTransfers(void);
+
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef HPP_HTTP_DECOMPRESSINGSINK_H
+#define HPP_HTTP_DECOMPRESSINGSINK_H
+
+#include "sink.h"
+
+#include "../decompressor.h"
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Sink that decompresses zlib compressed body and passes the
+// decompressed data to another Sink. Progress of this Sink is
+// reported in compressed bytes.
+class DecompressingSink : public Sink
+{
+
+public:
+
+	inline DecompressingSink(Sink* target);
+	inline virtual ~DecompressingSink(void);
+
+private:
+
+	Sink* target;
+
+	Decompressor decomp;
+
+	// Block of output that is got from decompressor
+	ByteV output;
+
+	inline virtual void doReset(void);
+	inline virtual void doWrite(uint8_t const* data, size_t size);
+	inline virtual void doFinish(void);
+
+};
+
+inline DecompressingSink::DecompressingSink(Sink* target) :
+target(target)
+{
+	decomp.init();
+}
+
+inline DecompressingSink::~DecompressingSink(void)
+{
+	// If body was not received completely, then
+	// decompressor is still initialized.
+	try {
+		if (decomp.isInitialized()) {
+			decomp.deinit();
+		}
+	}
+	catch ( ... ) {
+	}
+}
+
+inline void DecompressingSink::doReset(void)
+{
+	// Starts new stream, even if earlier one was finished or broken
+	decomp.reset();
+	target->reset();
+}
+
+inline void DecompressingSink::doWrite(uint8_t const* data, size_t size)
+{
+	decomp.decompress(data, size);
+	while (decomp.readChunk(output)) {
+		target->receive(&output[0], output.size(), 0);
+	}
+}
+
+inline void DecompressingSink::doFinish(void)
+{
+	output = decomp.deinit();
+	if (!output.empty()) {
+		target->receive(&output[0], output.size(), 0);
+	}
+	target->finish();
+}
+
+}
+
+}
+
+#endif
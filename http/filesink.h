@@ -0,0 +1,84 @@
+#ifndef HPP_HTTP_FILESINK_H
+#define HPP_HTTP_FILESINK_H
+
+#include "sink.h"
+
+#include "../path.h"
+#include "../exception.h"
+
+#include <fstream>
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Sink that writes body to a file. File is truncated when Sink is
+// created and when next body starts, and closed when the whole body
+// has been received.
+class FileSink : public Sink
+{
+
+public:
+
+	inline FileSink(Path const& path);
+	inline virtual ~FileSink(void) { }
+
+private:
+
+	Path path;
+	std::ofstream file;
+
+	inline virtual void doReset(void);
+	inline virtual void doWrite(uint8_t const* data, size_t size);
+	inline virtual void doFinish(void);
+
+	inline void openFile(void);
+
+};
+
+inline FileSink::FileSink(Path const& path) :
+path(path)
+{
+	if (path.isUnknown()) {
+		throw Exception("Unable to write to unknown path!");
+	}
+	openFile();
+}
+
+inline void FileSink::doReset(void)
+{
+	if (file.is_open()) {
+		file.close();
+	}
+	openFile();
+}
+
+inline void FileSink::doWrite(uint8_t const* data, size_t size)
+{
+	file.write((char const*)data, size);
+	if (file.fail()) {
+		throw Exception("Unable to write to file \"" + path.toString() + "\"!");
+	}
+}
+
+inline void FileSink::doFinish(void)
+{
+	file.close();
+}
+
+inline void FileSink::openFile(void)
+{
+	file.clear();
+	file.open(path.toString().c_str(), std::ios::binary);
+	if (!file.is_open()) {
+		throw Exception("Unable to open file \"" + path.toString() + "\" for writing!");
+	}
+}
+
+}
+
+}
+
+#endif
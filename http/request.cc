@@ -8,14 +8,14 @@ namespace Hpp
 namespace Http
 {
 
-Request::Request(std::string const& url, Flags flags) :
+Request::Request(std::string const& url, Flags flags, Sink* sink) :
 curl(curl_easy_init())
 {
 	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_error);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, responseReader);
 	curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
 
-	open(url, flags);
+	open(url, flags, sink);
 }
 
 Request::~Request(void)
@@ -23,11 +23,16 @@ Request::~Request(void)
 	curl_easy_cleanup(curl);
 }
 
-void Request::open(std::string const& url, Flags flags)
+void Request::open(std::string const& url, Flags flags, Sink* sink)
 {
 	// Reset response
 	response_data.clear();
 	response_http_code = 0;
+	this->sink = sink;
+	sink_error.clear();
+	if (sink) {
+		sink->reset();
+	}
 
 	// Refresh options
 	extractFlags(flags);
@@ -40,11 +45,27 @@ void Request::open(std::string const& url, Flags flags)
 	else curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 
 	CURLcode perform_result = curl_easy_perform(curl);
+	if (!sink_error.empty()) {
+		throw Exception("Unable to receive response from " + url + "! Reason: " + sink_error);
+	}
 	if (perform_result != 0) {
 		throw Exception("Unable to connect to " + url + "! Reason: " + curl_error);
 	}
 
 	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_http_code);
+
+	if (sink) {
+		sink->finish();
+	}
+}
+
+size_t Request::getContentLength(CURL* curl)
+{
+	curl_off_t length;
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) != CURLE_OK || length < 0) {
+		return 0;
+	}
+	return length;
 }
 
 void Request::extractFlags(Request::Flags flags)
@@ -57,6 +78,19 @@ size_t Request::responseReader(char* ptr, size_t size, size_t nmemb, void* userd
 	size_t totalsize = size * nmemb;
 	Request* r = reinterpret_cast< Request* >(userdata);
 
+	if (r->sink) {
+		// Exceptions must not pass through curl, so store
+		// error and make curl abort the transfer.
+		try {
+			r->sink->receive((uint8_t const*)ptr, totalsize, getContentLength(r->curl));
+		}
+		catch (std::exception const& e) {
+			r->sink_error = e.what();
+			return 0;
+		}
+		return totalsize;
+	}
+
 	r->response_data.insert(r->response_data.end(), ptr, ptr + totalsize);
 
 	return totalsize;
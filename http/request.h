@@ -1,6 +1,8 @@
 #ifndef HPP_HTTP_REQUEST_H
 #define HPP_HTTP_REQUEST_H
 
+#include "sink.h"
+
 #include "../bytev.h"
 #include "../noncopyable.h"
 
@@ -23,14 +25,20 @@ public:
 
 	static Flags const DISABLE_REDIRECTS = 0x01;
 
-	Request(std::string const& url, Flags flags = 0);
+	// If Sink is given, then response body is streamed to
+	// it and it is not stored to this object at all.
+	Request(std::string const& url, Flags flags = 0, Sink* sink = NULL);
 	~Request(void);
 
-	void open(std::string const& url, Flags flags = 0);
+	void open(std::string const& url, Flags flags = 0, Sink* sink = NULL);
 
 	inline std::string getResponseText(void) const { return std::string((char*)&response_data[0], response_data.size()); }
 	inline uint16_t getHttpCode(void) const { return response_http_code; }
 
+	// Returns length of response body that curl is receiving,
+	// or zero if it is not known.
+	static size_t getContentLength(CURL* curl);
+
 private:
 
 	// Curl stuff
@@ -44,6 +52,11 @@ private:
 	ByteV response_data;
 	long response_http_code;
 
+	// Optional streaming target and possible error that
+	// it has thrown while curl has been performing.
+	Sink* sink;
+	std::string sink_error;
+
 	void extractFlags(Flags flags);
 
 	static size_t responseReader(char* ptr, size_t size, size_t nmemb, void* userdata);
@@ -0,0 +1,608 @@
+#include "server.h"
+
+#include "../profilermanager.h"
+#include "../exception.h"
+#include "../assert.h"
+#include "../lock.h"
+#include "../cast.h"
+
+#include <fstream>
+#include <unistd.h>
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+Server::Server(void) :
+port(0),
+running(false)
+{
+	stats.connections_total = 0;
+	stats.connections_open = 0;
+	stats.requests = 0;
+	stats.bad_requests = 0;
+	stats.bytes_received = 0;
+	stats.bytes_sent = 0;
+	stats.handling_time = Delay::secs(0);
+}
+
+Server::~Server(void)
+{
+	if (running) {
+		stop();
+	}
+}
+
+void Server::addRoute(std::string const& method, std::string const& path, Handler handler, void* data)
+{
+	if (running) {
+		throw Exception("Unable to add routes while HTTP server is running!");
+	}
+	if (path.empty()) {
+		throw Exception("Path of route must not be empty!");
+	}
+	Route route;
+	route.handler = handler;
+	route.data = data;
+	if (path[path.size() - 1] == '*') {
+		prefix_routes[path.substr(0, path.size() - 1)][method] = route;
+	} else {
+		routes[path][method] = route;
+	}
+}
+
+void Server::addMetricsRoute(std::string const& path)
+{
+	addRoute("GET", path, metricsHandler, this);
+}
+
+void Server::start(uint16_t port)
+{
+	if (running) {
+		throw Exception("HTTP server is already running!");
+	}
+	tcpserver.startListening(port, connectionHandler, this);
+	this->port = port;
+	running = true;
+}
+
+void Server::stop(void)
+{
+	if (!running) {
+		throw Exception("HTTP server is not running!");
+	}
+
+	// After listener has stopped, no other
+	// thread will touch the list of connections.
+	tcpserver.stopListening(port);
+	running = false;
+
+	Lock lock(mutex);
+	Connections conns_copy;
+	conns_copy.swap(conns);
+	lock.unlock();
+
+	for (Connections::iterator conns_it = conns_copy.begin();
+	     conns_it != conns_copy.end();
+	     ++ conns_it) {
+		Connection* conn = *conns_it;
+		conn->conn->close();
+		conn->thread.wait();
+		delete conn->conn;
+		delete conn;
+	}
+}
+
+Server::Stats Server::getStats(void) const
+{
+	Lock lock(mutex);
+	return stats;
+}
+
+void Server::connectionHandler(TCPConnection* new_conn, uint16_t port, void* server_raw)
+{
+	(void)port;
+	Server* server = reinterpret_cast< Server* >(server_raw);
+
+	Lock lock(server->mutex);
+	server->cleanFinishedConnections();
+
+	Connection* conn = new Connection;
+	conn->server = server;
+	conn->conn = new_conn;
+	conn->finished = false;
+	conn->thread = Thread(connectionThread, reinterpret_cast< void* >(conn));
+	server->conns.push_back(conn);
+
+	++ server->stats.connections_total;
+	++ server->stats.connections_open;
+}
+
+void Server::connectionThread(void* conn_raw)
+{
+	Connection* c = reinterpret_cast< Connection* >(conn_raw);
+	Server* server = c->server;
+	TCPConnection* conn = c->conn;
+
+	// These are reused between requests
+	std::string input;
+	Request request;
+	Response response;
+	std::string head;
+
+	try {
+
+		bool keep_alive = true;
+		while (keep_alive) {
+
+			// Wait for more data and move all of it to input buffer
+			if (!conn->waitForReading(1)) {
+				break;
+			}
+			size_t amount = conn->getAmountOfWaitingData();
+			input += conn->readString(amount);
+
+			// Handle all complete requests that were received. If
+			// requests were pipelined, then responses are written
+			// in one batch.
+			size_t input_used = 0;
+			size_t requests = 0;
+			size_t bad_requests = 0;
+			uint64_t bytes_sent = 0;
+			Delay handling_time = Delay::secs(0);
+			bool writing = false;
+			while (keep_alive) {
+
+				size_t consumed;
+				ParseResult parse_result = parseRequest(request, consumed, input, input_used);
+				if (parse_result == PARSE_INCOMPLETE) {
+					break;
+				}
+
+				if (!writing) {
+					conn->initWrite();
+					writing = true;
+				}
+
+				response.reset();
+				bool head_only = false;
+				bool http_1_0 = false;
+				if (parse_result == PARSE_OK) {
+					input_used += consumed;
+
+					std::string connection = request.getHeader("connection");
+					if (request.version_minor >= 1) {
+						keep_alive = connection.find("close") == std::string::npos;
+					} else {
+						keep_alive = connection.find("keep-alive") != std::string::npos;
+					}
+					head_only = request.method == "HEAD";
+					http_1_0 = request.version_minor == 0;
+
+					Time handling_started = now();
+					server->handleRequest(request, response);
+					handling_time += now() - handling_started;
+					++ requests;
+				} else {
+					if (parse_result == PARSE_TOO_LARGE) {
+						setErrorResponse(response, 413, "Request is too large!");
+					} else {
+						setErrorResponse(response, 400, "Malformed request!");
+					}
+					keep_alive = false;
+					++ bad_requests;
+				}
+
+				bytes_sent += writeResponse(conn, head, response, keep_alive, http_1_0, head_only);
+			}
+			input.erase(0, input_used);
+
+			if (writing) {
+				conn->deinitWrite();
+			}
+
+			Lock lock(server->mutex);
+			server->stats.requests += requests;
+			server->stats.bad_requests += bad_requests;
+			server->stats.bytes_received += amount;
+			server->stats.bytes_sent += bytes_sent;
+			server->stats.handling_time += handling_time;
+		}
+
+		conn->close();
+	}
+	catch ( ... ) {
+		conn->close();
+	}
+
+	Lock lock(server->mutex);
+	c->finished = true;
+	-- server->stats.connections_open;
+}
+
+void Server::cleanFinishedConnections(void)
+{
+	Connections::iterator conns_it = conns.begin();
+	while (conns_it != conns.end()) {
+		Connection* conn = *conns_it;
+		if (!conn->finished) {
+			++ conns_it;
+			continue;
+		}
+		conn->thread.wait();
+		delete conn->conn;
+		delete conn;
+		conns_it = conns.erase(conns_it);
+	}
+}
+
+Server::ParseResult Server::parseRequest(Request& request, size_t& consumed, std::string const& buf, size_t offset)
+{
+	// Find end of headers
+	size_t headers_end = buf.find("\r\n\r\n", offset);
+	if (headers_end == std::string::npos) {
+		if (buf.size() - offset > MAX_HEADER_SIZE) {
+			return PARSE_TOO_LARGE;
+		}
+		return PARSE_INCOMPLETE;
+	}
+	if (headers_end - offset > MAX_HEADER_SIZE) {
+		return PARSE_TOO_LARGE;
+	}
+
+	// Request line
+	size_t line_end = buf.find("\r\n", offset);
+	HppAssert(line_end != std::string::npos, "Line ending should be found!");
+	size_t method_end = buf.find(' ', offset);
+	if (method_end == std::string::npos || method_end >= line_end || method_end == offset) {
+		return PARSE_BAD;
+	}
+	size_t target_end = buf.find(' ', method_end + 1);
+	if (target_end == std::string::npos || target_end >= line_end || target_end == method_end + 1) {
+		return PARSE_BAD;
+	}
+	if (line_end - target_end - 1 != 8 || buf.compare(target_end + 1, 7, "HTTP/1.") != 0 ||
+	    buf[line_end - 1] < '0' || buf[line_end - 1] > '9') {
+		return PARSE_BAD;
+	}
+	request.method.assign(buf, offset, method_end - offset);
+	request.version_minor = buf[line_end - 1] - '0';
+	size_t query_begin = buf.find('?', method_end + 1);
+	if (query_begin != std::string::npos && query_begin < target_end) {
+		request.path.assign(buf, method_end + 1, query_begin - method_end - 1);
+		request.query.assign(buf, query_begin + 1, target_end - query_begin - 1);
+	} else {
+		request.path.assign(buf, method_end + 1, target_end - method_end - 1);
+		request.query.clear();
+	}
+
+	// Headers
+	request.headers.clear();
+	while (line_end < headers_end) {
+		size_t line_begin = line_end + 2;
+		line_end = buf.find("\r\n", line_begin);
+		HppAssert(line_end != std::string::npos, "Line ending should be found!");
+		size_t colon = buf.find(':', line_begin);
+		if (colon == std::string::npos || colon >= line_end || colon == line_begin) {
+			return PARSE_BAD;
+		}
+		std::string name(buf, line_begin, colon - line_begin);
+		for (std::string::iterator name_it = name.begin();
+		     name_it != name.end();
+		     ++ name_it) {
+			if (*name_it >= 'A' && *name_it <= 'Z') {
+				*name_it += 'a' - 'A';
+			}
+		}
+		size_t value_begin = colon + 1;
+		size_t value_end = line_end;
+		while (value_begin < value_end && (buf[value_begin] == ' ' || buf[value_begin] == '\t')) {
+			++ value_begin;
+		}
+		while (value_end > value_begin && (buf[value_end - 1] == ' ' || buf[value_end - 1] == '\t')) {
+			-- value_end;
+		}
+		std::string& value = request.headers[name];
+		if (!value.empty()) {
+			value += ", ";
+		}
+		value.append(buf, value_begin, value_end - value_begin);
+	}
+
+	// Chunked request bodies are not supported
+	if (request.headers.find("transfer-encoding") != request.headers.end()) {
+		return PARSE_BAD;
+	}
+
+	// Body
+	size_t body_begin = headers_end + 4;
+	size_t body_size = 0;
+	Request::Headers::const_iterator content_length_find = request.headers.find("content-length");
+	if (content_length_find != request.headers.end()) {
+		std::string const& content_length = content_length_find->second;
+		if (content_length.empty() || content_length.size() > 10) {
+			return PARSE_BAD;
+		}
+		for (size_t ofs = 0; ofs < content_length.size(); ++ ofs) {
+			if (content_length[ofs] < '0' || content_length[ofs] > '9') {
+				return PARSE_BAD;
+			}
+			body_size = body_size * 10 + (content_length[ofs] - '0');
+		}
+		if (body_size > MAX_BODY_SIZE) {
+			return PARSE_TOO_LARGE;
+		}
+	}
+	if (buf.size() < body_begin + body_size) {
+		return PARSE_INCOMPLETE;
+	}
+	request.body.assign(buf, body_begin, body_size);
+
+	consumed = body_begin + body_size - offset;
+	return PARSE_OK;
+}
+
+void Server::handleRequest(Request const& request, Response& response)
+{
+	// Find routes of path. First try exact
+	// match and then the longest prefix.
+	RoutesByMethod const* path_routes = NULL;
+	Routes::const_iterator routes_find = routes.find(request.path);
+	if (routes_find != routes.end()) {
+		path_routes = &routes_find->second;
+	} else {
+		size_t longest_prefix = 0;
+		for (Routes::const_iterator prefix_routes_it = prefix_routes.begin();
+		     prefix_routes_it != prefix_routes.end();
+		     ++ prefix_routes_it) {
+			std::string const& prefix = prefix_routes_it->first;
+			if ((!path_routes || prefix.size() > longest_prefix) &&
+			    request.path.compare(0, prefix.size(), prefix) == 0) {
+				path_routes = &prefix_routes_it->second;
+				longest_prefix = prefix.size();
+			}
+		}
+	}
+	if (!path_routes) {
+		setErrorResponse(response, 404, "Not found!");
+		return;
+	}
+
+	// Find route of method. HEAD falls back to GET.
+	RoutesByMethod::const_iterator route_find = path_routes->find(request.method);
+	if (route_find == path_routes->end() && request.method == "HEAD") {
+		route_find = path_routes->find("GET");
+	}
+	if (route_find == path_routes->end()) {
+		setErrorResponse(response, 405, "Method not allowed!");
+		std::string allow;
+		for (RoutesByMethod::const_iterator path_routes_it = path_routes->begin();
+		     path_routes_it != path_routes->end();
+		     ++ path_routes_it) {
+			if (!allow.empty()) {
+				allow += ", ";
+			}
+			allow += path_routes_it->first;
+		}
+		response.setHeader("Allow", allow);
+		return;
+	}
+
+	Route const& route = route_find->second;
+	try {
+		route.handler(request, response, route.data);
+	}
+	catch (std::exception const& e) {
+		response.reset();
+		setErrorResponse(response, 500, e.what());
+	}
+	catch ( ... ) {
+		response.reset();
+		setErrorResponse(response, 500, "Unknown error!");
+	}
+}
+
+size_t Server::writeResponse(TCPConnection* conn, std::string& head, Response& response, bool keep_alive, bool http_1_0, bool head_only)
+{
+	uint8_t const* body;
+	size_t body_size;
+	if (!response.taken_body.empty()) {
+		body = &response.taken_body[0];
+		body_size = response.taken_body.size();
+	} else if (response.ext_body) {
+		body = response.ext_body;
+		body_size = response.ext_body_size;
+	} else {
+		body = reinterpret_cast< uint8_t const* >(response.body.data());
+		body_size = response.body.size();
+	}
+
+	head.clear();
+	head += "HTTP/1.1 ";
+	appendUInt(head, response.status);
+	head += ' ';
+	head += getStatusText(response.status);
+	head += "\r\n";
+	for (Response::Headers::const_iterator headers_it = response.headers.begin();
+	     headers_it != response.headers.end();
+	     ++ headers_it) {
+		head += headers_it->first;
+		head += ": ";
+		head += headers_it->second;
+		head += "\r\n";
+	}
+	head += "Content-Length: ";
+	appendUInt(head, body_size);
+	head += "\r\n";
+	if (!keep_alive) {
+		head += "Connection: close\r\n";
+	} else if (http_1_0) {
+		head += "Connection: keep-alive\r\n";
+	}
+	head += "\r\n";
+
+	conn->writeString(head);
+	if (head_only) {
+		return head.size();
+	}
+	// Taken buffer is given to connection as it is
+	if (!response.taken_body.empty()) {
+		conn->writeAndTake(response.taken_body);
+	} else {
+		conn->writeData(body, body_size);
+	}
+	return head.size() + body_size;
+}
+
+void Server::setErrorResponse(Response& response, uint16_t status, std::string const& message)
+{
+	response.setStatus(status);
+	response.setContentType("text/plain; charset=utf-8");
+	response.body = message;
+	response.body += '\n';
+}
+
+std::string Server::getStatusText(uint16_t status)
+{
+	switch (status) {
+	case 200: return "OK";
+	case 201: return "Created";
+	case 202: return "Accepted";
+	case 204: return "No Content";
+	case 301: return "Moved Permanently";
+	case 302: return "Found";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 403: return "Forbidden";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 413: return "Payload Too Large";
+	case 500: return "Internal Server Error";
+	case 501: return "Not Implemented";
+	case 503: return "Service Unavailable";
+	}
+	return "Unknown";
+}
+
+void Server::appendUInt(std::string& str, uint64_t i)
+{
+	char buf[20];
+	size_t ofs = sizeof(buf);
+	do {
+		buf[-- ofs] = '0' + i % 10;
+		i /= 10;
+	} while (i);
+	str.append(buf + ofs, sizeof(buf) - ofs);
+}
+
+void Server::appendDelay(std::string& str, Delay const& d)
+{
+	if (d < Delay::secs(0)) {
+		str += '-';
+		appendDelay(str, -d);
+		return;
+	}
+	appendUInt(str, d.getSeconds());
+	str += '.';
+	char buf[9];
+	uint32_t nsecs = d.getNanoseconds();
+	for (size_t ofs = 9; ofs > 0; -- ofs) {
+		buf[ofs - 1] = '0' + nsecs % 10;
+		nsecs /= 10;
+	}
+	str.append(buf, 9);
+}
+
+bool Server::getMemoryUsage(uint64_t& resident, uint64_t& virt)
+{
+	#ifndef WIN32
+	// Sizes are in pages
+	std::ifstream statm("/proc/self/statm");
+	uint64_t virt_pages;
+	uint64_t resident_pages;
+	if (!(statm >> virt_pages >> resident_pages)) {
+		return false;
+	}
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0) {
+		return false;
+	}
+	resident = resident_pages * page_size;
+	virt = virt_pages * page_size;
+	return true;
+	#else
+	(void)resident;
+	(void)virt;
+	return false;
+	#endif
+}
+
+void Server::metricsHandler(Request const& request, Response& response, void* server_raw)
+{
+	(void)request;
+	Server const* server = reinterpret_cast< Server const* >(server_raw);
+
+	response.setContentType("text/plain; version=0.0.4");
+	std::string& out = response.getBody();
+
+	// Time spent in tasks of Profilermanager
+	Profilermanager::Totals totals = Profilermanager::getTotals();
+	out += "# TYPE hpp_profiler_seconds_total counter\n";
+	for (Profilermanager::Totals::const_iterator totals_it = totals.begin();
+	     totals_it != totals.end();
+	     ++ totals_it) {
+		out += "hpp_profiler_seconds_total{task=\"";
+		std::string const& task = totals_it->first;
+		for (std::string::const_iterator task_it = task.begin();
+		     task_it != task.end();
+		     ++ task_it) {
+			if (*task_it == '\\' || *task_it == '"') {
+				out += '\\';
+				out += *task_it;
+			} else if (*task_it == '\n') {
+				out += "\\n";
+			} else {
+				out += *task_it;
+			}
+		}
+		out += "\"} ";
+		appendDelay(out, totals_it->second);
+		out += '\n';
+	}
+
+	// Statistics of this server
+	Stats stats = server->getStats();
+	out += "# TYPE hpp_http_connections_total counter\nhpp_http_connections_total ";
+	appendUInt(out, stats.connections_total);
+	out += "\n# TYPE hpp_http_connections_open gauge\nhpp_http_connections_open ";
+	appendUInt(out, stats.connections_open);
+	out += "\n# TYPE hpp_http_requests_total counter\nhpp_http_requests_total ";
+	appendUInt(out, stats.requests);
+	out += "\n# TYPE hpp_http_bad_requests_total counter\nhpp_http_bad_requests_total ";
+	appendUInt(out, stats.bad_requests);
+	out += "\n# TYPE hpp_http_received_bytes_total counter\nhpp_http_received_bytes_total ";
+	appendUInt(out, stats.bytes_received);
+	out += "\n# TYPE hpp_http_sent_bytes_total counter\nhpp_http_sent_bytes_total ";
+	appendUInt(out, stats.bytes_sent);
+	out += "\n# TYPE hpp_http_handling_seconds_total counter\nhpp_http_handling_seconds_total ";
+	appendDelay(out, stats.handling_time);
+	out += '\n';
+
+	// Memory usage of process
+	uint64_t resident;
+	uint64_t virt;
+	if (getMemoryUsage(resident, virt)) {
+		out += "# TYPE process_resident_memory_bytes gauge\nprocess_resident_memory_bytes ";
+		appendUInt(out, resident);
+		out += "\n# TYPE process_virtual_memory_bytes gauge\nprocess_virtual_memory_bytes ";
+		appendUInt(out, virt);
+		out += '\n';
+	}
+}
+
+}
+
+}
@@ -0,0 +1,225 @@
+#ifndef HPP_HTTP_SERVER_H
+#define HPP_HTTP_SERVER_H
+
+#include "../tcpserver.h"
+#include "../tcpconnection.h"
+#include "../thread.h"
+#include "../mutex.h"
+#include "../time.h"
+#include "../noncopyable.h"
+#include "../bytev.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <utility>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Small HTTP/1.1 server for exposing runtime statistics and control
+// commands of a process. Connections are kept alive and pipelined
+// requests are answered in order, so that all responses that are ready
+// are sent as one write. Every connection is served by its own thread.
+class Server : public NonCopyable
+{
+
+public:
+
+	// Request that has been received from client.
+	// Names of headers are converted to lowercase.
+	struct Request
+	{
+		typedef std::map< std::string, std::string > Headers;
+
+		std::string method;
+		std::string path;
+		std::string query;
+		uint8_t version_minor;
+		Headers headers;
+		std::string body;
+
+		// Returns empty string if header does not exist
+		inline std::string getHeader(std::string const& name) const;
+	};
+
+	// Response that is filled by request handler. Response objects are
+	// reused between requests of same connection, so body can be
+	// written to without reallocation.
+	class Response
+	{
+
+		friend class Server;
+
+	public:
+
+		inline Response(void) : status(200), ext_body(NULL), ext_body_size(0) { }
+
+		inline void setStatus(uint16_t status) { this->status = status; }
+		inline uint16_t getStatus(void) const { return status; }
+
+		inline void setHeader(std::string const& name, std::string const& value) { headers.push_back(std::make_pair(name, value)); }
+		inline void setContentType(std::string const& type) { setHeader("Content-Type", type); }
+
+		// Body is either written to this string by handler. It is
+		// copied once, right after the head of response, so small
+		// responses of a batch are sent together...
+		inline std::string& getBody(void) { return body; }
+
+		// ...or handler can give data of its own. Data is copied
+		// like above, so it only needs to stay valid until the
+		// handler has returned...
+		inline void setBody(uint8_t const* data, size_t size) { ext_body = data; ext_body_size = size; }
+
+		// ...or handler can give a whole buffer. Its contents are
+		// taken and given to the connection without copying them,
+		// and "data" is left empty. This is best for big bodies.
+		inline void setBody(ByteV& data) { taken_body.swap(data); data.clear(); }
+
+	private:
+
+		typedef std::vector< std::pair< std::string, std::string > > Headers;
+
+		uint16_t status;
+		Headers headers;
+		std::string body;
+		uint8_t const* ext_body;
+		size_t ext_body_size;
+		ByteV taken_body;
+
+		inline void reset(void) { status = 200; headers.clear(); body.clear(); ext_body = NULL; ext_body_size = 0; taken_body.clear(); }
+
+	};
+
+	// Request handler. Exceptions thrown by
+	// handler are reported with status 500.
+	typedef void (*Handler)(Request const& request, Response& response, void* data);
+
+	// Statistics of the server
+	struct Stats
+	{
+		size_t connections_total;
+		size_t connections_open;
+		size_t requests;
+		size_t bad_requests;
+		uint64_t bytes_received;
+		uint64_t bytes_sent;
+		Delay handling_time;
+	};
+
+	Server(void);
+	~Server(void);
+
+	// Adds handler for method and path. If path ends with "*", then
+	// it matches all paths that begin with it. Exact matches are
+	// preferred over prefixes and longer prefixes over shorter ones.
+	void addRoute(std::string const& method, std::string const& path, Handler handler, void* data = NULL);
+
+	// Adds route that serves statistics of Profilermanager, of
+	// this server and of memory usage of the process in Prometheus
+	// text format.
+	void addMetricsRoute(std::string const& path = "/metrics");
+
+	void start(uint16_t port);
+	void stop(void);
+
+	inline bool isRunning(void) const { return running; }
+
+	Stats getStats(void) const;
+
+	// Limits for requests. Larger requests are rejected.
+	static size_t const MAX_HEADER_SIZE = 16 * 1024;
+	static size_t const MAX_BODY_SIZE = 1024 * 1024;
+
+private:
+
+	struct Route
+	{
+		Handler handler;
+		void* data;
+	};
+	// Routes are indexed first by path and then by method
+	typedef std::map< std::string, Route > RoutesByMethod;
+	typedef std::map< std::string, RoutesByMethod > Routes;
+
+	struct Connection
+	{
+		Server* server;
+		TCPConnection* conn;
+		Thread thread;
+		bool finished;
+	};
+	typedef std::list< Connection* > Connections;
+
+	// Result of parsing request from input buffer
+	enum ParseResult { PARSE_INCOMPLETE, PARSE_OK, PARSE_BAD, PARSE_TOO_LARGE };
+
+	TCPServer tcpserver;
+	uint16_t port;
+	bool running;
+
+	// Routes are modified only when server is not running
+	Routes routes;
+	Routes prefix_routes;
+
+	// Open connections and statistics. Protected by mutex.
+	mutable Mutex mutex;
+	Connections conns;
+	Stats stats;
+
+	static void connectionHandler(TCPConnection* new_conn, uint16_t port, void* server_raw);
+	static void connectionThread(void* conn_raw);
+
+	// Waits threads of finished connections and destroys them.
+	// Mutex must be locked when this is called.
+	void cleanFinishedConnections(void);
+
+	// Parses one request from buffer, starting at offset. On success,
+	// request is filled and "consumed" tells how many bytes it took.
+	static ParseResult parseRequest(Request& request, size_t& consumed, std::string const& buf, size_t offset);
+
+	// Finds route for request and runs its handler
+	void handleRequest(Request const& request, Response& response);
+
+	// Writes response to connection. Initialization of writing must
+	// be done by caller. "head" is a reusable buffer. Keeping alive
+	// is told explicitly only to HTTP/1.0 clients. Returns amount of
+	// bytes written.
+	static size_t writeResponse(TCPConnection* conn, std::string& head, Response& response, bool keep_alive, bool http_1_0, bool head_only);
+
+	// Writes simple error response with given status
+	static void setErrorResponse(Response& response, uint16_t status, std::string const& message);
+
+	static std::string getStatusText(uint16_t status);
+
+	// Fast formatting of numbers
+	static void appendUInt(std::string& str, uint64_t i);
+	static void appendDelay(std::string& str, Delay const& d);
+
+	// Gets resident and virtual memory size of process in bytes.
+	// Returns false if they are not available.
+	static bool getMemoryUsage(uint64_t& resident, uint64_t& virt);
+
+	static void metricsHandler(Request const& request, Response& response, void* server_raw);
+
+};
+
+inline std::string Server::Request::getHeader(std::string const& name) const
+{
+	Headers::const_iterator headers_find = headers.find(name);
+	if (headers_find == headers.end()) {
+		return "";
+	}
+	return headers_find->second;
+}
+
+}
+
+}
+
+#endif
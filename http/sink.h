@@ -0,0 +1,91 @@
+#ifndef HPP_HTTP_SINK_H
+#define HPP_HTTP_SINK_H
+
+#include "../noncopyable.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Destination of streamed response body. When a Request or a Client
+// transfer is given a Sink, body is not collected to memory, but every
+// received chunk is given to the Sink as soon as it arrives.
+class Sink : public NonCopyable
+{
+
+public:
+
+	// Called after every received chunk. "total" is
+	// zero if size of the body is not known.
+	typedef void (*ProgressCallback)(size_t received, size_t total, void* data);
+
+	inline Sink(void) : received(0), progress_callback(NULL), progress_data(NULL) { }
+	inline virtual ~Sink(void) { }
+
+	inline void setProgressCallback(ProgressCallback callback, void* data) { progress_callback = callback; progress_data = data; }
+
+	// These are called by Request and Client. Reset is called
+	// before every transfer, so same Sink can be used again.
+	inline void reset(void) { received = 0; doReset(); }
+	inline void receive(uint8_t const* data, size_t size, size_t total);
+	inline void finish(void) { doFinish(); }
+
+	inline size_t getReceived(void) const { return received; }
+
+private:
+
+	size_t received;
+
+	ProgressCallback progress_callback;
+	void* progress_data;
+
+	// Prepares for a new body
+	inline virtual void doReset(void) { }
+
+	// Handles chunk of body
+	virtual void doWrite(uint8_t const* data, size_t size) = 0;
+
+	// Called when whole body has been received
+	inline virtual void doFinish(void) { }
+
+};
+
+// Sink that gives every chunk to a callback function
+class CallbackSink : public Sink
+{
+
+public:
+
+	typedef void (*Callback)(uint8_t const* data, size_t size, void* userdata);
+
+	inline CallbackSink(Callback callback, void* userdata) : callback(callback), userdata(userdata) { }
+	inline virtual ~CallbackSink(void) { }
+
+private:
+
+	Callback callback;
+	void* userdata;
+
+	inline virtual void doWrite(uint8_t const* data, size_t size) { callback(data, size, userdata); }
+
+};
+
+inline void Sink::receive(uint8_t const* data, size_t size, size_t total)
+{
+	doWrite(data, size);
+	received += size;
+	if (progress_callback) {
+		progress_callback(received, total, progress_data);
+	}
+}
+
+}
+
+}
+
+#endif
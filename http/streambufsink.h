@@ -0,0 +1,41 @@
+#ifndef HPP_HTTP_STREAMBUFSINK_H
+#define HPP_HTTP_STREAMBUFSINK_H
+
+#include "sink.h"
+
+#include "../streambuf.h"
+
+namespace Hpp
+{
+
+namespace Http
+{
+
+// Sink that pushes body to Streambuf, so it can be read from another
+// thread, for example through IStreampipe. If Streambuf has capacity
+// set, then downloading is paused while the buffer is full. This keeps
+// memory usage bounded. Streambuf is closed when body has been received,
+// and opened again when next body starts.
+class StreambufSink : public Sink
+{
+
+public:
+
+	inline StreambufSink(Streambuf* sbuf) : sbuf(sbuf) { }
+	inline virtual ~StreambufSink(void) { }
+
+private:
+
+	Streambuf* sbuf;
+
+	inline virtual void doReset(void) { sbuf->reopen(); }
+	inline virtual void doWrite(uint8_t const* data, size_t size) { sbuf->pushData(data, data + size); }
+	inline virtual void doFinish(void) { sbuf->close(); }
+
+};
+
+}
+
+}
+
+#endif
@@ -55,12 +55,17 @@ Image::Image(uint8_t const* data, size_t width, size_t height, Pixelformat forma
 
 Image::Image(ByteV const& filedata, Pixelformat format, Flags flags)
 {
-	loadFromFiledata(&filedata[0], format, flags);
+	loadFromFiledata(&filedata[0], filedata.size(), format, flags);
+}
+
+Image::Image(ConstByteView filedata, Pixelformat format, Flags flags)
+{
+	loadFromFiledata(filedata.data(), filedata.size(), format, flags);
 }
 
 Image::Image(uint8_t const* filedata, Pixelformat format, Flags flags)
 {
-	loadFromFiledata(filedata, format, flags);
+	loadFromFiledata(filedata, 0, format, flags);
 }
 
 Image::Image(size_t width, size_t height, Pixelformat format)
@@ -655,10 +660,10 @@ void Image::loadFromPixeldata(uint8_t const* data, size_t width, size_t height,
 	HppAssert(this->data.size() == getBppOfPixelformat(this->format) * this->width * this->height, "Fail!");
 }
 
-void Image::loadFromFiledata(uint8_t const* filedata, Pixelformat format, Flags flags)
+void Image::loadFromFiledata(uint8_t const* filedata, size_t filedata_size, Pixelformat format, Flags flags)
 {
 	HppAssert(filedata, "Must be not NULL!");
-	SDL_Surface* surf = loadSDLSurface("", filedata);
+	SDL_Surface* surf = loadSDLSurface("", filedata, filedata_size);
 	loadFromSDLSurface(surf, format, flags, data, this->format, width, height);
 	SDL_FreeSurface(surf);
 }
@@ -7,6 +7,7 @@
 #include "assert.h"
 #include "pixelformat.h"
 #include "bytev.h"
+#include "byteview.h"
 #include "assert.h"
 #include "misc.h"
 
@@ -38,6 +39,8 @@ public:
 	Image(ByteV const& data, size_t width, size_t height, Pixelformat format, Flags flags = 0);
 	Image(uint8_t const* data, size_t width, size_t height, Pixelformat format, Flags flags = 0);
 	Image(ByteV const& filedata, Pixelformat format = DEFAULT, Flags flags = 0);
+	// Contents of image file, for example from MappedFile
+	Image(ConstByteView filedata, Pixelformat format = DEFAULT, Flags flags = 0);
 	Image(uint8_t const* filedata, Pixelformat format = DEFAULT, Flags flags = 0);
 	Image(size_t width, size_t height, Pixelformat format);
 	~Image(void);
@@ -54,6 +57,10 @@ public:
 
 	// Getters
 	inline ByteV getData(void) const { return data; }
+	// Pixels without copying. Views are valid until image is changed
+	// in a way that changes its size or format, or it is destroyed.
+	inline ConstByteView getDataView(void) const { return data; }
+	inline ByteView getDataView(void) { return data; }
 	inline ByteV getDataFlipped(void) const;
 	inline Pixelformat getFormat(void) const { return format; }
 	inline size_t getWidth(void) const { return width; }
@@ -87,7 +94,7 @@ private:
 
 	// If "data" is NULL, then content of image is full black and zero alpha.
 	void loadFromPixeldata(uint8_t const* data, size_t width, size_t height, Pixelformat format, Flags flags);
-	void loadFromFiledata(uint8_t const* filedata, Pixelformat format, Flags flags);
+	void loadFromFiledata(uint8_t const* filedata, size_t filedata_size, Pixelformat format, Flags flags);
 };
 
 inline ByteV Image::getDataFlipped(void) const
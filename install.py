@@ -94,6 +94,8 @@ def main(pname, args):
 		build(sources, cflags, libs, libname)
 	elif user_command == 'test':
 		test()
+	elif user_command == 'benchmark':
+		benchmark()
 	elif user_command == 'install':
 		build(sources, cflags, libs, libname)
 		install(install_path, headers, libname, libs, version, desc)
@@ -204,10 +206,15 @@ def clean(sources, libname):
 	os.remove('lib' + libname + '.so')
 
 def test():
-	runCommand('g++ -Wall -Wpointer-arith -Werror -ansi -pedantic -o /tmp/libhpp_tester test.cc 3dconstants.cc assert.cc json.cc printonce.cc -lcrypto -lrt')
+	runCommand('g++ -Wall -Wpointer-arith -Werror -ansi -pedantic -o /tmp/libhpp_tester test.cc 3dconstants.cc assert.cc json.cc printonce.cc connectionmanager.cc tcpconnection.cc tcpserver.cc http/client.cc http/request.cc http/server.cc profilermanager.cc -lcrypto -lz -lrt -lpthread -lcurl')
 	runCommand('/tmp/libhpp_tester')
 	os.remove('/tmp/libhpp_tester')
 
+def benchmark():
+	runCommand('g++ -Wall -Wpointer-arith -Werror -ansi -pedantic -O2 -DNDEBUG -o /tmp/libhpp_benchmark benchmark.cc assert.cc json.cc -lcrypto -lz -lrt -lpthread')
+	runCommand('/tmp/libhpp_benchmark')
+	os.remove('/tmp/libhpp_benchmark')
+
 def install(path, headers, libname, libs, version, desc, real_path = None):
 
 	# TODO: Get these from somewhere else!
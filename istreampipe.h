@@ -2,9 +2,12 @@
 #define HPP_ISTREAMPIPE_H
 
 #include "streambuf.h"
+#include "bytev.h"
 
 #include <ostream>
 #include <istream>
+#include <algorithm>
+#include <cstring>
 
 namespace Hpp
 {
@@ -21,11 +24,14 @@ protected:
 	// Functions required by class std::streambuf.
 	inline virtual int_type underflow(void);
 
+	// Reads many characters at once
+	inline virtual std::streamsize xsgetn(char_type* s, std::streamsize count);
+
 private:
 
-	// Work in buffer mode.
-	static size_t const BUF_SIZE = 64;
-	char buf[BUF_SIZE];
+	// Chunk that is being read. It is taken from
+	// Streambuf as it is, so nothing is copied.
+	ByteV chunk;
 
 	Streambuf* sbuf;
 
@@ -65,17 +71,35 @@ sbuf(sbuf)
 
 inline std::streambuf::int_type IStreampipeBuf::underflow(void)
 {
-	// Extract data to buffer
-	size_t bytes_read = sbuf->readData((uint8_t*)buf, BUF_SIZE);
-	HppAssert(bytes_read <= BUF_SIZE, "Overflow!");
+	if (gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
 
-	if (bytes_read == 0) {
+	// Take next chunk to be the buffer
+	if (!sbuf->popChunk(chunk)) {
+		setg(NULL, NULL, NULL);
 		return traits_type::eof();
 	}
 
-	setg(buf, buf, buf + bytes_read);
+	char* begin = reinterpret_cast< char* >(&chunk[0]);
+	setg(begin, begin, begin + chunk.size());
+
+	return traits_type::to_int_type(*begin);
+}
 
-	return buf[0];
+inline std::streamsize IStreampipeBuf::xsgetn(char_type* s, std::streamsize count)
+{
+	std::streamsize result = 0;
+	while (result < count) {
+		if (gptr() == egptr() && traits_type::eq_int_type(underflow(), traits_type::eof())) {
+			break;
+		}
+		std::streamsize amount = std::min< std::streamsize >(count - result, egptr() - gptr());
+		memcpy(s + result, gptr(), amount);
+		setg(eback(), gptr() + amount, egptr());
+		result += amount;
+	}
+	return result;
 }
 
 inline IStreampipe::IStreampipe(Streambuf* sbuf) :
@@ -69,8 +69,8 @@ public:
 private:
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -229,21 +229,16 @@ inline void IVector2::constructFromJson(Json const& json)
 	y = json.getItem(1).getInteger();
 }
 
-inline void IVector2::doSerialize(ByteV& result, bool bigendian) const
+inline void IVector2::doSerialize(BinaryWriter& writer) const
 {
-	result += int64ToByteV(x, bigendian);
-	result += int64ToByteV(y, bigendian);
+	writer.writeInt64(x);
+	writer.writeInt64(y);
 }
 
-inline void IVector2::doDeserialize(std::istream& strm, bool bigendian)
+inline void IVector2::doDeserialize(BinaryReader& reader)
 {
-	char buf[16];
-	strm.read(buf, 16);
-	if (strm.eof()) {
-		throw Exception("Unexpected end of data!");
-	}
-	x = cStrToInt64(buf, bigendian);
-	y = cStrToInt64(buf + 8, bigendian);
+	x = reader.readInt64();
+	y = reader.readInt64();
 }
 
 inline std::ostream& operator<<(std::ostream& strm, IVector2 const& v)
@@ -70,8 +70,8 @@ public:
 private:
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -239,23 +239,18 @@ inline void IVector3::constructFromJson(Json const& json)
 	z = json.getItem(2).getInteger();
 }
 
-inline void IVector3::doSerialize(ByteV& result, bool bigendian) const
+inline void IVector3::doSerialize(BinaryWriter& writer) const
 {
-	result += int64ToByteV(x, bigendian);
-	result += int64ToByteV(y, bigendian);
-	result += int64ToByteV(z, bigendian);
+	writer.writeInt64(x);
+	writer.writeInt64(y);
+	writer.writeInt64(z);
 }
 
-inline void IVector3::doDeserialize(std::istream& strm, bool bigendian)
+inline void IVector3::doDeserialize(BinaryReader& reader)
 {
-	char buf[24];
-	strm.read(buf, 24);
-	if (strm.eof()) {
-		throw Exception("Unexpected end of data!");
-	}
-	x = cStrToInt64(buf, bigendian);
-	y = cStrToInt64(buf + 8, bigendian);
-	z = cStrToInt64(buf + 16, bigendian);
+	x = reader.readInt64();
+	y = reader.readInt64();
+	z = reader.readInt64();
 }
 
 inline std::ostream& operator<<(std::ostream& strm, IVector3 const& v)
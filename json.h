@@ -12,6 +12,7 @@
 
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <cstdlib>
 
 namespace Hpp
@@ -20,6 +21,9 @@ namespace Hpp
 class Json
 {
 
+	// Builds values of captured subtrees in place
+	friend class JsonParser;
+
 public:
 
 	enum Type { NUMBER, STRING, BOOLEAN, OBJECT, ARRAY, NUL, USERDATA };
@@ -34,6 +38,9 @@ public:
 	inline Json(Json const& json);
 	inline Json const& operator=(Json const& json);
 
+	// Swaps contents without copying them
+	inline void swap(Json& json);
+
 	inline void decode(std::string const& json);
 	inline std::string encode(bool nice = false) const;
 
@@ -110,18 +117,30 @@ private:
 };
 
 inline Json::Json(void) :
-type(NUL)
+type(NUL),
+num(0),
+num_i(0),
+num_is_integer(false),
+userdata(NULL)
 {
 }
 
 inline Json::Json(std::string const& json) :
-type(NUL)
+type(NUL),
+num(0),
+num_i(0),
+num_is_integer(false),
+userdata(NULL)
 {
 	decode(json);
 }
 
 inline Json::Json(Json const& json) :
-type(json.type)
+type(json.type),
+num(0),
+num_i(0),
+num_is_integer(false),
+userdata(NULL)
 {
 	switch (type) {
 	case NUMBER:
@@ -178,6 +197,18 @@ inline Json const& Json::operator=(Json const& json)
 	return *this;
 }
 
+inline void Json::swap(Json& json)
+{
+	std::swap(type, json.type);
+	std::swap(num, json.num);
+	std::swap(num_i, json.num_i);
+	std::swap(num_is_integer, json.num_is_integer);
+	str.swap(json.str);
+	obj.swap(json.obj);
+	arr.swap(json.arr);
+	std::swap(userdata, json.userdata);
+}
+
 inline void Json::decode(std::string const& json)
 {
 	std::string::const_iterator json_it = json.begin();
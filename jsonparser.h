@@ -0,0 +1,956 @@
+#ifndef HPP_JSONPARSER_H
+#define HPP_JSONPARSER_H
+
+#include "json.h"
+#include "byteview.h"
+#include "bytev.h"
+#include "streambuf.h"
+#include "path.h"
+#include "mappedfile.h"
+#include "unicode.h"
+#include "cast.h"
+#include "exception.h"
+#include "noncopyable.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Receives events from JsonParser. Only needed functions are overridden.
+class JsonHandler
+{
+
+public:
+
+	inline virtual ~JsonHandler(void) { }
+
+	inline virtual void startObject(void) { }
+	inline virtual void endObject(void) { }
+	inline virtual void startArray(void) { }
+	inline virtual void endArray(void) { }
+	inline virtual void key(std::string const& key) { (void)key; }
+	inline virtual void string(std::string const& str) { (void)str; }
+	inline virtual void number(double num) { (void)num; }
+	// Numbers without fraction or exponent that fit to 64 bits.
+	// By default these are given to number().
+	inline virtual void integer(int64_t num) { number(double(num)); }
+	inline virtual void boolean(bool value) { (void)value; }
+	inline virtual void null(void) { }
+
+	// Value that was selected with JsonParser::addCapture(). It is
+	// given as a whole instead of events. Json can be swapped out.
+	inline virtual void subtree(std::string const& path, Json& json) { (void)path; (void)json; }
+
+};
+
+// Streaming JSON parser. Input is given in chunks of any size, and events
+// are sent to handler as soon as values are complete, so the document is
+// never in memory as a whole. Memory use depends only on depth of nesting
+// and length of the longest string. Selected parts of the document can be
+// read as Json values by capturing them.
+//
+// Paths are written like "/levels/3/name", where numbers are indices of
+// arrays and "*" matches any key or index. Empty path is the whole document.
+class JsonParser : public NonCopyable
+{
+
+public:
+
+	inline JsonParser(JsonHandler* handler);
+
+	// Values at matching paths are given to JsonHandler::subtree()
+	inline void addCapture(std::string const& path);
+
+	// Parses more of the document
+	inline void feed(char const* data, size_t size);
+	inline void feed(ConstByteView data);
+
+	// Tells that document has ended. Throws if it is not complete.
+	inline void finish(void);
+
+	// Parses whole document
+	inline void parse(std::istream& strm);
+	inline void parse(Streambuf& sbuf);
+	inline void parse(Path const& path);
+
+	// Starts a new document
+	inline void reset(void);
+
+	inline bool isDone(void) const { return state == DONE; }
+
+	// Path of value that is being read
+	inline size_t getDepth(void) const { return frames.size(); }
+	inline std::string getPath(void) const;
+
+private:
+
+	enum State {
+		VALUE,
+		FIRST_VALUE_OR_END,
+		FIRST_KEY_OR_END,
+		KEY,
+		COLON,
+		COMMA_OR_END,
+		STRING,
+		STRING_ESCAPE,
+		STRING_UNICODE,
+		NUMBER,
+		LITERAL,
+		DONE
+	};
+
+	// Object or array that is open
+	struct Frame
+	{
+		bool is_object;
+		// Amount of items in array
+		size_t items;
+		// Key of current member in object
+		std::string key;
+		// Container that is being captured, or NULL
+		Json* capture;
+	};
+	typedef std::vector< Frame > Frames;
+
+	typedef std::vector< std::string > PathParts;
+	typedef std::vector< PathParts > Captures;
+
+	// Amount of bytes that are read at once from streams
+	static size_t const READ_SIZE = 64 * 1024;
+
+	JsonHandler* handler;
+
+	State state;
+	Frames frames;
+
+	// String or number that is being read
+	std::string token;
+	bool token_is_key;
+	char const* literal;
+	size_t literal_pos;
+	uint32_t unicode;
+	unsigned int unicode_digits;
+	uint32_t high_surrogate;
+
+	// Where scalar value is captured, or NULL
+	Json* value_target;
+
+	Captures captures;
+	bool capturing;
+	size_t capture_depth;
+	Json capture_root;
+
+	// Bytes parsed so far, for error messages
+	size_t offset;
+
+	inline void handleCharacter(char c);
+	inline void beginValue(char c);
+	inline Json* prepareValue(void);
+	inline bool matchesCapture(void) const;
+	inline void endContainer(bool is_object);
+	inline void endValue(void);
+	inline void endString(void);
+	inline void endNumber(void);
+	inline void endLiteral(void);
+	inline void handleEscape(char c);
+	inline void handleUnicodeDigit(char c);
+	inline void flushSurrogate(void);
+
+	inline Exception unexpected(char c) const;
+
+	inline static bool isWhitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+	inline static bool isNumberChar(char c) { return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'; }
+
+};
+
+// Pull interface to JsonParser. Events are asked one by one, and
+// more input is parsed only when earlier events have been used.
+class JsonReader : public NonCopyable
+{
+
+public:
+
+	enum Event { START_OBJECT, END_OBJECT, START_ARRAY, END_ARRAY, KEY, STRING, NUMBER, BOOLEAN, NUL, SUBTREE, END };
+
+	// Source must exist while it is read
+	inline JsonReader(std::istream& strm);
+	inline JsonReader(Streambuf& sbuf);
+	inline JsonReader(ConstByteView data);
+
+	inline void addCapture(std::string const& path) { parser.addCapture(path); }
+
+	// Returns next event. END is returned when document has ended.
+	inline Event next(void);
+
+	// Skips the rest of object or array that has just started
+	inline void skip(void);
+
+	// Values of the current event. String is the key, the string or
+	// path of subtree. Integer is valid only if isInteger() is true.
+	inline Event getEvent(void) const { return current.event; }
+	inline std::string const& getString(void) const { return current.str; }
+	inline double getNumber(void) const { return current.num; }
+	inline bool isInteger(void) const { return current.is_integer; }
+	inline int64_t getInteger(void) const { return current.num_i; }
+	inline bool getBoolean(void) const { return current.boolean; }
+	inline Json& getSubtree(void) { return current_subtree; }
+
+private:
+
+	struct QueuedEvent
+	{
+		Event event;
+		std::string str;
+		double num;
+		int64_t num_i;
+		bool is_integer;
+		bool boolean;
+	};
+	typedef std::deque< QueuedEvent > Events;
+	typedef std::deque< Json > Subtrees;
+
+	// Queues events of parser
+	class Queuer : public JsonHandler
+	{
+	public:
+		inline Queuer(Events* events, Subtrees* subtrees) : events(events), subtrees(subtrees) { }
+		inline virtual void startObject(void) { push(START_OBJECT); }
+		inline virtual void endObject(void) { push(END_OBJECT); }
+		inline virtual void startArray(void) { push(START_ARRAY); }
+		inline virtual void endArray(void) { push(END_ARRAY); }
+		inline virtual void key(std::string const& key) { push(KEY).str = key; }
+		inline virtual void string(std::string const& str) { push(STRING).str = str; }
+		inline virtual void number(double num) { push(NUMBER).num = num; }
+		inline virtual void integer(int64_t num);
+		inline virtual void boolean(bool value) { push(BOOLEAN).boolean = value; }
+		inline virtual void null(void) { push(NUL); }
+		inline virtual void subtree(std::string const& path, Json& json);
+	private:
+		Events* events;
+		Subtrees* subtrees;
+		inline QueuedEvent& push(Event event);
+	};
+
+	Events events;
+	Subtrees subtrees;
+	Queuer queuer;
+	JsonParser parser;
+
+	std::istream* strm;
+	Streambuf* sbuf;
+	ConstByteView data;
+	bool finished;
+
+	ByteV buf;
+
+	QueuedEvent current;
+	Json current_subtree;
+
+	// Amount of bytes that are parsed at once
+	static size_t const READ_SIZE = 64 * 1024;
+
+	inline void init(void);
+	inline void feedMore(void);
+
+};
+
+inline JsonParser::JsonParser(JsonHandler* handler) :
+handler(handler)
+{
+	reset();
+}
+
+inline void JsonParser::addCapture(std::string const& path)
+{
+	PathParts parts;
+	size_t pos = 0;
+	while (pos < path.size()) {
+		if (path[pos] != '/') {
+			throw Exception("Path \"" + path + "\" must begin with \"/\"!");
+		}
+		size_t next = path.find('/', pos + 1);
+		if (next == std::string::npos) {
+			next = path.size();
+		}
+		parts.push_back(path.substr(pos + 1, next - pos - 1));
+		pos = next;
+	}
+	captures.push_back(parts);
+}
+
+inline void JsonParser::feed(char const* data, size_t size)
+{
+	char const* end = data + size;
+	char const* it = data;
+	while (it != end) {
+		// Characters of strings are copied in runs
+		if (state == STRING) {
+			char const* run = it;
+			while (run != end && *run != '\"' && *run != '\\' && uint8_t(*run) >= 0x20) {
+				++ run;
+			}
+			if (run != it) {
+				flushSurrogate();
+				token.append(it, run);
+				offset += run - it;
+				it = run;
+			}
+			if (it == end) {
+				break;
+			}
+		}
+		char c = *it;
+		// Number ends at the first character that does not belong to it.
+		// That character is then handled again in the new state.
+		if (state == NUMBER && !isNumberChar(c)) {
+			endNumber();
+			continue;
+		}
+		handleCharacter(c);
+		++ it;
+		++ offset;
+	}
+}
+
+inline void JsonParser::feed(ConstByteView data)
+{
+	feed(reinterpret_cast< char const* >(data.data()), data.size());
+}
+
+inline void JsonParser::finish(void)
+{
+	if (state == NUMBER) {
+		endNumber();
+	}
+	if (state != DONE) {
+		throw Exception("JSON document ended prematurely!");
+	}
+}
+
+inline void JsonParser::parse(std::istream& strm)
+{
+	std::vector< char > buf(READ_SIZE);
+	while (true) {
+		strm.read(&buf[0], buf.size());
+		if (strm.bad()) {
+			throw Exception("Unable to read JSON from stream!");
+		}
+		size_t amount = strm.gcount();
+		feed(&buf[0], amount);
+		if (amount < buf.size()) {
+			break;
+		}
+	}
+	finish();
+}
+
+inline void JsonParser::parse(Streambuf& sbuf)
+{
+	ByteV chunk;
+	while (sbuf.popChunk(chunk)) {
+		feed(ConstByteView(chunk));
+	}
+	finish();
+}
+
+inline void JsonParser::parse(Path const& path)
+{
+	MappedFile file;
+	path.mapFile(file, MappedFile::SEQUENTIAL);
+	feed(file.getView());
+	finish();
+}
+
+inline void JsonParser::reset(void)
+{
+	state = VALUE;
+	frames.clear();
+	token.clear();
+	token_is_key = false;
+	literal = NULL;
+	literal_pos = 0;
+	unicode = 0;
+	unicode_digits = 0;
+	high_surrogate = 0;
+	value_target = NULL;
+	capturing = false;
+	capture_depth = 0;
+	capture_root = Json();
+	offset = 0;
+}
+
+inline std::string JsonParser::getPath(void) const
+{
+	std::string result;
+	for (Frames::const_iterator frames_it = frames.begin();
+	     frames_it != frames.end();
+	     ++ frames_it) {
+		result += '/';
+		if (frames_it->is_object) {
+			result += frames_it->key;
+		} else if (frames_it->items > 0) {
+			result += sizeToStr(frames_it->items - 1);
+		}
+	}
+	return result;
+}
+
+inline void JsonParser::handleCharacter(char c)
+{
+	switch (state) {
+	case STRING:
+		if (c == '\"') {
+			flushSurrogate();
+			endString();
+		} else if (c == '\\') {
+			state = STRING_ESCAPE;
+		} else {
+			throw Exception("Control character in JSON string at byte " + sizeToStr(offset) + "!");
+		}
+		return;
+	case STRING_ESCAPE:
+		handleEscape(c);
+		return;
+	case STRING_UNICODE:
+		handleUnicodeDigit(c);
+		return;
+	case NUMBER:
+		token += c;
+		return;
+	case LITERAL:
+		if (c != literal[literal_pos]) {
+			throw unexpected(c);
+		}
+		++ literal_pos;
+		if (literal[literal_pos] == '\0') {
+			endLiteral();
+		}
+		return;
+	default:
+		break;
+	}
+
+	if (isWhitespace(c)) {
+		return;
+	}
+
+	switch (state) {
+	case VALUE:
+		beginValue(c);
+		break;
+	case FIRST_VALUE_OR_END:
+		if (c == ']') {
+			endContainer(false);
+		} else {
+			beginValue(c);
+		}
+		break;
+	case FIRST_KEY_OR_END:
+		if (c == '}') {
+			endContainer(true);
+			break;
+		}
+	// Fall through
+	case KEY:
+		if (c != '\"') {
+			throw unexpected(c);
+		}
+		token.clear();
+		token_is_key = true;
+		state = STRING;
+		break;
+	case COLON:
+		if (c != ':') {
+			throw unexpected(c);
+		}
+		state = VALUE;
+		break;
+	case COMMA_OR_END:
+		if (c == ',') {
+			state = frames.back().is_object ? KEY : VALUE;
+		} else if (c == '}' && frames.back().is_object) {
+			endContainer(true);
+		} else if (c == ']' && !frames.back().is_object) {
+			endContainer(false);
+		} else {
+			throw unexpected(c);
+		}
+		break;
+	case DONE:
+		throw Exception("Unexpected data after JSON document at byte " + sizeToStr(offset) + "!");
+	default:
+		HppAssert(false, "Invalid state!");
+		break;
+	}
+}
+
+inline void JsonParser::beginValue(char c)
+{
+	Json* target = prepareValue();
+	if (c == '{' || c == '[') {
+		bool is_object = c == '{';
+		if (target) {
+			target->type = is_object ? Json::OBJECT : Json::ARRAY;
+		} else if (is_object) {
+			handler->startObject();
+		} else {
+			handler->startArray();
+		}
+		frames.push_back(Frame());
+		Frame& frame = frames.back();
+		frame.is_object = is_object;
+		frame.items = 0;
+		frame.capture = target;
+		state = is_object ? FIRST_KEY_OR_END : FIRST_VALUE_OR_END;
+		return;
+	}
+	value_target = target;
+	if (c == '\"') {
+		token.clear();
+		token_is_key = false;
+		state = STRING;
+	} else if (c == '-' || (c >= '0' && c <= '9')) {
+		token.assign(1, c);
+		state = NUMBER;
+	} else if (c == 't') {
+		literal = "true";
+		literal_pos = 1;
+		state = LITERAL;
+	} else if (c == 'f') {
+		literal = "false";
+		literal_pos = 1;
+		state = LITERAL;
+	} else if (c == 'n') {
+		literal = "null";
+		literal_pos = 1;
+		state = LITERAL;
+	} else {
+		throw unexpected(c);
+	}
+}
+
+inline Json* JsonParser::prepareValue(void)
+{
+	if (!frames.empty() && !frames.back().is_object) {
+		++ frames.back().items;
+	}
+	// Value is part of a captured subtree
+	if (capturing) {
+		Frame& parent = frames.back();
+		if (parent.is_object) {
+			Json& member = parent.capture->obj[parent.key];
+			member = Json();
+			return &member;
+		}
+		parent.capture->arr.push_back(Json());
+		return &parent.capture->arr.back();
+	}
+	if (matchesCapture()) {
+		capturing = true;
+		capture_depth = frames.size();
+		capture_root = Json();
+		return &capture_root;
+	}
+	return NULL;
+}
+
+inline bool JsonParser::matchesCapture(void) const
+{
+	for (Captures::const_iterator captures_it = captures.begin();
+	     captures_it != captures.end();
+	     ++ captures_it) {
+		PathParts const& parts = *captures_it;
+		if (parts.size() != frames.size()) {
+			continue;
+		}
+		bool match = true;
+		for (size_t part_id = 0; part_id < parts.size() && match; ++ part_id) {
+			std::string const& part = parts[part_id];
+			Frame const& frame = frames[part_id];
+			if (part == "*") {
+				continue;
+			}
+			if (frame.is_object) {
+				match = part == frame.key;
+			} else {
+				match = part == sizeToStr(frame.items - 1);
+			}
+		}
+		if (match) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline void JsonParser::endContainer(bool is_object)
+{
+	bool captured = frames.back().capture != NULL;
+	frames.pop_back();
+	if (!captured) {
+		if (is_object) {
+			handler->endObject();
+		} else {
+			handler->endArray();
+		}
+	}
+	endValue();
+}
+
+inline void JsonParser::endValue(void)
+{
+	value_target = NULL;
+	state = frames.empty() ? DONE : COMMA_OR_END;
+	if (capturing && frames.size() == capture_depth) {
+		capturing = false;
+		handler->subtree(getPath(), capture_root);
+		capture_root = Json();
+	}
+}
+
+inline void JsonParser::endString(void)
+{
+	if (token_is_key) {
+		frames.back().key = token;
+		if (!capturing) {
+			handler->key(token);
+		}
+		state = COLON;
+		return;
+	}
+	if (value_target) {
+		value_target->type = Json::STRING;
+		value_target->str.swap(token);
+	} else {
+		handler->string(token);
+	}
+	endValue();
+}
+
+inline void JsonParser::endNumber(void)
+{
+	// Check syntax: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+	size_t pos = 0;
+	bool negative = false;
+	if (token[pos] == '-') {
+		negative = true;
+		++ pos;
+	}
+	size_t int_begin = pos;
+	while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9') {
+		++ pos;
+	}
+	size_t int_end = pos;
+	bool valid = int_end > int_begin && (token[int_begin] != '0' || int_end == int_begin + 1);
+	bool is_integer = true;
+	if (valid && pos < token.size() && token[pos] == '.') {
+		is_integer = false;
+		size_t frac_begin = ++ pos;
+		while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9') {
+			++ pos;
+		}
+		valid = pos > frac_begin;
+	}
+	if (valid && pos < token.size() && (token[pos] == 'e' || token[pos] == 'E')) {
+		is_integer = false;
+		++ pos;
+		if (pos < token.size() && (token[pos] == '+' || token[pos] == '-')) {
+			++ pos;
+		}
+		size_t exp_begin = pos;
+		while (pos < token.size() && token[pos] >= '0' && token[pos] <= '9') {
+			++ pos;
+		}
+		valid = pos > exp_begin;
+	}
+	if (!valid || pos != token.size()) {
+		throw Exception("Invalid JSON number \"" + token + "\" at byte " + sizeToStr(offset) + "!");
+	}
+
+	// Integers that do not fit to 64 bits are handled as doubles
+	uint64_t magnitude = 0;
+	if (is_integer) {
+		uint64_t limit = uint64_t(1) << 63;
+		if (!negative) {
+			-- limit;
+		}
+		for (size_t digit_pos = int_begin; digit_pos < int_end && is_integer; ++ digit_pos) {
+			unsigned int digit = token[digit_pos] - '0';
+			if (magnitude > (limit - digit) / 10) {
+				is_integer = false;
+			}
+			magnitude = magnitude * 10 + digit;
+		}
+	}
+
+	if (is_integer) {
+		int64_t num = negative ? int64_t(-magnitude) : int64_t(magnitude);
+		if (value_target) {
+			value_target->type = Json::NUMBER;
+			value_target->num = double(num);
+			value_target->num_i = num;
+			value_target->num_is_integer = true;
+		} else {
+			handler->integer(num);
+		}
+	} else {
+		double num = strtod(token.c_str(), NULL);
+		if (value_target) {
+			value_target->type = Json::NUMBER;
+			value_target->num = num;
+			value_target->num_i = num + 0.5;
+			value_target->num_is_integer = false;
+		} else {
+			handler->number(num);
+		}
+	}
+	endValue();
+}
+
+inline void JsonParser::endLiteral(void)
+{
+	if (literal[0] == 'n') {
+		if (value_target) {
+			value_target->type = Json::NUL;
+		} else {
+			handler->null();
+		}
+	} else {
+		bool value = literal[0] == 't';
+		if (value_target) {
+			value_target->type = Json::BOOLEAN;
+			value_target->num_is_integer = value;
+		} else {
+			handler->boolean(value);
+		}
+	}
+	endValue();
+}
+
+inline void JsonParser::handleEscape(char c)
+{
+	state = STRING;
+	if (c == 'u') {
+		unicode = 0;
+		unicode_digits = 0;
+		state = STRING_UNICODE;
+		return;
+	}
+	flushSurrogate();
+	switch (c) {
+	case '\"': token += '\"'; break;
+	case '\\': token += '\\'; break;
+	case '/': token += '/'; break;
+	case 'b': token += '\b'; break;
+	case 'f': token += '\f'; break;
+	case 'n': token += '\n'; break;
+	case 'r': token += '\r'; break;
+	case 't': token += '\t'; break;
+	default:
+		throw Exception(std::string("Escaped \"") + c + "\" is unexpected in JSON string!");
+	}
+}
+
+inline void JsonParser::handleUnicodeDigit(char c)
+{
+	uint32_t digit;
+	if (c >= '0' && c <= '9') {
+		digit = c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		digit = c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		digit = c - 'A' + 10;
+	} else {
+		throw unexpected(c);
+	}
+	unicode = unicode * 16 + digit;
+	++ unicode_digits;
+	if (unicode_digits < 4) {
+		return;
+	}
+	state = STRING;
+
+	// Characters outside the basic plane are escaped as surrogate pairs
+	if (unicode >= 0xd800 && unicode < 0xdc00) {
+		flushSurrogate();
+		high_surrogate = unicode;
+		return;
+	}
+	if (unicode >= 0xdc00 && unicode < 0xe000) {
+		if (high_surrogate) {
+			unicode = 0x10000 + ((high_surrogate - 0xd800) << 10) + (unicode - 0xdc00);
+			high_surrogate = 0;
+		} else {
+			unicode = 0xfffd;
+		}
+	} else {
+		flushSurrogate();
+	}
+	token += uChrToUTF8(unicode);
+}
+
+inline void JsonParser::flushSurrogate(void)
+{
+	// High surrogate without pair becomes a replacement character
+	if (high_surrogate) {
+		token += uChrToUTF8(0xfffd);
+		high_surrogate = 0;
+	}
+}
+
+inline Exception JsonParser::unexpected(char c) const
+{
+	return Exception(std::string("Unexpected character \"") + c + "\" in JSON at byte " + sizeToStr(offset) + "!");
+}
+
+inline JsonReader::JsonReader(std::istream& strm) :
+queuer(&events, &subtrees),
+parser(&queuer),
+strm(&strm),
+sbuf(NULL),
+finished(false)
+{
+	init();
+}
+
+inline JsonReader::JsonReader(Streambuf& sbuf) :
+queuer(&events, &subtrees),
+parser(&queuer),
+strm(NULL),
+sbuf(&sbuf),
+finished(false)
+{
+	init();
+}
+
+inline JsonReader::JsonReader(ConstByteView data) :
+queuer(&events, &subtrees),
+parser(&queuer),
+strm(NULL),
+sbuf(NULL),
+data(data),
+finished(false)
+{
+	init();
+}
+
+inline JsonReader::Event JsonReader::next(void)
+{
+	while (events.empty()) {
+		if (finished) {
+			current.event = END;
+			return END;
+		}
+		feedMore();
+	}
+	QueuedEvent& event = events.front();
+	current.event = event.event;
+	current.str.swap(event.str);
+	current.num = event.num;
+	current.num_i = event.num_i;
+	current.is_integer = event.is_integer;
+	current.boolean = event.boolean;
+	events.pop_front();
+	if (current.event == SUBTREE) {
+		current_subtree.swap(subtrees.front());
+		subtrees.pop_front();
+	}
+	return current.event;
+}
+
+inline void JsonReader::skip(void)
+{
+	if (current.event != START_OBJECT && current.event != START_ARRAY) {
+		throw Exception("Only objects and arrays can be skipped!");
+	}
+	size_t depth = 1;
+	while (depth > 0) {
+		Event event = next();
+		if (event == START_OBJECT || event == START_ARRAY) {
+			++ depth;
+		} else if (event == END_OBJECT || event == END_ARRAY) {
+			-- depth;
+		} else if (event == END) {
+			throw Exception("JSON document ended prematurely!");
+		}
+	}
+}
+
+inline void JsonReader::init(void)
+{
+	current.event = END;
+	current.num = 0;
+	current.num_i = 0;
+	current.is_integer = false;
+	current.boolean = false;
+}
+
+inline void JsonReader::feedMore(void)
+{
+	if (strm) {
+		buf.resize(READ_SIZE);
+		strm->read(reinterpret_cast< char* >(&buf[0]), buf.size());
+		if (strm->bad()) {
+			throw Exception("Unable to read JSON from stream!");
+		}
+		size_t amount = strm->gcount();
+		parser.feed(ConstByteView(&buf[0], amount));
+		if (amount < buf.size()) {
+			finished = true;
+		}
+	} else if (sbuf) {
+		if (sbuf->popChunk(buf)) {
+			parser.feed(ConstByteView(buf));
+		} else {
+			finished = true;
+		}
+	} else {
+		size_t amount = std::min(data.size(), size_t(READ_SIZE));
+		parser.feed(data.sub(0, amount));
+		data = data.sub(amount);
+		if (data.size() == 0) {
+			finished = true;
+		}
+	}
+	if (finished) {
+		parser.finish();
+	}
+}
+
+inline void JsonReader::Queuer::integer(int64_t num)
+{
+	QueuedEvent& event = push(NUMBER);
+	event.num = double(num);
+	event.num_i = num;
+	event.is_integer = true;
+}
+
+inline void JsonReader::Queuer::subtree(std::string const& path, Json& json)
+{
+	push(SUBTREE).str = path;
+	subtrees->push_back(Json());
+	subtrees->back().swap(json);
+}
+
+inline JsonReader::QueuedEvent& JsonReader::Queuer::push(Event event)
+{
+	events->push_back(QueuedEvent());
+	QueuedEvent& result = events->back();
+	result.event = event;
+	result.num = 0;
+	result.num_i = 0;
+	result.is_integer = false;
+	result.boolean = false;
+	return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef HPP_LZ77CODEC_H
+#define HPP_LZ77CODEC_H
+
+#include "codec.h"
+#include "exception.h"
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Fast LZ77 codec in the style of LZ4. Ratio is worse than with zlib,
+// but compression is several times and decompression about an order
+// of magnitude faster. Compressed data is a list of sequences:
+//
+//   token          high four bits: literal length, low four bits:
+//                  match length minus four. Value 15 means that
+//                  length continues in following bytes.
+//   [length bytes] 255 is added to length and next byte is read,
+//                  until a byte smaller than 255 is found.
+//   literals
+//   offset         two bytes, little endian. Distance of match.
+//   [length bytes] continuation of match length
+//
+// The last sequence has only literals. Decompression checks all bounds,
+// so corrupted or malicious data only causes an exception.
+class Lz77Codec : public Codec
+{
+
+public:
+
+	inline Lz77Codec(void) { }
+	inline virtual ~Lz77Codec(void) { }
+
+	inline virtual Id getId(void) const { return LZ77; }
+
+	inline virtual size_t getMaxCompressedSize(size_t data_size) const { return data_size + data_size / 255 + 16; }
+
+	// Every byte of compressed data can produce at most 255 bytes
+	inline virtual size_t getMaxDecompressedSize(size_t compressed_size) const { return compressed_size * 255 + 16; }
+
+	inline virtual size_t compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size);
+
+	inline virtual void decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size);
+
+private:
+
+	static size_t const MIN_MATCH = 4;
+	// Last bytes are always literals, and no match starts near the end.
+	// This way the match finder can read four bytes without checks.
+	static size_t const LAST_LITERALS = 5;
+	static size_t const MATCH_FIND_LIMIT = 12;
+	static size_t const MAX_OFFSET = 65535;
+	// After this many failed searches, step is increased. This makes
+	// uncompressible data go through fast.
+	static size_t const SKIP_TRIGGER = 6;
+
+	static size_t const HASH_BITS = 14;
+	static size_t const HASH_SIZE = 1 << HASH_BITS;
+
+	// Positions of last occurrences of four byte sequences.
+	// Allocated on first compression and reused after that.
+	std::vector< uint32_t > hashtable;
+
+	inline static uint32_t read32(uint8_t const* ptr);
+	inline static uint32_t hash(uint32_t value) { return (value * 2654435761U) >> (32 - HASH_BITS); }
+
+	// Writes extra bytes of length, that has already exceeded 15
+	inline static uint8_t* writeLength(uint8_t* out, size_t length);
+
+	// Reads extra bytes of length. Throws if data ends.
+	inline static size_t readLength(uint8_t const*& in, uint8_t const* in_end);
+
+};
+
+inline size_t Lz77Codec::compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size)
+{
+	if (result_size < getMaxCompressedSize(data_size)) {
+		throw Exception("Not enough room for compressed data!");
+	}
+	if (data_size > 0x7e000000) {
+		throw Exception("Too much data for Lz77Codec!");
+	}
+
+	uint8_t* out = result;
+	uint8_t const* anchor = data;
+
+	if (data_size > MATCH_FIND_LIMIT) {
+		if (hashtable.empty()) {
+			hashtable.resize(HASH_SIZE);
+		}
+		// Table must be cleared, because old positions would point
+		// outside of this buffer. Matches are always verified, so
+		// zeros only produce failed candidates.
+		memset(&hashtable[0], 0, HASH_SIZE * sizeof(uint32_t));
+
+		uint8_t const* in = data + 1;
+		uint8_t const* in_end = data + data_size;
+		uint8_t const* match_find_limit = in_end - MATCH_FIND_LIMIT;
+		uint8_t const* match_limit = in_end - LAST_LITERALS;
+
+		while (true) {
+			// Find next match
+			uint8_t const* ref = NULL;
+			size_t attempts = 1 << SKIP_TRIGGER;
+			uint8_t const* next = in;
+			bool found = false;
+			while (!found) {
+				in = next;
+				next = in + (attempts ++ >> SKIP_TRIGGER);
+				if (next > match_find_limit) {
+					break;
+				}
+				uint32_t& slot = hashtable[hash(read32(in))];
+				ref = data + slot;
+				slot = in - data;
+				found = size_t(in - ref) <= MAX_OFFSET && read32(ref) == read32(in);
+			}
+			if (!found) {
+				break;
+			}
+
+			// Extend match backwards
+			while (in > anchor && ref > data && in[-1] == ref[-1]) {
+				-- in;
+				-- ref;
+			}
+
+			// Literals
+			size_t literals = in - anchor;
+			uint8_t* token = out ++;
+			if (literals >= 15) {
+				*token = 15 << 4;
+				out = writeLength(out, literals - 15);
+			} else {
+				*token = literals << 4;
+			}
+			memcpy(out, anchor, literals);
+			out += literals;
+
+			// Offset
+			size_t offset = in - ref;
+			*(out ++) = offset;
+			*(out ++) = offset >> 8;
+
+			// Length of match. Eight bytes are compared at once
+			// as long as there is room for it.
+			uint8_t const* match_begin = in;
+			in += MIN_MATCH;
+			ref += MIN_MATCH;
+			while (in + 8 <= match_limit) {
+				uint64_t a;
+				uint64_t b;
+				memcpy(&a, in, 8);
+				memcpy(&b, ref, 8);
+				if (a != b) {
+					break;
+				}
+				in += 8;
+				ref += 8;
+			}
+			while (in < match_limit && *in == *ref) {
+				++ in;
+				++ ref;
+			}
+			size_t match = in - match_begin - MIN_MATCH;
+			if (match >= 15) {
+				*token |= 15;
+				out = writeLength(out, match - 15);
+			} else {
+				*token |= match;
+			}
+
+			anchor = in;
+			if (in > match_find_limit) {
+				break;
+			}
+			// Add position from inside of match, it helps
+			// to find matches in repetitive data.
+			hashtable[hash(read32(in - 2))] = in - 2 - data;
+		}
+	}
+
+	// Rest of data as literals
+	size_t literals = data + data_size - anchor;
+	if (literals >= 15) {
+		*(out ++) = 15 << 4;
+		out = writeLength(out, literals - 15);
+	} else {
+		*(out ++) = literals << 4;
+	}
+	if (literals) {
+		memcpy(out, anchor, literals);
+		out += literals;
+	}
+
+	return out - result;
+}
+
+inline void Lz77Codec::decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size)
+{
+	uint8_t const* in = data;
+	uint8_t const* in_end = data + data_size;
+	uint8_t* out = result;
+	uint8_t* out_end = result + result_size;
+
+	while (true) {
+		if (in >= in_end) {
+			throw Exception("Corrupted data!");
+		}
+		uint8_t token = *(in ++);
+
+		// Literals
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			literals += readLength(in, in_end);
+		}
+		if (literals > size_t(in_end - in) || literals > size_t(out_end - out)) {
+			throw Exception("Corrupted data!");
+		}
+		// Short literals are copied as two fixed size chunks, if there
+		// is room for it. Extra bytes will be overwritten later.
+		if (literals <= 16 && in_end - in >= 16 && out_end - out >= 16) {
+			memcpy(out, in, 8);
+			memcpy(out + 8, in + 8, 8);
+			in += literals;
+			out += literals;
+		} else if (literals) {
+			memcpy(out, in, literals);
+			in += literals;
+			out += literals;
+		}
+
+		// Last sequence has no match
+		if (in == in_end) {
+			break;
+		}
+
+		// Match
+		if (in_end - in < 2) {
+			throw Exception("Corrupted data!");
+		}
+		size_t offset = in[0] | (size_t(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > size_t(out - result)) {
+			throw Exception("Corrupted data!");
+		}
+		size_t match = token & 15;
+		if (match == 15) {
+			match += readLength(in, in_end);
+		}
+		match += MIN_MATCH;
+		if (match > size_t(out_end - out)) {
+			throw Exception("Corrupted data!");
+		}
+		uint8_t const* ref = out - offset;
+		uint8_t* match_end = out + match;
+		if (offset >= 8 && size_t(out_end - out) >= match + 8) {
+			// Chunks of eight bytes do not overlap, and there
+			// is room to write a little past the match.
+			do {
+				memcpy(out, ref, 8);
+				out += 8;
+				ref += 8;
+			} while (out < match_end);
+			out = match_end;
+		} else if (offset >= match) {
+			memcpy(out, ref, match);
+			out = match_end;
+		} else {
+			while (out < match_end) {
+				*(out ++) = *(ref ++);
+			}
+		}
+	}
+
+	if (out != out_end) {
+		throw Exception("Corrupted data!");
+	}
+}
+
+inline uint32_t Lz77Codec::read32(uint8_t const* ptr)
+{
+	uint32_t result;
+	memcpy(&result, ptr, 4);
+	return result;
+}
+
+inline uint8_t* Lz77Codec::writeLength(uint8_t* out, size_t length)
+{
+	while (length >= 255) {
+		*(out ++) = 255;
+		length -= 255;
+	}
+	*(out ++) = length;
+	return out;
+}
+
+inline size_t Lz77Codec::readLength(uint8_t const*& in, uint8_t const* in_end)
+{
+	size_t result = 0;
+	uint8_t byte;
+	do {
+		if (in >= in_end) {
+			throw Exception("Corrupted data!");
+		}
+		byte = *(in ++);
+		result += byte;
+	} while (byte == 255);
+	return result;
+}
+
+}
+
+#endif
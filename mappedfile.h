@@ -0,0 +1,197 @@
+#ifndef HPP_MAPPEDFILE_H
+#define HPP_MAPPEDFILE_H
+
+#include "byteview.h"
+#include "bytev.h"
+#include "exception.h"
+#include "noncopyable.h"
+
+#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#else
+#include <fstream>
+#endif
+
+namespace Hpp
+{
+
+// Read only view to the contents of a file. File is mapped to memory,
+// so nothing is read until bytes are used, and pages are shared with
+// the cache of operating system instead of being copied. Mapping is
+// removed when MappedFile is closed or destroyed, and views to it
+// become invalid then. If file is shrunk while it is mapped, reading
+// the missing part crashes the process, so only map files that are
+// not modified by others. On Windows file is read to memory instead.
+//
+// Usually MappedFile is opened with Path::mapFile().
+class MappedFile : public NonCopyable
+{
+
+public:
+
+	// Hints about how bytes are going to be read
+	enum Access { NORMAL, SEQUENTIAL, RANDOM, WILL_NEED };
+
+	inline MappedFile(void);
+	inline MappedFile(std::string const& filename, Access access = SEQUENTIAL);
+	inline ~MappedFile(void);
+
+	inline void open(std::string const& filename, Access access = SEQUENTIAL);
+	inline void close(void);
+
+	inline bool isOpen(void) const { return is_open; }
+
+	inline uint8_t const* data(void) const { return ptr; }
+	inline size_t size(void) const { return len; }
+	inline ConstByteView getView(void) const { return ConstByteView(ptr, len); }
+
+	// Changes access hint of whole file or part of it
+	inline void advise(Access access);
+	inline void advise(size_t offset, size_t size, Access access);
+
+private:
+
+	bool is_open;
+	uint8_t const* ptr;
+	size_t len;
+
+	#ifdef WIN32
+	ByteV buf;
+	#endif
+
+};
+
+inline MappedFile::MappedFile(void) :
+is_open(false),
+ptr(NULL),
+len(0)
+{
+}
+
+inline MappedFile::MappedFile(std::string const& filename, Access access) :
+is_open(false),
+ptr(NULL),
+len(0)
+{
+	open(filename, access);
+}
+
+inline MappedFile::~MappedFile(void)
+{
+	close();
+}
+
+inline void MappedFile::open(std::string const& filename, Access access)
+{
+	close();
+
+	#ifndef WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw Exception("Unable to open file \"" + filename + "\" for mapping! Reason: " + strerror(errno));
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		throw Exception("Unable to get size of file \"" + filename + "\" for mapping!");
+	}
+	if (uint64_t(st.st_size) > size_t(-1)) {
+		::close(fd);
+		throw Exception("File \"" + filename + "\" is too big to be mapped!");
+	}
+	size_t file_size = st.st_size;
+	// Empty files cannot be mapped
+	if (file_size > 0) {
+		void* mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			::close(fd);
+			throw Exception("Unable to map file \"" + filename + "\" to memory! Reason: " + strerror(errno));
+		}
+		ptr = reinterpret_cast< uint8_t const* >(mapped);
+		len = file_size;
+	}
+	// Mapping stays valid after file is closed
+	::close(fd);
+	is_open = true;
+	advise(access);
+	#else
+	(void)access;
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file.is_open()) {
+		throw Exception("Unable to open file \"" + filename + "\" for mapping!");
+	}
+	file.seekg(0, std::ios::end);
+	buf.resize(file.tellg());
+	file.seekg(0, std::ios::beg);
+	if (!buf.empty()) {
+		file.read(reinterpret_cast< char* >(&buf[0]), buf.size());
+		if (size_t(file.gcount()) != buf.size()) {
+			buf.clear();
+			throw Exception("Unable to read file \"" + filename + "\"!");
+		}
+		ptr = &buf[0];
+	}
+	len = buf.size();
+	is_open = true;
+	#endif
+}
+
+inline void MappedFile::close(void)
+{
+	#ifndef WIN32
+	if (ptr) {
+		munmap(const_cast< uint8_t* >(ptr), len);
+	}
+	#else
+	ByteV().swap(buf);
+	#endif
+	is_open = false;
+	ptr = NULL;
+	len = 0;
+}
+
+inline void MappedFile::advise(Access access)
+{
+	advise(0, len, access);
+}
+
+inline void MappedFile::advise(size_t offset, size_t size, Access access)
+{
+	#ifndef WIN32
+	if (!ptr || offset >= len || size == 0) {
+		return;
+	}
+	size = std::min(size, len - offset);
+	// Range must begin at the beginning of a page
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t page_offset = offset % page_size;
+	offset -= page_offset;
+	size += page_offset;
+	int advice;
+	switch (access) {
+	case SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+	case RANDOM: advice = MADV_RANDOM; break;
+	case WILL_NEED: advice = MADV_WILLNEED; break;
+	default: advice = MADV_NORMAL; break;
+	}
+	// Hints are only hints, so failing is not an error
+	madvise(const_cast< uint8_t* >(ptr) + offset, size, advice);
+	#else
+	(void)offset;
+	(void)size;
+	(void)access;
+	#endif
+}
+
+}
+
+#endif
@@ -94,8 +94,8 @@ private:
 	inline Real subdeterminant(uint8_t cell_id) const;
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -501,23 +501,17 @@ inline Real Matrix3::subdeterminant(uint8_t cell_id) const
 	return 0;
 }
 
-inline void Matrix3::doSerialize(ByteV& result, bool bigendian) const
+inline void Matrix3::doSerialize(BinaryWriter& writer) const
 {
-	result.reserve(result.size() + 4*9);
 	for (size_t cell_id = 0; cell_id < 9; ++ cell_id) {
-		result += floatToByteV(cells[cell_id], bigendian);
+		writer.writeFloat(cells[cell_id]);
 	}
 }
 
-inline void Matrix3::doDeserialize(std::istream& strm, bool bigendian)
+inline void Matrix3::doDeserialize(BinaryReader& reader)
 {
-	char buf[4];
 	for (size_t cell_id = 0; cell_id < 9; ++ cell_id) {
-		strm.read(buf, 4);
-		if (strm.eof()) {
-			throw Exception("Unexpected end of data!");
-		}
-		cells[cell_id] = cStrToFloat(buf, bigendian);
+		cells[cell_id] = reader.readFloat();
 	}
 }
 
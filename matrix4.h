@@ -115,8 +115,8 @@ private:
 	inline Real complement(uint8_t cell_id) const;
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -785,23 +785,17 @@ inline Real Matrix4::complement(uint8_t cell_id) const
 	return 0;
 }
 
-inline void Matrix4::doSerialize(ByteV& result, bool bigendian) const
+inline void Matrix4::doSerialize(BinaryWriter& writer) const
 {
-	result.reserve(result.size() + 4*16);
 	for (size_t cell_id = 0; cell_id < 16; ++ cell_id) {
-		result += floatToByteV(cells[cell_id], bigendian);
+		writer.writeFloat(cells[cell_id]);
 	}
 }
 
-inline void Matrix4::doDeserialize(std::istream& strm, bool bigendian)
+inline void Matrix4::doDeserialize(BinaryReader& reader)
 {
-	char buf[4];
 	for (size_t cell_id = 0; cell_id < 16; ++ cell_id) {
-		strm.read(buf, 4);
-		if (strm.eof()) {
-			throw Exception("Unexpected end of data!");
-		}
-		cells[cell_id] = cStrToFloat(buf, bigendian);
+		cells[cell_id] = reader.readFloat();
 	}
 }
 
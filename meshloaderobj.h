@@ -3,14 +3,17 @@
 
 #include "meshloader.h"
 #include "path.h"
+#include "mappedfile.h"
+#include "byteview.h"
 #include "misc.h"
 #include "exception.h"
 #include "cast.h"
 #include "types.h"
 
 #include <GL/gl.h>
-#include <fstream>
 #include <vector>
+#include <string>
+#include <cstring>
 
 namespace Hpp
 {
@@ -22,17 +25,30 @@ public:
 
 	inline MeshloaderObj(Path const& path);
 
+	// Loads from contents of .obj-file. Name is used in error messages.
+	inline MeshloaderObj(ConstByteView data, std::string const& name = "");
+
 private:
 
+	inline void load(ConstByteView data, std::string const& name);
+
 };
 
 inline MeshloaderObj::MeshloaderObj(Path const& path)
 {
-	std::ifstream file(path.toString().c_str());
-	if (!file.is_open()) {
-		throw Exception("Unable to open .obj-file \"" + path.toString() + "\"!");
-	}
+	// Lines are parsed straight from memory map
+	MappedFile file;
+	path.mapFile(file, MappedFile::SEQUENTIAL);
+	load(file.getView(), path.toString());
+}
 
+inline MeshloaderObj::MeshloaderObj(ConstByteView data, std::string const& name)
+{
+	load(data, name);
+}
+
+inline void MeshloaderObj::load(ConstByteView data, std::string const& name)
+{
 	std::vector< GLfloat > poss;
 	std::vector< GLfloat > nrms;
 	std::vector< GLfloat > uvs;
@@ -40,11 +56,17 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 	std::vector< GLuint > indices_nrms;
 	std::vector< GLuint > indices_uvs;
 
+	char const* data_it = reinterpret_cast< char const* >(data.begin());
+	char const* data_end = reinterpret_cast< char const* >(data.end());
 	size_t line_num = 0;
-	while (!file.eof()) {
+	while (data_it != data_end) {
 
-		std::string line;
-		getline (file, line);
+		char const* line_end = reinterpret_cast< char const* >(memchr(data_it, '\n', data_end - data_it));
+		if (!line_end) {
+			line_end = data_end;
+		}
+		std::string line(data_it, line_end);
+		data_it = line_end == data_end ? data_end : line_end + 1;
 		++ line_num;
 
 		if (line.empty()) {
@@ -65,7 +87,7 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 		// Position of vertex
 		if (words[0] == "v") {
 			if (words.size() < 4) {
-				throw Exception("Position components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + path.toString() + "\"!");
+				throw Exception("Position components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + name + "\"!");
 			}
 			poss.push_back(strToFloat(words[1]));
 			poss.push_back(strToFloat(words[2]));
@@ -74,7 +96,7 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 		// Normal
 		else if (words[0] == "vn") {
 			if (words.size() < 4) {
-				throw Exception("Normal components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + path.toString() + "\"!");
+				throw Exception("Normal components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + name + "\"!");
 			}
 			nrms.push_back(strToFloat(words[1]));
 			nrms.push_back(strToFloat(words[2]));
@@ -83,7 +105,7 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 		// UV
 		else if (words[0] == "vt") {
 			if (words.size() < 3) {
-				throw Exception("UV components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + path.toString() + "\"!");
+				throw Exception("UV components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + name + "\"!");
 			}
 			uvs.push_back(strToFloat(words[1]));
 			uvs.push_back(strToFloat(words[2]));
@@ -91,7 +113,7 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 		// Index
 		else if (words[0] == "f") {
 			if (words.size() < 4) {
-				throw Exception("Index components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + path.toString() + "\"!");
+				throw Exception("Index components missing at line " + sizeToStr(line_num) + " in .obj-file \"" + name + "\"!");
 			}
 // TODO: Support quads!
 			if (words.size() > 4) {
@@ -111,13 +133,12 @@ inline MeshloaderObj::MeshloaderObj(Path const& path)
 					}
 					indices_nrms.push_back(strToSize(parts[2]) - 1);
 				} else {
-					throw Exception("Invalid index \"" + words[word_id] + "\" at line " + sizeToStr(line_num) + " in .obj-file \"" + path.toString() + "\"!");
+					throw Exception("Invalid index \"" + words[word_id] + "\" at line " + sizeToStr(line_num) + " in .obj-file \"" + name + "\"!");
 				}
 			}
 		}
 
 	}
-	file.close();
 
 	// Let base class do the rest
 	readArrays(poss, nrms, uvs, indices_poss, indices_nrms, indices_uvs);
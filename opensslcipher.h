@@ -2,41 +2,61 @@
 #define HPP_OPENSSLCIPHER_H
 
 #include "cipher.h"
+#include "noncopyable.h"
 #include "assert.h"
 #include "exception.h"
 
 #include <openssl/evp.h>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 namespace Hpp
 {
 
-template< EVP_CIPHER const* (*cipfunc)(void) > class OpensslCipher : public Cipher
+// Cipher that uses OpenSSL. Contexts of OpenSSL are allocated once,
+// and reused when cipher is initialized again or when only the
+// initialization vector is changed with reset().
+template< EVP_CIPHER const* (*cipfunc)(void) > class OpensslCipher : public Cipher, public NonCopyable
 {
 
 public:
 
-	inline OpensslCipher(void) : initialized(false) { }
+	inline OpensslCipher(void) :
+	initialized(false),
+	padding(false),
+	enc_cipher(NULL),
+	dec_cipher(NULL),
+	enc_fed(0),
+	dec_fed(0)
+	{
+	}
 
 	inline OpensslCipher(ByteV const& key, ByteV const& iv, bool padding) :
-	initialized(false)
+	initialized(false),
+	padding(false),
+	enc_cipher(NULL),
+	dec_cipher(NULL),
+	enc_fed(0),
+	dec_fed(0)
 	{
-		init(key, iv, padding);
+		try {
+			init(key, iv, padding);
+		}
+		catch ( ... ) {
+			freeContexts();
+			throw;
+		}
 	}
 	inline virtual ~OpensslCipher(void)
 	{
-		// For security, clean ciphers.
-		if (initialized) {
-			EVP_CIPHER_CTX_cleanup(&enc_cipher);
-			EVP_CIPHER_CTX_cleanup(&dec_cipher);
-		}
+		// For security, clean ciphers. Freeing does it.
+		freeContexts();
 	}
 
 	inline void init(ByteV const& key, ByteV const& iv, bool padding)
 	{
-		if (initialized) {
-			EVP_CIPHER_CTX_cleanup(&enc_cipher);
-			EVP_CIPHER_CTX_cleanup(&dec_cipher);
-		}
+		initialized = false;
 
 		// Verify parameters
 		size_t key_size = EVP_CIPHER_key_length(cipfunc());
@@ -48,134 +68,284 @@ public:
 			throw Exception("Initialization vector has invalid size!");
 		}
 
-		// Initialize encryption cipher
-		EVP_CIPHER_CTX_init(&enc_cipher);
-		if (!EVP_EncryptInit_ex(&enc_cipher, cipfunc(), NULL, &key[0], &iv[0])) {
-			EVP_CIPHER_CTX_cleanup(&enc_cipher);
-			throw Exception("Unable to initialize OpenSSL cipher!");
+		// Contexts are created only once
+		if (!enc_cipher) {
+			enc_cipher = EVP_CIPHER_CTX_new();
+		}
+		if (!dec_cipher) {
+			dec_cipher = EVP_CIPHER_CTX_new();
+		}
+		if (!enc_cipher || !dec_cipher) {
+			throw Exception("Unable to create OpenSSL cipher context!");
 		}
 
-		// Initialize decryption cipher
-		EVP_CIPHER_CTX_init(&dec_cipher);
-		if (!EVP_DecryptInit_ex(&dec_cipher, cipfunc(), NULL, &key[0], &iv[0])) {
-			EVP_CIPHER_CTX_cleanup(&enc_cipher);
-			EVP_CIPHER_CTX_cleanup(&dec_cipher);
+		// Initialize encryption and decryption ciphers
+		if (!EVP_EncryptInit_ex(enc_cipher, cipfunc(), NULL, &key[0], iv.empty() ? NULL : &iv[0])) {
+			throw Exception("Unable to initialize OpenSSL cipher!");
+		}
+		if (!EVP_DecryptInit_ex(dec_cipher, cipfunc(), NULL, &key[0], iv.empty() ? NULL : &iv[0])) {
 			throw Exception("Unable to initialize OpenSSL cipher!");
 		}
 
 		// Set padding
-		EVP_CIPHER_CTX_set_padding(&enc_cipher, padding);
-		EVP_CIPHER_CTX_set_padding(&dec_cipher, padding);
+		this->padding = padding;
+		EVP_CIPHER_CTX_set_padding(enc_cipher, padding);
+		EVP_CIPHER_CTX_set_padding(dec_cipher, padding);
 
+		enc_fed = 0;
+		dec_fed = 0;
 		initialized = true;
 	}
 
+	// Starts new encryption and/or decryption with the same key but
+	// different initialization vector. This is much cheaper than
+	// init(), because key schedule does not need to be calculated.
+	inline void reset(ByteV const& iv) { resetEncryption(iv); resetDecryption(iv); }
+	inline void resetEncryption(ByteV const& iv);
+	inline void resetDecryption(ByteV const& iv);
+
+	// Encrypts/decrypts many separate messages in place. Every message
+	// has its own initialization vector and is finalized, but the same
+	// contexts are used for all of them. This suits well for streams
+	// of small messages, like video frames or network packets.
+	inline void encryptMessages(std::vector< ByteV >& messages, std::vector< ByteV > const& ivs);
+	inline void decryptMessages(std::vector< ByteV >& messages, std::vector< ByteV > const& ivs);
+
+	inline virtual size_t getBlockSize(void) const { return EVP_CIPHER_block_size(cipfunc()); }
+
 private:
 
 	// Is class initialized or not
 	bool initialized;
+	bool padding;
 
 	// Ciphers
-	EVP_CIPHER_CTX enc_cipher;
-	EVP_CIPHER_CTX dec_cipher;
+	EVP_CIPHER_CTX* enc_cipher;
+	EVP_CIPHER_CTX* dec_cipher;
+
+	// Amount of data given since initialization. These are used to find
+	// out if OpenSSL holds partial blocks, in which case its output
+	// runs ahead of its input, and data can not be processed in place.
+	uint64_t enc_fed;
+	uint64_t dec_fed;
+
+	// Copy of input, if in place processing is not possible
+	ByteV scratch;
 
 	inline virtual void doEncryption(ByteV& result, uint8_t const* data, size_t data_size)
 	{
-		if (!initialized) {
-			throw Exception("Cipher is not initialized!");
-		}
+		size_t subresult_begin = result.size();
+		result.resize(subresult_begin + getMaxResultSize(data_size));
+		size_t subresult_size = update(true, &result[subresult_begin], data, data_size);
+		result.resize(subresult_begin + subresult_size);
+	}
+
+	inline virtual void finalizeEncryption(ByteV& result)
+	{
+		size_t subresult_begin = result.size();
+		result.resize(subresult_begin + getBlockSize());
+		size_t subresult_size = finalize(true, &result[subresult_begin]);
+		result.resize(subresult_begin + subresult_size);
+	}
 
-		size_t const BLOCKSIZE = EVP_CIPHER_CTX_block_size(&enc_cipher);
+	inline virtual void doDecryption(ByteV& result, uint8_t const* data, size_t data_size)
+	{
+		size_t subresult_begin = result.size();
+		result.resize(subresult_begin + getMaxResultSize(data_size));
+		size_t subresult_size = update(false, &result[subresult_begin], data, data_size);
+		result.resize(subresult_begin + subresult_size);
+	}
 
-		// Make some space to result
-		size_t subresult_reserve = data_size + BLOCKSIZE * 3;
+	inline virtual void finalizeDecryption(ByteV& result)
+	{
 		size_t subresult_begin = result.size();
-		result.insert(result.end(), subresult_reserve, 0);
+		result.resize(subresult_begin + getBlockSize());
+		size_t subresult_size = finalize(false, &result[subresult_begin]);
+		result.resize(subresult_begin + subresult_size);
+	}
 
-		// Encrypt chunk
-		int subresult_size;
-		if (!EVP_EncryptUpdate(&enc_cipher, &result[subresult_begin], &subresult_size, data, data_size)) {
-			throw Exception("Unable to encrypt with OpenSSL cipher!");
+	inline virtual size_t doEncryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
+	{
+		size_t result_size = update(true, result, data, data_size);
+		if (finalize) {
+			result_size += this->finalize(true, result + result_size);
 		}
-		HppAssert(subresult_size <= (int)subresult_reserve, "Result overflow!");
-
-		// Resize result to correct size
-		result.erase(result.begin() + subresult_begin + subresult_size, result.end());
+		return result_size;
 	}
 
-	inline virtual void finalizeEncryption(ByteV& result)
+	inline virtual size_t doDecryptionInto(uint8_t* result, uint8_t const* data, size_t data_size, bool finalize)
 	{
-		if (!initialized) {
-			throw Exception("Cipher is not initialized!");
+		size_t result_size = update(false, result, data, data_size);
+		if (finalize) {
+			result_size += this->finalize(false, result + result_size);
 		}
+		return result_size;
+	}
 
-		size_t const BLOCKSIZE = EVP_CIPHER_CTX_block_size(&enc_cipher);
+	inline size_t update(bool encryption, uint8_t* result, uint8_t const* data, size_t data_size);
+	inline size_t finalize(bool encryption, uint8_t* result);
 
-		// Make some space to result
-		size_t subresult_reserve = BLOCKSIZE * 3;
-		size_t subresult_begin = result.size();
-		result.insert(result.end(), subresult_reserve, 0);
+	inline bool canWorkInPlace(bool encryption) const;
 
-		// Finalize encryption
-		int subresult_size;
-		if (!EVP_EncryptFinal_ex(&enc_cipher, &result[subresult_begin], &subresult_size)) {
-			throw Exception("Unable to finalize encryption with OpenSSL cipher!");
-		}
-		HppAssert(subresult_size <= (int)subresult_reserve, "Result overflow!");
+	inline void freeContexts(void);
+
+};
+
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline void OpensslCipher< cipfunc >::resetEncryption(ByteV const& iv)
+{
+	if (!initialized) {
+		throw Exception("Cipher is not initialized!");
+	}
+	if (iv.size() != size_t(EVP_CIPHER_iv_length(cipfunc()))) {
+		throw Exception("Initialization vector has invalid size!");
+	}
+	if (!EVP_EncryptInit_ex(enc_cipher, NULL, NULL, NULL, iv.empty() ? NULL : &iv[0])) {
+		throw Exception("Unable to reset OpenSSL cipher!");
+	}
+	EVP_CIPHER_CTX_set_padding(enc_cipher, padding);
+	enc_fed = 0;
+}
 
-		// Resize result to correct size
-		result.erase(result.begin() + subresult_begin + subresult_size, result.end());
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline void OpensslCipher< cipfunc >::resetDecryption(ByteV const& iv)
+{
+	if (!initialized) {
+		throw Exception("Cipher is not initialized!");
 	}
+	if (iv.size() != size_t(EVP_CIPHER_iv_length(cipfunc()))) {
+		throw Exception("Initialization vector has invalid size!");
+	}
+	if (!EVP_DecryptInit_ex(dec_cipher, NULL, NULL, NULL, iv.empty() ? NULL : &iv[0])) {
+		throw Exception("Unable to reset OpenSSL cipher!");
+	}
+	EVP_CIPHER_CTX_set_padding(dec_cipher, padding);
+	dec_fed = 0;
+}
 
-	inline virtual void doDecryption(ByteV& result, uint8_t const* data, size_t data_size)
-	{
-		if (!initialized) {
-			throw Exception("Cipher is not initialized!");
-		}
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline void OpensslCipher< cipfunc >::encryptMessages(std::vector< ByteV >& messages, std::vector< ByteV > const& ivs)
+{
+	if (messages.size() != ivs.size()) {
+		throw Exception("Every message needs an initialization vector!");
+	}
+	for (size_t message_id = 0; message_id < messages.size(); ++ message_id) {
+		resetEncryption(ivs[message_id]);
+		encryptInPlace(messages[message_id], true);
+	}
+}
 
-		size_t const BLOCKSIZE = EVP_CIPHER_CTX_block_size(&enc_cipher);
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline void OpensslCipher< cipfunc >::decryptMessages(std::vector< ByteV >& messages, std::vector< ByteV > const& ivs)
+{
+	if (messages.size() != ivs.size()) {
+		throw Exception("Every message needs an initialization vector!");
+	}
+	for (size_t message_id = 0; message_id < messages.size(); ++ message_id) {
+		resetDecryption(ivs[message_id]);
+		decryptInPlace(messages[message_id], true);
+	}
+}
 
-		// Make some space to result
-		size_t subresult_reserve = data_size + BLOCKSIZE * 3;
-		size_t subresult_begin = result.size();
-		result.insert(result.end(), subresult_reserve, 0);
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline size_t OpensslCipher< cipfunc >::update(bool encryption, uint8_t* result, uint8_t const* data, size_t data_size)
+{
+	if (!initialized) {
+		throw Exception("Cipher is not initialized!");
+	}
 
-		// Decrypt chunk
+	if (result == data && data_size > 0 && !canWorkInPlace(encryption)) {
+		scratch.assign(data, data + data_size);
+		data = &scratch[0];
+	}
+
+	// OpenSSL takes sizes as integers, so
+	// huge buffers are given in parts.
+	size_t const MAX_PART = 1 << 30;
+	size_t result_size = 0;
+	size_t data_left = data_size;
+	while (data_left > 0) {
+		size_t part = std::min(data_left, MAX_PART);
 		int subresult_size;
-		if (!EVP_DecryptUpdate(&dec_cipher, &result[subresult_begin], &subresult_size, data, data_size)) {
-			throw Exception("Unable to decrypt with OpenSSL cipher!");
+		if (encryption) {
+			if (!EVP_EncryptUpdate(enc_cipher, result + result_size, &subresult_size, data, part)) {
+				throw Exception("Unable to encrypt with OpenSSL cipher!");
+			}
+		} else {
+			if (!EVP_DecryptUpdate(dec_cipher, result + result_size, &subresult_size, data, part)) {
+				throw Exception("Unable to decrypt with OpenSSL cipher!");
+			}
 		}
-		HppAssert(subresult_size <= (int)subresult_reserve, "Result overflow!");
-
-		// Resize result to correct size
-		result.erase(result.begin() + subresult_begin + subresult_size, result.end());
+		HppAssert(subresult_size >= 0 && size_t(subresult_size) <= part + getBlockSize(), "Result overflow!");
+		result_size += subresult_size;
+		data += part;
+		data_left -= part;
 	}
 
-	inline virtual void finalizeDecryption(ByteV& result)
-	{
-		if (!initialized) {
-			throw Exception("Cipher is not initialized!");
-		}
+	if (encryption) {
+		enc_fed += data_size;
+	} else {
+		dec_fed += data_size;
+	}
 
-		size_t const BLOCKSIZE = EVP_CIPHER_CTX_block_size(&dec_cipher);
+	return result_size;
+}
 
-		// Make some space to result
-		size_t subresult_reserve = BLOCKSIZE * 3;
-		size_t subresult_begin = result.size();
-		result.insert(result.end(), subresult_reserve, 0);
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline size_t OpensslCipher< cipfunc >::finalize(bool encryption, uint8_t* result)
+{
+	if (!initialized) {
+		throw Exception("Cipher is not initialized!");
+	}
 
-		// Finalize decryption
-		int subresult_size;
-		if (!EVP_DecryptFinal_ex(&dec_cipher, &result[subresult_begin], &subresult_size)) {
+	int result_size;
+	if (encryption) {
+		if (!EVP_EncryptFinal_ex(enc_cipher, result, &result_size)) {
+			throw Exception("Unable to finalize encryption with OpenSSL cipher!");
+		}
+		enc_fed = 0;
+	} else {
+		if (!EVP_DecryptFinal_ex(dec_cipher, result, &result_size)) {
 			throw Exception("Unable to finalize decryption with OpenSSL cipher!");
 		}
-		HppAssert(subresult_size <= (int)subresult_reserve, "Result overflow!");
+		dec_fed = 0;
+	}
+	HppAssert(result_size >= 0 && size_t(result_size) <= getBlockSize(), "Result overflow!");
 
-		// Resize result to correct size
-		result.erase(result.begin() + subresult_begin + subresult_size, result.end());
+	return result_size;
+}
+
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline bool OpensslCipher< cipfunc >::canWorkInPlace(bool encryption) const
+{
+	size_t const BLOCKSIZE = getBlockSize();
+	if (BLOCKSIZE == 1) {
+		return true;
 	}
+	if (encryption) {
+		return enc_fed % BLOCKSIZE == 0;
+	}
+	// With padding, the last full block is held back
+	// until more data comes or decryption is finalized.
+	if (padding) {
+		return dec_fed == 0;
+	}
+	return dec_fed % BLOCKSIZE == 0;
+}
 
-};
+template< EVP_CIPHER const* (*cipfunc)(void) >
+inline void OpensslCipher< cipfunc >::freeContexts(void)
+{
+	if (enc_cipher) {
+		EVP_CIPHER_CTX_free(enc_cipher);
+		enc_cipher = NULL;
+	}
+	if (dec_cipher) {
+		EVP_CIPHER_CTX_free(dec_cipher);
+		dec_cipher = NULL;
+	}
+	initialized = false;
+}
 
 }
 
@@ -2,8 +2,10 @@
 #define HPP_OSTREAMPIPE_H
 
 #include "streambuf.h"
+#include "bytev.h"
 
 #include <ostream>
+#include <cstring>
 
 namespace Hpp
 {
@@ -26,55 +28,82 @@ protected:
 	// for example when std::endl is put to stream.
 	inline virtual int sync(void);
 
+	// Writes many characters at once
+	inline virtual std::streamsize xsputn(char const* s, std::streamsize count);
+
 private:
 
 	// For EOF detection
 	typedef std::char_traits< char > Traits;
 
-	// Work in buffer mode. It is also possible to work without buffer.
-	static size_t const BUF_SIZE = 64;
-	char buf[BUF_SIZE];
+	// Characters are written straight to a chunk. When the chunk is
+	// mostly full, it is given to Streambuf as it is, without copying.
+	static size_t const CHUNK_SIZE = 64 * 1024;
+	ByteV chunk;
 
 	Streambuf* sbuf;
 
-	// In this function, the characters are parsed.
-	inline void putChars(char const* begin, char const* end);
+	// Gives written characters to Streambuf and starts a new chunk
+	inline void pushChunk(void);
 
 };
 
 inline OStreampipe::OStreampipe(Streambuf* sbuf) :
 sbuf(sbuf)
 {
-	setp(buf, buf + BUF_SIZE);
+	setp(NULL, NULL);
 }
 
 inline int OStreampipe::overflow(int c)
 {
-	// Handle output
-	putChars(pbase(), pptr());
+	pushChunk();
 	if (c != Traits::eof()) {
-		char c2 = c;
-		// Handle the one character that didn't fit to buffer
-		putChars(&c2, &c2 + 1);
+		*pptr() = c;
+		pbump(1);
 	}
-	// This tells that buffer is empty again
-	setp(buf, buf + BUF_SIZE);
-	// I'm not sure about this return value!
-	return 0;
+	return Traits::not_eof(c);
 }
 
 inline int OStreampipe::sync(void)
 {
-	// Handle output
-	putChars(pbase(), pptr());
-	// This tells that buffer is empty again
-	setp(buf, buf + BUF_SIZE);
+	// Only chunks that are mostly full are given as they are.
+	// Small amounts are copied, so they share chunks in Streambuf.
+	size_t filled = pptr() - pbase();
+	if (filled >= CHUNK_SIZE / 2) {
+		pushChunk();
+	} else if (filled > 0) {
+		sbuf->pushData(reinterpret_cast< uint8_t const* >(pbase()), reinterpret_cast< uint8_t const* >(pptr()));
+		setp(pbase(), epptr());
+	}
 	return 0;
 }
 
-inline void OStreampipe::putChars(char const* begin, char const* end)
+inline std::streamsize OStreampipe::xsputn(char const* s, std::streamsize count)
+{
+	if (count > epptr() - pptr()) {
+		// Big writes are pushed right away
+		if (size_t(count) >= CHUNK_SIZE) {
+			sync();
+			sbuf->pushData(reinterpret_cast< uint8_t const* >(s), reinterpret_cast< uint8_t const* >(s + count));
+			return count;
+		}
+		pushChunk();
+	}
+	memcpy(pptr(), s, count);
+	pbump(count);
+	return count;
+}
+
+inline void OStreampipe::pushChunk(void)
 {
-	sbuf->pushData((uint8_t const*)begin, (uint8_t const*)end);
+	if (pptr() != pbase()) {
+		chunk.resize(pptr() - pbase());
+		sbuf->pushChunk(chunk);
+	}
+	// Chunk that comes back may be a used one
+	chunk.resize(CHUNK_SIZE);
+	char* begin = reinterpret_cast< char* >(&chunk[0]);
+	setp(begin, begin + chunk.size());
 }
 
 }
@@ -8,6 +8,7 @@
 #include "time.h"
 #include "cast.h"
 #include "types.h"
+#include "mappedfile.h"
 
 #include <string>
 #include <vector>
@@ -110,12 +111,19 @@ public:
 	inline void forceToAbsolute(void);
 
 	// Reads pointed file as bytes/string. If target
-	// is not file, then exception is thrown.
+	// is not file, then exception is thrown. File may be
+	// modified meanwhile. To avoid copying, use mapFile().
 	inline void readBytes(ByteV& result) const;
 	inline void readString(std::string& result) const;
 	inline ByteV readBytes(void) const { ByteV result; readBytes(result); return result; }
 	inline std::string readString(void) const { std::string result; readString(result); return result; }
 
+	// Maps pointed file to memory for reading. Bytes are
+	// not copied. If target is not file, then exception
+	// is thrown. File must not be truncated while it is
+	// mapped. See MappedFile for more information.
+	inline void mapFile(MappedFile& result, MappedFile::Access access = MappedFile::SEQUENTIAL) const;
+
 	inline void writeBytes(ByteV const& bytes) const;
 	inline void writeString(std::string const& str) const;
 
@@ -691,19 +699,14 @@ inline void Path::readBytes(ByteV& result) const
 	file.seekg(0, std::ios::end);
 	size_t file_size = file.tellg();
 	file.seekg(0, std::ios::beg);
-	// Read data
-	result.clear();
-	result.reserve(file_size);
-	size_t const READBUF_SIZE = 256 * 1024;
-	uint8_t* readbuf = new uint8_t[READBUF_SIZE];
-	for (size_t offset = 0; offset < file_size; offset += READBUF_SIZE) {
-		size_t read_amount = std::min(file_size - offset, READBUF_SIZE);
-		file.read((char*)readbuf, read_amount);
-		result.insert(result.end(), readbuf, readbuf + read_amount);
-	}
-	delete[] readbuf;
+	// Read data straight into result. If file is truncated
+	// meanwhile, then only the remaining bytes are got.
+	result.resize(file_size);
+	if (file_size > 0) {
+		file.read(reinterpret_cast< char* >(&result[0]), file_size);
+		result.resize(file.gcount());
+	}
 	file.close();
-	HppAssert(result.size() == file_size, "Not all bytes could be read!");
 }
 
 inline void Path::readString(std::string& result) const
@@ -726,19 +729,28 @@ inline void Path::readString(std::string& result) const
 	file.seekg(0, std::ios::end);
 	size_t file_size = file.tellg();
 	file.seekg(0, std::ios::beg);
-	// Read data
-	result.clear();
-	result.reserve(file_size);
-	size_t const READBUF_SIZE = 256 * 1024;
-	uint8_t* readbuf = new uint8_t[READBUF_SIZE];
-	for (size_t offset = 0; offset < file_size; offset += READBUF_SIZE) {
-		size_t read_amount = std::min(file_size - offset, READBUF_SIZE);
-		file.read((char*)readbuf, read_amount);
-		result.insert(result.end(), readbuf, readbuf + read_amount);
-	}
-	delete[] readbuf;
+	// Read data straight into result. If file is truncated
+	// meanwhile, then only the remaining bytes are got.
+	result.resize(file_size);
+	if (file_size > 0) {
+		file.read(&result[0], file_size);
+		result.resize(file.gcount());
+	}
 	file.close();
-	HppAssert(result.size() == file_size, "Not all bytes could be read!");
+}
+
+inline void Path::mapFile(MappedFile& result, MappedFile::Access access) const
+{
+	if (isUnknown()) {
+		throw Exception("Unable to map unknown path!");
+	}
+	if (!exists()) {
+		throw Exception("Unable to map file! Reason: \"" + toString() + "\" does not exist!");
+	}
+	if (!isFile()) {
+		throw Exception("Unable to map file! Reason: \"" + toString() + "\" is not file!");
+	}
+	result.open(toString(), access);
 }
 
 inline void Path::writeBytes(ByteV const& bytes) const
@@ -751,7 +763,9 @@ inline void Path::writeBytes(ByteV const& bytes) const
 	if (!file.is_open()) {
 		throw Exception("Unable to open file \"" + toString() + "\" for writing!");
 	}
-	file.write((char const*)&bytes[0], bytes.size());
+	if (!bytes.empty()) {
+		file.write((char const*)&bytes[0], bytes.size());
+	}
 	file.close();
 }
 
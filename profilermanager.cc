@@ -33,6 +33,12 @@ void Profilermanager::printReport(void)
 	}
 }
 
+Profilermanager::Totals Profilermanager::getTotals(void)
+{
+	Lock lock(instance.mutex);
+	return instance.pdata;
+}
+
 void Profilermanager::reset(void)
 {
 	Lock lock(instance.mutex);
@@ -25,9 +25,15 @@ class Profilermanager
 
 public:
 
+	// Total time consumed by each task
+	typedef std::map< std::string, Delay > Totals;
+
 	// Prints all tasks and time consuming of them
 	static void printReport(void);
 
+	// Returns copy of time consumed by each task so far
+	static Totals getTotals(void);
+
 	// Resets tasks
 	static void reset(void);
 
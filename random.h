@@ -9,6 +9,7 @@
 #include "real.h"
 #include "bytev.h"
 #include "unicodestring.h"
+#include "randomengine.h"
 
 #include <cstdlib>
 #include <fstream>
@@ -17,6 +18,12 @@
 namespace Hpp
 {
 
+// Functions below, except randomSecureData(), use the engine of calling
+// thread, so they can be called from many threads without locking.
+
+// Seeds engines of threads. See RandomEngine::seedThreadEngines().
+inline void seedRandom(uint64_t seed) { RandomEngine::seedThreadEngines(seed); }
+
 // Returns a value in range [min, max)
 inline Real random(Real min, Real max);
 
@@ -42,37 +49,19 @@ inline UnicodeString randomString(size_t size, UnicodeString const& chars = "abc
 inline Real random(Real min, Real max)
 {
 	HppAssert(max >= min, "Maximum cannot be smaller than minimum");
-	return min + ((max - min) * (Real)rand() / (Real)RAND_MAX);
+	return min + (max - min) * Real(RandomEngine::getThreadEngine().nextDouble());
 }
 
 inline ssize_t randomInt(ssize_t min, ssize_t max)
 {
-	ssize_t range = max - min + 1;
-	return min + (rand() % range);
+	return RandomEngine::getThreadEngine().nextInt(min, max);
 }
 
 inline size_t randomNBitInt(size_t n)
 {
-	size_t result;
 	HppAssert(n > 1, "n must be at least 2!");
-
-	size_t rand_max_bits;
-	if (RAND_MAX == 0x7fffffff) {
-		rand_max_bits = 31;
-	} else {
-		rand_max_bits = 15;
-	}
-
-	size_t bits_left = n;
-	result = 0;
-	while (bits_left > 0) {
-		size_t bits_get = std::min(rand_max_bits, bits_left);
-		bits_left -= bits_get;
-		result <<= bits_get;
-		result += rand() % (1 << bits_get);
-	}
-
-	return result;
+	HppAssert(n <= sizeof(size_t) * 8, "n is too big!");
+	return RandomEngine::getThreadEngine().next() >> (64 - n);
 }
 
 inline Angle randomAngle(void)
@@ -123,11 +112,12 @@ inline Vector3 randomVector3(Real max_radius, Real min_radius)
 
 inline Color randomColor(bool randomize_alpha)
 {
+	RandomEngine& engine = RandomEngine::getThreadEngine();
 	Color result;
 	if (randomize_alpha) {
-		result = Color(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+		result = Color(engine.nextFloat(), engine.nextFloat(), engine.nextFloat(), engine.nextFloat());
 	} else {
-		result = Color(rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX));
+		result = Color(engine.nextFloat(), engine.nextFloat(), engine.nextFloat());
 	}
 	return result;
 }
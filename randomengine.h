@@ -0,0 +1,308 @@
+#ifndef HPP_RANDOMENGINE_H
+#define HPP_RANDOMENGINE_H
+
+#include "mutex.h"
+#include "lock.h"
+#include "assert.h"
+
+#include <new>
+#include <stdint.h>
+
+// Storage that every thread has its own copy of. Only plain data can be
+// stored in it, and it is not destroyed when thread ends.
+#ifdef _MSC_VER
+#define HPP_THREAD_LOCAL __declspec(thread)
+#else
+#define HPP_THREAD_LOCAL __thread
+#endif
+
+namespace Hpp
+{
+
+// Fast pseudorandom number generator, xoshiro256**. It has 256 bits of
+// state and passes all known statistical tests, but it is NOT suitable
+// for cryptography. Use randomSecureData() for that.
+//
+// Every thread has its own engine, returned by getThreadEngine(), so
+// there is no locking when numbers are generated. Engines of threads
+// use different streams of the same seed, so for a fixed seed the
+// numbers of every thread are the same in every run, as long as threads
+// use their engines for the first time in the same order.
+class RandomEngine
+{
+
+public:
+
+	inline RandomEngine(void);
+	inline explicit RandomEngine(uint64_t seed, uint64_t stream = 0);
+
+	// Different streams of the same seed are independent of each other
+	inline void seed(uint64_t seed, uint64_t stream = 0);
+
+	// Returns engine of calling thread
+	inline static RandomEngine& getThreadEngine(void);
+
+	// Sets seed that engines of threads are created from. Engine of
+	// calling thread is seeded again, and threads that use their
+	// engines for the first time after this get the next streams.
+	// Threads that already have engines keep them.
+	inline static void seedThreadEngines(uint64_t seed);
+
+	// Returns 64 random bits
+	inline uint64_t next(void);
+
+	// Returns a value in range [0, range). Every value has exactly the
+	// same probability. If range is zero, all 64 bits are returned.
+	inline uint64_t nextBelow(uint64_t range);
+
+	// Returns a value in range [min, max]
+	inline int64_t nextInt(int64_t min, int64_t max);
+
+	// Return a value in range [0, 1)
+	inline double nextDouble(void) { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+	inline float nextFloat(void) { return (next() >> 40) * (1.0f / 16777216.0f); }
+
+	// Fill arrays. Floats are in range [min, max) and integers in
+	// range [min, max]. Two floats are made from every 64 bits, and
+	// state is kept in registers during the whole loop.
+	inline void fill(uint8_t* result, size_t size);
+	inline void fill(float* result, size_t size, float min, float max);
+	inline void fill(double* result, size_t size, double min, double max);
+	inline void fill(int32_t* result, size_t size, int32_t min, int32_t max);
+
+private:
+
+	static uint64_t const DEFAULT_SEED = 5489;
+
+	// If size of this changes, then the buffer in getThreadEngine() must be changed too
+	uint64_t state[4];
+
+	// Seed and next free stream of engines of threads
+	struct Streams
+	{
+		Mutex mutex;
+		uint64_t seed;
+		uint64_t next_stream;
+		inline Streams(void) : seed(DEFAULT_SEED), next_stream(0) { }
+	};
+
+	inline static Streams& getStreams(void);
+
+	inline static uint64_t rotl(uint64_t x, unsigned int k) { return (x << k) | (x >> (64 - k)); }
+
+	inline static uint64_t splitMix64(uint64_t& x);
+
+	// Generator step with state given as parameters
+	inline static uint64_t step(uint64_t& s0, uint64_t& s1, uint64_t& s2, uint64_t& s3);
+
+};
+
+inline RandomEngine::RandomEngine(void)
+{
+	seed(DEFAULT_SEED);
+}
+
+inline RandomEngine::RandomEngine(uint64_t seed, uint64_t stream)
+{
+	this->seed(seed, stream);
+}
+
+inline void RandomEngine::seed(uint64_t seed, uint64_t stream)
+{
+	// State is filled from SplitMix64, like the authors of xoshiro
+	// recommend. Stream is mixed separately, so that nearby seeds
+	// and streams do not give nearby states.
+	uint64_t x = seed;
+	x ^= splitMix64(stream);
+	for (size_t i = 0; i < 4; ++ i) {
+		state[i] = splitMix64(x);
+	}
+	// State must not be all zeros
+	if (!state[0] && !state[1] && !state[2] && !state[3]) {
+		state[0] = 1;
+	}
+}
+
+inline RandomEngine& RandomEngine::getThreadEngine(void)
+{
+	// Thread local storage must be plain data, so engine
+	// is constructed to a buffer when it is used first time.
+	static HPP_THREAD_LOCAL uint64_t engine_buf[4];
+	static HPP_THREAD_LOCAL bool engine_created = false;
+	if (!engine_created) {
+		Streams& streams = getStreams();
+		Lock lock(streams.mutex);
+		new (engine_buf) RandomEngine(streams.seed, streams.next_stream ++);
+		engine_created = true;
+	}
+	return *reinterpret_cast< RandomEngine* >(engine_buf);
+}
+
+inline void RandomEngine::seedThreadEngines(uint64_t seed)
+{
+	RandomEngine& engine = getThreadEngine();
+	Streams& streams = getStreams();
+	Lock lock(streams.mutex);
+	streams.seed = seed;
+	streams.next_stream = 1;
+	engine.seed(seed, 0);
+}
+
+inline uint64_t RandomEngine::next(void)
+{
+	return step(state[0], state[1], state[2], state[3]);
+}
+
+inline uint64_t RandomEngine::nextBelow(uint64_t range)
+{
+	if (range == 0) {
+		return next();
+	}
+
+	// Small ranges use multiplication instead of division, like
+	// described by Daniel Lemire. Values that would make result
+	// biased are thrown away. Division is needed only rarely.
+	if (range <= 0xffffffffU) {
+		uint32_t range32 = range;
+		uint64_t m = uint64_t(uint32_t(next() >> 32)) * range32;
+		uint32_t low = uint32_t(m);
+		if (low < range32) {
+			uint32_t threshold = uint32_t(-range32) % range32;
+			while (low < threshold) {
+				m = uint64_t(uint32_t(next() >> 32)) * range32;
+				low = uint32_t(m);
+			}
+		}
+		return m >> 32;
+	}
+
+	// Big ranges take enough bits, and throw away values that are
+	// too big. At least half of values are accepted.
+	uint64_t mask = range - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	mask |= mask >> 8;
+	mask |= mask >> 16;
+	mask |= mask >> 32;
+	uint64_t result;
+	do {
+		result = next() & mask;
+	} while (result >= range);
+	return result;
+}
+
+inline int64_t RandomEngine::nextInt(int64_t min, int64_t max)
+{
+	HppAssert(max >= min, "Maximum cannot be smaller than minimum");
+	// Range of full 64 bits wraps to zero, which is what nextBelow() expects
+	uint64_t range = uint64_t(max) - uint64_t(min) + 1;
+	return int64_t(uint64_t(min) + nextBelow(range));
+}
+
+inline void RandomEngine::fill(uint8_t* result, size_t size)
+{
+	uint64_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+	while (size >= 8) {
+		uint64_t r = step(s0, s1, s2, s3);
+		for (size_t byte = 0; byte < 8; ++ byte) {
+			result[byte] = r >> (byte * 8);
+		}
+		result += 8;
+		size -= 8;
+	}
+	if (size > 0) {
+		uint64_t r = step(s0, s1, s2, s3);
+		for (size_t byte = 0; byte < size; ++ byte) {
+			result[byte] = r >> (byte * 8);
+		}
+	}
+	state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+}
+
+inline void RandomEngine::fill(float* result, size_t size, float min, float max)
+{
+	HppAssert(max >= min, "Maximum cannot be smaller than minimum");
+	float const m = (max - min) * (1.0f / 16777216.0f);
+	uint64_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+	while (size >= 2) {
+		uint64_t r = step(s0, s1, s2, s3);
+		result[0] = min + float(uint32_t(r >> 40)) * m;
+		result[1] = min + float(uint32_t(r >> 16) & 0xffffff) * m;
+		result += 2;
+		size -= 2;
+	}
+	if (size > 0) {
+		uint64_t r = step(s0, s1, s2, s3);
+		result[0] = min + float(uint32_t(r >> 40)) * m;
+	}
+	state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+}
+
+inline void RandomEngine::fill(double* result, size_t size, double min, double max)
+{
+	HppAssert(max >= min, "Maximum cannot be smaller than minimum");
+	double const m = (max - min) * (1.0 / 9007199254740992.0);
+	uint64_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+	for (size_t i = 0; i < size; ++ i) {
+		result[i] = min + double(step(s0, s1, s2, s3) >> 11) * m;
+	}
+	state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+}
+
+inline void RandomEngine::fill(int32_t* result, size_t size, int32_t min, int32_t max)
+{
+	HppAssert(max >= min, "Maximum cannot be smaller than minimum");
+	uint64_t range = uint64_t(int64_t(max) - int64_t(min)) + 1;
+	uint64_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+	if (range > 0xffffffffU) {
+		// Full range of 32 bits, so there is no bias
+		for (size_t i = 0; i < size; ++ i) {
+			result[i] = int32_t(uint32_t(step(s0, s1, s2, s3) >> 32));
+		}
+	} else {
+		// Same method as in nextBelow()
+		uint32_t range32 = range;
+		uint32_t threshold = uint32_t(-range32) % range32;
+		for (size_t i = 0; i < size; ++ i) {
+			uint64_t m;
+			do {
+				m = uint64_t(uint32_t(step(s0, s1, s2, s3) >> 32)) * range32;
+			} while (uint32_t(m) < threshold);
+			result[i] = int32_t(int64_t(min) + int64_t(m >> 32));
+		}
+	}
+	state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+}
+
+inline RandomEngine::Streams& RandomEngine::getStreams(void)
+{
+	static Streams streams;
+	return streams;
+}
+
+inline uint64_t RandomEngine::splitMix64(uint64_t& x)
+{
+	x += (uint64_t(0x9e3779b9U) << 32) | 0x7f4a7c15U;
+	uint64_t z = x;
+	z = (z ^ (z >> 30)) * ((uint64_t(0xbf58476dU) << 32) | 0x1ce4e5b9U);
+	z = (z ^ (z >> 27)) * ((uint64_t(0x94d049bbU) << 32) | 0x133111ebU);
+	return z ^ (z >> 31);
+}
+
+inline uint64_t RandomEngine::step(uint64_t& s0, uint64_t& s1, uint64_t& s2, uint64_t& s3)
+{
+	uint64_t result = rotl(s1 * 5, 7) * 9;
+	uint64_t t = s1 << 17;
+	s2 ^= s0;
+	s3 ^= s1;
+	s1 ^= s2;
+	s0 ^= s3;
+	s2 ^= t;
+	s3 = rotl(s3, 45);
+	return result;
+}
+
+}
+
+#endif
@@ -4,13 +4,15 @@
 #include "vector3.h"
 #include "serialize.h"
 #include "path.h"
+#include "mappedfile.h"
+#include "byteviewreaderbuf.h"
 #include "exception.h"
 #include "vertexgroupinfluences.h"
 #include "rawmaterial.h"
 #include "skeleton.h"
 #include "types.h"
 
-#include <fstream>
+#include <istream>
 #include <cstring>
 #include <map>
 #include <vector>
@@ -75,6 +77,7 @@ public:
 	inline Rawmesh(void);
 	inline Rawmesh(Path const& p);
 	inline Rawmesh(std::istream& strm);
+	inline Rawmesh(ConstByteView data);
 
 	// Read data which is in specific format
 	inline void readVersion100(std::istream& strm);
@@ -103,14 +106,11 @@ inline Rawmesh::Rawmesh(void)
 
 inline Rawmesh::Rawmesh(Path const& p)
 {
-	std::ifstream file(p.toString().c_str(), std::ios_base::binary);
-	if (!file.is_open()) {
-		throw Exception("Unable to open file \"" + p.toString() + "\"!");
-	}
-
-	detectVersionAndRead(file);
-
-	file.close();
+	// File is read in place from memory map
+	MappedFile file;
+	p.mapFile(file, MappedFile::SEQUENTIAL);
+	ByteViewReaderBuf strm(file.getView());
+	detectVersionAndRead(strm);
 }
 
 inline Rawmesh::Rawmesh(std::istream& strm)
@@ -118,6 +118,12 @@ inline Rawmesh::Rawmesh(std::istream& strm)
 	detectVersionAndRead(strm);
 }
 
+inline Rawmesh::Rawmesh(ConstByteView data)
+{
+	ByteViewReaderBuf strm(data);
+	detectVersionAndRead(strm);
+}
+
 inline void Rawmesh::readVersion100(std::istream& strm)
 {
 	// Clear possible old data
@@ -179,9 +185,7 @@ inline void Rawmesh::readVersion100(std::istream& strm)
 			while (new_submesh.tris.size() < tris_size) {
 				Tri new_tri;
 				// Vertices
-				new_tri.vrts[0] = deserializeUInt32(strm, false);
-				new_tri.vrts[1] = deserializeUInt32(strm, false);
-				new_tri.vrts[2] = deserializeUInt32(strm, false);
+				deserializeArray(new_tri.vrts, 3, strm, false);
 				if (new_tri.vrts[0] >= vrts.size() ||
 				    new_tri.vrts[1] >= vrts.size() ||
 				    new_tri.vrts[2] >= vrts.size()) {
@@ -194,10 +198,9 @@ inline void Rawmesh::readVersion100(std::istream& strm)
 					FaceLayer new_layer;
 					uint8_t uvcomps = new_submesh.uvcompcounts[new_tri.layers.size()];
 					for (uint8_t vrts_id = 0; vrts_id < 3; vrts_id ++) {
-						std::vector< float > uv;
-						uv.reserve(uvcomps);
-						while (uv.size() < uvcomps) {
-							uv.push_back(deserializeFloat(strm));
+						std::vector< float > uv(uvcomps);
+						if (uvcomps > 0) {
+							deserializeArray(&uv[0], uvcomps, strm);
 						}
 						new_layer.uvs.push_back(uv);
 					}
@@ -222,10 +225,7 @@ inline void Rawmesh::readVersion100(std::istream& strm)
 			while (new_submesh.quads.size() < quads_size) {
 				Quad new_quad;
 				// Vertices
-				new_quad.vrts[0] = deserializeUInt32(strm, false);
-				new_quad.vrts[1] = deserializeUInt32(strm, false);
-				new_quad.vrts[2] = deserializeUInt32(strm, false);
-				new_quad.vrts[3] = deserializeUInt32(strm, false);
+				deserializeArray(new_quad.vrts, 4, strm, false);
 				if (new_quad.vrts[0] >= vrts.size() ||
 				    new_quad.vrts[1] >= vrts.size() ||
 				    new_quad.vrts[2] >= vrts.size() ||
@@ -239,10 +239,9 @@ inline void Rawmesh::readVersion100(std::istream& strm)
 					FaceLayer new_layer;
 					uint8_t uvcomps = new_submesh.uvcompcounts[new_quad.layers.size()];
 					for (uint8_t vrts_id = 0; vrts_id < 4; vrts_id ++) {
-						std::vector< float > uv;
-						uv.reserve(uvcomps);
-						while (uv.size() < uvcomps) {
-							uv.push_back(deserializeFloat(strm));
+						std::vector< float > uv(uvcomps);
+						if (uvcomps > 0) {
+							deserializeArray(&uv[0], uvcomps, strm);
 						}
 						new_layer.uvs.push_back(uv);
 					}
@@ -5,10 +5,15 @@
 
 #include <string.h>
 #include <cstdlib>
+#include <algorithm>
 
 namespace Hpp
 {
 
+// Ring buffer of items that can be copied with memcpy. Capacity is always
+// a power of two, so positions wrap around with a mask. Buffered items are
+// in at most two contiguous spans, so they can be copied in bulk or given
+// straight to system calls instead of being handled one by one.
 template< typename T >
 class RBuf
 {
@@ -16,24 +21,46 @@ class RBuf
 public:
 
 	inline RBuf(void) :
+	buf(NULL),
 	res(0),
+	mask(0),
+	first(0),
 	items(0)
 	{
 	}
 
+	inline RBuf(RBuf< T > const& rbuf) :
+	buf(NULL),
+	res(0),
+	mask(0),
+	first(0),
+	items(0)
+	{
+		reserve(rbuf.items);
+		rbuf.copyOut(buf, 0, rbuf.items);
+		items = rbuf.items;
+	}
+
+	inline RBuf< T >& operator=(RBuf< T > const& rbuf)
+	{
+		RBuf< T > copy(rbuf);
+		swap(copy);
+		return *this;
+	}
+
 	inline ~RBuf(void)
 	{
-		if (res > 0) {
-			delete[] buf;
-		}
+		delete[] buf;
 	}
 
+	// Removes all items and releases memory
 	inline void clear(void)
 	{
-		if (res > 0) {
-			delete[] buf;
-		}
+		delete[] buf;
+		buf = NULL;
 		res = 0;
+		mask = 0;
+		first = 0;
 		items = 0;
 	}
 
@@ -47,6 +74,33 @@ public:
 		return items;
 	}
 
+	inline size_t capacity(void) const
+	{
+		return res;
+	}
+
+	// Makes room for at least given amount of items
+	inline void reserve(size_t size)
+	{
+		ensureSpace(size);
+	}
+
+	// Releases memory that is not needed by current items
+	inline void shrinkToFit(void)
+	{
+		if (items == 0) {
+			clear();
+			return;
+		}
+		size_t new_res = MIN_CAPACITY;
+		while (new_res < items) {
+			new_res *= 2;
+		}
+		if (new_res < res) {
+			reallocate(new_res);
+		}
+	}
+
 	inline void insert(T const* begin, T const* end)
 	{
 		HppAssert(end >= begin, "Invalid range!");
@@ -55,111 +109,172 @@ public:
 		}
 		size_t add = end - begin;
 		ensureSpace(items + add);
-		if (write + add <= buf + res) {
-			memcpy(write, begin, add * sizeof(T));
-			write += add;
-		} else {
-			size_t amount = buf + res - write;
-			memcpy(write, begin, amount * sizeof(T));
-			HppAssert(add >= amount, "Fail!");
-			size_t amount2 = add - amount;
-			memcpy(buf, begin + amount, amount2 * sizeof(T));
-			write = buf + amount2;
-		}
+		size_t pos = (first + items) & mask;
+		size_t amount = std::min(add, res - pos);
+		memcpy(buf + pos, begin, amount * sizeof(T));
+		memcpy(buf, begin + amount, (add - amount) * sizeof(T));
 		items += add;
 	}
 
 	inline T pop(void)
 	{
 		HppAssert(items > 0, "Queue is empty!");
-		HppAssert(read != buf + res, "Fail!");
-		T result = *read;
-		read ++;
-		if (read == buf + res) {
-			read = buf;
-		}
+		T result = buf[first];
+		first = (first + 1) & mask;
 		items --;
-// TODO: Check if it would be good idea to reduce space!
+		if (items == 0) {
+			first = 0;
+		}
 		return result;
 	}
 
 	inline void push(T const& t)
 	{
 		ensureSpace(items + 1);
-		HppAssert(write != buf + res, "Write points to the end of buffer!");
-		*write = t;
-		write ++;
-		if (write == buf + res) {
-			write = buf;
-		}
+		buf[(first + items) & mask] = t;
 		items ++;
 	}
 
 	inline T front(void) const
 	{
 		HppAssert(items > 0, "No items!");
-		return *read;
+		return buf[first];
 	}
 
-	inline void swap(RBuf< T >& rbuf)
+	// Copies items from the front and removes them
+	inline void read(T* result, size_t amount)
 	{
-		size_t swap_res = rbuf.res;
-		size_t swap_items = rbuf.items;
-		T* swap_write = rbuf.write;
-		T* swap_read = rbuf.read;
-		T* swap_buf = rbuf.buf;
+		peek(result, amount);
+		consume(amount);
+	}
 
-		rbuf.res = res;
-		rbuf.items = items;
-		rbuf.write = write;
-		rbuf.read = read;
-		rbuf.buf = buf;
+	// Copies items without removing them. Offset is counted from the front.
+	inline void peek(T* result, size_t amount, size_t offset = 0) const
+	{
+		HppAssert(offset + amount <= items, "Not enough items!");
+		copyOut(result, offset, amount);
+	}
 
-		res = swap_res;
-		items = swap_items;
-		write = swap_write;
-		read = swap_read;
-		buf = swap_buf;
+	// Removes items from the front
+	inline void consume(size_t amount)
+	{
+		HppAssert(amount <= items, "Not enough items!");
+		if (amount == 0) {
+			return;
+		}
+		first = (first + amount) & mask;
+		items -= amount;
+		// Empty buffer starts from the beginning, so
+		// next items are in one span for as long as possible
+		if (items == 0) {
+			first = 0;
+		}
+	}
+
+	// Buffered items in order. Second span is empty
+	// unless items wrap around the end of buffer.
+	inline T const* getFirstSpan(size_t& span_size) const
+	{
+		span_size = std::min(items, res - first);
+		return buf + first;
+	}
+	inline T const* getSecondSpan(size_t& span_size) const
+	{
+		span_size = items - std::min(items, res - first);
+		return buf;
+	}
+
+	// Free space after the last item. Items can be written there
+	// directly and then added to the buffer with commit(). Use
+	// reserve() first to make sure there is enough space.
+	inline T* getWriteSpan(size_t& span_size)
+	{
+		if (items == res) {
+			span_size = 0;
+			return NULL;
+		}
+		size_t pos = (first + items) & mask;
+		if (first + items < res) {
+			span_size = res - pos;
+		} else {
+			span_size = first - pos;
+		}
+		return buf + pos;
+	}
+	inline void commit(size_t amount)
+	{
+		HppAssert(items + amount <= res, "Committed more than there is space!");
+		items += amount;
+	}
+
+	// Swaps only pointers, so this is the cheap way to
+	// move contents from one buffer to another.
+	inline void swap(RBuf< T >& rbuf)
+	{
+		std::swap(buf, rbuf.buf);
+		std::swap(res, rbuf.res);
+		std::swap(mask, rbuf.mask);
+		std::swap(first, rbuf.first);
+		std::swap(items, rbuf.items);
 	}
 
 private:
 
+	static size_t const MIN_CAPACITY = 16;
+
+	T* buf;
+	// Capacity, which is zero or a power of two
 	size_t res;
+	size_t mask;
+	// Position of the first item
+	size_t first;
 	size_t items;
-	T* write;
-	T* read;
-	T* buf;
 
 	inline void ensureSpace(size_t req)
 	{
 		if (res >= req) {
 			return;
 		}
-		req *= 2;
-		T* newbuf = new T[req];
-		if (items > 0) {
-			if (read < write || write == buf) {
-				HppAssert(read + items <= buf + res, "Overflow!");
-				memcpy(newbuf, read, items * sizeof(T));
-			} else {
-				size_t amount = buf + res - read;
-				memcpy(newbuf, read, amount * sizeof(T));
-				HppAssert(items >= amount, "Fail!");
-				size_t amount2 = items - amount;
-				memcpy(newbuf + amount, buf, amount2 * sizeof(T));
-			}
+		size_t new_res = res > 0 ? res : size_t(MIN_CAPACITY);
+		while (new_res < req) {
+			new_res *= 2;
 		}
-		if (res > 0) {
-			delete[] buf;
+		reallocate(new_res);
+	}
+
+	// Moves items to the beginning of a new buffer
+	inline void reallocate(size_t new_res)
+	{
+		HppAssert(new_res >= items, "New buffer is too small!");
+		HppAssert((new_res & (new_res - 1)) == 0, "Capacity must be a power of two!");
+		T* new_buf = new T[new_res];
+		copyOut(new_buf, 0, items);
+		delete[] buf;
+		buf = new_buf;
+		res = new_res;
+		mask = new_res - 1;
+		first = 0;
+	}
+
+	inline void copyOut(T* result, size_t offset, size_t amount) const
+	{
+		if (amount == 0) {
+			return;
 		}
-		res = req;
-		buf = newbuf;
-		read = newbuf;
-		write = newbuf + items;
+		size_t pos = (first + offset) & mask;
+		size_t amount1 = std::min(amount, res - pos);
+		memcpy(result, buf + pos, amount1 * sizeof(T));
+		memcpy(result + amount1, buf, (amount - amount1) * sizeof(T));
 	}
 
 };
 
+template< typename T >
+inline void swap(RBuf< T >& rbuf1, RBuf< T >& rbuf2)
+{
+	rbuf1.swap(rbuf2);
+}
+
 }
 
 #endif
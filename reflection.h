@@ -0,0 +1,460 @@
+#ifndef HPP_REFLECTION_H
+#define HPP_REFLECTION_H
+
+#include "serializable.h"
+#include "deserializable.h"
+#include "binarywriter.h"
+#include "binaryreader.h"
+#include "json.h"
+#include "bytev.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Serialization of structs from one description of their fields. Struct
+// tells its fields with a public static function template:
+//
+//	struct Particle
+//	{
+//		Vector3 pos;
+//		float mass;
+//		std::vector< uint32_t > neighbors;
+//		template< typename Self, typename Visitor > static void reflect(Self& self, Visitor& visitor)
+//		{
+//			visitor.field("pos", self.pos);
+//			visitor.field("mass", self.mass);
+//			visitor.field("neighbors", self.neighbors);
+//		}
+//	};
+//
+// Then serializeReflected(), deserializeReflected(), reflectedToJson()
+// and reflectedFromJson() work for it. Deriving from Reflected< Type >
+// makes the struct Serializable and Deserializable too. When struct is
+// written, "Self" is const, so its fields are given to visitor as const.
+//
+// Fields are resolved at compile time, so there are no virtual calls per
+// field. Fields may be numbers, booleans, strings, Serializable types,
+// other reflected structs, fixed arrays and vectors of these. Arrays and
+// vectors of numbers are copied as one block using serializeArray().
+// Vectors of booleans are handled one boolean at a time.
+//
+// Binary form is fields in order without names. Vectors and strings are
+// prefixed with their size as varint. JSON form is an object of fields.
+
+template< typename Type > struct ReflectedValue;
+
+template< typename Type > inline void serializeReflected(BinaryWriter& writer, Type const& value);
+template< typename Type > inline ByteV serializeReflected(Type const& value, bool bigendian = true);
+template< typename Type > inline void deserializeReflected(Type& result, BinaryReader& reader);
+template< typename Type > inline void deserializeReflected(Type& result, ByteV const& bytes, bool bigendian = true);
+template< typename Type > inline Json reflectedToJson(Type const& value);
+template< typename Type > inline void reflectedFromJson(Type& result, Json const& json);
+
+// Base class that implements Serializable and Deserializable using reflect() of Type
+template< typename Type >
+class Reflected : public Serializable, public Deserializable
+{
+
+public:
+
+	inline virtual ~Reflected(void) { }
+
+	// Virtual functions needed by superclasses Serializable and Deserializable
+	inline virtual Json toJson(void) const;
+	inline virtual void constructFromJson(Json const& json);
+
+private:
+
+	// Virtual functions needed by superclasses Serializable and Deserializable
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
+
+};
+
+// Visitors that are given to reflect()
+class ReflectionWriter
+{
+public:
+	inline ReflectionWriter(BinaryWriter& writer) : writer(writer) { }
+	template< typename Type > inline void field(char const* name, Type const& value) { (void)name; ReflectedValue< Type >::write(writer, value); }
+private:
+	BinaryWriter& writer;
+};
+
+class ReflectionReader
+{
+public:
+	inline ReflectionReader(BinaryReader& reader) : reader(reader) { }
+	template< typename Type > inline void field(char const* name, Type& value) { (void)name; ReflectedValue< Type >::read(reader, value); }
+private:
+	BinaryReader& reader;
+};
+
+class ReflectionJsonWriter
+{
+public:
+	inline ReflectionJsonWriter(Json& json) : json(json) { }
+	template< typename Type > inline void field(char const* name, Type const& value) { json.setMember(name, ReflectedValue< Type >::toJson(value)); }
+private:
+	Json& json;
+};
+
+class ReflectionJsonReader
+{
+public:
+	inline ReflectionJsonReader(Json const& json) : json(json) { }
+	template< typename Type > inline void field(char const* name, Type& value);
+private:
+	Json const& json;
+};
+
+// Tells if Type is both Serializable and Deserializable
+template< typename Type >
+struct IsSerializable
+{
+	static char test(Serializable const*);
+	static long test(...);
+	static bool const VALUE = sizeof(test(static_cast< Type* >(NULL))) == sizeof(char);
+};
+
+// Arrays of values that are not numbers are handled one value at a time
+template< typename Type >
+struct ReflectedElements
+{
+	inline static void writeArray(BinaryWriter& writer, Type const* values, size_t size)
+	{
+		for (size_t i = 0; i < size; ++ i) {
+			ReflectedValue< Type >::write(writer, values[i]);
+		}
+	}
+	inline static void readArray(BinaryReader& reader, Type* result, size_t size)
+	{
+		for (size_t i = 0; i < size; ++ i) {
+			ReflectedValue< Type >::read(reader, result[i]);
+		}
+	}
+};
+
+// Serializable types use their own functions, and other
+// structs are expected to have reflect() function.
+template< typename Type, bool SERIALIZABLE >
+struct ReflectedObject : public ReflectedElements< Type >
+{
+	inline static void write(BinaryWriter& writer, Type const& value) { value.serialize(writer); }
+	inline static void read(BinaryReader& reader, Type& result) { result.deserialize(reader); }
+	inline static Json toJson(Type const& value) { return value.toJson(); }
+	inline static void fromJson(Json const& json, Type& result) { result.constructFromJson(json); }
+};
+
+template< typename Type >
+struct ReflectedObject< Type, false > : public ReflectedElements< Type >
+{
+	inline static void write(BinaryWriter& writer, Type const& value)
+	{
+		ReflectionWriter visitor(writer);
+		Type::reflect(value, visitor);
+	}
+	inline static void read(BinaryReader& reader, Type& result)
+	{
+		ReflectionReader visitor(reader);
+		Type::reflect(result, visitor);
+	}
+	inline static Json toJson(Type const& value)
+	{
+		Json result = Json::newObject();
+		ReflectionJsonWriter visitor(result);
+		Type::reflect(value, visitor);
+		return result;
+	}
+	inline static void fromJson(Json const& json, Type& result)
+	{
+		if (json.getType() != Json::OBJECT) {
+			throw Exception("JSON for reflected struct must be an object!");
+		}
+		ReflectionJsonReader visitor(json);
+		Type::reflect(result, visitor);
+	}
+};
+
+template< typename Type >
+struct ReflectedValue : public ReflectedObject< Type, IsSerializable< Type >::VALUE >
+{
+};
+
+// Numbers. Arrays of them are copied as one block.
+template< typename Type >
+struct ReflectedNumber
+{
+	inline static void write(BinaryWriter& writer, Type value) { writer.writeArray(&value, 1); }
+	inline static void read(BinaryReader& reader, Type& result) { reader.readArray(&result, 1); }
+	inline static Json toJson(Type value) { return Json::newNumber(value); }
+	inline static void writeArray(BinaryWriter& writer, Type const* values, size_t size) { writer.writeArray(values, size); }
+	inline static void readArray(BinaryReader& reader, Type* result, size_t size) { reader.readArray(result, size); }
+};
+
+template< typename Type >
+struct ReflectedInteger : public ReflectedNumber< Type >
+{
+	inline static void fromJson(Json const& json, Type& result)
+	{
+		if (json.getType() != Json::NUMBER) {
+			throw Exception("JSON for reflected integer must be a number!");
+		}
+		result = Type(json.getInteger());
+	}
+};
+
+template< typename Type >
+struct ReflectedReal : public ReflectedNumber< Type >
+{
+	inline static void fromJson(Json const& json, Type& result)
+	{
+		if (json.getType() != Json::NUMBER) {
+			throw Exception("JSON for reflected number must be a number!");
+		}
+		result = Type(json.getNumber());
+	}
+};
+
+template< > struct ReflectedValue< int8_t > : public ReflectedInteger< int8_t > { };
+template< > struct ReflectedValue< int16_t > : public ReflectedInteger< int16_t > { };
+template< > struct ReflectedValue< int32_t > : public ReflectedInteger< int32_t > { };
+template< > struct ReflectedValue< int64_t > : public ReflectedInteger< int64_t > { };
+template< > struct ReflectedValue< uint8_t > : public ReflectedInteger< uint8_t > { };
+template< > struct ReflectedValue< uint16_t > : public ReflectedInteger< uint16_t > { };
+template< > struct ReflectedValue< uint32_t > : public ReflectedInteger< uint32_t > { };
+template< > struct ReflectedValue< uint64_t > : public ReflectedInteger< uint64_t > { };
+template< > struct ReflectedValue< float > : public ReflectedReal< float > { };
+template< > struct ReflectedValue< double > : public ReflectedReal< double > { };
+
+template< >
+struct ReflectedValue< bool > : public ReflectedElements< bool >
+{
+	inline static void write(BinaryWriter& writer, bool value) { writer.writeBool(value); }
+	inline static void read(BinaryReader& reader, bool& result) { result = reader.readBool(); }
+	inline static Json toJson(bool value) { return Json::newBoolean(value); }
+	inline static void fromJson(Json const& json, bool& result)
+	{
+		if (json.getType() != Json::BOOLEAN) {
+			throw Exception("JSON for reflected boolean must be a boolean!");
+		}
+		result = json.getBoolean();
+	}
+};
+
+template< >
+struct ReflectedValue< std::string > : public ReflectedElements< std::string >
+{
+	inline static void write(BinaryWriter& writer, std::string const& value) { writer.writeString(value); }
+	inline static void read(BinaryReader& reader, std::string& result) { result = reader.readString(); }
+	inline static Json toJson(std::string const& value) { return Json::newString(value); }
+	inline static void fromJson(Json const& json, std::string& result)
+	{
+		if (json.getType() != Json::STRING) {
+			throw Exception("JSON for reflected string must be a string!");
+		}
+		result = json.getString();
+	}
+};
+
+template< typename Type, size_t SIZE >
+struct ReflectedValue< Type[SIZE] > : public ReflectedElements< Type[SIZE] >
+{
+	inline static void write(BinaryWriter& writer, Type const (&values)[SIZE]) { ReflectedValue< Type >::writeArray(writer, values, SIZE); }
+	inline static void read(BinaryReader& reader, Type (&result)[SIZE]) { ReflectedValue< Type >::readArray(reader, result, SIZE); }
+	inline static Json toJson(Type const (&values)[SIZE])
+	{
+		Json result = Json::newArray();
+		for (size_t i = 0; i < SIZE; ++ i) {
+			result.addItem(ReflectedValue< Type >::toJson(values[i]));
+		}
+		return result;
+	}
+	inline static void fromJson(Json const& json, Type (&result)[SIZE])
+	{
+		if (json.getType() != Json::ARRAY || json.getArraySize() != SIZE) {
+			throw Exception("JSON for reflected array must be an array of correct size!");
+		}
+		for (size_t i = 0; i < SIZE; ++ i) {
+			ReflectedValue< Type >::fromJson(json.getItem(i), result[i]);
+		}
+	}
+};
+
+template< typename Type >
+struct ReflectedValue< std::vector< Type > > : public ReflectedElements< std::vector< Type > >
+{
+	inline static void write(BinaryWriter& writer, std::vector< Type > const& values)
+	{
+		writer.writeVarUInt(values.size());
+		if (!values.empty()) {
+			ReflectedValue< Type >::writeArray(writer, &values[0], values.size());
+		}
+	}
+	inline static void read(BinaryReader& reader, std::vector< Type >& result)
+	{
+		uint64_t size = reader.readVarUInt();
+		// Vector grows in steps, so broken size
+		// cannot allocate lots of memory at once.
+		size_t const STEP = 4096;
+		result.clear();
+		while (result.size() < size) {
+			size_t offset = result.size();
+			size_t step = std::min< uint64_t >(size - offset, STEP);
+			result.resize(offset + step);
+			ReflectedValue< Type >::readArray(reader, &result[offset], step);
+		}
+	}
+	inline static Json toJson(std::vector< Type > const& values)
+	{
+		Json result = Json::newArray();
+		for (size_t i = 0; i < values.size(); ++ i) {
+			result.addItem(ReflectedValue< Type >::toJson(values[i]));
+		}
+		return result;
+	}
+	inline static void fromJson(Json const& json, std::vector< Type >& result)
+	{
+		if (json.getType() != Json::ARRAY) {
+			throw Exception("JSON for reflected vector must be an array!");
+		}
+		result.resize(json.getArraySize());
+		for (size_t i = 0; i < result.size(); ++ i) {
+			ReflectedValue< Type >::fromJson(json.getItem(i), result[i]);
+		}
+	}
+};
+
+// Booleans of vector are packed to bits, so they
+// cannot be accessed as an array of bool values.
+template< >
+struct ReflectedValue< std::vector< bool > > : public ReflectedElements< std::vector< bool > >
+{
+	inline static void write(BinaryWriter& writer, std::vector< bool > const& values)
+	{
+		writer.writeVarUInt(values.size());
+		for (std::vector< bool >::const_iterator values_it = values.begin(); values_it != values.end(); ++ values_it) {
+			writer.writeBool(*values_it);
+		}
+	}
+	inline static void read(BinaryReader& reader, std::vector< bool >& result)
+	{
+		uint64_t size = reader.readVarUInt();
+		// Every boolean takes a byte, so broken size
+		// cannot grow vector beyond size of input.
+		result.clear();
+		while (result.size() < size) {
+			result.push_back(reader.readBool());
+		}
+	}
+	inline static Json toJson(std::vector< bool > const& values)
+	{
+		Json result = Json::newArray();
+		for (std::vector< bool >::const_iterator values_it = values.begin(); values_it != values.end(); ++ values_it) {
+			result.addItem(Json::newBoolean(*values_it));
+		}
+		return result;
+	}
+	inline static void fromJson(Json const& json, std::vector< bool >& result)
+	{
+		if (json.getType() != Json::ARRAY) {
+			throw Exception("JSON for reflected vector must be an array!");
+		}
+		result.clear();
+		result.reserve(json.getArraySize());
+		for (size_t i = 0; i < json.getArraySize(); ++ i) {
+			bool value;
+			ReflectedValue< bool >::fromJson(json.getItem(i), value);
+			result.push_back(value);
+		}
+	}
+};
+
+// Reflected uses reflect() directly, because going through
+// ReflectedValue would call its virtual functions again.
+template< typename Type >
+inline Json Reflected< Type >::toJson(void) const
+{
+	return ReflectedObject< Type, false >::toJson(static_cast< Type const& >(*this));
+}
+
+template< typename Type >
+inline void Reflected< Type >::constructFromJson(Json const& json)
+{
+	ReflectedObject< Type, false >::fromJson(json, static_cast< Type& >(*this));
+}
+
+template< typename Type >
+inline void Reflected< Type >::doSerialize(BinaryWriter& writer) const
+{
+	ReflectedObject< Type, false >::write(writer, static_cast< Type const& >(*this));
+}
+
+template< typename Type >
+inline void Reflected< Type >::doDeserialize(BinaryReader& reader)
+{
+	ReflectedObject< Type, false >::read(reader, static_cast< Type& >(*this));
+}
+
+template< typename Type >
+inline void ReflectionJsonReader::field(char const* name, Type& value)
+{
+	if (!json.keyExists(name)) {
+		throw Exception(std::string("JSON is missing member \"") + name + "\"!");
+	}
+	ReflectedValue< Type >::fromJson(json.getMember(name), value);
+}
+
+template< typename Type >
+inline void serializeReflected(BinaryWriter& writer, Type const& value)
+{
+	ReflectedValue< Type >::write(writer, value);
+}
+
+template< typename Type >
+inline ByteV serializeReflected(Type const& value, bool bigendian)
+{
+	ByteV result;
+	BinaryWriter writer(result, bigendian);
+	ReflectedValue< Type >::write(writer, value);
+	return result;
+}
+
+template< typename Type >
+inline void deserializeReflected(Type& result, BinaryReader& reader)
+{
+	ReflectedValue< Type >::read(reader, result);
+}
+
+template< typename Type >
+inline void deserializeReflected(Type& result, ByteV const& bytes, bool bigendian)
+{
+	BinaryReader reader(bytes, bigendian);
+	ReflectedValue< Type >::read(reader, result);
+	if (!reader.atEnd()) {
+		throw Exception("Reflected struct did not use all bytes!");
+	}
+}
+
+template< typename Type >
+inline Json reflectedToJson(Type const& value)
+{
+	return ReflectedValue< Type >::toJson(value);
+}
+
+template< typename Type >
+inline void reflectedFromJson(Type& result, Json const& json)
+{
+	ReflectedValue< Type >::fromJson(json, result);
+}
+
+}
+
+#endif
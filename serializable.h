@@ -3,6 +3,7 @@
 
 #include "json.h"
 #include "bytev.h"
+#include "binarywriter.h"
 
 namespace Hpp
 {
@@ -16,28 +17,38 @@ public:
 	inline void serialize(ByteV& result, bool bigendian = true) const;
 	inline ByteV serialize(bool bigendian = true) const;
 
+	// Serialize to the end of writer. This is
+	// useful when many objects are serialized.
+	inline void serialize(BinaryWriter& writer) const;
+
 	// Serialize to JSON
 	virtual Json toJson(void) const = 0;
 
 private:
 
-	// "result" must not be cleared!
-	virtual void doSerialize(ByteV& result, bool bigendian) const = 0;
+	virtual void doSerialize(BinaryWriter& writer) const = 0;
 
 };
 
 inline void Serializable::serialize(ByteV& result, bool bigendian) const
 {
-	doSerialize(result, bigendian);
+	BinaryWriter writer(result, bigendian);
+	doSerialize(writer);
 }
 
 inline ByteV Serializable::serialize(bool bigendian) const
 {
 	ByteV result;
-	doSerialize(result, bigendian);
+	BinaryWriter writer(result, bigendian);
+	doSerialize(writer);
 	return result;
 }
 
+inline void Serializable::serialize(BinaryWriter& writer) const
+{
+	doSerialize(writer);
+}
+
 }
 
 #endif
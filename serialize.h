@@ -2,11 +2,18 @@
 #define HPP_SERIALIZE_H
 
 #include "bytev.h"
+#include "byteview.h"
 #include "assert.h"
 #include "exception.h"
 #include "cast.h"
 
 #include <istream>
+#include <cstring>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // TODO: Use (u)int64_t instead of (u)int32_t in casting functions with variable bytesize!
 namespace Hpp
@@ -40,6 +47,31 @@ inline float deserializeFloat(std::istream& strm, bool bigendian = true);
 inline std::string deserializeString(std::istream& strm, uint8_t bytes, bool bigendian = true);
 inline ByteV deserializeByteV(std::istream& strm, size_t size);
 
+// These read from the beginning of view, and move its beginning forward.
+// ByteView version gives the bytes without copying them.
+inline int8_t deserializeInt8(ConstByteView& data);
+inline int16_t deserializeInt16(ConstByteView& data, bool bigendian = true);
+inline int32_t deserializeInt32(ConstByteView& data, bool bigendian = true);
+inline int64_t deserializeInt64(ConstByteView& data, bool bigendian = true);
+inline uint8_t deserializeUInt8(ConstByteView& data);
+inline uint16_t deserializeUInt16(ConstByteView& data, bool bigendian = true);
+inline uint32_t deserializeUInt32(ConstByteView& data, bool bigendian = true);
+inline uint64_t deserializeUInt64(ConstByteView& data, bool bigendian = true);
+inline float deserializeFloat(ConstByteView& data, bool bigendian = true);
+inline std::string deserializeString(ConstByteView& data, uint8_t bytes, bool bigendian = true);
+inline ConstByteView deserializeByteView(ConstByteView& data, size_t size);
+inline ByteV deserializeByteV(ConstByteView& data, size_t size);
+
+// Arrays of integers and floats. Whole array is converted at once, and
+// if byte order of host matches, it is just copied. Buffer versions
+// need room for size * sizeof(Type) bytes. ByteV version appends to
+// result. Type can be any 8, 16, 32 or 64 bit integer, float or double.
+template< typename Type > inline void serializeArray(uint8_t* result, Type const* values, size_t size, bool bigendian = true);
+template< typename Type > inline void serializeArray(ByteV& result, Type const* values, size_t size, bool bigendian = true);
+template< typename Type > inline void deserializeArray(Type* result, size_t size, uint8_t const* data, bool bigendian = true);
+template< typename Type > inline void deserializeArray(Type* result, size_t size, ConstByteView& data, bool bigendian = true);
+template< typename Type > inline void deserializeArray(Type* result, size_t size, std::istream& strm, bool bigendian = true);
+
 inline void serializeString(ByteV& result, std::string const& str, uint8_t bytes, bool bigendian)
 {
 	if (bytes == 1) {
@@ -313,6 +345,242 @@ inline ByteV deserializeByteV(std::istream& strm, size_t size)
 	return result;
 }
 
+inline ConstByteView deserializeByteView(ConstByteView& data, size_t size)
+{
+	if (data.size() < size) {
+		throw Exception("Unexpected end of data!");
+	}
+	ConstByteView result = data.sub(0, size);
+	data = data.sub(size);
+	return result;
+}
+
+inline int8_t deserializeInt8(ConstByteView& data)
+{
+	return (int8_t)deserializeByteView(data, 1)[0];
+}
+
+inline int16_t deserializeInt16(ConstByteView& data, bool bigendian)
+{
+	return cStrToInt16(deserializeByteView(data, 2).data(), bigendian);
+}
+
+inline int32_t deserializeInt32(ConstByteView& data, bool bigendian)
+{
+	return cStrToInt32(deserializeByteView(data, 4).data(), bigendian);
+}
+
+inline int64_t deserializeInt64(ConstByteView& data, bool bigendian)
+{
+	return cStrToInt64(deserializeByteView(data, 8).data(), bigendian);
+}
+
+inline uint8_t deserializeUInt8(ConstByteView& data)
+{
+	return deserializeByteView(data, 1)[0];
+}
+
+inline uint16_t deserializeUInt16(ConstByteView& data, bool bigendian)
+{
+	return cStrToUInt16(deserializeByteView(data, 2).data(), bigendian);
+}
+
+inline uint32_t deserializeUInt32(ConstByteView& data, bool bigendian)
+{
+	return cStrToUInt32(deserializeByteView(data, 4).data(), bigendian);
+}
+
+inline uint64_t deserializeUInt64(ConstByteView& data, bool bigendian)
+{
+	return cStrToUInt64(deserializeByteView(data, 8).data(), bigendian);
+}
+
+inline float deserializeFloat(ConstByteView& data, bool bigendian)
+{
+	return cStrToFloat(deserializeByteView(data, 4).data(), bigendian);
+}
+
+inline std::string deserializeString(ConstByteView& data, uint8_t bytes, bool bigendian)
+{
+	uint32_t result_size = cStrToUInt(deserializeByteView(data, bytes).data(), bytes, bigendian);
+	ConstByteView result = deserializeByteView(data, result_size);
+	return std::string((char const*)result.data(), result.size());
+}
+
+inline ByteV deserializeByteV(ConstByteView& data, size_t size)
+{
+	return deserializeByteView(data, size).toByteV();
+}
+
+// Types that can be serialized as arrays. Other types fail to compile.
+template< typename Type > struct SerializableArrayElement;
+template< > struct SerializableArrayElement< int8_t > { };
+template< > struct SerializableArrayElement< int16_t > { };
+template< > struct SerializableArrayElement< int32_t > { };
+template< > struct SerializableArrayElement< int64_t > { };
+template< > struct SerializableArrayElement< uint8_t > { };
+template< > struct SerializableArrayElement< uint16_t > { };
+template< > struct SerializableArrayElement< uint32_t > { };
+template< > struct SerializableArrayElement< uint64_t > { };
+template< > struct SerializableArrayElement< float > { };
+template< > struct SerializableArrayElement< double > { };
+
+// Reverses bytes of every element. Destination may be the same as
+// source, but they must not overlap otherwise. SSSE3 swaps with one
+// shuffle, and plain SSE2 with word shuffles and shifts.
+inline void swapArrayBytes16(uint8_t* dest, uint8_t const* src, size_t count)
+{
+	size_t i = 0;
+	#if defined(__SSSE3__)
+	__m128i const mask = _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 2));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 2), _mm_shuffle_epi8(v, mask));
+	}
+	#elif defined(__SSE2__)
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 2));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 2), v);
+	}
+	#endif
+	for (; i < count; ++ i) {
+		uint8_t b0 = src[i * 2];
+		dest[i * 2] = src[i * 2 + 1];
+		dest[i * 2 + 1] = b0;
+	}
+}
+
+inline void swapArrayBytes32(uint8_t* dest, uint8_t const* src, size_t count)
+{
+	size_t i = 0;
+	#if defined(__SSSE3__)
+	__m128i const mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 4));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 4), _mm_shuffle_epi8(v, mask));
+	}
+	#elif defined(__SSE2__)
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 4));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 4), v);
+	}
+	#endif
+	for (; i < count; ++ i) {
+		uint8_t b0 = src[i * 4];
+		uint8_t b1 = src[i * 4 + 1];
+		dest[i * 4] = src[i * 4 + 3];
+		dest[i * 4 + 1] = src[i * 4 + 2];
+		dest[i * 4 + 2] = b1;
+		dest[i * 4 + 3] = b0;
+	}
+}
+
+inline void swapArrayBytes64(uint8_t* dest, uint8_t const* src, size_t count)
+{
+	size_t i = 0;
+	#if defined(__SSSE3__)
+	__m128i const mask = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 8));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 8), _mm_shuffle_epi8(v, mask));
+	}
+	#elif defined(__SSE2__)
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const* >(src + i * 8));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128(reinterpret_cast< __m128i* >(dest + i * 8), v);
+	}
+	#endif
+	for (; i < count; ++ i) {
+		uint8_t b[8];
+		memcpy(b, src + i * 8, 8);
+		for (size_t byte = 0; byte < 8; ++ byte) {
+			dest[i * 8 + byte] = b[7 - byte];
+		}
+	}
+}
+
+// Copies array of elements, and converts byte order if needed
+inline void copyArrayElements(uint8_t* dest, uint8_t const* src, size_t count, size_t element_size, bool bigendian)
+{
+	#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	bool const swap = !bigendian;
+	#else
+	bool const swap = bigendian;
+	#endif
+	if (!swap || element_size == 1) {
+		if (dest != src) {
+			memcpy(dest, src, count * element_size);
+		}
+	} else if (element_size == 2) {
+		swapArrayBytes16(dest, src, count);
+	} else if (element_size == 4) {
+		swapArrayBytes32(dest, src, count);
+	} else {
+		HppAssert(element_size == 8, "Invalid size of element!");
+		swapArrayBytes64(dest, src, count);
+	}
+}
+
+template< typename Type >
+inline void serializeArray(uint8_t* result, Type const* values, size_t size, bool bigendian)
+{
+	(void)sizeof(SerializableArrayElement< Type >);
+	if (size > 0) {
+		copyArrayElements(result, reinterpret_cast< uint8_t const* >(values), size, sizeof(Type), bigendian);
+	}
+}
+
+template< typename Type >
+inline void serializeArray(ByteV& result, Type const* values, size_t size, bool bigendian)
+{
+	if (size > 0) {
+		size_t result_begin = result.size();
+		result.resize(result_begin + size * sizeof(Type));
+		serializeArray(&result[result_begin], values, size, bigendian);
+	}
+}
+
+template< typename Type >
+inline void deserializeArray(Type* result, size_t size, uint8_t const* data, bool bigendian)
+{
+	(void)sizeof(SerializableArrayElement< Type >);
+	if (size > 0) {
+		copyArrayElements(reinterpret_cast< uint8_t* >(result), data, size, sizeof(Type), bigendian);
+	}
+}
+
+template< typename Type >
+inline void deserializeArray(Type* result, size_t size, ConstByteView& data, bool bigendian)
+{
+	if (data.size() / sizeof(Type) < size) {
+		throw Exception("Unexpected end of data!");
+	}
+	deserializeArray(result, size, deserializeByteView(data, size * sizeof(Type)).data(), bigendian);
+}
+
+template< typename Type >
+inline void deserializeArray(Type* result, size_t size, std::istream& strm, bool bigendian)
+{
+	(void)sizeof(SerializableArrayElement< Type >);
+	if (size == 0) {
+		return;
+	}
+	// Data is read straight to result, and converted there
+	uint8_t* result_bytes = reinterpret_cast< uint8_t* >(result);
+	strm.read(reinterpret_cast< char* >(result_bytes), size * sizeof(Type));
+	if (size_t(strm.gcount()) != size * sizeof(Type)) {
+		throw Exception("Unexpected end of data!");
+	}
+	copyArrayElements(result_bytes, result_bytes, size, sizeof(Type), bigendian);
+}
+
 }
 
 #endif
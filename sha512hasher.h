@@ -3,6 +3,8 @@
 
 #include "opensslhasher.h"
 
+#include <openssl/sha.h>
+
 namespace Hpp
 {
 
@@ -20,6 +22,27 @@ public:
 	{
 	}
 
+private:
+
+	#ifndef OPENSSL_NO_DEPRECATED_3_0
+	// Low level API is deprecated since OpenSSL 3.0, but unlike
+	// restarting EVP context, it does not allocate anything.
+	#ifdef __GNUC__
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+	#endif
+	inline virtual void doHashMessage(uint8_t* result, uint8_t const* data, size_t data_size)
+	{
+		SHA512_CTX ctx;
+		if (!SHA512_Init(&ctx) || !SHA512_Update(&ctx, data, data_size) || !SHA512_Final(result, &ctx)) {
+			throw Exception("Unable to hash data!");
+		}
+	}
+	#ifdef __GNUC__
+	#pragma GCC diagnostic pop
+	#endif
+	#endif
+
 };
 
 }
@@ -1,16 +1,26 @@
 #ifndef HPP_STREAMBUF_H
 #define HPP_STREAMBUF_H
 
-#include "byteq.h"
+#include "bytev.h"
+#include "assert.h"
 #include "condition.h"
 #include "mutex.h"
 #include "lock.h"
 
 #include <stdint.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 namespace Hpp
 {
 
+// Pipe of bytes between threads. Bytes are buffered as chunks. Writer can
+// copy bytes in with pushData() or give whole buffers with pushChunk(), and
+// reader can copy bytes out with readData() or take whole buffers with
+// popChunk(). When whole buffers are moved, nothing is copied, and used
+// buffers are given back to writer, so memory is not allocated either.
 class Streambuf
 {
 
@@ -18,41 +28,180 @@ public:
 
 	typedef size_t (*WriterCallback)(uint8_t* buf, size_t buf_size, void* data);
 
-	inline Streambuf(void);
+	// If capacity is given, then no more than that amount of bytes is
+	// buffered, and memory that is allocated for chunks is limited to
+	// the same amount. In that case pushing blocks until there is room.
+	inline Streambuf(size_t capacity = 0);
 
 	// Push more data
 	inline void pushData(uint8_t const* begin, uint8_t const* end);
 
+	// Gives filled buffer to reader without copying it. In return, chunk
+	// gets a buffer that reader has finished with, or an empty one. Its
+	// contents are undefined. Whole chunk is accepted at once, so with
+	// capacity, buffered bytes may exceed it by less than one chunk.
+	// Chunks take their whole allocated size from the capacity, so
+	// small amounts of bytes should be given with pushData() instead.
+	inline void pushChunk(ByteV& chunk);
+	// Like pushChunk(), but returns false instead of blocking when full
+	inline bool tryPushChunk(ByteV& chunk);
+
+	// Marks that no more data will be pushed. After all
+	// buffered data has been read, readData() returns zero.
+	inline void close(void);
+	// Allows pushing again after close(), for example for the next
+	// stream. Reader should have reached end of earlier data first.
+	inline void reopen(void);
+
 	// Read bytes. Returns amount of bytes read. Zero means EOF.
 	inline size_t readData(uint8_t* buf, size_t buf_size);
 
+	// Takes next chunk without copying it. Old contents of chunk are
+	// given back to writer for reuse. Returns false on EOF.
+	inline bool popChunk(ByteV& chunk);
+
 	inline void setWriter(WriterCallback writer, void* data);
 
+	// Amount of memory that is allocated for buffered chunks
+	inline size_t getMemoryUsage(void) const;
+
 private:
 
-	ByteQ buf;
+	typedef std::deque< ByteV > Chunks;
+	typedef std::vector< ByteV > Spares;
+
+	// Minimum size of chunks that pushData() fills
+	static size_t const CHUNK_SIZE = 64 * 1024;
+	// How many used buffers are kept for reuse
+	static size_t const MAX_SPARES = 4;
 
+	Chunks chunks;
+	// Bytes of first chunk that are already read
+	size_t chunk_offset;
+	size_t buffered;
+	// Allocated size of chunks in queue
+	size_t memory;
+	Spares spares;
+
+	size_t capacity;
+	bool closed;
+
+	// Signaled when data is pushed or buffer is closed
 	Condition cond;
+	// Signaled when data is read from full buffer
+	Condition space_cond;
 
-	Mutex mutex;
+	mutable Mutex mutex;
 
 	// Writer and it's data
 // TODO: Need mutex protect?
 	WriterCallback writer;
 	void* writer_data;
 
+	// These must be called when mutex is locked
+	inline bool lastChunkHasRoom(void) const;
+	inline void enqueueChunk(ByteV& chunk);
+	inline void dequeueChunk(ByteV& chunk);
+	inline void recycle(ByteV& chunk);
+
 };
 
-inline Streambuf::Streambuf(void)
+inline Streambuf::Streambuf(size_t capacity) :
+chunk_offset(0),
+buffered(0),
+memory(0),
+capacity(capacity),
+closed(false),
+writer(NULL),
+writer_data(NULL)
 {
+	spares.reserve(MAX_SPARES);
 }
 
 inline void Streambuf::pushData(uint8_t const* begin, uint8_t const* end)
 {
 	Lock lock(mutex);
-	buf.insert(begin, end);
+	HppAssert(!closed, "Streambuf is closed!");
+	while (begin != end) {
+		// New chunk is allocated only if memory limit allows it
+		if (capacity) {
+			while (buffered >= capacity || (!lastChunkHasRoom() && memory >= capacity)) {
+				space_cond.wait(mutex);
+			}
+		}
+		// Fill free space of last chunk, or start a new one. Chunks
+		// are never reallocated, so pushed chunks are not copied.
+		if (!lastChunkHasRoom()) {
+			chunks.push_back(ByteV());
+			if (!spares.empty()) {
+				chunks.back().swap(spares.back());
+				spares.pop_back();
+				chunks.back().clear();
+			}
+			if (capacity) {
+				chunks.back().reserve(std::min(size_t(CHUNK_SIZE), capacity));
+			} else {
+				chunks.back().reserve(CHUNK_SIZE);
+			}
+			memory += chunks.back().capacity();
+		}
+		ByteV& chunk = chunks.back();
+		size_t amount = std::min< size_t >(end - begin, chunk.capacity() - chunk.size());
+		if (capacity) {
+			amount = std::min(amount, capacity - buffered);
+		}
+		chunk.insert(chunk.end(), begin, begin + amount);
+		buffered += amount;
+		begin += amount;
+		cond.signal();
+	}
+}
+
+inline void Streambuf::pushChunk(ByteV& chunk)
+{
+	Lock lock(mutex);
+	HppAssert(!closed, "Streambuf is closed!");
+	if (chunk.empty()) {
+		return;
+	}
+	if (capacity) {
+		while (buffered >= capacity || memory >= capacity) {
+			space_cond.wait(mutex);
+		}
+	}
+	enqueueChunk(chunk);
+	lock.unlock();
+	cond.signal();
+}
+
+inline bool Streambuf::tryPushChunk(ByteV& chunk)
+{
+	Lock lock(mutex);
+	HppAssert(!closed, "Streambuf is closed!");
+	if (chunk.empty()) {
+		return true;
+	}
+	if (capacity && (buffered >= capacity || memory >= capacity)) {
+		return false;
+	}
+	enqueueChunk(chunk);
 	lock.unlock();
 	cond.signal();
+	return true;
+}
+
+inline void Streambuf::close(void)
+{
+	Lock lock(mutex);
+	closed = true;
+	lock.unlock();
+	cond.broadcast();
+}
+
+inline void Streambuf::reopen(void)
+{
+	Lock lock(mutex);
+	closed = false;
 }
 
 inline size_t Streambuf::readData(uint8_t* buf, size_t buf_size)
@@ -62,30 +211,108 @@ inline size_t Streambuf::readData(uint8_t* buf, size_t buf_size)
 		return writer(buf, buf_size, writer_data);
 	}
 	Lock lock(mutex);
-	size_t amount;
-	do {
-		amount = std::min(buf_size, this->buf.size());
-		if (amount == 0) {
-			cond.wait(mutex);
-			continue;
+	while (buffered == 0) {
+		if (closed) {
+			return 0;
 		}
-		break;
-	} while (true);
-// TODO/Optimize: Do not use loop!
-	for (size_t offset = 0;
-	     offset < amount;
-	     offset ++) {
-	     	buf[offset] = this->buf.pop();
+		cond.wait(mutex);
+	}
+	size_t amount = 0;
+	while (amount < buf_size && buffered > 0) {
+		ByteV& chunk = chunks.front();
+		size_t part = std::min(buf_size - amount, chunk.size() - chunk_offset);
+		memcpy(buf + amount, &chunk[chunk_offset], part);
+		amount += part;
+		chunk_offset += part;
+		buffered -= part;
+		if (chunk_offset == chunk.size()) {
+			dequeueChunk(chunk);
+			recycle(chunk);
+			chunks.pop_front();
+			chunk_offset = 0;
+		}
+	}
+	if (capacity) {
+		space_cond.signal();
 	}
 	return amount;
 }
 
+inline bool Streambuf::popChunk(ByteV& chunk)
+{
+	if (writer) {
+		chunk.resize(CHUNK_SIZE);
+		chunk.resize(writer(&chunk[0], chunk.size(), writer_data));
+		return !chunk.empty();
+	}
+	Lock lock(mutex);
+	while (buffered == 0) {
+		if (closed) {
+			chunk.clear();
+			return false;
+		}
+		cond.wait(mutex);
+	}
+	ByteV& front = chunks.front();
+	// Part that is already read with readData()
+	if (chunk_offset > 0) {
+		front.erase(front.begin(), front.begin() + chunk_offset);
+		chunk_offset = 0;
+	}
+	dequeueChunk(front);
+	recycle(chunk);
+	chunk.swap(front);
+	chunks.pop_front();
+	buffered -= chunk.size();
+	if (capacity) {
+		space_cond.signal();
+	}
+	return true;
+}
+
 inline void Streambuf::setWriter(WriterCallback writer, void* data)
 {
 	this->writer = writer;
 	writer_data = data;
 }
 
+inline size_t Streambuf::getMemoryUsage(void) const
+{
+	Lock lock(mutex);
+	return memory;
+}
+
+inline bool Streambuf::lastChunkHasRoom(void) const
+{
+	return !chunks.empty() && chunks.back().size() < chunks.back().capacity();
+}
+
+inline void Streambuf::enqueueChunk(ByteV& chunk)
+{
+	chunks.push_back(ByteV());
+	chunks.back().swap(chunk);
+	buffered += chunks.back().size();
+	memory += chunks.back().capacity();
+	if (!spares.empty()) {
+		chunk.swap(spares.back());
+		spares.pop_back();
+	}
+}
+
+inline void Streambuf::dequeueChunk(ByteV& chunk)
+{
+	HppAssert(memory >= chunk.capacity(), "Memory usage out of sync!");
+	memory -= chunk.capacity();
+}
+
+inline void Streambuf::recycle(ByteV& chunk)
+{
+	if (spares.size() < MAX_SPARES && chunk.capacity() > 0) {
+		spares.push_back(ByteV());
+		spares.back().swap(chunk);
+	}
+}
+
 }
 
 #endif
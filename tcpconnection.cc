@@ -4,6 +4,7 @@
 #include "exception.h"
 #include "lock.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <iostream>
 #include <unistd.h>
@@ -18,6 +19,7 @@ TCPConnection::TCPConnection(void)
 {
 	rconn = new RealConnection;
 	rconn->outbuffer_pending_lock = NULL;
+	rconn->outbuffer_sending = false;
 	rconn->connected_state = CLOSED;
 	rconn->host_or_ip = "";
 	rconn->port = 0;
@@ -28,6 +30,7 @@ TCPConnection::TCPConnection(std::string const& host_or_ip, uint16_t port)
 {
 	rconn = new RealConnection;
 	rconn->outbuffer_pending_lock = NULL;
+	rconn->outbuffer_sending = false;
 	rconn->connected_state = CLOSED;
 	rconn->host_or_ip = "";
 	rconn->port = 0;
@@ -159,23 +162,26 @@ bool TCPConnection::waitForReading(size_t bytes)
 		// Check if there is no data to be copied to inbuffer_rcv.
 		Lock reader_lock(rconn2->reader_mutex);
 
-		// Ensure connection is not closed
-		Lock connected_lock(rconn2->connected_mutex);
-		if (rconn2->connected_state != CONNECTED) {
-			waitUntilConnectionIsClosed(rconn2);
-			return false;
-		}
-		connected_lock.unlock();
-
+		// Ensure connection is not closed. Data that was
+		// received before closing can still be read.
 		if (rconn2->inbuffer.empty()) {
-			rconn2->reader_cond.wait(rconn2->reader_mutex);
-			// Ensure connection is not closed
-			connected_lock.relock();
+			Lock connected_lock(rconn2->connected_mutex);
 			if (rconn2->connected_state != CONNECTED) {
 				waitUntilConnectionIsClosed(rconn2);
 				return false;
 			}
 			connected_lock.unlock();
+
+			rconn2->reader_cond.wait(rconn2->reader_mutex);
+			// Ensure connection is not closed
+			if (rconn2->inbuffer.empty()) {
+				connected_lock.relock();
+				if (rconn2->connected_state != CONNECTED) {
+					waitUntilConnectionIsClosed(rconn2);
+					return false;
+				}
+				connected_lock.unlock();
+			}
 		}
 
 		// If lag emulation is enabled, then wait
@@ -200,9 +206,13 @@ bool TCPConnection::waitForReading(size_t bytes)
 		// but it does not matter.
 		HppAssert(rconn2->inbuffer.size() >= amount_to_copy, "Too much to copy! There is not that much in the buffer!");
 		inbuffer_rcv_lock.relock();
-		for (size_t copy_ofs = 0; copy_ofs < amount_to_copy; ++ copy_ofs) {
-			rconn2->inbuffer_rcv.push(rconn2->inbuffer.front());
-			rconn2->inbuffer.pop();
+		while (amount_to_copy > 0) {
+			size_t span_size;
+			uint8_t const* span = rconn2->inbuffer.getFirstSpan(span_size);
+			span_size = std::min(span_size, amount_to_copy);
+			rconn2->inbuffer_rcv.insert(span, span + span_size);
+			rconn2->inbuffer.consume(span_size);
+			amount_to_copy -= span_size;
 		}
 
 	}
@@ -222,13 +232,24 @@ void TCPConnection::deinitWrite(void)
 {
 	HppAssert(rconn, "No RealConnect object!");
 
+	// Pending buffers are moved to queue without copying them
 	Lock writer_lock(rconn->writer_mutex);
-	for (ByteV::iterator outbuffer_pending_it = rconn->outbuffer_pending.begin();
-	     outbuffer_pending_it != rconn->outbuffer_pending.end();
-	     outbuffer_pending_it ++) {
-		rconn->outbuffer.push(*outbuffer_pending_it);
+	for (Chunks::iterator pending_chunks_it = rconn->outbuffer_pending_chunks.begin();
+	     pending_chunks_it != rconn->outbuffer_pending_chunks.end();
+	     ++ pending_chunks_it) {
+		rconn->outbuffer.push_back(ByteV());
+		rconn->outbuffer.back().swap(*pending_chunks_it);
+	}
+	rconn->outbuffer_pending_chunks.clear();
+	if (!rconn->outbuffer_pending.empty()) {
+		rconn->outbuffer.push_back(ByteV());
+		rconn->outbuffer.back().swap(rconn->outbuffer_pending);
+	}
+	// Continue with a buffer that has been sent already
+	if (rconn->outbuffer_pending.capacity() == 0 && !rconn->outbuffer_spares.empty()) {
+		rconn->outbuffer_pending.swap(rconn->outbuffer_spares.back());
+		rconn->outbuffer_spares.pop_back();
 	}
-	rconn->outbuffer_pending.clear();
 	writer_lock.unlock();
 	rconn->writer_cond.signal();
 
@@ -297,8 +318,9 @@ void TCPConnection::readerThread(void* conn_raw)
 		}
 		// Check if an error has occured
 		else if (recv_bytes < 0) {
-			// Check if connection was just closed
-			if (errno == ECONNRESET || errno == ENOTCONN) {
+			// Check if connection was just closed, either by
+			// remote host or by close() from another thread.
+			if (errno == ECONNRESET || errno == ENOTCONN || errno == EBADF) {
 				closeByRemoteHost(rconn);
 				return;
 			}
@@ -316,12 +338,7 @@ void TCPConnection::readerThread(void* conn_raw)
 				lag_emulation_queue.push_back(TimeAndAmount(access_time, recv_bytes));
 			}
 
-			uint8_t* buffer_end = buffer + recv_bytes;
-			for (uint8_t* buffer_it = buffer;
-			     buffer_it != buffer_end;
-			     buffer_it ++) {
-				inbuffer.push(*buffer_it);
-			}
+			inbuffer.insert(buffer, buffer + recv_bytes);
 
 			reader_lock.unlock();
 
@@ -349,12 +366,7 @@ void TCPConnection::readerThread(void* conn_raw)
 		else {
 
 			Lock reader_lock(reader_mutex);
-			uint8_t* buffer_end = buffer + recv_bytes;
-			for (uint8_t* buffer_it = buffer;
-			     buffer_it != buffer_end;
-			     buffer_it ++) {
-				inbuffer.push(*buffer_it);
-			}
+			inbuffer.insert(buffer, buffer + recv_bytes);
 			reader_lock.unlock();
 
 			// Inform possible waiting thread
@@ -376,7 +388,8 @@ void TCPConnection::writerThread(void* conn_raw)
 	Mutex& writer_mutex = rconn->writer_mutex;
 	Condition& writer_cond = rconn->writer_cond;
 	Condition& writecheck_cond = rconn->writecheck_cond;
-	ByteQ& outbuffer = rconn->outbuffer;
+	Chunks& outbuffer = rconn->outbuffer;
+	Chunks& outbuffer_spares = rconn->outbuffer_spares;
 	State& connected_state = rconn->connected_state;
 	Mutex& connected_mutex = rconn->connected_mutex;
 	#ifndef HPP_USE_SDL_NET
@@ -390,13 +403,26 @@ void TCPConnection::writerThread(void* conn_raw)
 	do {
 
 		Lock writer_lock(writer_mutex);
+		rconn->outbuffer_sending = false;
+
+		// Buffer that was sent last time is kept for reuse
+		if (outbuffer_v.capacity() > 0) {
+			if (outbuffer_spares.size() < MAX_OUTBUFFER_SPARES && outbuffer_v.capacity() <= MAX_OUTBUFFER_SPARE_SIZE) {
+				outbuffer_v.clear();
+				outbuffer_spares.push_back(ByteV());
+				outbuffer_spares.back().swap(outbuffer_v);
+			} else {
+				ByteV().swap(outbuffer_v);
+			}
+		}
 
-		// Ensure connection is not closed
+		// Ensure connection is not closed. If it is being
+		// closed, then data that is in queue is still sent.
 		Lock connected_lock(connected_mutex);
-		if (connected_state != CONNECTED) {
+		if (connected_state == CLOSED || (connected_state == CLOSING && outbuffer.empty())) {
 			writer_lock.unlock();
-			waitUntilConnectionIsClosed(rconn);
 			writecheck_cond.broadcast();
+			waitUntilConnectionIsClosed(rconn);
 			return;
 		}
 		connected_lock.unlock();
@@ -409,35 +435,37 @@ void TCPConnection::writerThread(void* conn_raw)
 			// Thread is being ran again. Check if connection is
 			// closed.
 			connected_lock.relock();
-			if (connected_state != CONNECTED) {
+			if (connected_state == CLOSED || (connected_state == CLOSING && outbuffer.empty())) {
 				writer_lock.unlock();
-				waitUntilConnectionIsClosed(rconn);
 				writecheck_cond.broadcast();
+				waitUntilConnectionIsClosed(rconn);
 				return;
 			}
 			connected_lock.unlock();
 
 		}
 
-		// Read queue to vector
-		outbuffer_v.clear();
+		// Take next buffer from queue
 // TODO: This causes errors in send() when connection is closed! Is it our fault?
-		outbuffer_v.reserve(outbuffer.size());
-		while (!outbuffer.empty()) {
-			outbuffer_v.push_back(outbuffer.front());
-			outbuffer.pop();
+		if (outbuffer.empty()) {
+			continue;
 		}
-		HppAssert(outbuffer.empty(), "");
+		outbuffer_v.swap(outbuffer.front());
+		outbuffer.pop_front();
+		rconn->outbuffer_sending = true;
 		writer_lock.unlock();
 
 		// Send data
 		#ifndef HPP_USE_SDL_NET
 		ssize_t sent_bytes = ::send(soc, reinterpret_cast< const void* >(&outbuffer_v[0]), outbuffer_v.size(), MSG_NOSIGNAL);
 		if (sent_bytes < static_cast< ssize_t >(outbuffer_v.size())) {
+			// Rest of data can not be sent anymore
+			int send_errno = errno;
+			discardOutput(rconn);
 			// Check if remote host has closed connection
-			if (errno == EPIPE ||
-			    errno == ECONNRESET ||
-			    errno == ENOTCONN) {
+			if (send_errno == EPIPE ||
+			    send_errno == ECONNRESET ||
+			    send_errno == ENOTCONN) {
 				closeByRemoteHost(rconn);
 				writecheck_cond.broadcast();
 				return;
@@ -452,6 +480,7 @@ void TCPConnection::writerThread(void* conn_raw)
 		ssize_t sent_bytes = SDLNet_TCP_Send(sdlsoc, reinterpret_cast< const void* >(&outbuffer_v[0]), outbuffer_v.size());
 		if (sent_bytes < static_cast< ssize_t >(outbuffer_v.size())) {
 // TODO: Errors are not checked! Is this bad?
+			discardOutput(rconn);
 			closeByRemoteHost(rconn);
 			writecheck_cond.broadcast();
 			return;
@@ -471,6 +500,7 @@ TCPConnection::TCPConnection(TCPsocket sdlsoc, uint16_t port)
 	rconn = new RealConnection;
 
 	rconn->outbuffer_pending_lock = NULL;
+	rconn->outbuffer_sending = false;
 	#ifndef HPP_USE_SDL_NET
 	rconn->soc = soc;
 	#else
@@ -554,11 +584,20 @@ void TCPConnection::waitUntilAllDataIsSent(RealConnection* rconn)
 	HppAssert(rconn, "No RealConnect object!");
 
 	Lock writer_lock(rconn->writer_mutex);
-	while (!rconn->outbuffer.empty()) {
+	while (!rconn->outbuffer.empty() || rconn->outbuffer_sending) {
 		rconn->writecheck_cond.wait(rconn->writer_mutex);
 	}
 }
 
+void TCPConnection::discardOutput(RealConnection* rconn)
+{
+	HppAssert(rconn, "No RealConnect object!");
+
+	Lock writer_lock(rconn->writer_mutex);
+	rconn->outbuffer.clear();
+	rconn->outbuffer_sending = false;
+}
+
 void TCPConnection::waitUntilConnectionIsClosed(RealConnection* rconn)
 {
 	HppAssert(rconn, "No RealConnect object!");
@@ -13,6 +13,7 @@
 #include "thread.h"
 #include "lock.h"
 #include "byteq.h"
+#include "byteview.h"
 #include "assert.h"
 #include "cast.h"
 #include "noncopyable.h"
@@ -22,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <deque>
 
 namespace Hpp
 {
@@ -72,6 +74,8 @@ public:
 	inline float readFloat(void);
 	inline ByteV readByteV(size_t size);
 	inline std::string readString(size_t size);
+	inline void readData(uint8_t* buf, size_t size);
+	inline void readData(ByteView buf) { readData(buf.data(), buf.size()); }
 
 	// Send specific types of data. These can be called from any thread.
 	void initWrite(void);
@@ -87,6 +91,12 @@ public:
 	inline void writeFloat(float f);
 	inline void writeByteV(ByteV const& v);
 	inline void writeString(std::string const& s);
+	inline void writeData(uint8_t const* data, size_t size);
+	inline void writeData(ConstByteView data) { writeData(data.data(), data.size()); }
+	// Gives whole buffer to be sent without copying it. Contents of
+	// "data" are taken, and it is left empty. In exchange, "data" gets
+	// a buffer that has been sent already, so its memory can be reused.
+	inline void writeAndTake(ByteV& data);
 
 	// Enables lag emulation of received data
 	void enableLagEmulation(Delay const& lag);
@@ -106,6 +116,13 @@ private:
 	};
 	typedef std::list< TimeAndAmount > TimesAndAmounts;
 
+	// Buffers of output, that are sent as they are
+	typedef std::deque< ByteV > Chunks;
+
+	// How many sent buffers are kept for reuse, and how big they may be
+	static size_t const MAX_OUTBUFFER_SPARES = 4;
+	static size_t const MAX_OUTBUFFER_SPARE_SIZE = 1024 * 1024;
+
 	enum State { CONNECTED, CLOSING, CLOSED };
 
 	struct RealConnection
@@ -135,10 +152,17 @@ private:
 		Thread writer_thread;
 		Mutex writer_mutex;
 		Condition writer_cond;
-		// Queue of data to be sent
-		ByteQ outbuffer;
+		// Queue of data to be sent. Buffers are moved here and
+		// given to send() without copying them.
+		Chunks outbuffer;
+		// Buffers that have been sent, for reuse
+		Chunks outbuffer_spares;
+		// Is writer sending a buffer that has been taken from queue
+		bool outbuffer_sending;
 		// Another buffer for pending output and mutex to protect it.
+		// Whole buffers that are pending go before pending bytes.
 		ByteV outbuffer_pending;
+		Chunks outbuffer_pending_chunks;
 		Mutex outbuffer_pending_mutex;
 		Lock* outbuffer_pending_lock;
 		// This condition is for waiting that all data is really sent. It uses
@@ -208,6 +232,9 @@ private:
 	// closing is wanted immediately after some write operations.
 	static void waitUntilAllDataIsSent(RealConnection* rconn);
 
+	// Throws away data that can not be sent anymore
+	static void discardOutput(RealConnection* rconn);
+
 	// connected_mutex must be locked when this is
 	// called! Throws exception if state is "connected".
 	static void waitUntilConnectionIsClosed(RealConnection* rconn);
@@ -244,10 +271,7 @@ inline uint16_t TCPConnection::readUInt16(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 2, "Not enough data in input buffer!");
 	uint8_t result_bytes[2];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 2);
 	return cStrToUInt16(result_bytes);
 }
 
@@ -255,14 +279,7 @@ inline uint32_t TCPConnection::readUInt32(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 4, "Not enough data in input buffer!");
 	uint8_t result_bytes[4];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[2] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[3] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 4);
 	return cStrToUInt32(result_bytes);
 }
 
@@ -270,22 +287,7 @@ inline uint64_t TCPConnection::readUInt64(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 8, "Not enough data in input buffer!");
 	uint8_t result_bytes[8];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[2] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[3] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[4] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[5] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[6] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[7] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 8);
 	return cStrToUInt64(result_bytes);
 }
 
@@ -301,10 +303,7 @@ inline int16_t TCPConnection::readInt16(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 2, "Not enough data in input buffer!");
 	uint8_t result_bytes[2];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 2);
 	return cStrToInt16(result_bytes);
 }
 
@@ -312,14 +311,7 @@ inline int32_t TCPConnection::readInt32(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 4, "Not enough data in input buffer!");
 	uint8_t result_bytes[4];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[2] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[3] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 4);
 	return cStrToInt32(result_bytes);
 }
 
@@ -327,22 +319,7 @@ inline int64_t TCPConnection::readInt64(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 8, "Not enough data in input buffer!");
 	uint8_t result_bytes[8];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[2] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[3] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[4] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[5] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[6] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[7] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 8);
 	return cStrToInt64(result_bytes);
 }
 
@@ -350,25 +327,16 @@ inline float TCPConnection::readFloat(void)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= 4, "Not enough data in input buffer!");
 	uint8_t result_bytes[4];
-	result_bytes[0] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[1] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[2] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
-	result_bytes[3] = rconn->inbuffer_rcv.front();
-	rconn->inbuffer_rcv.pop();
+	rconn->inbuffer_rcv.read(result_bytes, 4);
 	return cStrToFloat(result_bytes);
 }
 
 inline ByteV TCPConnection::readByteV(size_t size)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= size, "Not enough data in input buffer!");
-	ByteV result;
-	result.reserve(size);
-	for (size_t bytes_read = 0; bytes_read < size; bytes_read ++) {
-		result.push_back(rconn->inbuffer_rcv.front());
-		rconn->inbuffer_rcv.pop();
+	ByteV result(size);
+	if (size > 0) {
+		rconn->inbuffer_rcv.read(&result[0], size);
 	}
 	return result;
 }
@@ -376,15 +344,19 @@ inline ByteV TCPConnection::readByteV(size_t size)
 inline std::string TCPConnection::readString(size_t size)
 {
 	HppAssert(rconn->inbuffer_rcv.size() >= size, "Not enough data in input buffer!");
-	std::string result;
-	result.reserve(size);
-	for (size_t bytes_read = 0; bytes_read < size; bytes_read ++) {
-		result.push_back(rconn->inbuffer_rcv.front());
-		rconn->inbuffer_rcv.pop();
+	std::string result(size, '\0');
+	if (size > 0) {
+		rconn->inbuffer_rcv.read(reinterpret_cast< uint8_t* >(&result[0]), size);
 	}
 	return result;
 }
 
+inline void TCPConnection::readData(uint8_t* buf, size_t size)
+{
+	HppAssert(rconn->inbuffer_rcv.size() >= size, "Not enough data in input buffer!");
+	rconn->inbuffer_rcv.read(buf, size);
+}
+
 inline void TCPConnection::writeUInt8(uint8_t i)
 {
 	rconn->outbuffer_pending.push_back(i);
@@ -479,6 +451,31 @@ inline void TCPConnection::writeString(std::string const& s)
 	rconn->outbuffer_pending.insert(rconn->outbuffer_pending.end(), s.begin(), s.end());
 }
 
+inline void TCPConnection::writeData(uint8_t const* data, size_t size)
+{
+	rconn->outbuffer_pending.insert(rconn->outbuffer_pending.end(), data, data + size);
+}
+
+inline void TCPConnection::writeAndTake(ByteV& data)
+{
+	if (data.empty()) {
+		return;
+	}
+	// Bytes that were written earlier must be sent first
+	if (!rconn->outbuffer_pending.empty()) {
+		rconn->outbuffer_pending_chunks.push_back(ByteV());
+		rconn->outbuffer_pending_chunks.back().swap(rconn->outbuffer_pending);
+	}
+	rconn->outbuffer_pending_chunks.push_back(ByteV());
+	rconn->outbuffer_pending_chunks.back().swap(data);
+	Lock writer_lock(rconn->writer_mutex);
+	if (!rconn->outbuffer_spares.empty()) {
+		data.swap(rconn->outbuffer_spares.back());
+		rconn->outbuffer_spares.pop_back();
+		data.clear();
+	}
+}
+
 inline void TCPConnection::closeByRemoteHost(RealConnection* rconn)
 {
 	close(rconn, true);
@@ -38,6 +38,11 @@ void TCPServer::startListening(uint16_t port, ConnHandlerFunc connhandler, void*
 		throw Exception("Unable to create socket for listening port " + sizeToStr(port) + "!");
 	}
 
+	// Port can be listened again right after earlier
+	// server has closed its connections.
+	int reuse = 1;
+	setsockopt(new_soc, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
 	// Clear socket address
 	sockaddr_in soc_addr;
 	bzero(&soc_addr, sizeof(soc_addr));
@@ -48,9 +53,10 @@ void TCPServer::startListening(uint16_t port, ConnHandlerFunc connhandler, void*
 
 	// Bind socket
 	if (bind(new_soc, reinterpret_cast< sockaddr* >(&soc_addr), sizeof(soc_addr)) == -1) {
+		std::string reason = strerror(errno);
 		shutdown(new_soc, SHUT_RDWR);
 		::close(new_soc);
-		throw Exception("Unable to bind socket for listening port " + sizeToStr(port) + "! Reason: " + std::string(strerror(errno)));
+		throw Exception("Unable to bind socket for listening port " + sizeToStr(port) + "! Reason: " + reason);
 	}
 
 	// Start listening for connections
@@ -143,6 +149,7 @@ void TCPServer::listenerThread(void* linfo_raw)
 	TCPsocket sdlsoc = linfo->sdlsoc;
 	#endif
 	uint16_t port = linfo->port;
+	delete linfo;
 
 	// Wait for new connections
 	do {
@@ -1,6 +1,7 @@
 #include "test3d.h"
 #include "testmisc.h"
 #include "testcast.h"
+#include "testhttp.h"
 
 // Include most of headers so they get tested too
 #include "gui/autogridcontainer.h"
@@ -35,7 +36,10 @@
 #include "angle.h"
 #include "arguments.h"
 #include "assert.h"
+#include "asyncfileio.h"
 #include "axis.h"
+#include "binaryreader.h"
+#include "binarywriter.h"
 #include "bitv.h"
 #include "boundingbox.h"
 #include "boundingconvex.h"
@@ -43,12 +47,18 @@
 #include "boundingvolume.h"
 #include "byteq.h"
 #include "bytev.h"
+#include "byteview.h"
+#include "byteviewreaderbuf.h"
 #include "cast.h"
 #include "charset.h"
 #include "collisions.h"
 #include "collisiontests.h"
 #include "color.h"
+#include "codec.h"
+#include "codecs.h"
+#include "codecstage.h"
 #include "commandexec.h"
+#include "compressiondictionary.h"
 #include "compressor.h"
 #include "concurrencywatcher.h"
 #include "condition.h"
@@ -57,14 +67,20 @@
 #include "datamanagerbase.h"
 #include "debug.h"
 #include "decompressor.h"
+#include "deflatestage.h"
 #include "event.h"
 #include "exception.h"
+#include "fasthash.h"
+#include "istreampipe.h"
 #include "ivector2.h"
 #include "ivector3.h"
 #include "json.h"
+#include "jsonparser.h"
 #include "key.h"
 #include "lock.h"
+#include "lz77codec.h"
 #include "magic.h"
+#include "mappedfile.h"
 #include "matrix3.h"
 #include "matrix4.h"
 #include "memwatch.h"
@@ -72,6 +88,7 @@
 #include "mutex.h"
 #include "noncopyable.h"
 #include "octree.h"
+#include "ostreampipe.h"
 #include "path.h"
 #include "pixelformat.h"
 #include "plane.h"
@@ -79,16 +96,20 @@
 #include "profilermanager.h"
 #include "quaternion.h"
 #include "random.h"
+#include "randomengine.h"
 #include "randomizer.h"
 #include "ray.h"
 #include "rbuf.h"
 #include "real.h"
+#include "reflection.h"
 #include "serializable.h"
 #include "serialize.h"
+#include "streambuf.h"
 #include "thread.h"
 #include "time.h"
 #include "transform2d.h"
 #include "transform.h"
+#include "transportstage.h"
 #include "trigon.h"
 #include "unicode.h"
 #include "unicodestring.h"
@@ -98,6 +119,7 @@
 #include "xmldocument.h"
 #include "xmlnode.h"
 #include "watchdog.h"
+#include "zlibcodec.h"
 
 #include <cstdlib>
 #include <iostream>
@@ -108,11 +130,13 @@ int main(int argc, char** argv)
 	(void)argv;
 
 	srand(time(NULL));
+	Hpp::seedRandom(time(NULL));
 
 	try {
 		Hpp::Tests::test3D();
 		Hpp::Tests::testMisc();
 		Hpp::Tests::testCast();
+		Hpp::Tests::testHttp();
 	}
 	catch (Hpp::Exception const& e)	{
 		std::cerr << "ERROR: " << e.what() << std::endl;
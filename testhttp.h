@@ -0,0 +1,246 @@
+#ifndef HPP_TESTHTTP_H
+#define HPP_TESTHTTP_H
+
+#include "http/client.h"
+#include "http/decompressingsink.h"
+#include "http/server.h"
+#include "tcpconnection.h"
+#include "assert.h"
+#include "bytev.h"
+#include "cast.h"
+#include "compressor.h"
+#include "exception.h"
+#include "test.h"
+
+#include <string>
+#include <vector>
+
+namespace Hpp
+{
+
+namespace Tests
+{
+
+// First port that test server tries
+uint16_t const HTTP_TEST_PORT = 18231;
+
+// Handlers of test server
+inline void httpTestHello(Http::Server::Request const& request, Http::Server::Response& response, void* data)
+{
+	(void)data;
+	response.setContentType("text/plain");
+	response.getBody() = "Hello " + request.path;
+}
+inline void httpTestBig(Http::Server::Request const& request, Http::Server::Response& response, void* big_raw)
+{
+	(void)request;
+	// Copy is given away, so original can be compared to response
+	ByteV body(*reinterpret_cast< ByteV const* >(big_raw));
+	response.setBody(body);
+	HppAssert(body.empty(), "Body of HTTP response was not taken!");
+}
+inline void httpTestCompressed(Http::Server::Request const& request, Http::Server::Response& response, void* compressed_raw)
+{
+	(void)request;
+	ByteV const& compressed = *reinterpret_cast< ByteV const* >(compressed_raw);
+	response.setContentType("application/octet-stream");
+	response.setBody(&compressed[0], compressed.size());
+}
+
+// Collects body that is streamed to client
+inline void httpTestCollect(uint8_t const* data, size_t size, void* result_raw)
+{
+	ByteV* result = reinterpret_cast< ByteV* >(result_raw);
+	result->insert(result->end(), data, data + size);
+}
+
+// Result of a transfer that was given to client with a callback
+struct HttpTestCompletion
+{
+	size_t calls;
+	bool failed;
+	uint16_t http_code;
+	ByteV body;
+	inline HttpTestCompletion(void) : calls(0), failed(false), http_code(0) { }
+};
+inline void httpTestComplete(Http::Client::Transfer const& transfer, void* completion_raw)
+{
+	HttpTestCompletion* completion = reinterpret_cast< HttpTestCompletion* >(completion_raw);
+	++ completion->calls;
+	completion->failed = transfer.hasFailed();
+	if (!completion->failed) {
+		completion->http_code = transfer.getHttpCode();
+		completion->body = transfer.getResponseData();
+	}
+}
+
+// Reads given amount of responses from connection
+inline void httpTestReadResponses(std::vector< std::string >& heads, std::vector< std::string >& bodies, TCPConnection& conn, size_t amount)
+{
+	heads.clear();
+	bodies.clear();
+	std::string input;
+	size_t pos = 0;
+	while (heads.size() < amount) {
+		size_t head_end = input.find("\r\n\r\n", pos);
+		size_t body_size = 0;
+		if (head_end != std::string::npos) {
+			size_t length_pos = input.find("Content-Length: ", pos);
+			HppAssert(length_pos < head_end, "HTTP response has no length!");
+			length_pos += 16;
+			body_size = strToSize(input.substr(length_pos, input.find("\r\n", length_pos) - length_pos));
+		}
+		if (head_end == std::string::npos || input.size() < head_end + 4 + body_size) {
+			HppAssert(conn.waitForReading(1), "HTTP connection was closed too early!");
+			input += conn.readString(conn.getAmountOfWaitingData());
+			continue;
+		}
+		heads.push_back(input.substr(pos, head_end + 4 - pos));
+		bodies.push_back(input.substr(head_end + 4, body_size));
+		pos = head_end + 4 + body_size;
+	}
+}
+
+inline void testHttp(void)
+{
+	ByteV big;
+	for (size_t i = 0; i < 300000; ++ i) {
+		big.push_back('a' + i % 26);
+	}
+
+	Compressor comp;
+	comp.init();
+	comp.compress(big);
+	ByteV compressed = comp.deinit();
+
+	Http::Server server;
+	server.addRoute("GET", "/hello", httpTestHello);
+	server.addRoute("GET", "/hello/*", httpTestHello);
+	server.addRoute("GET", "/big", httpTestBig, &big);
+	server.addRoute("GET", "/compressed", httpTestCompressed, &compressed);
+	server.addMetricsRoute();
+	// Port may still be reserved by an earlier run, so try a few
+	uint16_t port = HTTP_TEST_PORT;
+	while (true) {
+		try {
+			server.start(port);
+			break;
+		}
+		catch (Exception const&) {
+			if (++ port == HTTP_TEST_PORT + 10) {
+				throw;
+			}
+		}
+	}
+
+	// Test HTTP server
+	{
+		TCPConnection conn("127.0.0.1", port);
+		std::vector< std::string > heads;
+		std::vector< std::string > bodies;
+
+		// Pipelined requests are answered in order
+		conn.initWrite();
+		conn.writeString("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n"
+		                 "GET /big HTTP/1.1\r\n\r\n"
+		                 "GET /missing HTTP/1.1\r\n\r\n"
+		                 "GET /metrics HTTP/1.1\r\n\r\n");
+		conn.deinitWrite();
+		httpTestReadResponses(heads, bodies, conn, 4);
+		HppAssert(heads[0].compare(0, 15, "HTTP/1.1 200 OK") == 0 && bodies[0] == "Hello /hello", "HTTP server has failed!");
+		HppAssert(bodies[1] == std::string(big.begin(), big.end()), "Taken body of HTTP response has failed!");
+		HppAssert(heads[2].compare(0, 12, "HTTP/1.1 404") == 0, "HTTP server did not report missing path!");
+		HppAssert(bodies[3].find("\nhpp_http_requests_total ") != std::string::npos &&
+		          bodies[3].find("\nprocess_resident_memory_bytes ") != std::string::npos, "Metrics of HTTP server have failed!");
+
+		// HTTP/1.0 client must be told that connection is kept alive
+		conn.initWrite();
+		conn.writeString("GET /hello HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+		conn.deinitWrite();
+		httpTestReadResponses(heads, bodies, conn, 1);
+		HppAssert(heads[0].find("\r\nConnection: keep-alive\r\n") != std::string::npos, "HTTP/1.0 keep-alive has failed!");
+		conn.initWrite();
+		conn.writeString("GET /hello HTTP/1.0\r\n\r\n");
+		conn.deinitWrite();
+		httpTestReadResponses(heads, bodies, conn, 1);
+		HppAssert(heads[0].find("\r\nConnection: close\r\n") != std::string::npos && bodies[0] == "Hello /hello", "Closing of HTTP/1.0 connection has failed!");
+		conn.close();
+	}
+
+	// Test HTTP client against the server
+	{
+		std::string url = "http://127.0.0.1:" + sizeToStr(port);
+		Http::Client client;
+		size_t conns_before = server.getStats().connections_total;
+
+		Http::Client::Transfer* hello = client.get(url + "/hello");
+		client.wait(hello);
+		HppAssert(!hello->hasFailed() && hello->getHttpCode() == 200 && hello->getResponseText() == "Hello /hello", "HTTP client has failed!");
+		delete hello;
+
+		// Compressed body is streamed through decompressing sink
+		ByteV result;
+		Http::CallbackSink collect_sink(httpTestCollect, &result);
+		Http::DecompressingSink decomp_sink(&collect_sink);
+		Http::Client::Transfer* big_tr = client.get(url + "/compressed", 0, &decomp_sink);
+		client.wait(big_tr);
+		HppAssert(!big_tr->hasFailed() && big_tr->getHttpCode() == 200, "Compressed transfer of HTTP client has failed!");
+		HppAssert(result == big && decomp_sink.getReceived() == compressed.size(), "Decompressing of HTTP body has failed!");
+		delete big_tr;
+
+		Http::Client::Transfer* missing = client.get(url + "/missing");
+		client.wait(missing);
+		HppAssert(missing->getHttpCode() == 404, "HTTP client did not get missing path!");
+		delete missing;
+
+		// All transfers must have used the same connection
+		HppAssert(server.getStats().connections_total == conns_before + 1, "HTTP client did not reuse connection!");
+	}
+
+	// Test concurrent transfers of HTTP client. All of
+	// them are started before the client is polled.
+	{
+		std::string url = "http://127.0.0.1:" + sizeToStr(port);
+		Http::Client client;
+		size_t const HELLOS = 6;
+		std::vector< HttpTestCompletion > hellos(HELLOS);
+		for (size_t hello_id = 0; hello_id < HELLOS; ++ hello_id) {
+			client.get(url + "/hello/" + sizeToStr(hello_id), httpTestComplete, &hellos[hello_id]);
+		}
+		HttpTestCompletion big_completion;
+		client.get(url + "/big", httpTestComplete, &big_completion);
+		Http::Client::Transfer* big_tr = client.get(url + "/big");
+		HppAssert(client.getAmountOfRunningTransfers() == HELLOS + 2, "HTTP client has wrong amount of transfers!");
+		for (size_t hello_id = 0; hello_id < HELLOS; ++ hello_id) {
+			HppAssert(hellos[hello_id].calls == 0, "HTTP callback was called before client was polled!");
+		}
+
+		client.run();
+
+		for (size_t hello_id = 0; hello_id < HELLOS; ++ hello_id) {
+			HttpTestCompletion const& hello = hellos[hello_id];
+			std::string expected = "Hello /hello/" + sizeToStr(hello_id);
+			HppAssert(hello.calls == 1, "HTTP callback was not called exactly once!");
+			HppAssert(!hello.failed && hello.http_code == 200, "Concurrent transfer of HTTP client has failed!");
+			HppAssert(hello.body == ByteV(expected.begin(), expected.end()), "Concurrent transfer of HTTP client got wrong body!");
+		}
+		HppAssert(big_completion.calls == 1 && !big_completion.failed && big_completion.body == big, "Concurrent big transfer of HTTP client has failed!");
+		HppAssert(big_tr->isFinished() && !big_tr->hasFailed() && big_tr->getResponseData() == big, "Concurrent future of HTTP client has failed!");
+		delete big_tr;
+
+		// Polling again must not call callbacks again
+		client.perform();
+		for (size_t hello_id = 0; hello_id < HELLOS; ++ hello_id) {
+			HppAssert(hellos[hello_id].calls == 1, "HTTP callback was called again!");
+		}
+		HppAssert(big_completion.calls == 1, "HTTP callback was called again!");
+	}
+
+	server.stop();
+}
+
+}
+
+}
+
+#endif
@@ -5,11 +5,45 @@
 #include "collisiontests.h"
 #include "collisions.h"
 #include "sha256hasher.h"
+#include "sha512hasher.h"
+#include "treehasher.h"
+#include "batchhasher.h"
+#include "aes256cbccipher.h"
+#include "aes256ofbcipher.h"
+#include "aes256ctrcipher.h"
+#include "crypto/rsakey.h"
 #include "misc.h"
 #include "assert.h"
 #include "cast.h"
 #include "path.h"
 #include "bytevreaderbuf.h"
+#include "byteq.h"
+#include "byteviewreaderbuf.h"
+#include "mappedfile.h"
+#include "streambuf.h"
+#include "istreampipe.h"
+#include "ostreampipe.h"
+#include "thread.h"
+#include "asyncfileio.h"
+#include "transportpipeline.h"
+#include "deflatestage.h"
+#include "cipherstage.h"
+#include "tcpserver.h"
+#include "tcpconnection.h"
+#include "compressor.h"
+#include "decompressor.h"
+#include "compressiondictionary.h"
+#include "codecs.h"
+#include "fasthash.h"
+#include "randomengine.h"
+#include "byteview.h"
+#include "serialize.h"
+#include "binarywriter.h"
+#include "binaryreader.h"
+#include "reflection.h"
+#include "jsonparser.h"
+#include "http/decompressingsink.h"
+#include "http/streambufsink.h"
 
 namespace Hpp
 {
@@ -17,6 +51,131 @@ namespace Hpp
 namespace Tests
 {
 
+// Structs for testing of reflection
+struct ReflectionTestPart
+{
+	std::string name;
+	bool enabled;
+	template< typename Self, typename Visitor > static void reflect(Self& self, Visitor& visitor)
+	{
+		visitor.field("name", self.name);
+		visitor.field("enabled", self.enabled);
+	}
+};
+
+struct ReflectionTest : public Reflected< ReflectionTest >
+{
+	Vector3 pos;
+	int16_t id;
+	float weights[4];
+	std::vector< uint32_t > indices;
+	std::vector< ReflectionTestPart > parts;
+	std::vector< bool > flags;
+	template< typename Self, typename Visitor > static void reflect(Self& self, Visitor& visitor)
+	{
+		visitor.field("pos", self.pos);
+		visitor.field("id", self.id);
+		visitor.field("weights", self.weights);
+		visitor.field("indices", self.indices);
+		visitor.field("parts", self.parts);
+		visitor.field("flags", self.flags);
+	}
+};
+
+// Receives connection for testing of transport pipeline
+struct TransportTestServer
+{
+	Mutex mutex;
+	Condition cond;
+	TCPConnection* conn;
+};
+inline void transportTestConnHandler(TCPConnection* new_conn, uint16_t port, void* server_raw)
+{
+	(void)port;
+	TransportTestServer* server = reinterpret_cast< TransportTestServer* >(server_raw);
+	Lock lock(server->mutex);
+	server->conn = new_conn;
+	server->cond.signal();
+}
+
+// Callback for testing of asynchronous file I/O
+struct AsyncFileTestResult
+{
+	Mutex mutex;
+	std::vector< int > priorities;
+	ByteV data;
+};
+inline void asyncFileTestCallback(AsyncFileRequest& request, void* result_raw)
+{
+	AsyncFileTestResult* result = reinterpret_cast< AsyncFileTestResult* >(result_raw);
+	Lock lock(result->mutex);
+	result->priorities.push_back(request.getData().size() % 7);
+	if (request.getType() == AsyncFileRequest::READ && !request.failed()) {
+		request.getData().swap(result->data);
+	}
+}
+
+// Writer thread for testing of stream pipes
+inline uint8_t streampipeTestByte(size_t i)
+{
+	return uint8_t(i * 31 + i / 251);
+}
+inline void streampipeTestWriter(void* sbuf_raw)
+{
+	Streambuf* sbuf = reinterpret_cast< Streambuf* >(sbuf_raw);
+	OStreampipe pipe(sbuf);
+	std::ostream strm(&pipe);
+	// Single characters, small writes and big writes
+	size_t const SIZES[] = { 1, 1, 100, 1, 200000, 7, 70000, 3 };
+	size_t pos = 0;
+	for (size_t round = 0; round < 10; ++ round) {
+		for (size_t size_id = 0; size_id < sizeof(SIZES) / sizeof(SIZES[0]); ++ size_id) {
+			std::string data;
+			for (size_t i = 0; i < SIZES[size_id]; ++ i) {
+				data += char(streampipeTestByte(pos ++));
+			}
+			if (data.size() == 1) {
+				strm.put(data[0]);
+			} else {
+				strm.write(data.c_str(), data.size());
+			}
+		}
+	}
+	strm.flush();
+	sbuf->close();
+}
+
+// Handler that writes events of JSON parser to a log
+class JsonTestHandler : public JsonHandler
+{
+public:
+	std::string log;
+	std::vector< Json > subtrees;
+	inline virtual void startObject(void) { log += "{"; }
+	inline virtual void endObject(void) { log += "}"; }
+	inline virtual void startArray(void) { log += "["; }
+	inline virtual void endArray(void) { log += "]"; }
+	inline virtual void key(std::string const& key) { log += "k:" + key + " "; }
+	inline virtual void string(std::string const& str) { log += "s:" + str + " "; }
+	inline virtual void number(double num) { log += "n:" + floatToStr(num) + " "; }
+	inline virtual void integer(int64_t num) { log += "i:" + ssizeToStr(num) + " "; }
+	inline virtual void boolean(bool value) { log += value ? "true " : "false "; }
+	inline virtual void null(void) { log += "null "; }
+	inline virtual void subtree(std::string const& path, Json& json)
+	{
+		log += "t:" + path + " ";
+		subtrees.push_back(Json());
+		subtrees.back().swap(json);
+	}
+};
+
+// Target of HTTP sinks
+inline void httpSinkTestCallback(uint8_t const* data, size_t size, void* result_raw)
+{
+	ByteV* result = reinterpret_cast< ByteV* >(result_raw);
+	result->insert(result->end(), data, data + size);
+}
+
 inline void testMisc(void)
 {
 
@@ -76,6 +235,248 @@ inline void testMisc(void)
 		HppAssert(byteVToHexV(hasher_result3) == "ef537f25c895bfa782526529a9b63d97aa631564d5d789c2b765448c8635fb6c", "SHA-256 hasher has failed!");
 	}
 
+	// Test tree hashing
+	{
+		ByteV data(10500);
+		for (size_t i = 0; i < data.size(); ++ i) {
+			data[i] = i * 7 + i / 100;
+		}
+		TreeHasher< Sha256Hasher > tree(1000, 3);
+		tree.hashData(&data[0], data.size());
+		HppAssert(tree.getLeafHashes().size() == 11, "Tree hasher has wrong amount of leaves!");
+
+		// Root does not depend on threads
+		TreeHasher< Sha256Hasher > tree1(1000, 1);
+		tree1.hashData(&data[0], data.size());
+		HppAssert(tree.getRoot() == tree1.getRoot(), "Tree hashing depends on threads!");
+
+		// Incremental update must give the same result as full hashing
+		data[4321] ^= 0xff;
+		data.resize(12345);
+		tree.markChanged(4321, 1);
+		size_t rehashed = tree.updateData(&data[0], data.size());
+		HppAssert(rehashed == 4, "Tree hasher hashed wrong leaves!");
+		tree1.hashData(&data[0], data.size());
+		HppAssert(tree.getRoot() == tree1.getRoot(), "Incremental tree hashing has failed!");
+		data.resize(2500);
+		tree.updateData(&data[0], data.size());
+		tree1.hashData(&data[0], data.size());
+		HppAssert(tree.getRoot() == tree1.getRoot(), "Incremental tree hashing has failed!");
+
+		// Tree of three leaves
+		Sha256Hasher hasher;
+		ByteV leaf_hashes[3];
+		for (size_t leaf = 0; leaf < 3; ++ leaf) {
+			hasher.addData(ByteV(1, 0x00));
+			hasher.addData(&data[leaf * 1000], std::min(size_t(1000), data.size() - leaf * 1000));
+			hasher.getHash(leaf_hashes[leaf]);
+		}
+		ByteV node;
+		hasher.addData(ByteV(1, 0x01));
+		hasher.addData(leaf_hashes[0]);
+		hasher.addData(leaf_hashes[1]);
+		hasher.getHash(node);
+		hasher.addData(ByteV(1, 0x01));
+		hasher.addData(node);
+		hasher.addData(leaf_hashes[2]);
+		HppAssert(tree.getRoot() == hasher.getHash(), "Tree hasher has calculated wrong root!");
+
+		// Test vectors of Certificate Transparency for RFC 6962
+		char const* const CT_LEAVES[] = { "", "00", "10", "2021", "3031", "40414243", "5051525354555657", "606162636465666768696a6b6c6d6e6f" };
+		char const* const CT_ROOTS[] = {
+			"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+			"6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d",
+			"fac54203e7cc696cf0dfcb42c92a1d9dbaf70ad9e621f4bd8d98662f00e3c125",
+			"aeb6bcfe274b70a14fb067a5e5578264db0fa9b51af5e0ba159158f329e06e77",
+			"d37ee418976dd95753c1c73862b9398fa2a2cf9b4ff0fdfe8b30cd95209614b7",
+			"4e3bbb1f7b478dcfe71fb631631519a3bca12c9aefca1612bfce4c13a86264d4",
+			"76e67dadbcdf1e10e1b74ddc608abd2f98dfb16fbce75277b5232a127f2087ef",
+			"ddb89be403809e325750d3d263cd78929c2942b7942a34b77e122c9594a74c8c",
+			"5dc9da79a70659a9ad559cb701ded9a2ab9d823aad2f4960cfe370eff4604328"
+		};
+		std::vector< ByteV > ct_leaf_hashes;
+		for (size_t leaves = 0; leaves <= 8; ++ leaves) {
+			TreeHasher< Sha256Hasher > ct_tree(1, 1);
+			ct_tree.setLeafHashes(ct_leaf_hashes, leaves);
+			HppAssert(byteVToHexV(ct_tree.getRoot()) == CT_ROOTS[leaves], "Tree hasher does not follow RFC 6962!");
+			if (leaves < 8) {
+				ByteV leaf = hexVToByteV(CT_LEAVES[leaves]);
+				leaf.insert(leaf.begin(), 0x00);
+				hasher.addData(leaf);
+				ct_leaf_hashes.push_back(hasher.getHash());
+			}
+		}
+	}
+
+	// Test batch hashing
+	{
+		std::vector< ByteV > messages;
+		for (size_t message_id = 0; message_id < 200; ++ message_id) {
+			messages.push_back(ByteV(message_id * message_id * 7, message_id));
+		}
+		BatchHasher< Sha256Hasher > batch(3);
+		// Second round uses the same workers
+		for (size_t round = 0; round < 2; ++ round) {
+			ByteV results;
+			batch.hash(results, messages);
+			HppAssert(results.size() == messages.size() * 32, "Batch hasher has returned wrong amount of hashes!");
+			Sha256Hasher hasher;
+			for (size_t message_id = 0; message_id < messages.size(); ++ message_id) {
+				hasher.addData(messages[message_id]);
+				ByteV result(results.begin() + message_id * 32, results.begin() + (message_id + 1) * 32);
+				HppAssert(hasher.getHash() == result, "Batch hashing has failed!");
+			}
+		}
+
+		// Whole message must give the same hash as streaming
+		Sha512Hasher hasher;
+		ByteV message(1000, 0x42);
+		uint8_t result[64];
+		hasher.addData(ByteV(10, 0x17));
+		hasher.hashMessage(result, &message[0], message.size());
+		hasher.addData(message);
+		HppAssert(hasher.getHash() == ByteV(result, result + 64), "Hashing of whole message has failed!");
+	}
+
+	// Test in place encryption
+	{
+		ByteV key(32, 0x42);
+		ByteV iv(16, 0x17);
+		ByteV data;
+		for (size_t i = 0; i < 1000; ++ i) {
+			data.push_back(i * 7);
+		}
+
+		// Result must be the same, no matter if cache, buffer or
+		// in place is used, and how data is split to chunks.
+		AES256CBCCipher cbc_ref(key, iv, true);
+		ByteV cbc_encrypted;
+		cbc_ref.encrypt(data);
+		cbc_ref.readEncrypted(cbc_encrypted, true);
+		HppAssert(cbc_encrypted.size() == 1008, "Padding has failed!");
+
+		AES256CBCCipher cbc(key, iv, true);
+		ByteV chunk1(data.begin(), data.begin() + 100);
+		ByteV chunk2(data.begin() + 100, data.end());
+		cbc.encryptInPlace(chunk1);
+		cbc.encryptInPlace(chunk2, true);
+		chunk1.insert(chunk1.end(), chunk2.begin(), chunk2.end());
+		HppAssert(chunk1 == cbc_encrypted, "In place encryption has failed!");
+
+		ByteV decrypted(data.size() + 32);
+		size_t decrypted_size = cbc.decryptInto(&decrypted[0], decrypted.size(), &cbc_encrypted[0], 500);
+		decrypted_size += cbc.decryptInto(&decrypted[decrypted_size], decrypted.size() - decrypted_size, &cbc_encrypted[500], cbc_encrypted.size() - 500, true);
+		decrypted.resize(decrypted_size);
+		HppAssert(decrypted == data, "Decryption to buffer has failed!");
+
+		// Separate messages with their own initialization vectors
+		AES256OFBCipher ofb(key, iv, false);
+		std::vector< ByteV > messages;
+		std::vector< ByteV > ivs;
+		for (size_t message_id = 0; message_id < 5; ++ message_id) {
+			messages.push_back(ByteV(data.begin(), data.begin() + message_id * 37));
+			ivs.push_back(ByteV(16, message_id));
+		}
+		std::vector< ByteV > encrypted_messages = messages;
+		ofb.encryptMessages(encrypted_messages, ivs);
+		AES256OFBCipher ofb_ref(key, ivs[3], false);
+		ByteV ofb_encrypted;
+		ofb_ref.encrypt(messages[3]);
+		ofb_ref.readEncrypted(ofb_encrypted, true);
+		HppAssert(encrypted_messages[3] == ofb_encrypted, "Encryption of messages has failed!");
+		ofb.decryptMessages(encrypted_messages, ivs);
+		HppAssert(encrypted_messages == messages, "Decryption of messages has failed!");
+	}
+
+	// Test counter mode encryption
+	{
+		// Test vector from NIST SP 800-38A
+		AES256CTRCipher nist(hexVToByteV("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"), hexVToByteV("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"));
+		ByteV nist_result;
+		nist.encrypt(hexVToByteV("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"));
+		nist.readEncrypted(nist_result, true);
+		HppAssert(byteVToHexV(nist_result) == "601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5", "AES-256-CTR has failed!");
+
+		// Multiple threads and splitting must not change
+		// result, even if counter overflows in the middle.
+		ByteV key(32, 0x42);
+		ByteV iv(16, 0xff);
+		iv[15] = 0xf0;
+		ByteV data(300 * 1000);
+		for (size_t i = 0; i < data.size(); ++ i) {
+			data[i] = i * 13;
+		}
+		AES256CTRCipher single(key, iv, 1);
+		ByteV single_result;
+		single.encrypt(data);
+		single.readEncrypted(single_result, true);
+		AES256CTRCipher multi(key, iv, 4);
+		ByteV multi_result(data.begin(), data.begin() + 7);
+		ByteV multi_result2(data.begin() + 7, data.end());
+		multi.encryptInPlace(multi_result);
+		multi.encryptInPlace(multi_result2);
+		multi_result.insert(multi_result.end(), multi_result2.begin(), multi_result2.end());
+		HppAssert(multi_result == single_result, "Parallel AES-256-CTR has failed!");
+		multi.decryptInPlace(multi_result);
+		HppAssert(multi_result == data, "Parallel AES-256-CTR has failed!");
+	}
+
+	// Test RSA envelopes
+	{
+		Crypto::RSAKey private_key = Crypto::RSAKey::generatePrivateKey(1024);
+		Crypto::RSAKey public_key = private_key.generatePublicKey();
+		HppAssert(private_key.hasPrivatePart() && !public_key.hasPrivatePart(), "Generating of RSA keys has failed!");
+		ByteV data(100 * 1000);
+		for (size_t i = 0; i < data.size(); ++ i) {
+			data[i] = i * 7;
+		}
+
+		ByteV envelope;
+		public_key.seal(envelope, data, 2);
+		HppAssert(envelope.size() == public_key.getEnvelopeSize(data.size()), "Sealing of envelope has failed!");
+		ByteV opened;
+		private_key.open(opened, envelope, 2);
+		HppAssert(opened == data, "Opening of envelope has failed!");
+
+		// Copied and serialized keys work too
+		Crypto::RSAKey copied_key(private_key);
+		ByteV key_bytes;
+		private_key.serialize(key_bytes);
+		Crypto::RSAKey deserialized_key;
+		deserialized_key.deserialize(key_bytes);
+		ByteV opened2;
+		copied_key.open(opened2, envelope);
+		ByteV opened3;
+		deserialized_key.open(opened3, envelope);
+		HppAssert(opened2 == data && opened3 == data, "Opening of envelope with copied key has failed!");
+
+		// Modified envelope is rejected
+		for (size_t pos_id = 0; pos_id < 2; ++ pos_id) {
+			ByteV tampered(envelope);
+			tampered[pos_id == 0 ? tampered.size() - 1 : tampered.size() / 2] ^= 1;
+			ByteV tampered_result;
+			bool rejected = false;
+			try {
+				private_key.open(tampered_result, tampered);
+			}
+			catch (Exception const&) {
+				rejected = true;
+			}
+			HppAssert(rejected && tampered_result.empty(), "Modified envelope was not rejected!");
+		}
+
+		// Many envelopes, including empty one
+		std::vector< ByteV > envelopes(5);
+		std::vector< ByteV > datas(5);
+		for (size_t envelope_id = 0; envelope_id < envelopes.size(); ++ envelope_id) {
+			datas[envelope_id] = ByteV(data.begin(), data.begin() + envelope_id * 1000);
+			public_key.seal(envelopes[envelope_id], datas[envelope_id]);
+		}
+		std::vector< ByteV > opened_many;
+		private_key.openMany(opened_many, envelopes, 3);
+		HppAssert(opened_many == datas, "Opening of many envelopes has failed!");
+	}
+
 	// Test path sorting
 	{
 		std::vector< Path > paths;
@@ -238,6 +639,860 @@ inline void testMisc(void)
 		*/
 	}
 
+	// Test compression
+	{
+		ByteV data;
+		for (size_t i = 0; i < 300000; ++ i) {
+			data.push_back(i % 7 == 0 ? i % 251 : 'a' + i % 5);
+		}
+		Compressor comp;
+		comp.init();
+		comp.compress(&data[0], data.size() / 2);
+		ByteV compressed;
+		ByteV chunk;
+		while (comp.readChunk(chunk)) {
+			compressed += chunk;
+		}
+		comp.compress(&data[data.size() / 2], data.size() - data.size() / 2);
+		compressed += comp.deinit();
+
+		Decompressor decomp;
+		decomp.init();
+		decomp.decompress(compressed);
+		ByteV decompressed = decomp.read(1000);
+		HppAssert(decompressed.size() == 1000, "Decompressor returned wrong amount of data!");
+		decompressed += decomp.deinit();
+		HppAssert(decompressed == data, "Compression has failed!");
+
+		ByteV decompressed2(data.size());
+		size_t decompressed2_size = Decompressor::decompress(&decompressed2[0], decompressed2.size(), &compressed[0], compressed.size());
+		HppAssert(decompressed2_size == data.size() && decompressed2 == data, "One-shot decompression has failed!");
+	}
+
+	// Test parallel compression
+	{
+		ByteV data;
+		for (size_t i = 0; i < 700000; ++ i) {
+			data.push_back(i % 13 == 0 ? i % 241 : 'a' + i % 3);
+		}
+		ByteV compressed2;
+		for (size_t threads = 2; threads <= 4; threads += 2) {
+			Compressor comp;
+			comp.init(Compressor::DEFAULT_COMPRESSION, threads);
+			// Second stream reuses worker threads
+			comp.compress(data);
+			comp.finish();
+			ByteV compressed_first = comp.read();
+			comp.reset();
+			comp.compress(&data[0], 100000);
+			comp.compress(&data[100000], data.size() - 100000);
+			comp.finish();
+			ByteV compressed = comp.deinit();
+			HppAssert(compressed == compressed_first, "Parallel compression after reset has failed!");
+			if (threads == 2) {
+				compressed2 = compressed;
+			} else {
+				HppAssert(compressed == compressed2, "Parallel compression depends on amount of threads!");
+			}
+
+			Decompressor decomp;
+			decomp.init();
+			decomp.decompress(compressed);
+			HppAssert(decomp.deinit() == data, "Parallel compression has failed!");
+		}
+	}
+
+	// Test compression dictionary
+	{
+		std::vector< ByteV > samples;
+		for (size_t i = 0; i < 200; ++ i) {
+			std::string sample = "{\"type\":\"update\",\"id\":" + sizeToStr(i * 7919 % 1000) + ",\"position\":[" + sizeToStr(i % 17) + ",0.5,2],\"flags\":[\"visible\",\"alive\"]}";
+			samples.push_back(ByteV(sample.begin(), sample.end()));
+		}
+		CompressionDictionary dict = CompressionDictionary::train(samples, 1024);
+		HppAssert(!dict.getData().empty(), "Training of compression dictionary has failed!");
+
+		Compressor comp;
+		comp.init(Compressor::DEFAULT_COMPRESSION, 1, &dict);
+		Decompressor decomp;
+		decomp.init();
+		decomp.addDictionary(&dict);
+		for (size_t i = 0; i < 3; ++ i) {
+			ByteV const& sample = samples[i * 50];
+			comp.reset();
+			comp.compress(sample);
+			comp.finish();
+			ByteV compressed = comp.read();
+			HppAssert(compressed.size() < sample.size() / 2, "Compression dictionary does not help!");
+			decomp.reset();
+			decomp.decompress(compressed);
+			HppAssert(decomp.isFinished() && decomp.read() == sample, "Decompression with dictionary has failed!");
+		}
+		comp.deinit();
+		decomp.deinit();
+	}
+
+	// Test codecs
+	{
+		ByteV data;
+		for (size_t i = 0; i < 100000; ++ i) {
+			data.push_back(i % 11 == 0 ? i % 239 : 'a' + i % 4);
+		}
+		Lz77Codec lz77;
+		ZlibCodec zlib;
+		Codec* codecs[2] = { &lz77, &zlib };
+		for (size_t codec_id = 0; codec_id < 2; ++ codec_id) {
+			ByteV packed;
+			codecs[codec_id]->pack(packed, data);
+			HppAssert(packed.size() < data.size() / 2, "Codec does not compress!");
+			ByteV unpacked;
+			unpack(unpacked, packed);
+			HppAssert(unpacked == data, "Unpacking has failed!");
+			packed[packed.size() / 2] ^= 0x55;
+			packed.resize(packed.size() - 1);
+			bool error = false;
+			try {
+				unpack(unpacked, packed);
+			}
+			catch (Exception const&) {
+				error = true;
+			}
+			HppAssert(error, "Corrupted data was not detected!");
+		}
+	}
+
+	// Test fast hash
+	{
+		HppAssert(fastHash(std::string()) == ((uint64_t(0xef46db37U) << 32) | 0x51d8e999U), "Fast hash has failed!");
+		HppAssert(fastHash(std::string("abc")) == ((uint64_t(0x44bc2cf5U) << 32) | 0xad770999U), "Fast hash has failed!");
+		HppAssert(fastHash(std::string("Nobody inspects the spammish repetition")) == ((uint64_t(0xfbcea83cU) << 32) | 0x8a378bf1U), "Fast hash has failed!");
+
+		// Streaming must give the same result as one-shot
+		ByteV data(1000);
+		for (size_t i = 0; i < data.size(); ++ i) {
+			data[i] = i * 7;
+		}
+		FastHasher hasher(123);
+		for (size_t ofs = 0; ofs < data.size(); ofs += 13) {
+			hasher.addData(&data[ofs], std::min(size_t(13), data.size() - ofs));
+		}
+		HppAssert(hasher.getHash() == fastHash(data, 123), "Streaming fast hash has failed!");
+		HppAssert(fastHash128(data).low == fastHash(data), "Fast 128 bit hash has failed!");
+		HppAssert(fastHash128(data).high != fastHash(data), "Fast 128 bit hash has failed!");
+
+		HppAssert(fastHash(Vector3(1, -0.0, 2)) == fastHash(Vector3(1, 0, 2)), "Hash of zero and negative zero differ!");
+		HppAssert(fastHash(IVector2(1, 2)) != fastHash(IVector2(2, 1)), "Hash of IVector2 has failed!");
+		HppAssert(FastHash< UnicodeString >()(UnicodeString("abc")) == fastHash(UnicodeString("abc")), "Hash of UnicodeString has failed!");
+	}
+
+	// Test byte views
+	{
+		ByteV data;
+		data += uInt32ToByteV(0x01020304);
+		serializeString(data, "view", 2);
+		data += uInt16ToByteV(7);
+
+		ConstByteView view(data);
+		HppAssert(view.data() == &data[0] && view.size() == data.size(), "Byte view has failed!");
+		HppAssert(deserializeUInt32(view) == 0x01020304, "Deserializing from view has failed!");
+		HppAssert(deserializeString(view, 2) == "view", "Deserializing from view has failed!");
+		ConstByteView rest = deserializeByteView(view, 2);
+		HppAssert(rest.data() == &data[data.size() - 2] && view.empty(), "Deserializing from view has failed!");
+		bool error = false;
+		try {
+			deserializeUInt8(view);
+		}
+		catch (Exception const&) {
+			error = true;
+		}
+		HppAssert(error, "Reading past the end of view was not detected!");
+
+		ByteView mutable_view(data);
+		mutable_view.sub(4, 2)[1] = 5;
+		HppAssert(data[5] == 5, "Mutable byte view has failed!");
+
+		// Hashing and encryption through views
+		Sha256Hasher hasher1;
+		Sha256Hasher hasher2;
+		hasher1.addData(data);
+		hasher2.addData(ConstByteView(data).sub(0, 3));
+		hasher2.addData(ConstByteView(data).sub(3));
+		HppAssert(hasher1.getHash() == hasher2.getHash(), "Hashing of views has failed!");
+
+		ByteV key(AES256CTRCipher::KEY_SIZE, 1);
+		ByteV iv(AES256CTRCipher::IV_SIZE, 2);
+		AES256CTRCipher cipher(key, iv);
+		ByteV encrypted(data.size() + 1);
+		size_t encrypted_size = cipher.encryptInto(encrypted, data);
+		ByteV decrypted(data.size() + 1);
+		size_t decrypted_size = cipher.decryptInto(decrypted, ConstByteView(encrypted).sub(0, encrypted_size));
+		decrypted.resize(decrypted_size);
+		HppAssert(decrypted == data, "Encryption of views has failed!");
+	}
+
+	// Test array serialization
+	{
+		uint16_t u16[19];
+		uint32_t u32[19];
+		uint64_t u64[19];
+		float f[19];
+		for (size_t i = 0; i < 19; ++ i) {
+			u16[i] = 0x0102 + i;
+			u32[i] = 0x01020304 + i;
+			u64[i] = (uint64_t(0x01020304U + i) << 32) | 0x05060708U;
+			f[i] = i * 0.5f - 3;
+		}
+		for (size_t endian = 0; endian < 2; ++ endian) {
+			bool bigendian = endian;
+			ByteV data;
+			serializeArray(data, u16, 19, bigendian);
+			serializeArray(data, u32, 19, bigendian);
+			serializeArray(data, u64, 19, bigendian);
+			serializeArray(data, f, 19, bigendian);
+			HppAssert(data.size() == 19 * 18, "Array serialization has failed!");
+			HppAssert(ByteV(data.begin() + 38 + 4 * 5, data.begin() + 38 + 4 * 6) == uInt32ToByteV(u32[5], bigendian), "Array serialization has failed!");
+			HppAssert(ByteV(data.begin() + 114 + 8 * 17, data.begin() + 114 + 8 * 18) == uInt64ToByteV(u64[17], bigendian), "Array serialization has failed!");
+
+			uint16_t u16_2[19];
+			uint32_t u32_2[19];
+			uint64_t u64_2[19];
+			float f_2[19];
+			ConstByteView view(data);
+			deserializeArray(u16_2, 19, view, bigendian);
+			deserializeArray(u32_2, 19, view, bigendian);
+			deserializeArray(u64_2, 19, view, bigendian);
+			deserializeArray(f_2, 19, view, bigendian);
+			HppAssert(view.empty(), "Array deserialization has failed!");
+			HppAssert(memcmp(u16, u16_2, sizeof(u16)) == 0, "Array deserialization has failed!");
+			HppAssert(memcmp(u32, u32_2, sizeof(u32)) == 0, "Array deserialization has failed!");
+			HppAssert(memcmp(u64, u64_2, sizeof(u64)) == 0, "Array deserialization has failed!");
+			HppAssert(memcmp(f, f_2, sizeof(f)) == 0, "Array deserialization has failed!");
+			ConstByteView view2(data);
+			HppAssert(deserializeUInt16(view2, bigendian) == u16[0], "Array serialization has failed!");
+
+			// Streams are converted in place
+			std::istringstream strm(std::string(data.begin() + 38, data.end()));
+			deserializeArray(u32_2, 19, strm, bigendian);
+			HppAssert(memcmp(u32, u32_2, sizeof(u32)) == 0, "Array deserialization from stream has failed!");
+		}
+	}
+
+	// Test binary writer and reader
+	{
+		uint64_t const uint64_max = (uint64_t(0xffffffffU) << 32) | 0xffffffffU;
+		ByteV data;
+		BinaryWriter writer(data, false);
+		writer.writeVarUInt(0);
+		writer.writeVarUInt(127);
+		writer.writeVarUInt(128);
+		writer.writeVarUInt(uint64_max);
+		HppAssert(data.size() == 1 + 1 + 2 + 10, "Writing of varints has failed!");
+		HppAssert(data[2] == 0x80 && data[3] == 0x01, "Writing of varints has failed!");
+		writer.writeVarInt(-1);
+		writer.writeVarInt(-64);
+		writer.writeVarInt(int64_t(uint64_max >> 1));
+		writer.writeString("binary");
+		writer.writeUInt16(0x0102);
+		writer.writeDouble(-2.5);
+		writer.writeBool(true);
+		Vector3(1, -2, 3).serialize(writer);
+
+		BinaryReader reader(data, false);
+		HppAssert(reader.readVarUInt() == 0, "Reading of varints has failed!");
+		HppAssert(reader.readVarUInt() == 127, "Reading of varints has failed!");
+		HppAssert(reader.readVarUInt() == 128, "Reading of varints has failed!");
+		HppAssert(reader.readVarUInt() == uint64_max, "Reading of varints has failed!");
+		HppAssert(reader.readVarInt() == -1, "Reading of signed varints has failed!");
+		HppAssert(reader.readVarInt() == -64, "Reading of signed varints has failed!");
+		HppAssert(reader.readVarInt() == int64_t(uint64_max >> 1), "Reading of signed varints has failed!");
+		HppAssert(reader.readString() == "binary", "Reading of strings has failed!");
+		HppAssert(reader.readUInt16() == 0x0102, "Reading of integers has failed!");
+		HppAssert(reader.readDouble() == -2.5, "Reading of doubles has failed!");
+		HppAssert(reader.readBool(), "Reading of booleans has failed!");
+		Vector3 v;
+		v.deserialize(reader);
+		HppAssert(v == Vector3(1, -2, 3) && reader.atEnd(), "Deserializing from reader has failed!");
+		bool error = false;
+		try {
+			reader.readUInt8();
+		}
+		catch (Exception const&) {
+			error = true;
+		}
+		HppAssert(error, "Reading past the end was not detected!");
+
+		// Too long varint
+		ByteV bad_varint(11, 0x80);
+		BinaryReader bad_reader(bad_varint);
+		error = false;
+		try {
+			bad_reader.readVarUInt();
+		}
+		catch (Exception const&) {
+			error = true;
+		}
+		HppAssert(error, "Too long varint was not detected!");
+
+		// Format of serializables must stay the same
+		ByteV vec_bytes = Vector3(1, -2, 3).serialize();
+		ByteV old_bytes = floatToByteV(1);
+		old_bytes += floatToByteV(-2);
+		old_bytes += floatToByteV(3);
+		HppAssert(vec_bytes == old_bytes, "Serialization format has changed!");
+		std::istringstream strm(std::string(vec_bytes.begin(), vec_bytes.end()));
+		v.deserialize(strm);
+		HppAssert(v == Vector3(1, -2, 3), "Deserializing from stream has failed!");
+	}
+
+	// Test reflection
+	{
+		ReflectionTest test;
+		test.pos = Vector3(1, 2, -3);
+		test.id = -300;
+		for (size_t i = 0; i < 4; ++ i) {
+			test.weights[i] = i * 0.25f;
+		}
+		test.indices.push_back(7);
+		test.indices.push_back(0x01020304);
+		ReflectionTestPart part;
+		part.name = "wheel";
+		part.enabled = true;
+		test.parts.push_back(part);
+		test.flags.push_back(true);
+		test.flags.push_back(false);
+		test.flags.push_back(true);
+
+		// Binary form is fields in order, and arrays are blocks
+		ByteV data = test.serialize();
+		ByteV expected = test.pos.serialize();
+		expected += int16ToByteV(-300);
+		serializeArray(expected, test.weights, 4);
+		expected.push_back(2);
+		serializeArray(expected, &test.indices[0], 2);
+		expected.push_back(1);
+		expected.push_back(5);
+		expected += ByteV(part.name.begin(), part.name.end());
+		expected.push_back(1);
+		expected.push_back(3);
+		expected.push_back(1);
+		expected.push_back(0);
+		expected.push_back(1);
+		HppAssert(data == expected, "Reflected serialization has failed!");
+
+		ReflectionTest test2;
+		test2.deserialize(data);
+		HppAssert(test2.pos == test.pos && test2.id == test.id, "Reflected deserialization has failed!");
+		HppAssert(memcmp(test2.weights, test.weights, sizeof(test.weights)) == 0, "Reflected deserialization has failed!");
+		HppAssert(test2.indices == test.indices, "Reflected deserialization has failed!");
+		HppAssert(test2.parts.size() == 1 && test2.parts[0].name == "wheel" && test2.parts[0].enabled, "Reflected deserialization has failed!");
+		HppAssert(test2.flags == test.flags, "Reflected deserialization of booleans has failed!");
+
+		// Plain struct without base class
+		ReflectionTestPart part2;
+		deserializeReflected(part2, serializeReflected(part, false), false);
+		HppAssert(part2.name == part.name && part2.enabled, "Reflected deserialization of plain struct has failed!");
+
+		// JSON
+		Json json(test.toJson().encode());
+		HppAssert(json.getMember("id").getInteger() == -300, "Reflected JSON has failed!");
+		HppAssert(json.getMember("parts").getItem(0).getMember("name").getString() == "wheel", "Reflected JSON has failed!");
+		HppAssert(!json.getMember("flags").getItem(1).getBoolean(), "Reflected JSON has failed!");
+		ReflectionTest test3;
+		test3.constructFromJson(json);
+		HppAssert(test3.serialize() == data, "Reflected JSON has failed!");
+		bool error = false;
+		try {
+			reflectedFromJson(part2, Json("{\"name\":\"x\"}"));
+		}
+		catch (Exception const&) {
+			error = true;
+		}
+		HppAssert(error, "Missing member of reflected JSON was not detected!");
+	}
+
+	// Test mapped files
+	{
+		ByteV data;
+		for (size_t i = 0; i < 10000; ++ i) {
+			data.push_back(i * 7);
+		}
+		Path path("hpp_test_mappedfile.tmp");
+		path.writeBytes(data);
+		{
+			MappedFile file;
+			path.mapFile(file, MappedFile::RANDOM);
+			HppAssert(file.isOpen() && file.size() == data.size(), "Mapping of file has failed!");
+			HppAssert(memcmp(file.data(), &data[0], data.size()) == 0, "Mapping of file has failed!");
+			file.advise(4097, 100, MappedFile::WILL_NEED);
+			HppAssert(path.readBytes() == data, "Reading of mapped file has failed!");
+
+			// Reading from view as a stream
+			ByteViewReaderBuf strm(file.getView().sub(9990));
+			char buf[16];
+			strm.read(buf, 16);
+			HppAssert(strm.gcount() == 10 && uint8_t(buf[2]) == uint8_t(9992 * 7), "Reading from view stream has failed!");
+			strm.clear();
+			strm.seekg(1);
+			HppAssert(uint8_t(strm.get()) == uint8_t(9991 * 7), "Seeking in view stream has failed!");
+		}
+		path.writeBytes(ByteV());
+		HppAssert(path.readBytes().empty() && path.readString().empty(), "Reading of empty file has failed!");
+		{
+			MappedFile file;
+			path.mapFile(file);
+			HppAssert(file.isOpen() && file.size() == 0, "Mapping of empty file has failed!");
+		}
+		::remove(path.toString().c_str());
+	}
+
+	// Test asynchronous file I/O
+	std::vector< AsyncFileIO::Backend > async_backends;
+	async_backends.push_back(AsyncFileIO::THREADS);
+	async_backends.push_back(AsyncFileIO::AUTO);
+	#ifdef HPP_USE_IO_URING
+	async_backends.push_back(AsyncFileIO::IO_URING);
+	#endif
+	for (size_t backend_id = 0; backend_id < async_backends.size(); ++ backend_id) {
+		AsyncFileIO::Backend backend = async_backends[backend_id];
+		ByteV data;
+		for (size_t i = 0; i < 100000; ++ i) {
+			data.push_back(i * 13);
+		}
+		Path path("hpp_test_asyncfileio.tmp");
+		AsyncFileTestResult result;
+		{
+			AsyncFileIO io(backend, 2);
+			HppAssert(backend == AsyncFileIO::AUTO || io.getBackend() == backend, "Wrong backend of asynchronous file I/O!");
+			AsyncFileRequest write;
+			io.writeAsync(write, path, data);
+			write.wait();
+			HppAssert(write.isDone() && !write.failed(), "Asynchronous writing has failed!");
+
+			// Batch of reads
+			std::vector< AsyncFileRequest* > reads;
+			for (size_t i = 0; i < 4; ++ i) {
+				reads.push_back(new AsyncFileRequest);
+				reads.back()->setRead(path, i);
+			}
+			io.submit(reads);
+			for (size_t i = 0; i < reads.size(); ++ i) {
+				reads[i]->wait();
+				HppAssert(!reads[i]->failed() && reads[i]->getData() == data, "Asynchronous reading has failed!");
+				delete reads[i];
+			}
+
+			AsyncFileRequest missing;
+			io.readAsync(missing, Path("hpp_test_asyncfileio_missing.tmp"));
+			missing.wait();
+			HppAssert(missing.failed(), "Reading of missing file did not fail!");
+
+			// Invalid batch is rejected without submitting any of it
+			AsyncFileRequest twice;
+			twice.setRead(path);
+			std::vector< AsyncFileRequest* > duplicates(2, &twice);
+			bool rejected = false;
+			try {
+				io.submit(duplicates);
+			}
+			catch (Exception const&) {
+				rejected = true;
+			}
+			HppAssert(rejected && !twice.isPending(), "Submitting of same file request twice has failed!");
+
+			// Request that is owned by service
+			io.readAsync(path, asyncFileTestCallback, &result);
+		}
+		HppAssert(result.priorities.size() == 1 && result.data == data, "Asynchronous reading with callback has failed!");
+
+		// With one thread, requests of one batch are run in order of priority
+		{
+			AsyncFileIO io(AsyncFileIO::THREADS, 1);
+			std::vector< AsyncFileRequest* > writes;
+			for (int priority = 1; priority <= 3; ++ priority) {
+				writes.push_back(new AsyncFileRequest);
+				writes.back()->setWrite(path, ByteV(priority * 2 % 5), priority * 2 % 5);
+				writes.back()->setCallback(asyncFileTestCallback, &result);
+			}
+			result.priorities.clear();
+			io.submit(writes);
+			for (size_t i = 0; i < writes.size(); ++ i) {
+				delete writes[i];
+			}
+		}
+		HppAssert(result.priorities.size() == 3 && result.priorities[0] == 4 && result.priorities[1] == 2 && result.priorities[2] == 1, "Priorities of asynchronous file I/O have failed!");
+		::remove(path.toString().c_str());
+	}
+
+	// Test ring buffer
+	{
+		ByteQ q;
+		uint8_t next_in = 0;
+		uint8_t next_out = 0;
+		// Push and pop so that items wrap around many times
+		for (size_t round = 0; round < 50; ++ round) {
+			for (size_t i = 0; i < 7 + round % 5; ++ i) {
+				q.push(next_in ++);
+			}
+			uint8_t chunk[40];
+			for (size_t i = 0; i < 40; ++ i) {
+				chunk[i] = next_in ++;
+			}
+			q.insert(chunk, chunk + 40);
+			HppAssert((q.capacity() & (q.capacity() - 1)) == 0, "Capacity of ring buffer is not a power of two!");
+			size_t size1, size2;
+			uint8_t const* span1 = q.getFirstSpan(size1);
+			uint8_t const* span2 = q.getSecondSpan(size2);
+			HppAssert(size1 + size2 == q.size() && span1[0] == next_out, "Spans of ring buffer are wrong!");
+			if (size2 > 0) {
+				HppAssert(span2[0] == uint8_t(next_out + size1), "Spans of ring buffer are wrong!");
+			}
+			uint8_t peeked;
+			q.peek(&peeked, 1, 3);
+			HppAssert(peeked == uint8_t(next_out + 3), "Peeking of ring buffer has failed!");
+			HppAssert(q.pop() == next_out ++, "Popping from ring buffer has failed!");
+			q.read(chunk, 30);
+			for (size_t i = 0; i < 30; ++ i) {
+				HppAssert(chunk[i] == next_out ++, "Reading from ring buffer has failed!");
+			}
+			q.consume(10);
+			next_out += 10;
+		}
+		HppAssert(q.size() % 256 == size_t(uint8_t(next_in - next_out)), "Size of ring buffer is wrong!");
+
+		// Writing straight to free space
+		ByteQ q2(q);
+		q2.reserve(q2.size() + 1);
+		size_t free_size;
+		uint8_t* free_span = q2.getWriteSpan(free_size);
+		HppAssert(free_size > 0, "Ring buffer has no free space!");
+		free_span[0] = next_in;
+		q2.commit(1);
+		q2.shrinkToFit();
+		HppAssert(q2.size() == q.size() + 1, "Writing to ring buffer has failed!");
+		q.swap(q2);
+		while (q2.size() > 0) {
+			HppAssert(q.pop() == q2.pop(), "Copying of ring buffer has failed!");
+		}
+		HppAssert(q.size() == 1 && q.front() == next_in, "Swapping of ring buffers has failed!");
+	}
+
+	// Test stream pipes
+	{
+		// Chunks are moved without copying
+		Streambuf sbuf;
+		ByteV chunk(1000, 5);
+		uint8_t const* chunk_data = &chunk[0];
+		sbuf.pushChunk(chunk);
+		uint8_t bytes[] = { 1, 2, 3 };
+		sbuf.pushData(bytes, bytes + 3);
+		ByteV popped;
+		HppAssert(sbuf.popChunk(popped) && &popped[0] == chunk_data && popped.size() == 1000, "Moving of chunk has failed!");
+		uint8_t read_bytes[10];
+		HppAssert(sbuf.readData(read_bytes, 10) == 3 && read_bytes[2] == 3, "Reading from Streambuf has failed!");
+		sbuf.close();
+		HppAssert(!sbuf.popChunk(popped) && sbuf.readData(read_bytes, 10) == 0, "Closing of Streambuf has failed!");
+
+		// Writing thread is slowed down by capacity
+		Streambuf sbuf2(100000);
+		IStreampipe strm(&sbuf2);
+		Thread writer(streampipeTestWriter, reinterpret_cast< void* >(&sbuf2));
+		size_t pos = 0;
+		std::vector< char > buf(150000);
+		while (true) {
+			size_t amount = (pos / 3) % buf.size() + 1;
+			strm.read(&buf[0], amount);
+			size_t got = strm.gcount();
+			for (size_t i = 0; i < got; ++ i) {
+				HppAssert(uint8_t(buf[i]) == streampipeTestByte(pos ++), "Reading from stream pipe has failed!");
+			}
+			if (got < amount) {
+				break;
+			}
+			int c = strm.get();
+			if (c == EOF) {
+				break;
+			}
+			HppAssert(uint8_t(c) == streampipeTestByte(pos ++), "Reading from stream pipe has failed!");
+		}
+		writer.wait();
+		HppAssert(pos == 10 * (1 + 1 + 100 + 1 + 200000 + 7 + 70000 + 3), "Stream pipe has lost bytes!");
+
+		// Small flushes share chunks, so memory is not wasted
+		Streambuf sbuf3;
+		OStreampipe pipe3(&sbuf3);
+		std::ostream ostrm3(&pipe3);
+		size_t lines_size = 0;
+		for (size_t line_id = 0; line_id < 20000; ++ line_id) {
+			ostrm3 << "Line " << line_id << std::endl;
+			lines_size += 6 + sizeToStr(line_id).size();
+		}
+		HppAssert(sbuf3.getMemoryUsage() < lines_size + 2 * 64 * 1024, "Small flushes of stream pipe waste memory!");
+		sbuf3.close();
+		size_t lines_read = 0;
+		size_t got;
+		while ((got = sbuf3.readData(read_bytes, 10)) > 0) {
+			lines_read += got;
+		}
+		HppAssert(lines_read == lines_size && sbuf3.getMemoryUsage() == 0, "Reading of small flushes has failed!");
+	}
+
+	// Test HTTP sinks. Same sink is used for many bodies.
+	{
+		ByteV data;
+		for (size_t i = 0; i < 100000; ++ i) {
+			data.push_back('a' + i % 7 + i % 11);
+		}
+		Compressor comp;
+		comp.init();
+		comp.compress(data);
+		ByteV compressed = comp.deinit();
+
+		ByteV result;
+		Http::CallbackSink callback_sink(httpSinkTestCallback, &result);
+		Http::DecompressingSink decomp_sink(&callback_sink);
+		for (size_t body_id = 0; body_id < 3; ++ body_id) {
+			result.clear();
+			decomp_sink.reset();
+			// The second body is broken, and the next one must still work
+			size_t body_size = body_id == 1 ? compressed.size() / 2 : compressed.size();
+			for (size_t pos = 0; pos < body_size; pos += 1000) {
+				decomp_sink.receive(&compressed[pos], std::min< size_t >(1000, body_size - pos), compressed.size());
+			}
+			if (body_id != 1) {
+				decomp_sink.finish();
+				HppAssert(result == data && callback_sink.getReceived() == data.size(), "Decompressing HTTP sink has failed!");
+			}
+			HppAssert(decomp_sink.getReceived() == body_size, "Decompressing HTTP sink has failed!");
+		}
+
+		Streambuf sbuf;
+		Http::StreambufSink sbuf_sink(&sbuf);
+		for (size_t body_id = 0; body_id < 2; ++ body_id) {
+			sbuf_sink.reset();
+			sbuf_sink.receive(&data[0], data.size(), data.size());
+			sbuf_sink.finish();
+			ByteV sbuf_result;
+			ByteV chunk;
+			while (sbuf.popChunk(chunk)) {
+				sbuf_result += chunk;
+			}
+			HppAssert(sbuf_result == data, "Streambuf HTTP sink has failed!");
+		}
+	}
+
+	// Test streaming JSON parser
+	{
+		std::string doc = " {\"name\": \"l\\u00e4\\ud83d\\ude00\\n\", \"size\": -12, \"scale\": 2.5e1,"
+		                  " \"items\": [ {\"id\": 1, \"meta\": {\"tags\": [\"a\", \"b\"], \"ok\": true}},"
+		                  " {\"id\": 2, \"meta\": null} ], \"empty\": {}, \"none\": [], \"flag\": false } ";
+		std::string expected = "{k:name s:l\xc3\xa4\xf0\x9f\x98\x80\n k:size i:-12 k:scale n:25 "
+		                       "k:items [{k:id i:1 k:meta t:/items/0/meta }{k:id i:2 k:meta t:/items/1/meta }]"
+		                       "k:empty {}k:none []k:flag false }";
+
+		// Result must not depend on how input is split
+		for (size_t chunk_size = 1; chunk_size <= doc.size(); chunk_size += 7) {
+			JsonTestHandler handler;
+			JsonParser parser(&handler);
+			parser.addCapture("/items/*/meta");
+			for (size_t pos = 0; pos < doc.size(); pos += chunk_size) {
+				parser.feed(doc.c_str() + pos, std::min(chunk_size, doc.size() - pos));
+			}
+			parser.finish();
+			HppAssert(handler.log == expected, "Streaming JSON parser has failed!");
+			HppAssert(handler.subtrees.size() == 2, "Capturing of JSON subtrees has failed!");
+			HppAssert(handler.subtrees[0].getMember("tags").getItem(1).getString() == "b", "Capturing of JSON subtrees has failed!");
+			HppAssert(handler.subtrees[0].getMember("ok").getBoolean(), "Capturing of JSON subtrees has failed!");
+			HppAssert(handler.subtrees[1].getType() == Json::NUL, "Capturing of JSON subtrees has failed!");
+		}
+
+		// Capturing whole document gives the same as decoding
+		JsonTestHandler handler;
+		JsonParser parser(&handler);
+		parser.addCapture("");
+		std::string doc2 = "[1, 2.5, \"x\", {\"a\": [true, null]}]";
+		parser.feed(doc2.c_str(), doc2.size());
+		parser.finish();
+		HppAssert(handler.subtrees.size() == 1 && handler.subtrees[0] == Json(doc2), "Capturing of JSON document has failed!");
+
+		// Pull interface
+		ConstByteView doc_view(reinterpret_cast< uint8_t const* >(doc.c_str()), doc.size());
+		JsonReader reader(doc_view);
+		reader.addCapture("/items/1");
+		HppAssert(reader.next() == JsonReader::START_OBJECT, "Pulling of JSON events has failed!");
+		size_t subtrees = 0;
+		while (reader.next() != JsonReader::END_OBJECT) {
+			HppAssert(reader.getEvent() == JsonReader::KEY, "Pulling of JSON events has failed!");
+			std::string key = reader.getString();
+			JsonReader::Event event = reader.next();
+			if (key == "size") {
+				HppAssert(event == JsonReader::NUMBER && reader.isInteger() && reader.getInteger() == -12, "Pulling of JSON number has failed!");
+			} else if (key == "items") {
+				HppAssert(reader.next() == JsonReader::START_OBJECT, "Pulling of JSON events has failed!");
+				reader.skip();
+				HppAssert(reader.next() == JsonReader::SUBTREE && reader.getString() == "/items/1", "Pulling of JSON subtree has failed!");
+				HppAssert(reader.getSubtree().getMember("id").getInteger() == 2, "Pulling of JSON subtree has failed!");
+				HppAssert(reader.next() == JsonReader::END_ARRAY, "Pulling of JSON events has failed!");
+				++ subtrees;
+			} else if (event == JsonReader::START_OBJECT || event == JsonReader::START_ARRAY) {
+				reader.skip();
+			}
+		}
+		HppAssert(subtrees == 1 && reader.next() == JsonReader::END, "Pulling of JSON events has failed!");
+
+		// Limits of integers
+		JsonTestHandler handler2;
+		JsonParser parser2(&handler2);
+		std::string doc3 = "[9223372036854775807, -9223372036854775808, 9223372036854775808]";
+		parser2.feed(doc3.c_str(), doc3.size());
+		parser2.finish();
+		HppAssert(handler2.log == "[i:9223372036854775807 i:-9223372036854775808 n:" + floatToStr(9223372036854775808.0) + " ]", "Parsing of big JSON integers has failed!");
+
+		// Invalid documents
+		char const* invalid[] = { "[1,]", "{\"a\" 1}", "[1] x", "[1", "[01]", "[1.]", "[tru]", "{\"a\":1]", "", "[\"a\\x\"]" };
+		for (size_t invalid_id = 0; invalid_id < sizeof(invalid) / sizeof(invalid[0]); ++ invalid_id) {
+			JsonTestHandler handler3;
+			JsonParser parser3(&handler3);
+			bool error = false;
+			try {
+				parser3.feed(invalid[invalid_id], strlen(invalid[invalid_id]));
+				parser3.finish();
+			}
+			catch (Exception const&) {
+				error = true;
+			}
+			HppAssert(error, std::string("Invalid JSON \"") + invalid[invalid_id] + "\" was accepted!");
+		}
+	}
+
+	// Test random engine
+	{
+		// Same seed and stream must give the same numbers
+		RandomEngine engine1(42, 3);
+		RandomEngine engine2(42, 3);
+		RandomEngine engine3(42, 4);
+		uint64_t first = engine1.next();
+		HppAssert(first == engine2.next(), "Random engine is not deterministic!");
+		HppAssert(first != engine3.next(), "Streams of random engine are not different!");
+
+		// Bulk filling must give the same numbers as one at a time
+		uint8_t bytes[13];
+		engine1.seed(7);
+		engine1.fill(bytes, sizeof(bytes));
+		engine2.seed(7);
+		uint64_t r = engine2.next();
+		HppAssert(bytes[0] == uint8_t(r) && bytes[7] == uint8_t(r >> 56), "Filling of random bytes has failed!");
+		HppAssert(bytes[8] == uint8_t(engine2.next()), "Filling of random bytes has failed!");
+
+		// Ranges
+		size_t counts[3] = { 0, 0, 0 };
+		for (size_t i = 0; i < 3000; ++ i) {
+			int64_t value = engine1.nextInt(-1, 1);
+			HppAssert(value >= -1 && value <= 1, "Random integer is out of range!");
+			++ counts[value + 1];
+		}
+		HppAssert(counts[0] > 800 && counts[1] > 800 && counts[2] > 800, "Random integers are not uniform!");
+		HppAssert(engine1.nextInt(5, 5) == 5, "Random integer is out of range!");
+		HppAssert(engine1.nextBelow((uint64_t(1) << 40) + 1) <= (uint64_t(1) << 40), "Random integer is out of range!");
+		float floats[101];
+		engine1.fill(floats, 101, -2, 3);
+		int32_t ints[101];
+		engine1.fill(ints, 101, -5, 5);
+		for (size_t i = 0; i < 101; ++ i) {
+			HppAssert(floats[i] >= -2 && floats[i] < 3, "Random float is out of range!");
+			HppAssert(ints[i] >= -5 && ints[i] <= 5, "Random integer is out of range!");
+		}
+
+		// Engine of thread
+		RandomEngine& thread_engine = RandomEngine::getThreadEngine();
+		HppAssert(&thread_engine == &RandomEngine::getThreadEngine(), "Engine of thread has changed!");
+	}
+
+	// Test transport pipeline
+	{
+		ByteV key(32, 0x42);
+		ByteV iv(16, 0x24);
+		DeflateStage deflate1;
+		DeflateStage deflate2;
+		AES256OFBCipher cipher1(key, iv, false);
+		AES256OFBCipher cipher2(key, iv, false);
+		CipherStage cipher_stage1(&cipher1);
+		CipherStage cipher_stage2(&cipher2);
+
+		// Cipher stage alone must keep its stream over messages
+		TransportPipeline cipher_pipeline1;
+		TransportPipeline cipher_pipeline2;
+		cipher_pipeline1.addStage(&cipher_stage1);
+		cipher_pipeline2.addStage(&cipher_stage2);
+		ByteV stream;
+		ByteV stream_encoded;
+		for (size_t test = 0; test < 10; ++ test) {
+			ByteV message(test * 100 + 1, 'a' + test);
+			ByteV encoded;
+			ByteV decoded;
+			cipher_pipeline1.encode(encoded, &message[0], message.size());
+			cipher_pipeline2.decode(decoded, &encoded[0], encoded.size());
+			HppAssert(encoded.size() == message.size() && encoded != message, "Cipher stage has failed!");
+			HppAssert(decoded == message, "Cipher stage has failed!");
+			stream += message;
+			stream_encoded += encoded;
+		}
+		AES256OFBCipher cipher3(key, iv, false);
+		cipher3.encryptInPlace(stream);
+		HppAssert(stream == stream_encoded, "Cipher stage did not work as one stream!");
+
+		TransportPipeline pipeline1;
+		TransportPipeline pipeline2;
+		pipeline1.addStage(&deflate1);
+		pipeline1.addStage(&cipher_stage1);
+		pipeline2.addStage(&deflate2);
+		pipeline2.addStage(&cipher_stage2);
+		for (size_t test = 0; test < 10; ++ test) {
+			ByteV message(test * 1000 + 1, 'a' + test);
+			ByteV encoded;
+			ByteV decoded;
+			pipeline1.encode(encoded, &message[0], message.size());
+			pipeline2.decode(decoded, &encoded[0], encoded.size());
+			HppAssert(decoded == message, "Transport pipeline has failed!");
+		}
+
+		// Send and receive messages over connection. Both
+		// directions use separate streams of same stages.
+		TransportTestServer server;
+		server.conn = NULL;
+		TCPServer listener;
+		uint16_t port = 18251;
+		while (true) {
+			try {
+				listener.startListening(port, transportTestConnHandler, &server);
+				break;
+			}
+			catch (Exception const&) {
+				if (++ port == 18261) {
+					throw;
+				}
+			}
+		}
+		TCPConnection conn("127.0.0.1", port);
+		Lock server_lock(server.mutex);
+		while (!server.conn) {
+			server.cond.wait(server.mutex);
+		}
+		server_lock.unlock();
+		ByteV received;
+		for (size_t test = 0; test < 10; ++ test) {
+			ByteV message(test * 5000, 'k' + test);
+			pipeline1.send(conn, message);
+			HppAssert(pipeline2.receive(*server.conn, received) && received == message, "Receiving from transport pipeline has failed!");
+			ByteV reply(test + 1, 'r');
+			pipeline2.send(*server.conn, reply);
+			HppAssert(pipeline1.receive(conn, received) && received == reply, "Receiving from transport pipeline has failed!");
+		}
+		conn.close();
+		HppAssert(!pipeline2.receive(*server.conn, received), "Closing of transport pipeline was not detected!");
+		delete server.conn;
+		listener.stopListening(port);
+	}
+
 }
 
 }
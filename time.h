@@ -129,8 +129,8 @@ private:
 	static inline std::string padWith(size_t num, size_t desired_len, char padder);
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -685,21 +685,16 @@ inline std::string Time::padWith(size_t num, size_t desired_len, char padder)
 	return result;
 }
 
-inline void Time::doSerialize(ByteV& result, bool bigendian) const
+inline void Time::doSerialize(BinaryWriter& writer) const
 {
-	result += uInt64ToByteV(secs, bigendian);
-	result += uInt32ToByteV(nsecs, bigendian);
+	writer.writeUInt64(secs);
+	writer.writeUInt32(nsecs);
 }
 
-inline void Time::doDeserialize(std::istream& strm, bool bigendian)
+inline void Time::doDeserialize(BinaryReader& reader)
 {
-	char buf[12];
-	strm.read(buf, 12);
-	if (strm.eof()) {
-		throw Exception("Unexpected end of data!");
-	}
-	secs = cStrToUInt64(buf, bigendian);
-	nsecs = cStrToUInt32(buf + 8, bigendian);
+	secs = reader.readUInt64();
+	nsecs = reader.readUInt32();
 }
 
 inline Time operator+(Time const& t, Delay const& d)
@@ -91,8 +91,8 @@ private:
 	Matrix4 transf;
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -279,14 +279,14 @@ inline void Transform::constructFromJson(Json const& json)
 	}
 }
 
-inline void Transform::doSerialize(ByteV& result, bool bigendian) const
+inline void Transform::doSerialize(BinaryWriter& writer) const
 {
-	transf.serialize(result, bigendian);
+	transf.serialize(writer);
 }
 
-inline void Transform::doDeserialize(std::istream& strm, bool bigendian)
+inline void Transform::doDeserialize(BinaryReader& reader)
 {
-	transf.deserialize(strm, bigendian);
+	transf.deserialize(reader);
 }
 
 }
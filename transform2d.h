@@ -67,8 +67,8 @@ private:
 	Matrix3 transf;
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -208,14 +208,14 @@ inline void Transform2D::constructFromJson(Json const& json)
 	}
 }
 
-inline void Transform2D::doSerialize(ByteV& result, bool bigendian) const
+inline void Transform2D::doSerialize(BinaryWriter& writer) const
 {
-	transf.serialize(result, bigendian);
+	transf.serialize(writer);
 }
 
-inline void Transform2D::doDeserialize(std::istream& strm, bool bigendian)
+inline void Transform2D::doDeserialize(BinaryReader& reader)
 {
-	transf.deserialize(strm, bigendian);
+	transf.deserialize(reader);
 }
 
 }
@@ -0,0 +1,195 @@
+#ifndef HPP_TRANSPORTPIPELINE_H
+#define HPP_TRANSPORTPIPELINE_H
+
+#include "transportstage.h"
+#include "tcpconnection.h"
+#include "exception.h"
+#include "cast.h"
+
+#include <vector>
+
+namespace Hpp
+{
+
+// Chain of TransportStages that is used to send and receive messages
+// over TCPConnection. Outgoing messages go through stages in the order
+// they were added and incoming messages in reverse order. Stages work
+// on two buffers that are reused between messages, so after warming up
+// no memory is allocated. Messages are framed with their length. The
+// last stage writes after room for the length, and its whole buffer is
+// given to the connection, that returns a sent buffer in exchange.
+//
+// Pipeline must be used only from one thread at a time. Both ends of
+// connection must use similar stages in same order.
+class TransportPipeline : public NonCopyable
+{
+
+public:
+
+	// Messages that are larger than this are considered broken
+	static size_t const DEFAULT_MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+	inline TransportPipeline(size_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE) : max_message_size(max_message_size) { }
+
+	// Stages are not owned by pipeline
+	inline void addStage(TransportStage* stage) { stages.push_back(stage); }
+
+	// Runs data through stages. Result is not cleared.
+	inline void encode(ByteV& result, uint8_t const* data, size_t data_size);
+	inline void decode(ByteV& result, uint8_t const* data, size_t data_size);
+
+	// Encodes message and writes it to connection
+	inline void send(TCPConnection& conn, uint8_t const* data, size_t data_size);
+	inline void send(TCPConnection& conn, ByteV const& data) { send(conn, data.empty() ? NULL : &data[0], data.size()); }
+
+	// Waits for next message from connection and decodes it to
+	// "message", that is cleared first. Returns false if connection
+	// was closed before whole message was received.
+	inline bool receive(TCPConnection& conn, ByteV& message);
+
+private:
+
+	typedef std::vector< TransportStage* > Stages;
+
+	Stages stages;
+
+	size_t max_message_size;
+
+	// Buffers that stages use in turns
+	ByteV buf1;
+	ByteV buf2;
+
+	// Runs data through stages and returns buffer that contains the
+	// result. If there are no stages, then NULL is returned. Result
+	// begins with "header_size" bytes that are left for the caller.
+	inline ByteV* runEncodingStages(uint8_t const* data, size_t data_size, size_t header_size = 0);
+	inline ByteV* runDecodingStages(uint8_t const* data, size_t data_size);
+
+};
+
+inline void TransportPipeline::encode(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	ByteV const* encoded = runEncodingStages(data, data_size);
+	if (encoded) {
+		result.insert(result.end(), encoded->begin(), encoded->end());
+	} else {
+		result.insert(result.end(), data, data + data_size);
+	}
+}
+
+inline void TransportPipeline::decode(ByteV& result, uint8_t const* data, size_t data_size)
+{
+	ByteV const* decoded = runDecodingStages(data, data_size);
+	if (decoded) {
+		result.insert(result.end(), decoded->begin(), decoded->end());
+	} else {
+		result.insert(result.end(), data, data + data_size);
+	}
+}
+
+inline void TransportPipeline::send(TCPConnection& conn, uint8_t const* data, size_t data_size)
+{
+	// Without stages, data belongs to caller and must be copied
+	if (stages.empty()) {
+		if (data_size > max_message_size) {
+			throw Exception("Message is too big!");
+		}
+		conn.initWrite();
+		conn.writeUInt32(data_size);
+		conn.writeData(data, data_size);
+		conn.deinitWrite();
+		return;
+	}
+
+	ByteV* encoded = runEncodingStages(data, data_size, 4);
+	size_t encoded_size = encoded->size() - 4;
+	if (encoded_size > max_message_size) {
+		throw Exception("Message is too big!");
+	}
+	uInt32ToCStr(encoded_size, &(*encoded)[0]);
+
+	conn.initWrite();
+	conn.writeAndTake(*encoded);
+	conn.deinitWrite();
+}
+
+inline bool TransportPipeline::receive(TCPConnection& conn, ByteV& message)
+{
+	message.clear();
+
+	if (!conn.waitForReading(4)) {
+		return false;
+	}
+	size_t data_size = conn.readUInt32();
+	if (data_size > max_message_size) {
+		throw Exception("Received message is too big!");
+	}
+	if (!conn.waitForReading(data_size)) {
+		return false;
+	}
+
+	// If there are no stages, then read directly to result
+	if (stages.empty()) {
+		message.resize(data_size);
+		if (data_size) {
+			conn.readData(&message[0], data_size);
+		}
+		return true;
+	}
+
+	// Read to one of the buffers and give the buffer
+	// that contains the result to the caller.
+	buf1.resize(data_size);
+	if (data_size) {
+		conn.readData(&buf1[0], data_size);
+	}
+	ByteV* decoded = runDecodingStages(buf1.empty() ? NULL : &buf1[0], buf1.size());
+	message.swap(*decoded);
+	return true;
+}
+
+inline ByteV* TransportPipeline::runEncodingStages(uint8_t const* data, size_t data_size, size_t header_size)
+{
+	ByteV* src = NULL;
+	ByteV* dest = &buf1;
+	for (Stages::iterator stages_it = stages.begin();
+	     stages_it != stages.end();
+	     ++ stages_it) {
+		dest->clear();
+		if (stages_it + 1 == stages.end()) {
+			dest->resize(header_size);
+		}
+		if (src) {
+			(*stages_it)->encode(*dest, src->empty() ? NULL : &(*src)[0], src->size());
+		} else {
+			(*stages_it)->encode(*dest, data, data_size);
+		}
+		src = dest;
+		dest = (dest == &buf1) ? &buf2 : &buf1;
+	}
+	return src;
+}
+
+inline ByteV* TransportPipeline::runDecodingStages(uint8_t const* data, size_t data_size)
+{
+	// Input may be one of the buffers, so start writing to the other one
+	ByteV* src = NULL;
+	ByteV* dest = (data && data == (buf1.empty() ? NULL : &buf1[0])) ? &buf2 : &buf1;
+	for (Stages::reverse_iterator stages_rit = stages.rbegin();
+	     stages_rit != stages.rend();
+	     ++ stages_rit) {
+		dest->clear();
+		if (src) {
+			(*stages_rit)->decode(*dest, src->empty() ? NULL : &(*src)[0], src->size());
+		} else {
+			(*stages_rit)->decode(*dest, data, data_size);
+		}
+		src = dest;
+		dest = (dest == &buf1) ? &buf2 : &buf1;
+	}
+	return src;
+}
+
+}
+
+#endif
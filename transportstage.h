@@ -0,0 +1,34 @@
+#ifndef HPP_TRANSPORTSTAGE_H
+#define HPP_TRANSPORTSTAGE_H
+
+#include "bytev.h"
+#include "noncopyable.h"
+
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// One transformation of TransportPipeline, for example compression or
+// encryption. Stages are stateful streams: messages must be encoded and
+// decoded in the same order. Both functions append their result to the
+// given buffer and must *NOT* clear it.
+class TransportStage : public NonCopyable
+{
+
+public:
+
+	inline TransportStage(void) { }
+	inline virtual ~TransportStage(void) { }
+
+	// Transforms outgoing message
+	virtual void encode(ByteV& result, uint8_t const* data, size_t data_size) = 0;
+
+	// Reverses transformation of incoming message
+	virtual void decode(ByteV& result, uint8_t const* data, size_t data_size) = 0;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef HPP_TREEHASHER_H
+#define HPP_TREEHASHER_H
+
+#include "bytev.h"
+#include "path.h"
+#include "mappedfile.h"
+#include "byteview.h"
+#include "thread.h"
+#include "mutex.h"
+#include "lock.h"
+#include "cores.h"
+#include "exception.h"
+#include "assert.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <new>
+#include <stdint.h>
+
+namespace Hpp
+{
+
+// Hashes big files or buffers as a Merkle tree. Data is split to leaves
+// of fixed size, which are hashed on multiple threads. Leaves are then
+// combined to a tree like in RFC 6962: leaf hashes are prefixed with
+// byte 0x00 and node hashes with 0x01, and every range of leaves is split
+// so that the left part has the largest power of two leaves that is less
+// than the size of the range. Empty data has the hash of empty input as
+// its root. Root depends only on data, leaf size and hash algorithm, not
+// on amount of threads.
+//
+// Hashes of leaves are kept, so when only some parts of data change,
+// only those leaves need to be read and hashed again. Leaf hashes can
+// also be stored, for example next to an asset archive, and given back
+// with setLeafHashes() to continue from them later.
+template< class HasherType > class TreeHasher
+{
+
+public:
+
+	static size_t const DEFAULT_LEAF_SIZE = 1024 * 1024;
+
+	// If threads is zero, all cores are used
+	inline TreeHasher(size_t leaf_size = DEFAULT_LEAF_SIZE, size_t threads = 0);
+
+	// Hashes all data and forgets earlier leaves
+	inline void hashFile(Path const& path);
+	inline void hashData(uint8_t const* data, size_t data_size);
+	inline void hashData(ConstByteView data) { hashData(data.data(), data.size()); }
+
+	// Marks part of data changed. Affected leaves
+	// are hashed again in the next update.
+	inline void markChanged(uint64_t offset, uint64_t size);
+
+	// Hashes leaves that are marked changed. If size of data has changed,
+	// then new leaves and the old last leaf are hashed too, and leaves
+	// past the end are removed. Returns the amount of leaves hashed.
+	inline size_t updateFile(Path const& path);
+	inline size_t updateData(uint8_t const* data, size_t data_size);
+	inline size_t updateData(ConstByteView data) { return updateData(data.data(), data.size()); }
+
+	// Returns the hash of root
+	inline ByteV getRoot(void) const;
+
+	inline size_t getLeafSize(void) const { return leaf_size; }
+	inline uint64_t getDataSize(void) const { return data_size; }
+
+	// Hashes of leaves. These can be stored and given back later,
+	// together with the size of data that they were calculated from.
+	inline std::vector< ByteV > const& getLeafHashes(void) const { return leaves; }
+	inline void setLeafHashes(std::vector< ByteV > const& leaves, uint64_t data_size);
+
+private:
+
+	// Shared state of leaf hashing threads
+	struct Job
+	{
+		TreeHasher* hasher;
+		uint8_t const* data;
+		Mutex mutex;
+		size_t next_todo;
+	};
+
+	struct Worker
+	{
+		Job* job;
+		std::string error;
+	};
+	typedef std::vector< Worker > Workers;
+
+	size_t leaf_size;
+	size_t threads;
+
+	uint64_t data_size;
+	std::vector< ByteV > leaves;
+
+	// Leaves that need to be hashed, in order
+	std::vector< size_t > todo;
+
+	// Resizes leaves to match data size. New
+	// leaves and the old last leaf are marked.
+	inline void setDataSize(uint64_t new_data_size);
+
+	// Hashes leaves in todo
+	inline size_t run(uint8_t const* data);
+
+	static void runWorker(void* worker_raw);
+
+	inline static void hashNode(HasherType& hasher, ByteV& result, ByteV const& left, ByteV const& right);
+
+	// Calculates hash of subtree of given range of leaves
+	inline ByteV hashRange(HasherType& hasher, size_t begin, size_t end) const;
+
+};
+
+template< class HasherType >
+inline TreeHasher< HasherType >::TreeHasher(size_t leaf_size, size_t threads) :
+leaf_size(leaf_size),
+threads(threads),
+data_size(0)
+{
+	if (leaf_size == 0) {
+		throw Exception("Leaf size must not be zero!");
+	}
+	if (this->threads == 0) {
+		this->threads = getNumberOfCores();
+	}
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::hashFile(Path const& path)
+{
+	leaves.clear();
+	todo.clear();
+	data_size = 0;
+	updateFile(path);
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::hashData(uint8_t const* data, size_t data_size)
+{
+	leaves.clear();
+	todo.clear();
+	this->data_size = 0;
+	updateData(data, data_size);
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::markChanged(uint64_t offset, uint64_t size)
+{
+	if (size == 0 || offset >= data_size) {
+		return;
+	}
+	uint64_t end = std::min(offset + size, data_size);
+	for (uint64_t leaf = offset / leaf_size; leaf * leaf_size < end; ++ leaf) {
+		todo.push_back(leaf);
+	}
+}
+
+template< class HasherType >
+inline size_t TreeHasher< HasherType >::updateFile(Path const& path)
+{
+	// Workers read leaves straight from memory map. Leaves
+	// are in random order, so read ahead would be wasted.
+	MappedFile file;
+	path.mapFile(file, MappedFile::RANDOM);
+	setDataSize(file.size());
+	return run(file.data());
+}
+
+template< class HasherType >
+inline size_t TreeHasher< HasherType >::updateData(uint8_t const* data, size_t data_size)
+{
+	setDataSize(data_size);
+	return run(data);
+}
+
+template< class HasherType >
+inline ByteV TreeHasher< HasherType >::getRoot(void) const
+{
+	HasherType hasher;
+	if (leaves.empty()) {
+		return hasher.getHash();
+	}
+	return hashRange(hasher, 0, leaves.size());
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::setLeafHashes(std::vector< ByteV > const& leaves, uint64_t data_size)
+{
+	if (leaves.size() != (data_size + leaf_size - 1) / leaf_size) {
+		throw Exception("Amount of leaf hashes does not match size of data!");
+	}
+	this->leaves = leaves;
+	this->data_size = data_size;
+	todo.clear();
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::setDataSize(uint64_t new_data_size)
+{
+	if (new_data_size == data_size) {
+		return;
+	}
+	size_t old_leaves = leaves.size();
+	size_t new_leaves = (new_data_size + leaf_size - 1) / leaf_size;
+	if (new_leaves != (new_data_size + leaf_size - 1) / leaf_size) {
+		throw Exception("Too much data for tree hasher!");
+	}
+	leaves.resize(new_leaves);
+	// Old last leaf was probably partial
+	if (old_leaves > 0 && old_leaves <= new_leaves) {
+		todo.push_back(old_leaves - 1);
+	}
+	for (size_t leaf = old_leaves; leaf < new_leaves; ++ leaf) {
+		todo.push_back(leaf);
+	}
+	// New last leaf may have been cut
+	if (new_leaves > 0 && new_leaves < old_leaves) {
+		todo.push_back(new_leaves - 1);
+	}
+	data_size = new_data_size;
+}
+
+template< class HasherType >
+inline size_t TreeHasher< HasherType >::run(uint8_t const* data)
+{
+	// Remove duplicates and leaves that do not exist anymore
+	std::sort(todo.begin(), todo.end());
+	todo.erase(std::unique(todo.begin(), todo.end()), todo.end());
+	todo.erase(std::lower_bound(todo.begin(), todo.end(), leaves.size()), todo.end());
+	if (todo.empty()) {
+		return 0;
+	}
+
+	Job job;
+	job.hasher = this;
+	job.data = data;
+	job.next_todo = 0;
+
+	// Run workers. The first one is run by this thread.
+	Workers workers(std::min(threads, todo.size()));
+	for (typename Workers::iterator workers_it = workers.begin();
+	     workers_it != workers.end();
+	     ++ workers_it) {
+		workers_it->job = &job;
+	}
+	std::vector< Thread > workers_threads;
+	workers_threads.reserve(workers.size() - 1);
+	for (size_t worker_id = 1; worker_id < workers.size(); ++ worker_id) {
+		workers_threads.push_back(Thread(runWorker, reinterpret_cast< void* >(&workers[worker_id])));
+	}
+	runWorker(reinterpret_cast< void* >(&workers[0]));
+	for (size_t thread_id = 0; thread_id < workers_threads.size(); ++ thread_id) {
+		workers_threads[thread_id].wait();
+	}
+
+	for (typename Workers::const_iterator workers_it = workers.begin();
+	     workers_it != workers.end();
+	     ++ workers_it) {
+		if (!workers_it->error.empty()) {
+			// Leaves are left marked, so they are tried again
+			throw Exception(workers_it->error);
+		}
+	}
+
+	size_t hashed = todo.size();
+	todo.clear();
+	return hashed;
+}
+
+template< class HasherType >
+void TreeHasher< HasherType >::runWorker(void* worker_raw)
+{
+	Worker& worker = *reinterpret_cast< Worker* >(worker_raw);
+	Job& job = *worker.job;
+	TreeHasher& tree = *job.hasher;
+
+	try {
+		HasherType hasher;
+
+		uint8_t const PREFIX = 0x00;
+		while (true) {
+			size_t leaf;
+			{
+				Lock lock(job.mutex);
+				if (job.next_todo >= tree.todo.size()) {
+					break;
+				}
+				leaf = tree.todo[job.next_todo ++];
+			}
+
+			uint64_t leaf_begin = uint64_t(leaf) * tree.leaf_size;
+			size_t leaf_size = std::min(uint64_t(tree.leaf_size), tree.data_size - leaf_begin);
+			hasher.addData(&PREFIX, 1);
+			hasher.addData(job.data + leaf_begin, leaf_size);
+			hasher.getHash(tree.leaves[leaf]);
+		}
+	}
+	catch (Exception const& e) {
+		worker.error = e.what();
+	}
+	catch (std::bad_alloc const&) {
+		worker.error = "Out of memory in tree hashing!";
+	}
+}
+
+template< class HasherType >
+inline void TreeHasher< HasherType >::hashNode(HasherType& hasher, ByteV& result, ByteV const& left, ByteV const& right)
+{
+	uint8_t const PREFIX = 0x01;
+	hasher.addData(&PREFIX, 1);
+	hasher.addData(left);
+	hasher.addData(right);
+	hasher.getHash(result);
+}
+
+template< class HasherType >
+inline ByteV TreeHasher< HasherType >::hashRange(HasherType& hasher, size_t begin, size_t end) const
+{
+	HppAssert(begin < end, "Range of leaves is empty!");
+	if (end - begin == 1) {
+		return leaves[begin];
+	}
+	size_t split = 1;
+	while (split * 2 < end - begin) {
+		split *= 2;
+	}
+	ByteV left = hashRange(hasher, begin, begin + split);
+	ByteV right = hashRange(hasher, begin + split, end);
+	ByteV result;
+	hashNode(hasher, result, left, right);
+	return result;
+}
+
+}
+
+#endif
@@ -78,8 +78,8 @@ public:
 private:
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -292,22 +292,16 @@ inline void Vector2::constructFromJson(Json const& json)
 	y = json.getItem(1).getNumber();
 }
 
-inline void Vector2::doSerialize(ByteV& result, bool bigendian) const
+inline void Vector2::doSerialize(BinaryWriter& writer) const
 {
-	result.reserve(result.size() + 4*2);
-	result += floatToByteV(x, bigendian);
-	result += floatToByteV(y, bigendian);
+	writer.writeFloat(x);
+	writer.writeFloat(y);
 }
 
-inline void Vector2::doDeserialize(std::istream& strm, bool bigendian)
+inline void Vector2::doDeserialize(BinaryReader& reader)
 {
-	char buf[8];
-	strm.read(buf, 8);
-	if (strm.eof()) {
-		throw Exception("Unexpected end of data!");
-	}
-	x = cStrToFloat(buf, bigendian);
-	y = cStrToFloat(buf + 4, bigendian);
+	x = reader.readFloat();
+	y = reader.readFloat();
 }
 
 }
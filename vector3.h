@@ -79,8 +79,8 @@ public:
 private:
 
 	// Virtual functions needed by superclasses Serializable and Deserializable
-	inline virtual void doSerialize(ByteV& result, bool bigendian) const;
-	inline virtual void doDeserialize(std::istream& strm, bool bigendian);
+	inline virtual void doSerialize(BinaryWriter& writer) const;
+	inline virtual void doDeserialize(BinaryReader& reader);
 
 };
 
@@ -315,24 +315,18 @@ inline void Vector3::constructFromJson(Json const& json)
 	z = json.getItem(2).getNumber();
 }
 
-inline void Vector3::doSerialize(ByteV& result, bool bigendian) const
+inline void Vector3::doSerialize(BinaryWriter& writer) const
 {
-	result.reserve(result.size() + 4*3);
-	result += floatToByteV(x, bigendian);
-	result += floatToByteV(y, bigendian);
-	result += floatToByteV(z, bigendian);
+	writer.writeFloat(x);
+	writer.writeFloat(y);
+	writer.writeFloat(z);
 }
 
-inline void Vector3::doDeserialize(std::istream& strm, bool bigendian)
+inline void Vector3::doDeserialize(BinaryReader& reader)
 {
-	char buf[12];
-	strm.read(buf, 12);
-	if (strm.eof()) {
-		throw Exception("Unexpected end of data!");
-	}
-	x = cStrToFloat(buf, bigendian);
-	y = cStrToFloat(buf + 4, bigendian);
-	z = cStrToFloat(buf + 8, bigendian);
+	x = reader.readFloat();
+	y = reader.readFloat();
+	z = reader.readFloat();
 }
 
 }
@@ -0,0 +1,47 @@
+#ifndef HPP_ZLIBCODEC_H
+#define HPP_ZLIBCODEC_H
+
+#include "codec.h"
+#include "compressor.h"
+#include "decompressor.h"
+
+namespace Hpp
+{
+
+// Codec that uses zlib. Better ratio but much slower than Lz77Codec.
+class ZlibCodec : public Codec
+{
+
+public:
+
+	inline ZlibCodec(int level = Compressor::DEFAULT_COMPRESSION) : level(level) { }
+	inline virtual ~ZlibCodec(void) { }
+
+	inline virtual Id getId(void) const { return ZLIB; }
+
+	inline virtual size_t getMaxCompressedSize(size_t data_size) const { return Compressor::getMaxCompressedSize(data_size); }
+
+	// Deflate can not compress better than about 1:1032
+	inline virtual size_t getMaxDecompressedSize(size_t compressed_size) const { return compressed_size * 1032 + 64; }
+
+	inline virtual size_t compress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size)
+	{
+		return Compressor::compress(result, result_size, data, data_size, level);
+	}
+
+	inline virtual void decompress(uint8_t* result, size_t result_size, uint8_t const* data, size_t data_size)
+	{
+		if (Decompressor::decompress(result, result_size, data, data_size) != result_size) {
+			throw Exception("Corrupted data!");
+		}
+	}
+
+private:
+
+	int level;
+
+};
+
+}
+
+#endif